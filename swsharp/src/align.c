@@ -25,6 +25,7 @@ Contact the author by mkorpar@gmail.com.
 #include <string.h>
 
 #include "alignment.h"
+#include "anchor.h"
 #include "chain.h"
 #include "constants.h"
 #include "cpu_module.h"
@@ -34,12 +35,12 @@ Contact the author by mkorpar@gmail.com.
 #include "reconstruct.h"
 #include "scorer.h"
 #include "threadpool.h"
+#include "tune.h"
 #include "utils.h"
 
 #include "align.h"
 
 #define GPU_MIN_LEN     256
-#define GPU_MIN_CELLS   1000000.0
 
 #define HW_DATA             0
 #define NW_DATA             1
@@ -74,6 +75,18 @@ typedef struct ContextPair {
     int cardsLen;
 } ContextPair;
 
+typedef struct ContextAnchored {
+    Alignment** alignment;
+    int type;
+    Chain* query;
+    Chain* target;
+    Scorer* scorer;
+    int seedLen;
+    int xDrop;
+    int* cards;
+    int cardsLen;
+} ContextAnchored;
+
 typedef struct ContextScore {
     int* score;
     AlignData** data;
@@ -85,6 +98,33 @@ typedef struct ContextScore {
     int cardsLen;
 } ContextScore;
 
+typedef struct ContextPairs {
+    Alignment** alignments;
+    int* scores;
+    int type;
+    Chain** queries;
+    Chain** targets;
+    int pairsLen;
+    Scorer* scorer;
+    int* cards;
+    int cardsLen;
+} ContextPairs;
+
+typedef struct ContextPairsCpu {
+    int* scores;
+    int type;
+    Chain** queries;
+    Chain** targets;
+    int pairsLen;
+    Scorer* scorer;
+} ContextPairsCpu;
+
+typedef struct PairLength {
+    int idx;
+    int shorter;
+    int longer;
+} PairLength;
+
 typedef struct HwData {
     int score;
     int queryEnd;
@@ -156,8 +196,20 @@ extern void alignBest(Alignment** alignment, int type, Chain** queries,
     int queriesLen, Chain* target, Scorer* scorer, int* cards, int cardsLen, 
     Thread* thread);
 
+extern void alignPairAnchored(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int seedLen, int xDrop, int* cards, 
+    int cardsLen, Thread* thread);
+
 extern void scorePair(int* score, int type, Chain* query, Chain* target, 
     Scorer* scorer, int* cards, int cardsLen, Thread* thread);
+
+extern void alignPairs(Alignment** alignments, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread);
+
+extern void scorePairs(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread);
     
 //******************************************************************************
 
@@ -168,8 +220,30 @@ static void* alignPairThread(void* param);
 
 static void* alignBestThread(void* param);
 
+static void* alignPairAnchoredThread(void* param);
+
+static void anchoredExtend(char* path, int* pathLen, int* queryLen, 
+    int* targetLen, int* score, Chain* query, int queryStart, int queryEnd, 
+    Chain* target, int targetStart, int targetEnd, Scorer* scorer, int xDrop, 
+    int reverse);
+
+static void anchoredGap(char* path, int* pathLen, int* score, Chain* query, 
+    int queryStart, int queryEnd, Chain* target, int targetStart, int targetEnd, 
+    Scorer* scorer, int* cards, int cardsLen);
+
+static void anchoredTrim(char* path, int* pathLen, int* queryStart, 
+    int* targetStart, int* score, Chain* query, Chain* target, Scorer* scorer);
+
 static void* scorePairThread(void* param);
 
+static void* scorePairDualThread(void* param);
+
+static void* pairsThread(void* param);
+
+static void* scorePairsCpuThread(void* param);
+
+static int pairLengthCmp(const void* a_, const void* b_);
+
 static int scorePairGpu(AlignData** data, int type, Chain* query, Chain* target, 
     Scorer* scorer, int score, int* cards, int cardsLen);
     
@@ -283,6 +357,29 @@ extern void alignBest(Alignment** alignment, int type, Chain** queries,
     }
 }
 
+extern void alignPairAnchored(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int seedLen, int xDrop, int* cards, 
+    int cardsLen, Thread* thread) {
+
+    ContextAnchored* param = (ContextAnchored*) malloc(sizeof(ContextAnchored));
+
+    param->alignment = alignment;
+    param->type = type;
+    param->query = query;
+    param->target = target;
+    param->scorer = scorer;
+    param->seedLen = seedLen;
+    param->xDrop = xDrop;
+    param->cards = cards;
+    param->cardsLen = cardsLen;
+
+    if (thread == NULL) {
+        alignPairAnchoredThread(param);
+    } else {
+        threadCreate(thread, alignPairAnchoredThread, (void*) param);
+    }
+}
+
 extern void scorePair(int* score, int type, Chain* query, Chain* target, 
     Scorer* scorer, int* cards, int cardsLen, Thread* thread) {
     
@@ -304,6 +401,52 @@ extern void scorePair(int* score, int type, Chain* query, Chain* target,
     }
 }
 
+extern void alignPairs(Alignment** alignments, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread) {
+
+    ContextPairs* param = (ContextPairs*) malloc(sizeof(ContextPairs));
+
+    param->alignments = alignments;
+    param->scores = NULL; // scores are kept in the alignments
+    param->type = type;
+    param->queries = queries;
+    param->targets = targets;
+    param->pairsLen = pairsLen;
+    param->scorer = scorer;
+    param->cards = cards;
+    param->cardsLen = cardsLen;
+
+    if (thread == NULL) {
+        pairsThread(param);
+    } else {
+        threadCreate(thread, pairsThread, (void*) param);
+    }
+}
+
+extern void scorePairs(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread) {
+
+    ContextPairs* param = (ContextPairs*) malloc(sizeof(ContextPairs));
+
+    param->alignments = NULL; // not needed
+    param->scores = scores;
+    param->type = type;
+    param->queries = queries;
+    param->targets = targets;
+    param->pairsLen = pairsLen;
+    param->scorer = scorer;
+    param->cards = cards;
+    param->cardsLen = cardsLen;
+
+    if (thread == NULL) {
+        pairsThread(param);
+    } else {
+        threadCreate(thread, pairsThread, (void*) param);
+    }
+}
+
 //******************************************************************************
     
 //******************************************************************************
@@ -329,7 +472,7 @@ static void* alignPairThread(void* param) {
     int cols = chainGetLength(target);
     double cells = (double) rows * cols;
 
-    if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS || cardsLen == 0) {
+    if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS) || cardsLen == 0) {
         if (score == NO_SCORE) {
             alignPairCpu(alignment, type, query, target, scorer);
         } else {
@@ -396,7 +539,7 @@ static void* alignBestThread(void* param) {
         context->target = target;
         context->scorer = scorer;
 
-        if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS || cardsLen == 0) {
+        if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS) || cardsLen == 0) {
             contextsCpu[contextsCpuLen++] = context;
             context->cards = NULL;
             context->cardsLen = 0;
@@ -405,8 +548,42 @@ static void* alignBestThread(void* param) {
         }
     }
 
+    // queries of the same length, for example both strands of a nucleotide 
+    // query, are moved to the front in pairs scored in one pass over the target
+    int pairedLen = 0;
+    if (type == SW_ALIGN) {
+
+        int end = contextsCpuLen;
+        while (pairedLen + 1 < end) {
+
+            int rows = chainGetLength(contextsCpu[pairedLen]->query);
+
+            for (j = pairedLen + 1; j < end; ++j) {
+                if (chainGetLength(contextsCpu[j]->query) == rows) {
+                    break;
+                }
+            }
+
+            if (j < end) {
+                SWAP(contextsCpu[pairedLen + 1], contextsCpu[j]);
+                pairedLen += 2;
+            } else {
+                --end;
+                SWAP(contextsCpu[pairedLen], contextsCpu[end]);
+            }
+        }
+    }
+
     for (i = 0; i < contextsCpuLen; ++i) {
-        tasks[i] = threadPoolSubmit(scorePairThread, (void*) contextsCpu[i]);
+        if (i >= pairedLen) {
+            tasks[i] = threadPoolSubmit(scorePairThread, 
+                (void*) contextsCpu[i]);
+        } else if (i % 2 == 0) {
+            tasks[i] = threadPoolSubmit(scorePairDualThread, 
+                (void*) &(contextsCpu[i]));
+        } else {
+            tasks[i] = NULL;
+        }
     }
     
     if (contextsGpuLen) {
@@ -442,10 +619,27 @@ static void* alignBestThread(void* param) {
         free(cardBucketsLens);
     }
 
+    // scores which overflowed in pairs are solved one by one
+    for (i = 0; i < pairedLen; ++i) {
+
+        if (tasks[i] != NULL) {
+            threadPoolTaskWait(tasks[i]);
+            threadPoolTaskDelete(tasks[i]);
+            tasks[i] = NULL;
+        }
+
+        if (*(contextsCpu[i]->score) == -1) {
+            tasks[i] = threadPoolSubmit(scorePairThread, 
+                (void*) contextsCpu[i]);
+        }
+    }
+
     // wait for cpu tasks
     for (i = 0; i < contextsCpuLen; ++i) {
-        threadPoolTaskWait(tasks[i]);
-        threadPoolTaskDelete(tasks[i]);
+        if (tasks[i] != NULL) {
+            threadPoolTaskWait(tasks[i]);
+            threadPoolTaskDelete(tasks[i]);
+        }
         free(contextsCpu[i]);
     }
     
@@ -498,6 +692,154 @@ static void* alignBestThread(void* param) {
     return NULL;
 }
 
+static void* alignPairAnchoredThread(void* param) {
+
+    ContextAnchored* context = (ContextAnchored*) param;
+
+    Alignment** alignment = context->alignment;
+    int type = context->type;
+    Chain* query = context->query;
+    Chain* target = context->target;
+    Scorer* scorer = context->scorer;
+    int seedLen = context->seedLen;
+    int xDrop = context->xDrop;
+    int* cards = context->cards;
+    int cardsLen = context->cardsLen;
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    Anchor* anchors = NULL;
+    int anchorsLen = 0;
+
+    if (type == SW_ALIGN || type == NW_ALIGN) {
+        anchorsCreate(&anchors, &anchorsLen, query, target, seedLen);
+    }
+
+    if (anchorsLen == 0) {
+
+        alignPair(alignment, type, query, target, scorer, cards, cardsLen, NULL);
+
+        free(anchors);
+        free(param);
+
+        return NULL;
+    }
+
+    int i, j;
+
+    // every move consumes at least one element
+    char* path = (char*) malloc((rows + cols) * sizeof(char));
+    int pathLen = 0;
+    int score = 0;
+
+    //**************************************************************************
+    // SOLVE BEGINNING
+
+    int queryStart = anchors[0].queryStart;
+    int targetStart = anchors[0].targetStart;
+
+    if (type == NW_ALIGN) {
+
+        anchoredGap(path, &pathLen, &score, query, 0, queryStart, target, 0, 
+            targetStart, scorer, cards, cardsLen);
+
+        queryStart = 0;
+        targetStart = 0;
+
+    } else {
+
+        int queryLen;
+        int targetLen;
+
+        anchoredExtend(path, &pathLen, &queryLen, &targetLen, &score, query, 0, 
+            queryStart, target, 0, targetStart, scorer, xDrop, 1);
+
+        queryStart -= queryLen;
+        targetStart -= targetLen;
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // SOLVE ANCHORS
+
+    for (i = 0; i < anchorsLen; ++i) {
+
+        Anchor* anchor = &(anchors[i]);
+
+        for (j = 0; j < anchor->length; ++j) {
+
+            score += scorerScore(scorer, 
+                chainGetCode(query, anchor->queryStart + j), 
+                chainGetCode(target, anchor->targetStart + j));
+
+            path[pathLen++] = MOVE_DIAG;
+        }
+
+        if (i == anchorsLen - 1) {
+            break;
+        }
+
+        Anchor* next = &(anchors[i + 1]);
+
+        anchoredGap(path, &pathLen, &score, query, 
+            anchor->queryStart + anchor->length, next->queryStart, target, 
+            anchor->targetStart + anchor->length, next->targetStart, scorer, 
+            cards, cardsLen);
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // SOLVE END
+
+    Anchor* last = &(anchors[anchorsLen - 1]);
+
+    int queryEnd = last->queryStart + last->length;
+    int targetEnd = last->targetStart + last->length;
+
+    if (type == NW_ALIGN) {
+
+        anchoredGap(path, &pathLen, &score, query, queryEnd, rows, target, 
+            targetEnd, cols, scorer, cards, cardsLen);
+
+    } else {
+
+        int queryLen;
+        int targetLen;
+
+        anchoredExtend(path, &pathLen, &queryLen, &targetLen, &score, query, 
+            queryEnd, rows, target, targetEnd, cols, scorer, xDrop, 0);
+
+        anchoredTrim(path, &pathLen, &queryStart, &targetStart, &score, query, 
+            target, scorer);
+    }
+
+    //**************************************************************************
+
+    queryEnd = queryStart - 1;
+    targetEnd = targetStart - 1;
+
+    for (i = 0; i < pathLen; ++i) {
+        queryEnd += path[i] != MOVE_LEFT;
+        targetEnd += path[i] != MOVE_UP;
+    }
+
+    // local alignment without positive part
+    if (pathLen == 0) {
+        queryStart = queryEnd = targetStart = targetEnd = 0;
+    }
+
+    *alignment = alignmentCreate(query, queryStart, queryEnd, target, 
+        targetStart, targetEnd, score, scorer, path, pathLen);
+
+    free(anchors);
+    free(param);
+
+    return NULL;
+}
+
 static void* scorePairThread(void* param) {
 
     ContextScore* context = (ContextScore*) param;
@@ -515,7 +857,7 @@ static void* scorePairThread(void* param) {
     int cols = chainGetLength(target);
     double cells = (double) rows * cols;
     
-    if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS || cardsLen == 0) {
+    if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS) || cardsLen == 0) {
         *score = scorePairCpu(type, query, target, scorer);
         if (data != NULL) *data = NULL;
     } else {
@@ -526,6 +868,203 @@ static void* scorePairThread(void* param) {
     return NULL;
 }
 
+static void* scorePairDualThread(void* param) {
+
+    ContextScore** contexts = (ContextScore**) param;
+
+    ContextScore* context = contexts[0];
+    ContextScore* context2 = contexts[1];
+
+    scorePairDualCpu(context->score, context2->score, context->type, 
+        context->query, context2->query, context->target, context->scorer);
+
+    if (context->data != NULL) *(context->data) = NULL;
+    if (context2->data != NULL) *(context2->data) = NULL;
+
+    return NULL;
+}
+
+static void* pairsThread(void* param) {
+
+    ContextPairs* context = (ContextPairs*) param;
+
+    Alignment** alignments = context->alignments;
+    int* scores = context->scores;
+    int type = context->type;
+    Chain** queries = context->queries;
+    Chain** targets = context->targets;
+    int pairsLen = context->pairsLen;
+    Scorer* scorer = context->scorer;
+    int* cards = context->cards;
+    int cardsLen = context->cardsLen;
+
+    int i, j;
+
+    if (scores == NULL) {
+        scores = (int*) malloc(pairsLen * sizeof(int));
+    }
+
+    //**************************************************************************
+    // SPLIT PAIRS
+
+    // cpu pairs are sorted by lengths so every task packs pairs of similar size
+    PairLength* order = (PairLength*) malloc(pairsLen * sizeof(PairLength));
+    int orderLen = 0;
+
+    int* gpuIdxs = (int*) malloc(pairsLen * sizeof(int));
+    int gpuIdxsLen = 0;
+
+    for (i = 0; i < pairsLen; ++i) {
+
+        int rows = chainGetLength(queries[i]);
+        int cols = chainGetLength(targets[i]);
+        double cells = (double) rows * cols;
+
+        if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS) || cardsLen == 0) {
+            order[orderLen].idx = i;
+            order[orderLen].shorter = MIN(rows, cols);
+            order[orderLen].longer = MAX(rows, cols);
+            orderLen++;
+        } else {
+            gpuIdxs[gpuIdxsLen++] = i;
+        }
+    }
+
+    qsort(order, orderLen, sizeof(PairLength), pairLengthCmp);
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // SCORE MULTITHREADED
+
+    Chain** cpuQueries = (Chain**) malloc(orderLen * sizeof(Chain*));
+    Chain** cpuTargets = (Chain**) malloc(orderLen * sizeof(Chain*));
+    int* cpuScores = (int*) malloc(orderLen * sizeof(int));
+
+    for (i = 0; i < orderLen; ++i) {
+        cpuQueries[i] = queries[order[i].idx];
+        cpuTargets[i] = targets[order[i].idx];
+    }
+
+    int chunk = (int) tuneGet(TUNE_CPU_THREAD_CHUNK);
+    int tasksLen = (orderLen + chunk - 1) / chunk;
+
+    size_t contextsSize = tasksLen * sizeof(ContextPairsCpu);
+    ContextPairsCpu* contexts = (ContextPairsCpu*) malloc(contextsSize);
+
+    size_t tasksSize = MAX(tasksLen, orderLen) * sizeof(ThreadPoolTask*);
+    ThreadPoolTask** tasks = (ThreadPoolTask**) malloc(tasksSize);
+
+    for (i = 0; i < tasksLen; ++i) {
+
+        int start = i * chunk;
+
+        contexts[i].scores = cpuScores + start;
+        contexts[i].type = type;
+        contexts[i].queries = cpuQueries + start;
+        contexts[i].targets = cpuTargets + start;
+        contexts[i].pairsLen = MIN(chunk, orderLen - start);
+        contexts[i].scorer = scorer;
+
+        tasks[i] = threadPoolSubmit(scorePairsCpuThread, &(contexts[i]));
+    }
+
+    // gpu pairs are solved one by one on all cards while cpu tasks run
+    AlignData** data = NULL;
+
+    if (alignments != NULL) {
+        data = (AlignData**) malloc(gpuIdxsLen * sizeof(AlignData*));
+    }
+
+    for (i = 0; i < gpuIdxsLen; ++i) {
+
+        int idx = gpuIdxs[i];
+
+        scores[idx] = scorePairGpu(data == NULL ? NULL : &(data[i]), type, 
+            queries[idx], targets[idx], scorer, NO_SCORE, cards, cardsLen);
+    }
+
+    for (i = 0; i < tasksLen; ++i) {
+        threadPoolTaskWait(tasks[i]);
+        threadPoolTaskDelete(tasks[i]);
+    }
+
+    for (i = 0; i < orderLen; ++i) {
+        scores[order[i].idx] = cpuScores[i];
+    }
+
+    free(contexts);
+    free(cpuQueries);
+    free(cpuTargets);
+    free(cpuScores);
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // ALIGN MULTITHREADED
+
+    if (alignments != NULL) {
+
+        for (i = 0; i < orderLen; ++i) {
+
+            int idx = order[i].idx;
+
+            // context is deleted by the thread
+            ContextPair* pair = (ContextPair*) malloc(sizeof(ContextPair));
+
+            pair->alignment = &(alignments[idx]);
+            pair->type = type;
+            pair->query = queries[idx];
+            pair->target = targets[idx];
+            pair->scorer = scorer;
+            pair->score = scores[idx];
+            pair->cards = NULL;
+            pair->cardsLen = 0;
+
+            tasks[i] = threadPoolSubmit(alignPairThread, (void*) pair);
+        }
+
+        for (i = 0; i < gpuIdxsLen; ++i) {
+
+            j = gpuIdxs[i];
+
+            reconstructPairGpu(&(alignments[j]), data[i], type, queries[j], 
+                targets[j], scorer, cards, cardsLen);
+
+            free(data[i]->data);
+            free(data[i]);
+        }
+
+        for (i = 0; i < orderLen; ++i) {
+            threadPoolTaskWait(tasks[i]);
+            threadPoolTaskDelete(tasks[i]);
+        }
+
+        free(data);
+        free(scores);
+    }
+
+    //**************************************************************************
+
+    free(tasks);
+    free(order);
+    free(gpuIdxs);
+
+    free(param);
+
+    return NULL;
+}
+
+static void* scorePairsCpuThread(void* param) {
+
+    ContextPairsCpu* context = (ContextPairsCpu*) param;
+
+    scorePairsCpu(context->scores, context->type, context->queries, 
+        context->targets, context->pairsLen, context->scorer);
+
+    return NULL;
+}
+
 static int scorePairGpu(AlignData** data, int type, Chain* query, Chain* target, 
     Scorer* scorer, int score, int* cards, int cardsLen) {
 
@@ -769,7 +1308,7 @@ static void nwFindScoreSpecific(int* queryStart, int* targetStart, Chain* query,
     
     double cells = (double) rows * cols;
     
-    if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS) {
+    if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS)) {
         if (thread == NULL) {
             nwFindScoreCpu(queryStart, targetStart, query, queryFrontGap, target,
                 scorer, score);
@@ -913,7 +1452,7 @@ static void ovFindScoreSpecific(int* queryStart, int* targetStart, Chain* query,
     
     double cells = (double) rows * cols;
     
-    if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS) {
+    if (cols < GPU_MIN_LEN || cells < tuneGet(TUNE_GPU_MIN_CELLS)) {
         if (thread == NULL) {
             ovFindScoreCpu(queryStart, targetStart, query, target, scorer, score);
         } else {
@@ -1355,5 +1894,187 @@ static void swReconstructPairGpuDual(Alignment** alignment, AlignData* data_,
         targetStart, targetEnd, score, scorer, path, pathLen);
 }
     
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// ANCHORED
+
+static void anchoredExtend(char* path, int* pathLen, int* queryLen, 
+    int* targetLen, int* score, Chain* query, int queryStart, int queryEnd, 
+    Chain* target, int targetStart, int targetEnd, Scorer* scorer, int xDrop, 
+    int reverse) {
+
+    *queryLen = 0;
+    *targetLen = 0;
+
+    if (queryStart == queryEnd || targetStart == targetEnd) {
+        return;
+    }
+
+    // beginning is extended on reversed chains, away from the first anchor
+    Chain* queryView = chainCreateView(query, queryStart, queryEnd - 1, reverse);
+    Chain* targetView = chainCreateView(target, targetStart, targetEnd - 1, 
+        reverse);
+
+    char* extension;
+    int extensionLen;
+    int extensionScore;
+
+    xDropExtendCpu(&extension, &extensionLen, queryLen, targetLen, 
+        &extensionScore, queryView, targetView, scorer, xDrop);
+
+    int i;
+    for (i = 0; i < extensionLen; ++i) {
+        int idx = reverse ? extensionLen - i - 1 : i;
+        path[(*pathLen)++] = extension[idx];
+    }
+
+    *score += extensionScore;
+
+    free(extension);
+
+    chainDelete(queryView);
+    chainDelete(targetView);
+}
+
+static void anchoredGap(char* path, int* pathLen, int* score, Chain* query, 
+    int queryStart, int queryEnd, Chain* target, int targetStart, int targetEnd, 
+    Scorer* scorer, int* cards, int cardsLen) {
+
+    int rows = queryEnd - queryStart;
+    int cols = targetEnd - targetStart;
+
+    if (rows == 0 && cols == 0) {
+        return;
+    }
+
+    if (rows == 0 || cols == 0) {
+
+        int gapOpen = scorerGetGapOpen(scorer);
+        int gapExtend = scorerGetGapExtend(scorer);
+
+        int length = rows + cols;
+        char move = rows == 0 ? MOVE_LEFT : MOVE_UP;
+
+        memset(path + *pathLen, move, length);
+        *pathLen += length;
+
+        *score -= gapOpen + (length - 1) * gapExtend;
+
+        return;
+    }
+
+    Chain* queryView = chainCreateView(query, queryStart, queryEnd - 1, 0);
+    Chain* targetView = chainCreateView(target, targetStart, targetEnd - 1, 0);
+
+    Alignment* alignment;
+    alignPair(&alignment, NW_ALIGN, queryView, targetView, scorer, cards, 
+        cardsLen, NULL);
+
+    alignmentCopyPath(alignment, path + *pathLen);
+    *pathLen += alignmentGetPathLen(alignment);
+
+    *score += alignmentGetScore(alignment);
+
+    alignmentDelete(alignment);
+
+    chainDelete(queryView);
+    chainDelete(targetView);
+}
+
+static void anchoredTrim(char* path, int* pathLen, int* queryStart, 
+    int* targetStart, int* score, Chain* query, Chain* target, Scorer* scorer) {
+
+    int gapOpen = scorerGetGapOpen(scorer);
+    int gapExtend = scorerGetGapExtend(scorer);
+
+    int queryIdx = *queryStart;
+    int targetIdx = *targetStart;
+
+    // prefix score, path can be cut only next to the diagonal moves where the
+    // gap state doesn't matter
+    int current = 0;
+
+    int minScore = 0;
+    int minIdx = 0;
+    int minQuery = queryIdx;
+    int minTarget = targetIdx;
+
+    int best = 0;
+    int bestStart = 0;
+    int bestEnd = 0;
+    int bestQuery = queryIdx;
+    int bestTarget = targetIdx;
+
+    char previous = MOVE_DIAG;
+
+    int i;
+    for (i = 0; i < *pathLen; ++i) {
+
+        char move = path[i];
+
+        if (move == MOVE_DIAG) {
+
+            if (current < minScore) {
+                minScore = current;
+                minIdx = i;
+                minQuery = queryIdx;
+                minTarget = targetIdx;
+            }
+
+            current += scorerScore(scorer, chainGetCode(query, queryIdx), 
+                chainGetCode(target, targetIdx));
+
+            queryIdx++;
+            targetIdx++;
+
+            if (current - minScore > best) {
+                best = current - minScore;
+                bestStart = minIdx;
+                bestEnd = i + 1;
+                bestQuery = minQuery;
+                bestTarget = minTarget;
+            }
+
+        } else if (move == MOVE_LEFT) {
+            current -= previous == MOVE_LEFT ? gapExtend : gapOpen;
+            targetIdx++;
+        } else {
+            current -= previous == MOVE_UP ? gapExtend : gapOpen;
+            queryIdx++;
+        }
+
+        previous = move;
+    }
+
+    memmove(path, path + bestStart, bestEnd - bestStart);
+    *pathLen = bestEnd - bestStart;
+
+    *queryStart = bestQuery;
+    *targetStart = bestTarget;
+    *score = best;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// UTILS
+
+static int pairLengthCmp(const void* a_, const void* b_) {
+
+    PairLength* a = (PairLength*) a_;
+    PairLength* b = (PairLength*) b_;
+
+    if (a->shorter != b->shorter) {
+        return a->shorter - b->shorter;
+    }
+
+    if (a->longer != b->longer) {
+        return a->longer - b->longer;
+    }
+
+    return a->idx - b->idx;
+}
+
 //------------------------------------------------------------------------------
 //******************************************************************************
@@ -99,6 +99,33 @@ If needed function utilzes provided CUDA cards.
 extern void alignBest(Alignment** alignment, int type, Chain** queries, 
     int queriesLen, Chain* target, Scorer* scorer, int* cards, int cardsLen, 
     Thread* thread);
+
+/*!
+@brief Anchored pairwise alignment function.
+
+Function is intended for long similar pairs. Exact matches seeded by the k-mers
+unique in the target are chained co-linearly and only the regions between them
+are aligned with Needleman-Wunsch algorithm. Ends are aligned with X-drop 
+extension for #SW_ALIGN and with Needleman-Wunsch algorithm for #NW_ALIGN, local 
+alignment is trimmed to the best scoring part of the chain. Result is heuristic,
+its score can be lower than the one of alignPair(). Other aligning types and 
+pairs without anchors are aligned with alignPair().
+
+@param alignment output alignment object
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query query chain
+@param target target chain
+@param scorer scorer object used for alignment
+@param seedLen seed length
+@param xDrop maximal score drop used for extending local alignment ends
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length
+@param thread thread on which the function will be executed, if NULL function is
+    executed on the current thread
+*/
+extern void alignPairAnchored(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int seedLen, int xDrop, int* cards, 
+    int cardsLen, Thread* thread);
     
 /*!
 @brief Pairwise scoring function.
@@ -119,6 +146,53 @@ If needed function utilzes provided CUDA cards.
 extern void scorePair(int* score, int type, Chain* query, Chain* target, 
     Scorer* scorer, int* cards, int cardsLen, Thread* thread);
 
+/*!
+@brief Independent pairs alignment function.
+
+Function aligns every pair made of queries[i] and targets[i] with the scorer 
+object. Pairs are first scored with scorePairs() and then aligned on the thread 
+pool, so the thread pool must be initialized. If needed function utilzes 
+provided CUDA cards.
+
+@param alignments output alignment objects array of length pairsLen
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param targets target chains array
+@param pairsLen number of pairs
+@param scorer scorer object used for alignment
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length
+@param thread thread on which the function will be executed, if NULL function is
+    executed on the current thread
+*/
+extern void alignPairs(Alignment** alignments, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread);
+
+/*!
+@brief Independent pairs scoring function.
+
+Function returns the alignment score of every pair made of queries[i] and 
+targets[i]. Pairs are sorted by length and split into chunks which are scored 
+on the thread pool, so the thread pool must be initialized. Within a chunk 
+different pairs are packed into the lanes of SIMD registers when the scorer 
+allows it. Pairs large enough for CUDA cards are scored on them.
+
+@param scores output scores array of length pairsLen
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param targets target chains array
+@param pairsLen number of pairs
+@param scorer scorer object used for alignment
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length
+@param thread thread on which the function will be executed, if NULL function is
+    executed on the current thread
+*/
+extern void scorePairs(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer, int* cards, int cardsLen, 
+    Thread* thread);
+
 #ifdef __cplusplus 
 }
 #endif
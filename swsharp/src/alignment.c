@@ -24,6 +24,7 @@ Contact the author by mkorpar@gmail.com.
 #include <string.h>
 
 #include "chain.h"
+#include "path.h"
 #include "scorer.h"
 
 #include "alignment.h"
@@ -37,8 +38,7 @@ struct Alignment {
     int targetEnd;
     int score;
     Scorer* scorer;
-    char* path;
-    int pathLen;
+    Path* path;
 };
 
 //******************************************************************************
@@ -49,9 +49,9 @@ struct Alignment {
 //******************************************************************************
 // PRIVATE
 
-static void unzipPath(char** path, int* pathLen, char* bytes, int bytesLen);
+static Path* unzipPath(char* bytes, int bytesLen);
 
-static void zipPath(char** bytes, int* bytesLen, char* path, int pathLen);
+static void zipPath(char** bytes, int* bytesLen, Path* path);
 
 //******************************************************************************
 
@@ -75,14 +75,15 @@ extern Alignment* alignmentCreate(Chain* query, int queryStart, int queryEnd,
     alignment->targetEnd = targetEnd;
     alignment->score = score;
     alignment->scorer = scorer;
-    alignment->path = path;
-    alignment->pathLen = pathLen;
+    alignment->path = pathCreate(path, pathLen);
+
+    free(path);
     
     return alignment;
 }
 
 extern void alignmentDelete(Alignment* alignment) {
-    free(alignment->path);
+    pathDelete(alignment->path);
     free(alignment); 
     alignment = NULL;
 }
@@ -93,11 +94,23 @@ extern void alignmentDelete(Alignment* alignment) {
 // GETTERS
 
 extern char alignmentGetMove(Alignment* alignment, int index) {
-    return alignment->path[index];
+    return pathGetMove(alignment->path, index);
 }
 
 extern int alignmentGetPathLen(Alignment* alignment) {
-    return alignment->pathLen;
+    return pathGetLen(alignment->path);
+}
+
+extern int alignmentGetRunsLen(Alignment* alignment) {
+    return pathGetRunsLen(alignment->path);
+}
+
+extern char alignmentGetRunMove(Alignment* alignment, int index) {
+    return pathGetRunMove(alignment->path, index);
+}
+
+extern int alignmentGetRunLen(Alignment* alignment, int index) {
+    return pathGetRunLen(alignment->path, index);
 }
 
 extern Chain* alignmentGetQuery(Alignment* alignment) {
@@ -138,7 +151,7 @@ extern int alignmentGetTargetStart(Alignment* alignment) {
 // FUNCTIONS
 
 extern void alignmentCopyPath(Alignment* alignment, char* dest) {
-    memcpy(dest, alignment->path, alignment->pathLen);
+    pathCopyMoves(alignment->path, dest);
 }
 
 extern Alignment* alignmentDeserialize(char* bytes) {
@@ -194,9 +207,7 @@ extern Alignment* alignmentDeserialize(char* bytes) {
     memcpy(pathBytes, bytes + ptr, pathBytesLen);
     ptr += pathBytesLen;
     
-    char* path;
-    int pathLen;
-    unzipPath(&path, &pathLen, pathBytes, pathBytesLen);
+    Path* path = unzipPath(pathBytes, pathBytesLen);
     
     free(pathBytes);
     
@@ -211,7 +222,6 @@ extern Alignment* alignmentDeserialize(char* bytes) {
     alignment->score = score;
     alignment->scorer = scorer;
     alignment->path = path;
-    alignment->pathLen = pathLen;
     
     return alignment;
 }
@@ -232,7 +242,7 @@ extern void alignmentSerialize(char** bytes, int* bytesLen, Alignment* alignment
     
     char* pathBytes;
     int pathBytesLen;
-    zipPath(&pathBytes, &pathBytesLen, alignment->path, alignment->pathLen);
+    zipPath(&pathBytes, &pathBytesLen, alignment->path);
     
     *bytesLen = 0;
     *bytesLen += sizeof(int); // query
@@ -304,16 +314,18 @@ extern void alignmentSerialize(char** bytes, int* bytesLen, Alignment* alignment
 //******************************************************************************
 // PRIVATE
 
-static void unzipPath(char** path, int* pathLen, char* bytes, int bytesLen) {
+static Path* unzipPath(char* bytes, int bytesLen) {
 
     int ptr = 0;
-    
-    memcpy(pathLen, bytes + ptr, sizeof(int));
+
+    int pathLen;
+    memcpy(&pathLen, bytes + ptr, sizeof(int));
     ptr += sizeof(int);
-    
-    *path = (char*) malloc(*pathLen);
-    
-    int offset = 0;
+
+    // stored runs are not limited in length
+    int runsSize = (bytesLen - ptr) / (1 + sizeof(int)) + pathLen / PATH_RUN_MAX;
+    char* runs = (char*) malloc(runsSize + 1);
+    int runsLen = 0;
     
     while (ptr < bytesLen) {
     
@@ -324,15 +336,29 @@ static void unzipPath(char** path, int* pathLen, char* bytes, int bytesLen) {
         int n;
         memcpy(&n, bytes + ptr, sizeof(int));
         ptr += sizeof(int);
-        
-        memset(*path + offset, move, n);
-        offset += n;
+
+        while (n > 0) {
+
+            int length = n < PATH_RUN_MAX ? n : PATH_RUN_MAX;
+
+            runs[runsLen++] = (char) ((move << 6) | (length - 1));
+            n -= length;
+        }
     }
+
+    Path* path = pathCreateFromRuns(runs, runsLen);
+
+    free(runs);
+
+    return path;
 }
 
-static void zipPath(char** bytes, int* bytesLen, char* path, int pathLen) {
+static void zipPath(char** bytes, int* bytesLen, Path* path) {
+
+    int runsLen = pathGetRunsLen(path);
+    int pathLen = pathGetLen(path);
 
-    size_t size = pathLen + pathLen * sizeof(int) + sizeof(int);
+    size_t size = runsLen + runsLen * sizeof(int) + sizeof(int);
     *bytes = (char*) malloc(size);
     
     int ptr = 0;
@@ -340,15 +366,16 @@ static void zipPath(char** bytes, int* bytesLen, char* path, int pathLen) {
     memcpy(*bytes + ptr, &pathLen, sizeof(int));
     ptr += sizeof(int);
     
+    // consecutive runs of the same move are joined
     int i = 0;
-    while (i < pathLen) {
+    while (i < runsLen) {
     
-        char move = path[i];
-        int n = 1;
+        char move = pathGetRunMove(path, i);
+        int n = pathGetRunLen(path, i);
         
-        while (i + 1 < pathLen && move == path[i + 1]) {
+        while (i + 1 < runsLen && move == pathGetRunMove(path, i + 1)) {
             i++;
-            n++;
+            n += pathGetRunLen(path, i);
         }
         
         memcpy(*bytes + ptr, &move, 1);
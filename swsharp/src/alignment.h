@@ -70,11 +70,11 @@ backtracking.
 All off the pairwise sequnce alignment algorithms produce a similiar result.
 Input query and target sequences are stored as ::Chain object. Algorithm scoring
 system is stored as ::Scorer object. Alignment stores the query and target
-start and endpoints as well as the alignment score. Alignment path is stored 
+start and endpoints as well as the alignment score. Alignment path is given 
 as a character array. Every character represents one move and can be #MOVE_LEFT,
 #MOVE_UP or #MOVE_DIAG. Alignment path is stored in format convinient for 
 backtracking, in other words the moves are named by the matrix movement while
-backtracking.
+backtracking. Internally the path is kept run-length encoded.
 */
 typedef struct Alignment Alignment;
 
@@ -84,7 +84,7 @@ typedef struct Alignment Alignment;
 Alignment object is constructed from the query and target sequence aligned and 
 their coresponding start and stop positions, alignment score, scorer which was
 used for alignment and the alignment path. None of the input objects are copied
-via the constructor.
+via the constructor, the path array is encoded and released by the constructor.
 
 @param query query sequnce
 @param queryStart query start position
@@ -132,6 +132,39 @@ extern char alignmentGetMove(Alignment* alignment, int index);
 */
 extern int alignmentGetPathLen(Alignment* alignment);
 
+/*!
+@brief Path runs length getter.
+
+Path is stored run-length encoded, runs are at most 64 moves long and
+consecutive runs can have the same move. Iterating over runs is faster than 
+calling alignmentGetMove() for every move.
+
+@param alignment alignment object 
+
+@return number of path runs
+*/
+extern int alignmentGetRunsLen(Alignment* alignment);
+
+/*!
+@brief Path run move getter.
+
+@param alignment alignment object 
+@param index run index, greater or equal to zero and less than runs length
+
+@return run move
+*/
+extern char alignmentGetRunMove(Alignment* alignment, int index);
+
+/*!
+@brief Path run length getter.
+
+@param alignment alignment object 
+@param index run index, greater or equal to zero and less than runs length
+
+@return number of moves in the run
+*/
+extern int alignmentGetRunLen(Alignment* alignment, int index);
+
 /*!
 @brief Query getter.
 
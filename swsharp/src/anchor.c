@@ -0,0 +1,439 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chain.h"
+#include "error.h"
+#include "utils.h"
+
+#include "anchor.h"
+
+#define SEED_BASE       1099511628211ull
+
+#define SLOT_EMPTY      -1
+
+// repeated seeds keep their position so other hits can still be compared
+#define SLOT_REPEATED(x)    (-(x) - 2)
+#define SLOT_POSITION(x)    ((x) < SLOT_EMPTY ? -(x) - 2 : (x))
+
+typedef struct MatchEnd {
+    int queryEnd;
+    int idx;
+} MatchEnd;
+
+typedef struct SeedTable {
+    int* slots;
+    unsigned int* keys;
+    unsigned long long mask;
+} SeedTable;
+
+//******************************************************************************
+// PUBLIC
+
+extern void anchorsCreate(Anchor** anchors, int* anchorsLen, Chain* query, 
+    Chain* target, int seedLen);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void findMatches(Anchor** matches, int* matchesLen, Chain* query, 
+    Chain* target, int seedLen);
+
+static void chainMatches(Anchor** anchors, int* anchorsLen, Anchor* matches, 
+    int matchesLen, int targetLen);
+
+static void seedTableCreate(SeedTable* table, const char* codes, int length, 
+    int seedLen);
+
+static int seedTableFind(SeedTable* table, const char* codes, int seedLen,
+    const char* seed, unsigned long long hash);
+
+static unsigned long long seedHash(const char* codes, int seedLen);
+
+static unsigned long long seedMix(unsigned long long hash);
+
+static int matchCmp(const void* a_, const void* b_);
+
+static int matchEndCmp(const void* a_, const void* b_);
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+extern void anchorsCreate(Anchor** anchors, int* anchorsLen, Chain* query, 
+    Chain* target, int seedLen) {
+
+    *anchors = NULL;
+    *anchorsLen = 0;
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    if (seedLen <= 0 || rows < seedLen || cols < seedLen) {
+        return;
+    }
+
+    Anchor* matches;
+    int matchesLen;
+    findMatches(&matches, &matchesLen, query, target, seedLen);
+
+    if (matchesLen > 0) {
+        chainMatches(anchors, anchorsLen, matches, matchesLen, cols);
+    }
+
+    LOG("Anchors: %d matches, %d chained", matchesLen, *anchorsLen);
+
+    free(matches);
+}
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void findMatches(Anchor** matches, int* matchesLen, Chain* query, 
+    Chain* target, int seedLen) {
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    const char* queryCodes = chainGetCodes(query);
+    const char* targetCodes = chainGetCodes(target);
+
+    SeedTable table;
+    seedTableCreate(&table, targetCodes, cols, seedLen);
+
+    unsigned long long power = 1;
+
+    int i;
+    for (i = 0; i < seedLen - 1; ++i) {
+        power *= SEED_BASE;
+    }
+
+    int capacity = 1024;
+    int length = 0;
+    Anchor* buffer = (Anchor*) malloc(capacity * sizeof(Anchor));
+
+    int lastDiagonal = 0;
+    int lastEnd = -1;
+
+    unsigned long long hash = seedHash(queryCodes, seedLen);
+
+    for (i = 0; i + seedLen <= rows; ++i) {
+
+        if (i > 0) {
+            hash -= queryCodes[i - 1] * power;
+            hash = hash * SEED_BASE + queryCodes[i + seedLen - 1];
+        }
+
+        // only seeds unique in the target are used
+        int position = seedTableFind(&table, targetCodes, seedLen, 
+            queryCodes + i, hash);
+
+        if (position <= SLOT_EMPTY) {
+            continue;
+        }
+
+        // hit inside of the last match
+        if (position - i == lastDiagonal && i < lastEnd) {
+            continue;
+        }
+
+        int back = 0;
+        while (i - back > 0 && position - back > 0 && 
+            queryCodes[i - back - 1] == targetCodes[position - back - 1]) {
+            back++;
+        }
+
+        int forward = seedLen;
+        while (i + forward < rows && position + forward < cols &&
+            queryCodes[i + forward] == targetCodes[position + forward]) {
+            forward++;
+        }
+
+        if (length == capacity) {
+            capacity *= 2;
+            buffer = (Anchor*) realloc(buffer, capacity * sizeof(Anchor));
+        }
+
+        buffer[length].queryStart = i - back;
+        buffer[length].targetStart = position - back;
+        buffer[length].length = back + forward;
+        length++;
+
+        lastDiagonal = position - i;
+        lastEnd = i + forward;
+    }
+
+    free(table.slots);
+    free(table.keys);
+
+    // matches found from different seeds on interleaved diagonals can repeat
+    qsort(buffer, length, sizeof(Anchor), matchCmp);
+
+    int unique = 0;
+    for (i = 0; i < length; ++i) {
+        if (unique == 0 || matchCmp(&(buffer[unique - 1]), &(buffer[i])) != 0) {
+            buffer[unique++] = buffer[i];
+        }
+    }
+
+    *matches = buffer;
+    *matchesLen = unique;
+}
+
+static void chainMatches(Anchor** anchors, int* anchorsLen, Anchor* matches, 
+    int matchesLen, int targetLen) {
+
+    // matches are sorted by the query start, chain[i] is the best total length
+    // of a chain ending with the i-th match
+    int* chain = (int*) malloc(matchesLen * sizeof(int));
+    int* previous = (int*) malloc(matchesLen * sizeof(int));
+
+    MatchEnd* byEnd = (MatchEnd*) malloc(matchesLen * sizeof(MatchEnd));
+
+    // fenwick tree of the best chains indexed by the match target end
+    int* treeChain = (int*) calloc(targetLen + 1, sizeof(int));
+    int* treeIdx = (int*) malloc((targetLen + 1) * sizeof(int));
+
+    int i, j;
+
+    for (i = 0; i < matchesLen; ++i) {
+        byEnd[i].queryEnd = matches[i].queryStart + matches[i].length;
+        byEnd[i].idx = i;
+        previous[i] = -1;
+    }
+
+    qsort(byEnd, matchesLen, sizeof(MatchEnd), matchEndCmp);
+
+    for (i = 0; i <= targetLen; ++i) {
+        treeIdx[i] = -1;
+    }
+
+    int inserted = 0;
+    int best = 0;
+
+    for (i = 0; i < matchesLen; ++i) {
+
+        Anchor* match = &(matches[i]);
+
+        // insert all matches which end before this one starts in the query
+        while (inserted < matchesLen) {
+
+            int idx = byEnd[inserted].idx;
+            Anchor* other = &(matches[idx]);
+
+            if (byEnd[inserted].queryEnd > match->queryStart) {
+                break;
+            }
+
+            int value = chain[idx];
+
+            for (j = other->targetStart + other->length; j <= targetLen; 
+                j += j & -j) {
+
+                if (value > treeChain[j]) {
+                    treeChain[j] = value;
+                    treeIdx[j] = idx;
+                }
+            }
+
+            inserted++;
+        }
+
+        chain[i] = match->length;
+
+        for (j = match->targetStart; j > 0; j -= j & -j) {
+            if (treeIdx[j] != -1 && treeChain[j] + match->length > chain[i]) {
+                chain[i] = treeChain[j] + match->length;
+                previous[i] = treeIdx[j];
+            }
+        }
+
+        if (chain[i] > chain[best]) {
+            best = i;
+        }
+    }
+
+    int length = 0;
+    for (i = best; i != -1; i = previous[i]) {
+        length++;
+    }
+
+    *anchorsLen = length;
+    *anchors = (Anchor*) malloc(length * sizeof(Anchor));
+
+    for (i = best; i != -1; i = previous[i]) {
+        (*anchors)[--length] = matches[i];
+    }
+
+    free(chain);
+    free(previous);
+    free(byEnd);
+    free(treeChain);
+    free(treeIdx);
+}
+
+static void seedTableCreate(SeedTable* table, const char* codes, int length, 
+    int seedLen) {
+
+    int seedsLen = length - seedLen + 1;
+
+    unsigned long long size = 1;
+    while (size < 2ull * seedsLen) {
+        size <<= 1;
+    }
+
+    table->slots = (int*) malloc(size * sizeof(int));
+    table->keys = (unsigned int*) malloc(size * sizeof(unsigned int));
+    table->mask = size - 1;
+
+    unsigned long long i;
+    for (i = 0; i < size; ++i) {
+        table->slots[i] = SLOT_EMPTY;
+    }
+
+    unsigned long long power = 1;
+
+    int j;
+    for (j = 0; j < seedLen - 1; ++j) {
+        power *= SEED_BASE;
+    }
+
+    unsigned long long hash = seedHash(codes, seedLen);
+
+    for (j = 0; j < seedsLen; ++j) {
+
+        if (j > 0) {
+            hash -= codes[j - 1] * power;
+            hash = hash * SEED_BASE + codes[j + seedLen - 1];
+        }
+
+        unsigned long long mixed = seedMix(hash);
+        unsigned int key = (unsigned int) (mixed >> 32);
+        unsigned long long slot = mixed & table->mask;
+
+        while (1) {
+
+            int value = table->slots[slot];
+
+            if (value == SLOT_EMPTY) {
+                table->slots[slot] = j;
+                table->keys[slot] = key;
+                break;
+            }
+
+            int position = SLOT_POSITION(value);
+
+            if (table->keys[slot] == key && 
+                memcmp(codes + position, codes + j, seedLen) == 0) {
+                table->slots[slot] = SLOT_REPEATED(position);
+                break;
+            }
+
+            slot = (slot + 1) & table->mask;
+        }
+    }
+}
+
+static int seedTableFind(SeedTable* table, const char* codes, int seedLen,
+    const char* seed, unsigned long long hash) {
+
+    unsigned long long mixed = seedMix(hash);
+    unsigned int key = (unsigned int) (mixed >> 32);
+    unsigned long long slot = mixed & table->mask;
+
+    while (1) {
+
+        int value = table->slots[slot];
+
+        if (value == SLOT_EMPTY) {
+            return SLOT_EMPTY;
+        }
+
+        if (table->keys[slot] == key && 
+            memcmp(codes + SLOT_POSITION(value), seed, seedLen) == 0) {
+            return value;
+        }
+
+        slot = (slot + 1) & table->mask;
+    }
+}
+
+static unsigned long long seedHash(const char* codes, int seedLen) {
+
+    unsigned long long hash = 0;
+
+    int i;
+    for (i = 0; i < seedLen; ++i) {
+        hash = hash * SEED_BASE + codes[i];
+    }
+
+    return hash;
+}
+
+static unsigned long long seedMix(unsigned long long hash) {
+
+    // murmur3 finalizer, polynomial hashes of codes are poorly distributed
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+static int matchCmp(const void* a_, const void* b_) {
+
+    Anchor* a = (Anchor*) a_;
+    Anchor* b = (Anchor*) b_;
+
+    if (a->queryStart != b->queryStart) {
+        return a->queryStart - b->queryStart;
+    }
+
+    if (a->targetStart != b->targetStart) {
+        return a->targetStart - b->targetStart;
+    }
+
+    return a->length - b->length;
+}
+
+static int matchEndCmp(const void* a_, const void* b_) {
+
+    MatchEnd* a = (MatchEnd*) a_;
+    MatchEnd* b = (MatchEnd*) b_;
+
+    if (a->queryEnd != b->queryEnd) {
+        return a->queryEnd - b->queryEnd;
+    }
+
+    return a->idx - b->idx;
+}
+
+//******************************************************************************
@@ -0,0 +1,78 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+
+/**
+@file
+
+@brief Exact match anchors header.
+
+Anchors are exact matches between the query and the target which are used to 
+split long similar pairs into small independent alignment problems. Seeds are
+k-mers which occur only once in the target, every seed hit is extended into a
+maximal exact match and the matches are chained co-linearly.
+*/
+
+#ifndef __SW_SHARP_ANCHORH__
+#define __SW_SHARP_ANCHORH__
+
+#include "chain.h"
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Exact match between the query and the target.
+*/
+typedef struct Anchor {
+
+    //! query start index
+    int queryStart;
+
+    //! target start index
+    int targetStart;
+
+    //! match length
+    int length;
+} Anchor;
+
+/*!
+@brief Co-linear anchors chain finding function.
+
+Function finds maximal exact matches seeded by the target unique k-mers and 
+returns the chain of matches with the largest total length in which every
+match starts after the previous one ends in both the query and the target. 
+Output array is sorted and should be released with free().
+
+@param anchors output anchors array
+@param anchorsLen output anchors array length, 0 if no anchors were found
+@param query query chain
+@param target target chain
+@param seedLen seed length
+*/
+extern void anchorsCreate(Anchor** anchors, int* anchorsLen, Chain* query, 
+    Chain* target, int seedLen);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __SW_SHARP_ANCHORH__
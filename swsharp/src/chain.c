@@ -24,26 +24,63 @@ Contact the author by mkorpar@gmail.com.
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define close _close
+#define read _read
+#define lseek _lseeki64
+#else
+#include <unistd.h>
+#endif
+
 #include "error.h"
 #include "scorer.h"
 #include "thread.h"
+#include "utils.h"
 
 #include "chain.h"
 
+#define SLAB_SIZE       (1 << 18) // 256kB
+#define SLAB_ALIGN(x)   (((x) + 7) & ~((size_t) 7))
+
+typedef struct ChainSlab {
+    ChainArena* arena;
+    int chains;
+} ChainSlab;
+
 struct Chain {
 
     char* name;
     int nameLen;
+    long long nameOffset;
     
     int length;
     char* codes;
     
     int reverseCalculated;
     char* reverseCodes;
-    Mutex reverseWrite;
+    Mutex* reverseWrite;
 
     Chain* origin;
     int isView;
+
+    ChainSlab* slab;
+};
+
+typedef struct HeapChain {
+    struct Chain chain;
+    Mutex reverseWrite;
+} HeapChain;
+
+struct ChainArena {
+    Mutex mutex;
+    int namesFd;
+    ChainSlab* slab;
+    size_t slabUsed;
+    size_t slabSize;
+    int slabs;
+    int deleted;
 };
 
 //******************************************************************************
@@ -54,8 +91,19 @@ struct Chain {
 //******************************************************************************
 // PRIVATE
 
+static void chainInit(Chain* chain, char* nameBuffer, char* codesBuffer, 
+    char* name, int nameLen, char* string, int stringLen);
+
 static void createReverse(Chain* chain);
 
+static void createName(Chain* chain);
+
+static char* arenaAllocate(ChainSlab** slab, ChainArena* arena, size_t size);
+
+static void arenaRelease(ChainSlab* slab);
+
+static void arenaFree(ChainArena* arena);
+
 //******************************************************************************
 
 //******************************************************************************
@@ -69,22 +117,156 @@ extern Chain* chainCreate(char* name, int nameLen, char* string, int stringLen)
     ASSERT(name != NULL && nameLen > 0 && string != NULL && stringLen > 0, 
         "invalid chain data");
 
-    Chain* chain = (Chain*) malloc(sizeof(struct Chain));
+    HeapChain* heapChain = (HeapChain*) malloc(sizeof(struct HeapChain));
+    Chain* chain = &(heapChain->chain);
 
-    chain->isView = 0;
-    
-    chain->nameLen = nameLen + 1;
-    chain->name = (char*) malloc((nameLen + 1) * sizeof(char));
-    memcpy(chain->name, name, nameLen * sizeof(char));
+    char* nameBuffer = (char*) malloc((nameLen + 1) * sizeof(char));
+    char* codesBuffer = (char*) malloc(stringLen * sizeof(char));
 
-    while (isspace(name[nameLen - 1])) {
-        nameLen--;
+    chainInit(chain, nameBuffer, codesBuffer, name, nameLen, string, stringLen);
+
+    chain->nameOffset = -1;
+    chain->slab = NULL;
+    chain->reverseWrite = &(heapChain->reverseWrite);
+    mutexCreate(chain->reverseWrite);
+
+    return chain;
+}
+
+extern void chainDelete(Chain* chain) {
+
+    if (chain == NULL) {
+        return;
     }
 
-    ASSERT(nameLen > 0, "invalid chain name, should be at least non space char");
-    chain->name[nameLen] = 0;
+    if (!chain->isView) {
+
+        if (chain->reverseCalculated) {
+            free(chain->reverseCodes);
+        }
+
+        // lazy names are read outside of the slab
+        if (chain->nameOffset != -1) {
+            free(chain->name);
+        }
+
+        // names and codes are a part of the slab
+        if (chain->slab != NULL) {
+            arenaRelease(chain->slab);
+            return;
+        }
+
+        mutexDelete(chain->reverseWrite);
+        free(chain->codes);
+        free(chain->name);
+    }
+
+    free(chain); 
+    chain = NULL;
+}
+
+extern ChainArena* chainArenaCreate() {
+
+    ChainArena* arena = (ChainArena*) malloc(sizeof(struct ChainArena));
+
+    mutexCreate(&(arena->mutex));
+
+    arena->namesFd = -1;
+    arena->slab = NULL;
+    arena->slabUsed = 0;
+    arena->slabSize = 0;
+    arena->slabs = 0;
+    arena->deleted = 0;
+
+    return arena;
+}
+
+extern void chainArenaDelete(ChainArena* arena) {
+
+    if (arena == NULL) {
+        return;
+    }
+
+    mutexLock(&(arena->mutex));
+
+    arena->deleted = 1;
+
+    if (arena->slab != NULL && arena->slab->chains == 0) {
+        free(arena->slab);
+        arena->slabs--;
+    }
+
+    arena->slab = NULL;
+
+    int empty = arena->slabs == 0;
+
+    mutexUnlock(&(arena->mutex));
+
+    // otherwise the last chain deletes the arena
+    if (empty) {
+        arenaFree(arena);
+    }
+}
+
+extern ChainArena* chainArenaCreateLazy(FILE* names) {
+
+    ChainArena* arena = chainArenaCreate();
+
+    // own descriptor outlives the file
+    arena->namesFd = dup(fileno(names));
+    ASSERT(arena->namesFd != -1, "io error");
+
+    return arena;
+}
+
+extern Chain* chainArenaCreateChain(ChainArena* arena, char* name, int nameLen, 
+    char* string, int stringLen) {
+
+    ASSERT(name != NULL && nameLen > 0 && string != NULL && stringLen > 0, 
+        "invalid chain data");
+
+    size_t chainSize = SLAB_ALIGN(sizeof(struct Chain));
+
+    mutexLock(&(arena->mutex));
+
+    ChainSlab* slab;
+    char* bytes = arenaAllocate(&slab, arena, chainSize + nameLen + 1 + stringLen);
+
+    Chain* chain = (Chain*) bytes;
+    char* nameBuffer = bytes + chainSize;
+    char* codesBuffer = nameBuffer + nameLen + 1;
+
+    chainInit(chain, nameBuffer, codesBuffer, name, nameLen, string, stringLen);
+
+    // codes of ignored characters are given back to the slab
+    arena->slabUsed -= stringLen - chain->length;
+
+    mutexUnlock(&(arena->mutex));
 
-    chain->codes = (char*) malloc(stringLen * sizeof(char));
+    chain->nameOffset = -1;
+    chain->slab = slab;
+    chain->reverseWrite = &(arena->mutex);
+
+    return chain;
+}
+
+extern Chain* chainArenaCreateLazyChain(ChainArena* arena, long long nameOffset, 
+    int nameLen, char* string, int stringLen) {
+
+    ASSERT(arena->namesFd != -1, "arena has no names file");
+    ASSERT(string != NULL && stringLen > 0, "invalid chain data");
+
+    size_t chainSize = SLAB_ALIGN(sizeof(struct Chain));
+
+    mutexLock(&(arena->mutex));
+
+    ChainSlab* slab;
+    char* bytes = arenaAllocate(&slab, arena, chainSize + stringLen);
+
+    Chain* chain = (Chain*) bytes;
+    char* codesBuffer = bytes + chainSize;
+
+    chain->codes = codesBuffer;
     chain->length = 0;
     
     int i;
@@ -100,33 +282,24 @@ extern Chain* chainCreate(char* name, int nameLen, char* string, int stringLen)
 
     ASSERT(chain->length > 0, "chain is empty after encoding, "
         "see scorerEncode function");
-    chain->origin = chain;
-    
-    chain->reverseCodes = NULL;
-    chain->reverseCalculated = 0;
-    mutexCreate(&(chain->reverseWrite));
 
-    return chain;
-}
+    arena->slabUsed -= stringLen - chain->length;
 
-extern void chainDelete(Chain* chain) {
+    mutexUnlock(&(arena->mutex));
 
-    if (chain == NULL) {
-        return;
-    }
+    chain->name = NULL;
+    chain->nameLen = nameLen + 1;
+    chain->nameOffset = nameOffset;
 
-    if (!chain->isView) {
-        mutexDelete(&(chain->reverseWrite));
-        free(chain->codes);
-        free(chain->name);
+    chain->isView = 0;
+    chain->origin = chain;
+    chain->slab = slab;
 
-        if (chain->reverseCalculated) {
-            free(chain->reverseCodes);
-        }
-    }
+    chain->reverseCodes = NULL;
+    chain->reverseCalculated = 0;
+    chain->reverseWrite = &(arena->mutex);
 
-    free(chain); 
-    chain = NULL;
+    return chain;
 }
 
 //------------------------------------------------------------------------------
@@ -143,9 +316,19 @@ extern char chainGetCode(Chain* chain, int index) {
 }
 
 extern const char* chainGetName(Chain* chain) {
+
+    if (chain->name == NULL) {
+        createName(chain);
+        chain->name = chain->origin->name;
+    }
+
     return chain->name;
 }
 
+extern int chainHasLazyName(Chain* chain) {
+    return chain->origin->nameOffset != -1;
+}
+
 extern const char* chainGetCodes(Chain* chain) {
     return chain->codes;
 }
@@ -167,6 +350,7 @@ extern Chain* chainCreateView(Chain* chain, int start, int end, int reverse) {
 
     view->length = (end - start) + 1;
     view->isView = 1;
+    view->slab = NULL;
     view->name = chain->name;
     view->origin = chain->origin;
 
@@ -205,7 +389,8 @@ extern Chain* chainDeserialize(char* bytes) {
     memcpy(codes, bytes + ptr, length);
     ptr += length;
     
-    Chain* chain = (Chain*) malloc(sizeof(struct Chain));
+    HeapChain* heapChain = (HeapChain*) malloc(sizeof(struct HeapChain));
+    Chain* chain = &(heapChain->chain);
     
     chain->name = name;
     chain->nameLen = nameLen;
@@ -214,17 +399,102 @@ extern Chain* chainDeserialize(char* bytes) {
     chain->isView = 0;
     
     chain->origin = chain;
+    chain->nameOffset = -1;
+    chain->slab = NULL;
     
     chain->reverseCodes = NULL;
     chain->reverseCalculated = 0;
-    mutexCreate(&(chain->reverseWrite));
+    chain->reverseWrite = &(heapChain->reverseWrite);
+    mutexCreate(chain->reverseWrite);
     
     return chain;
 }
 
+extern Chain* chainArenaDeserializeChain(ChainArena* arena, char* bytes) {
+
+    int nameLen;
+    memcpy(&nameLen, bytes, sizeof(int));
+
+    int length;
+    memcpy(&length, bytes + sizeof(int) + nameLen, sizeof(int));
+
+    size_t chainSize = SLAB_ALIGN(sizeof(struct Chain));
+
+    mutexLock(&(arena->mutex));
+
+    ChainSlab* slab;
+    char* buffer = arenaAllocate(&slab, arena, chainSize + nameLen + length);
+
+    mutexUnlock(&(arena->mutex));
+
+    Chain* chain = (Chain*) buffer;
+
+    chain->name = buffer + chainSize;
+    chain->nameLen = nameLen;
+    memcpy(chain->name, bytes + sizeof(int), nameLen);
+
+    chain->length = length;
+    chain->codes = chain->name + nameLen;
+    memcpy(chain->codes, bytes + 2 * sizeof(int) + nameLen, length);
+
+    chain->nameOffset = -1;
+    chain->isView = 0;
+    chain->origin = chain;
+    chain->slab = slab;
+
+    chain->reverseCodes = NULL;
+    chain->reverseCalculated = 0;
+    chain->reverseWrite = &(arena->mutex);
+
+    return chain;
+}
+
+extern Chain* chainArenaDeserializeLazyChain(ChainArena* arena, char* bytes, 
+    long long offset) {
+
+    ASSERT(arena->namesFd != -1, "arena has no names file");
+
+    int nameLen;
+    memcpy(&nameLen, bytes, sizeof(int));
+
+    int length;
+    memcpy(&length, bytes + sizeof(int) + nameLen, sizeof(int));
+
+    size_t chainSize = SLAB_ALIGN(sizeof(struct Chain));
+
+    mutexLock(&(arena->mutex));
+
+    ChainSlab* slab;
+    char* buffer = arenaAllocate(&slab, arena, chainSize + length);
+
+    mutexUnlock(&(arena->mutex));
+
+    Chain* chain = (Chain*) buffer;
+
+    chain->name = NULL;
+    chain->nameLen = nameLen;
+    chain->nameOffset = offset + sizeof(int);
+
+    chain->length = length;
+    chain->codes = buffer + chainSize;
+    memcpy(chain->codes, bytes + 2 * sizeof(int) + nameLen, length);
+
+    chain->isView = 0;
+    chain->origin = chain;
+    chain->slab = slab;
+
+    chain->reverseCodes = NULL;
+    chain->reverseCalculated = 0;
+    chain->reverseWrite = &(arena->mutex);
+
+    return chain;
+}
+
 extern void chainSerialize(char** bytes, int* bytesLen, Chain* chain) {
 
     ASSERT(!chain->isView, "chain view cannot be serialized");
+
+    const char* name = chainGetName(chain);
     
     *bytesLen = 0;
     *bytesLen += sizeof(int); // nameLen
@@ -239,7 +509,7 @@ extern void chainSerialize(char** bytes, int* bytesLen, Chain* chain) {
     memcpy(*bytes + ptr, &chain->nameLen, sizeof(int));
     ptr += sizeof(int);
     
-    memcpy(*bytes + ptr, chain->name, chain->nameLen);
+    memcpy(*bytes + ptr, name, chain->nameLen);
     ptr += chain->nameLen;
     
     memcpy(*bytes + ptr, &chain->length, sizeof(int));
@@ -255,6 +525,44 @@ extern void chainSerialize(char** bytes, int* bytesLen, Chain* chain) {
 //******************************************************************************
 // PRIVATE
 
+static void chainInit(Chain* chain, char* nameBuffer, char* codesBuffer, 
+    char* name, int nameLen, char* string, int stringLen) {
+
+    chain->isView = 0;
+    
+    chain->nameLen = nameLen + 1;
+    chain->name = nameBuffer;
+    memcpy(chain->name, name, nameLen * sizeof(char));
+
+    while (isspace(name[nameLen - 1])) {
+        nameLen--;
+    }
+
+    ASSERT(nameLen > 0, "invalid chain name, should be at least non space char");
+    chain->name[nameLen] = 0;
+
+    chain->codes = codesBuffer;
+    chain->length = 0;
+    
+    int i;
+    for (i = 0; i < stringLen; ++i) {
+    
+        char code = scorerEncode(string[i]);
+        
+        if (code != -1) {      
+            chain->codes[chain->length] = code;
+            chain->length++;
+        }
+    }
+
+    ASSERT(chain->length > 0, "chain is empty after encoding, "
+        "see scorerEncode function");
+    chain->origin = chain;
+    
+    chain->reverseCodes = NULL;
+    chain->reverseCalculated = 0;
+}
+
 static void createReverse(Chain* chain) {
 
     Chain* origin = chain->origin;
@@ -262,24 +570,139 @@ static void createReverse(Chain* chain) {
     if (origin->reverseCalculated) {
         return;
     }
+
+    // arena chains share the lock, it is held only while publishing
+    char* reverseCodes = (char*) malloc(origin->length * sizeof(char));
+
+    int i;
+    for (i = 0; i < origin->length; ++i) {
+        reverseCodes[origin->length - i - 1] = origin->codes[i];
+    }
     
-    mutexLock(&(origin->reverseWrite));
+    mutexLock(origin->reverseWrite);
     
     if (origin->reverseCalculated) {
-        mutexUnlock(&(origin->reverseWrite));
+        mutexUnlock(origin->reverseWrite);
+        free(reverseCodes);
         return;
     }
     
-    origin->reverseCodes = (char*) malloc(origin->length * sizeof(char));
+    origin->reverseCodes = reverseCodes;
+    origin->reverseCalculated = 1;
 
+    mutexUnlock(origin->reverseWrite);
+}
+
+static void createName(Chain* chain) {
+
+    Chain* origin = chain->origin;
+
+    if (origin->name != NULL) {
+        return;
+    }
+
+    ChainArena* arena = origin->slab->arena;
+
+    // nameLen - 1 bytes are stored for both fasta and serialized names
+    int length = origin->nameLen - 1;
+    char* name = (char*) malloc(origin->nameLen * sizeof(char));
+
+    mutexLock(&(arena->mutex));
+
+    if (origin->name != NULL) {
+        mutexUnlock(&(arena->mutex));
+        free(name);
+        return;
+    }
+
+    ASSERT(lseek(arena->namesFd, origin->nameOffset, SEEK_SET) != -1, "io error");
+    ASSERT(read(arena->namesFd, name, length) == length, "io error");
+
+    // serialized names are zero terminated, fasta names are trimmed
     int i;
-    for (i = 0; i < origin->length; ++i) {
-        origin->reverseCodes[origin->length - i - 1] = origin->codes[i];
+    int nameLen = 0;
+    for (i = 0; i < length && name[i] != 0; ++i) {
+        if (name[i] != '\r') {
+            name[nameLen++] = name[i];
+        }
     }
 
-    origin->reverseCalculated = 1;
+    while (nameLen > 0 && isspace(name[nameLen - 1])) {
+        nameLen--;
+    }
+
+    name[nameLen] = 0;
+
+    origin->name = name;
+
+    mutexUnlock(&(arena->mutex));
+}
+
+static char* arenaAllocate(ChainSlab** slab, ChainArena* arena, size_t size) {
+
+    size_t headerSize = SLAB_ALIGN(sizeof(ChainSlab));
+
+    arena->slabUsed = SLAB_ALIGN(arena->slabUsed);
+
+    if (arena->slab == NULL || arena->slabUsed + size > arena->slabSize) {
+
+        // full slab is freed by its last chain
+        if (arena->slab != NULL && arena->slab->chains == 0) {
+            free(arena->slab);
+            arena->slabs--;
+        }
+
+        arena->slabSize = MAX(SLAB_SIZE, headerSize + size);
+        arena->slabUsed = headerSize;
+
+        arena->slab = (ChainSlab*) malloc(arena->slabSize);
+        arena->slab->arena = arena;
+        arena->slab->chains = 0;
+
+        arena->slabs++;
+    }
+
+    char* bytes = (char*) arena->slab + arena->slabUsed;
+
+    arena->slabUsed += size;
+    arena->slab->chains++;
+
+    *slab = arena->slab;
+
+    return bytes;
+}
+
+static void arenaRelease(ChainSlab* slab) {
+
+    ChainArena* arena = slab->arena;
+
+    mutexLock(&(arena->mutex));
+
+    slab->chains--;
+
+    // current slab is still being filled
+    if (slab->chains == 0 && slab != arena->slab) {
+        free(slab);
+        arena->slabs--;
+    }
+
+    int empty = arena->deleted && arena->slabs == 0;
+
+    mutexUnlock(&(arena->mutex));
+
+    if (empty) {
+        arenaFree(arena);
+    }
+}
+
+static void arenaFree(ChainArena* arena) {
+
+    if (arena->namesFd != -1) {
+        close(arena->namesFd);
+    }
 
-    mutexUnlock(&(origin->reverseWrite));
+    mutexDelete(&(arena->mutex));
+    free(arena);
 }
 
 //******************************************************************************
@@ -27,6 +27,8 @@ Contact the author by mkorpar@gmail.com.
 #ifndef __SW_SHARP_CHAINH__
 #define __SW_SHARP_CHAINH__
 
+#include <stdio.h>
+
 #ifdef __cplusplus 
 extern "C" {
 #endif
@@ -42,6 +44,16 @@ than the input sequence.
 */
 typedef struct Chain Chain;
 
+/*!
+@brief Arena used for constructing many chains at once.
+
+Chains constructed in the arena share slab allocated memory with their names
+and codes, and a single lock instead of a lock per chain. Arena chains are 
+deleted with chainDelete(Chain*) as any other chain, memory of a slab is freed
+when all of its chains are deleted.
+*/
+typedef struct ChainArena ChainArena;
+
 /*!
 @brief Chain object constructor.
 
@@ -65,6 +77,72 @@ extern Chain* chainCreate(char* name, int nameLen, char* string, int stringLen);
 */
 extern void chainDelete(Chain* chain);
 
+/*!
+@brief Chain arena constructor.
+
+@return chain arena object
+*/
+extern ChainArena* chainArenaCreate();
+
+/*!
+@brief Chain arena destructor.
+
+Method releases the arena, chains constructed in it stay valid until they are
+deleted. No chains can be constructed in the arena afterwards.
+
+@param arena chain arena object
+*/
+extern void chainArenaDelete(ChainArena* arena);
+
+/*!
+@brief Chain object constructor in the arena.
+
+Method is equivalent to chainCreate(char*, int, char*, int) with the chain 
+memory taken from the arena.
+
+@param arena chain arena object
+@param name chain name
+@param nameLen chain name length
+@param string chain characters
+@param stringLen chain characters length
+
+@return chain object 
+*/
+extern Chain* chainArenaCreateChain(ChainArena* arena, char* name, int nameLen, 
+    char* string, int stringLen);
+
+/*!
+@brief Chain arena constructor with lazily read names.
+
+Arena works as the one constructed with chainArenaCreate() but names of chains 
+constructed with chainArenaCreateLazyChain() and 
+chainArenaDeserializeLazyChain() are read from the given file only when first
+requested with chainGetName(Chain*). File can be closed after the arena is 
+constructed.
+
+@param names file holding the chain names
+
+@return chain arena object
+*/
+extern ChainArena* chainArenaCreateLazy(FILE* names);
+
+/*!
+@brief Chain object constructor in the arena with a lazily read name.
+
+Chain name is nameLen bytes long and starts at nameOffset in the names file of 
+the arena. Name is trimmed as in chainCreate(char*, int, char*, int) when read.
+
+@param arena chain arena object constructed with chainArenaCreateLazy()
+@param nameOffset chain name offset in the names file
+@param nameLen chain name length
+@param string chain characters
+@param stringLen chain characters length
+
+@return chain object 
+*/
+extern Chain* chainArenaCreateLazyChain(ChainArena* arena, long long nameOffset, 
+    int nameLen, char* string, int stringLen);
+
 /*!
 @brief Chain char getter.
 
@@ -110,6 +188,18 @@ extern int chainGetLength(Chain* chain);
 */
 extern const char* chainGetName(Chain* chain);
 
+/*!
+@brief Checks if the chain name is read lazily.
+
+Lazily read names are not compared when ordering database alignments, database 
+indexes are used instead.
+
+@param chain chain object 
+
+@return 1 if the chain name is read lazily, 0 otherwise
+*/
+extern int chainHasLazyName(Chain* chain);
+
 /*!
 @brief Chain codes getter.
 
@@ -159,6 +249,34 @@ Method deserializes chain object from a byte buffer.
 */
 extern Chain* chainDeserialize(char* bytes);
 
+/*!
+@brief Chain deserialization method in the arena.
+
+Method is equivalent to chainDeserialize(char*) with the chain memory taken 
+from the arena.
+
+@param arena chain arena object
+@param bytes byte buffer
+
+@return chain object
+*/
+extern Chain* chainArenaDeserializeChain(ChainArena* arena, char* bytes);
+
+/*!
+@brief Chain deserialization method in the arena with a lazily read name.
+
+Method is equivalent to chainArenaDeserializeChain(ChainArena*, char*) but the
+name is read from the names file of the arena when first requested.
+
+@param arena chain arena object constructed with chainArenaCreateLazy()
+@param bytes byte buffer
+@param offset byte buffer offset in the names file
+
+@return chain object
+*/
+extern Chain* chainArenaDeserializeLazyChain(ChainArena* arena, char* bytes, 
+    long long offset);
+
 /*!
 @brief Chain serialization method.
 
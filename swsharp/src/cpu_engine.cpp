@@ -0,0 +1,596 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alignment.h"
+#include "chain.h"
+#include "constants.h"
+#include "error.h"
+#include "scorer.h"
+#include "utils.h"
+
+#include "cpu_engine.h"
+
+// solving passes of the engine
+#define PASS_SCORE  0
+#define PASS_FIND   1
+#define PASS_TRACE  2
+
+typedef struct Move {
+    char move;
+    int vGaps;
+    int hGaps;
+} Move;
+
+typedef struct HBus {
+    int scr;
+    int aff;
+} HBus;
+
+typedef struct Result {
+    int score;
+    int row;
+    int col;
+} Result;
+
+//******************************************************************************
+// PUBLIC
+
+extern void alignPairEngine(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score);
+
+extern int scorePairEngine(int type, Chain* query, Chain* target, 
+    Scorer* scorer);
+
+extern void findScoreEngine(int* queryStart, int* targetStart, int type, 
+    Chain* query, int queryFrontGap, Chain* target, Scorer* scorer, int score);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+template<int MODE, class Sub, int PASS>
+static void solve(Result* result, Move* moves, Chain* query, Chain* target, 
+    Scorer* scorer, int score, int queryFrontGap);
+
+template<int MODE>
+static void traceback(Alignment** alignment, Result* result, Move* moves, 
+    Chain* query, Chain* target, Scorer* scorer);
+
+template<class Sub, int PASS>
+static void solveType(Result* result, Move* moves, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score, int queryFrontGap);
+
+template<int PASS>
+static void dispatch(Result* result, Move* moves, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score, int queryFrontGap);
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+extern void alignPairEngine(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score) {
+
+    ASSERT(type == SW_ALIGN || type == HW_ALIGN || type == OV_ALIGN, 
+        "invalid engine align type");
+
+    if (type == SW_ALIGN && scorerGetMaxScore(scorer) <= 0) {
+        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, 0, scorer, 
+            NULL, 0);
+        return;
+    }
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    Move* moves = (Move*) malloc((size_t) rows * cols * sizeof(Move));
+
+    Result result;
+    dispatch<PASS_TRACE>(&result, moves, type, query, target, scorer, score, 0);
+
+    switch (type) {
+    case HW_ALIGN: 
+        traceback<HW_ALIGN>(alignment, &result, moves, query, target, scorer);
+        break;
+    case OV_ALIGN: 
+        traceback<OV_ALIGN>(alignment, &result, moves, query, target, scorer);
+        break;
+    case SW_ALIGN: 
+        traceback<SW_ALIGN>(alignment, &result, moves, query, target, scorer);
+        break;
+    }
+
+    free(moves);
+}
+
+extern int scorePairEngine(int type, Chain* query, Chain* target, 
+    Scorer* scorer) {
+
+    if (type == SW_ALIGN && scorerGetMaxScore(scorer) <= 0) {
+        return 0;
+    }
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    // degenerated matrices, without any cell to solve
+    if (rows == 0 || cols == 0) {
+        switch (type) {
+        case NW_ALIGN: 
+            if (rows + cols == 0) {
+                return 0;
+            }
+            return -scorerGetGapOpen(scorer) - 
+                (rows + cols - 1) * scorerGetGapExtend(scorer);
+        case SW_ALIGN: 
+            return 0;
+        default:
+            return SCORE_MIN;
+        }
+    }
+
+    Result result;
+    dispatch<PASS_SCORE>(&result, NULL, type, query, target, scorer, 
+        NO_SCORE, 0);
+
+    return result.score;
+}
+
+extern void findScoreEngine(int* queryStart, int* targetStart, int type, 
+    Chain* query, int queryFrontGap, Chain* target, Scorer* scorer, int score) {
+
+    ASSERT(type == NW_ALIGN || type == OV_ALIGN, "invalid engine find type");
+
+    Result result;
+    dispatch<PASS_FIND>(&result, NULL, type, query, target, scorer, score, 
+        queryFrontGap);
+
+    *queryStart = result.row;
+    *targetStart = result.col;
+}
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+//------------------------------------------------------------------------------
+// FUNCTORS
+
+class SubScalar {
+public:
+    SubScalar(Scorer* scorer) {
+        match_ = scorerScore(scorer, 0, 0);
+        mismatch_ = scorerScore(scorer, 0, 1);
+    }
+    
+    inline void setRow(char code) {
+        code_ = code;
+    }
+    
+    inline int operator () (char code) const {
+        return code == code_ ? match_ : mismatch_;
+    }
+    
+private:
+    int match_;
+    int mismatch_;
+    char code_;
+};
+
+class SubVector {
+public:
+    SubVector(Scorer* scorer) {
+        table_ = scorerGetTable(scorer);
+        maxCode_ = scorerGetMaxCode(scorer);
+        row_ = table_;
+    }
+    
+    inline void setRow(char code) {
+        row_ = table_ + code * maxCode_;
+    }
+    
+    inline int operator () (char code) const {
+        return row_[(int) code];
+    }
+    
+private:
+    const int* table_;
+    int maxCode_;
+    const int* row_;
+};
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// ENGINE
+
+// Solves the matrix in row major order. Query chain is placed vertically and 
+// the target chain horizontally. NW and HW pay for the gaps before the query, 
+// NW and finding also for the gaps before the target. SW is floored at 0 and 
+// prunes the cells that can't reach the best score. For HW and OV ending cells
+// are read from the buses after the rows are solved, so the inner loop has no 
+// boundary checks. Cells are visited in the same order as before, so equal
+// scores are resolved to the same cells.
+template<int MODE, class Sub, int PASS>
+static void solve(Result* result, Move* moves, Chain* query, Chain* target, 
+    Scorer* scorer, int score, int queryFrontGap) {
+
+    // finding is done on the reversed chains from the alignment end, so the
+    // gaps before both chains are paid
+    const bool globalRows = 
+        MODE == NW_ALIGN || MODE == HW_ALIGN || PASS == PASS_FIND;
+    const bool globalCols = MODE == NW_ALIGN || PASS == PASS_FIND;
+
+    const int gapOpen = scorerGetGapOpen(scorer);
+    const int gapExtend = scorerGetGapExtend(scorer);
+    const int gapDiff = gapOpen - gapExtend;
+    const int frontGap = queryFrontGap ? gapDiff : 0;
+
+    const int rows = chainGetLength(query);
+    const int cols = chainGetLength(target);
+
+    const char* const rowCodes = chainGetCodes(query);
+    const char* const colCodes = chainGetCodes(target);
+
+    Sub sub(scorer);
+
+    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
+
+    int row;
+    int col;
+
+    for (col = 0; col < cols; ++col) {
+        hBus[col].scr = globalCols ? -gapOpen - col * gapExtend : 0;
+        hBus[col].aff = SCORE_MIN;
+    }
+
+    result->score = MODE == SW_ALIGN ? 0 : SCORE_MIN;
+    result->row = PASS == PASS_FIND ? -1 : 0;
+    result->col = PASS == PASS_FIND ? -1 : 0;
+
+    int pruneLow = 0;
+    int pruneHigh = cols;
+    int pruneFactor = scorerGetMaxScore(scorer);
+
+    int bestScore = MAX(0, score);
+
+    for (row = 0; row < rows; ++row) {
+
+        int iScr = globalRows ? -gapOpen - row * gapExtend + frontGap : 0;
+        int iAff = SCORE_MIN;
+
+        int diag = globalRows ? 
+            (-gapOpen - (row - 1) * gapExtend + frontGap) * (row > 0) : 0;
+
+        if (MODE == SW_ALIGN && row > rows / 2) {
+
+            for (col = pruneLow; rows - row <= cols - col; ++col) {
+
+                int scr = hBus[col].scr; 
+                if (col > 0) {
+                    scr = MAX(scr, hBus[col - 1].scr);
+                }
+
+                if (scr + (rows - row) * pruneFactor < bestScore) {
+                    pruneLow = col;
+                } else {
+                    break;
+                }
+            }
+
+            if (pruneLow != 0) {
+                diag = hBus[pruneLow - 1].scr;
+            }
+        }
+
+        if (MODE == SW_ALIGN) {
+
+            pruneHigh = cols;
+            for (col = cols - 1; cols - col <= rows - row; --col) {
+
+                int scr = hBus[col].scr; 
+                if (col > 0) {
+                    scr = MAX(scr, hBus[col - 1].scr);
+                }
+
+                if (scr + (cols - col) * pruneFactor < bestScore) {
+                    pruneHigh = col;
+                } else {
+                    break;
+                }
+            }
+
+            if (pruneHigh < cols) {
+                hBus[pruneHigh].scr = 0;
+                hBus[pruneHigh].aff = SCORE_MIN;
+            }
+        }
+
+        sub.setRow(rowCodes[row]);
+
+        Move* rowMoves = 
+            PASS == PASS_TRACE ? moves + (size_t) row * cols : NULL;
+
+        for (col = pruneLow; col < pruneHigh; ++col) {
+
+            // MATCHING
+            int mch = sub(colCodes[col]) + diag;
+            // MATCHING END
+
+            // INSERT
+            int ins = MAX(iScr - gapOpen, iAff - gapExtend);
+            // INSERT END
+
+            // DELETE
+            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend);
+            // DELETE END
+
+            int scr;
+            if (MODE == SW_ALIGN) {
+                scr = MAX(MAX(0, mch), MAX(ins, del));
+            } else {
+                scr = MAX(mch, MAX(ins, del));
+            }
+
+            if (PASS == PASS_TRACE) {
+
+                Move* move = rowMoves + col;
+
+                if (ins == iAff - gapExtend) {
+                    move->hGaps = (move - 1)->hGaps + 1;
+                } else {
+                    move->hGaps = 0;
+                }
+
+                if (del == hBus[col].aff - gapExtend) {
+                    move->vGaps = (move - cols)->vGaps + 1;
+                } else {
+                    move->vGaps = 0;
+                }
+
+                if (del == scr) {
+                    move->move = MOVE_UP;
+                } else if (ins == scr) {
+                    move->move = MOVE_LEFT;
+                } else if (MODE != SW_ALIGN || mch == scr) {
+                    move->move = MOVE_DIAG;
+                } else {
+                    move->move = MOVE_STOP;
+                }
+            }
+
+            if (PASS == PASS_FIND && scr == score && 
+                (MODE == NW_ALIGN || row == rows - 1)) {
+                result->row = row;
+                result->col = col;
+                free(hBus);
+                return;
+            }
+
+            if (MODE == SW_ALIGN && scr > result->score) {
+                result->score = scr;
+                result->row = row;
+                result->col = col;
+                bestScore = MAX(bestScore, scr);
+            }
+
+            // UPDATE BUSES
+            iScr = scr;
+            iAff = ins;
+
+            diag = hBus[col].scr;
+
+            hBus[col].scr = scr;
+            hBus[col].aff = del;
+            // UPDATE BUSES END
+        }
+
+        // last column of the rows before the last one
+        if (MODE == OV_ALIGN && row < rows - 1) {
+
+            int scr = hBus[cols - 1].scr;
+
+            if (PASS == PASS_FIND && scr == score) {
+                result->row = row;
+                result->col = cols - 1;
+                free(hBus);
+                return;
+            }
+
+            if (PASS != PASS_FIND && scr > result->score) {
+                result->score = scr;
+                result->row = row;
+                result->col = cols - 1;
+            }
+        }
+    }
+
+    // last row
+    if ((MODE == HW_ALIGN || MODE == OV_ALIGN) && PASS != PASS_FIND && 
+        rows > 0) {
+        for (col = 0; col < cols; ++col) {
+            if (hBus[col].scr > result->score) {
+                result->score = hBus[col].scr;
+                result->row = rows - 1;
+                result->col = col;
+            }
+        }
+    }
+
+    if (MODE == NW_ALIGN && PASS == PASS_SCORE) {
+        result->score = hBus[cols - 1].scr;
+    }
+
+    free(hBus);
+}
+
+template<int MODE>
+static void traceback(Alignment** alignment, Result* result, Move* moves, 
+    Chain* query, Chain* target, Scorer* scorer) {
+
+    int cols = chainGetLength(target);
+
+    int outScore = result->score;
+    int endRow = result->row;
+    int endCol = result->col;
+
+    if (MODE == SW_ALIGN && (endRow == 0 || endCol == 0) && outScore == 0) {
+        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, 0, scorer, 
+            NULL, 0);
+        return;
+    }
+
+    int row = endRow;
+    int col = endCol;
+
+    int pathEnd = endRow + endCol + 1;
+    int pathIdx = pathEnd;
+
+    char* path = (char*) malloc(pathEnd * sizeof(char));
+
+    while (row >= 0 && col >= 0) {
+
+        int movesIdx = row * cols + col;
+        char move = moves[movesIdx].move;
+
+        path[--pathIdx] = move;
+
+        if (move == MOVE_DIAG) {
+            col--;
+            row--;
+        } else if (move == MOVE_LEFT) {
+
+            int gaps = moves[movesIdx].hGaps;
+
+            pathIdx -= gaps;
+            memset(path + pathIdx, MOVE_LEFT, gaps);
+
+            col -= gaps + 1;
+
+        } else if (move == MOVE_UP) {
+
+            int gaps = moves[movesIdx].vGaps;
+
+            pathIdx -= gaps;
+            memset(path + pathIdx, MOVE_UP, gaps);
+
+            row -= gaps + 1;
+
+        } else {
+            // don't count the stop move, it came from the diagonal
+            row++;
+            col++;
+            pathIdx++;
+            break;
+        }
+
+        // HW aligns the whole query, horizontal gaps till the end
+        if (MODE == HW_ALIGN && col == -1 && row >= 0) {
+
+            pathIdx -= row + 1;
+            memset(path + pathIdx, MOVE_UP, row + 1);
+
+            col = 0;
+            row = 0;
+
+            break;
+        }
+    }
+
+    // don't count last move (diagonal) out of the matrix
+    if (row == -1 || (MODE != HW_ALIGN && col == -1)) {
+        row++;
+        col++;
+    }
+
+    int pathLen = pathEnd - pathIdx;
+
+    if (MODE == OV_ALIGN && pathLen <= 0) {
+        free(path);
+        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, outScore, 
+            scorer, NULL, 0);
+        return;
+    }
+
+    // shift data to begining of the array
+    int shiftIdx;
+    for (shiftIdx = 0; shiftIdx < pathLen; ++shiftIdx) {
+        path[shiftIdx] = path[pathIdx + shiftIdx];
+    }
+
+    *alignment = alignmentCreate(query, row, endRow, target, col, endCol, 
+        outScore, scorer, path, pathLen);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// DISPATCH
+
+template<class Sub, int PASS>
+static void solveType(Result* result, Move* moves, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score, int queryFrontGap) {
+
+    switch (type) {
+    case HW_ALIGN: 
+        solve<HW_ALIGN, Sub, PASS>(result, moves, query, target, scorer, 
+            score, queryFrontGap);
+        break;
+    case NW_ALIGN: 
+        solve<NW_ALIGN, Sub, PASS>(result, moves, query, target, scorer, 
+            score, queryFrontGap);
+        break;
+    case SW_ALIGN: 
+        solve<SW_ALIGN, Sub, PASS>(result, moves, query, target, scorer, 
+            score, queryFrontGap);
+        break;
+    case OV_ALIGN: 
+        solve<OV_ALIGN, Sub, PASS>(result, moves, query, target, scorer, 
+            score, queryFrontGap);
+        break;
+    default:
+        ERROR("invalid align type");
+    }
+}
+
+template<int PASS>
+static void dispatch(Result* result, Move* moves, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score, int queryFrontGap) {
+
+    if (scorerIsScalar(scorer)) {
+        solveType<SubScalar, PASS>(result, moves, type, query, target, scorer, 
+            score, queryFrontGap);
+    } else {
+        solveType<SubVector, PASS>(result, moves, type, query, target, scorer, 
+            score, queryFrontGap);
+    }
+}
+
+//------------------------------------------------------------------------------
+//******************************************************************************
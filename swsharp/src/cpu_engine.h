@@ -0,0 +1,100 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+/**
+@file
+
+@brief Templated CPU dynamic programming engine.
+
+Single implementation of the scalar CPU kernels for all aligning types. The 
+engine is instantiated at compile time for every combination of the aligning 
+type and the scorer kind (matrix or match/mismatch), and functions below 
+dispatch to the right instantiation. Boundary conditions of each aligning type
+are compile time constants, so they are folded out of the inner loop.
+*/
+
+#ifndef __SW_SHARP_CPU_ENGINEH__
+#define __SW_SHARP_CPU_ENGINEH__
+
+#include "alignment.h"
+#include "chain.h"
+#include "scorer.h"
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Pairwise alignment function.
+
+Aligns the query and the target with the full dynamic programming matrix and
+traceback. Only #SW_ALIGN, #HW_ALIGN and #OV_ALIGN are supported, #NW_ALIGN is
+solved with the banded nwReconstructCpu().
+
+@param alignment output alignment object
+@param type aligning type, can be #SW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query query chain
+@param target target chain
+@param scorer scorer object used for alignment
+@param score alignment score if known, otherwise #NO_SCORE
+*/
+extern void alignPairEngine(Alignment** alignment, int type, Chain* query, 
+    Chain* target, Scorer* scorer, int score);
+
+/*!
+@brief Pairwise scoring function.
+
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query query chain
+@param target target chain
+@param scorer scorer object used for alignment
+
+@return alignment score
+*/
+extern int scorePairEngine(int type, Chain* query, Chain* target, 
+    Scorer* scorer);
+
+/*!
+@brief Score finding function.
+
+Finds the first cell, in row major order, which has the given score. Gaps 
+before both chains are paid, as the function is used on reversed chains to find
+the alignment start. For #OV_ALIGN only the cells in the last row and the last 
+column are considered.
+If the cell isn't found both outputs are set to -1.
+
+@param queryStart output, row of the found cell
+@param targetStart output, column of the found cell
+@param type aligning type, can be #NW_ALIGN or #OV_ALIGN
+@param query query chain
+@param queryFrontGap if not 0, query starts with a gap that is already open, 
+    used only with #NW_ALIGN
+@param target target chain
+@param scorer scorer object used for alignment
+@param score score to find
+*/
+extern void findScoreEngine(int* queryStart, int* targetStart, int type, 
+    Chain* query, int queryFrontGap, Chain* target, Scorer* scorer, int score);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __SW_SHARP_CPU_ENGINEH__
@@ -28,6 +28,7 @@ Contact the author by mkorpar@gmail.com.
 #include "alignment.h"
 #include "chain.h"
 #include "constants.h"
+#include "cpu_engine.h"
 #include "error.h"
 #include "scorer.h"
 #include "sse_module.h"
@@ -35,6 +36,25 @@ Contact the author by mkorpar@gmail.com.
 
 #include "cpu_module.h"
 
+// number of chains in interleaved database block, multiple of every simd width
+#define CPU_DB_LANES    64
+
+// initial half width of the banded scoring diagonal band
+#define CPU_BAND_START  32
+
+// banded scoring gives up when the bands would solve more than this fraction
+// of the full matrix, divergent pairs never pass the bound
+#define CPU_BAND_WORK   8
+
+// x-drop extension trace, source of the best score and gap openings
+#define EXTEND_NEG      (INT_MIN / 2)
+#define EXTEND_H_DIAG   0
+#define EXTEND_H_LEFT   1
+#define EXTEND_H_UP     2
+#define EXTEND_H_MASK   3
+#define EXTEND_E_OPEN   4
+#define EXTEND_F_OPEN   8
+
 typedef struct Move {
     char move;
     int vGaps;
@@ -46,6 +66,29 @@ typedef struct HBus {
     int aff;
 } HBus;
 
+typedef struct ExtendRow {
+    int start;
+    char* moves;
+} ExtendRow;
+
+typedef struct ChainLength {
+    int idx;
+    int length;
+} ChainLength;
+
+struct ChainDatabaseCpu {
+    Chain** database;
+    int databaseLen;
+    int* indexes; // database index of every lane, -1 if lane is empty
+    int* lengths; // chain length of every lane, 0 if lane is empty
+    unsigned char* codes;
+    unsigned char** blocks;
+    int* blocksLens;
+    int* packed; // nucleotide blocks are stored with 2 bits per code
+    unsigned char packedCodes[4];
+    int blocksLen;
+};
+
 //******************************************************************************
 // PUBLIC
 
@@ -65,38 +108,61 @@ extern void nwReconstructCpu(char** path, int* pathLen, int* outScore,
 extern void ovFindScoreCpu(int* queryStart, int* targetStart, Chain* query, 
     Chain* target, Scorer* scorer, int score);
 
+extern void xDropExtendCpu(char** path, int* pathLen, int* queryLen, 
+    int* targetLen, int* outScore, Chain* query, Chain* target, Scorer* scorer, 
+    int xDrop);
+
 extern int scorePairCpu(int type, Chain* query, Chain* target, Scorer* scorer);
 
+extern void scorePairDualCpu(int* score, int* score2, int type, Chain* query, 
+    Chain* query2, Chain* target, Scorer* scorer);
+
+extern void scorePairsCpu(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer);
+
 extern void scoreDatabaseCpu(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer);
 
 extern void scoreDatabasePartiallyCpu(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer, int maxScore);
 
+extern ChainDatabaseCpu* chainDatabaseCpuCreate(Chain** database, 
+    int databaseLen);
+
+extern void chainDatabaseCpuDelete(ChainDatabaseCpu* chainDatabaseCpu);
+
+extern int chainDatabaseCpuGetBlocksLen(ChainDatabaseCpu* chainDatabaseCpu);
+
+extern int chainDatabaseCpuGetBlock(const int** indexes, 
+    ChainDatabaseCpu* chainDatabaseCpu, int block);
+
+extern void scoreChainDatabaseCpu(int* scores, int type, Chain* query, 
+    ChainDatabaseCpu* chainDatabaseCpu, int blocksStart, int blocksLen, 
+    Scorer* scorer);
+
+extern void scoreChainDatabaseDualCpu(int* scores, int* scores2, int type, 
+    Chain* query, Chain* query2, ChainDatabaseCpu* chainDatabaseCpu, 
+    int blocksStart, int blocksLen, Scorer* scorer);
+
 //******************************************************************************
 
 //******************************************************************************
 // PRIVATE
 
-static void hwAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score);
-    
-static int hwScore(Chain* query, Chain* target, Scorer* scorer);
-
 static void nwAlign(Alignment** alignment, Chain* query, Chain* target, 
     Scorer* scorer, int score);
-    
-static int nwScore(Chain* query, Chain* target, Scorer* scorer);
 
-static void ovAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score);
+static int scoreBanded(int* score, int* band, int type, Chain* query, 
+    Chain* target, Scorer* scorer);
 
-static int ovScore(Chain* query, Chain* target, Scorer* scorer);
+static int solveBand(int* bound, int type, Chain* query, Chain* target, 
+    Scorer* scorer, int low, int high);
 
-static void swAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score);
+static int chainLengthCmp(const void* a_, const void* b_);
 
-static int swScore(Chain* query, Chain* target, Scorer* scorer);
+static void scoreUnsolvedCpu(int* scores, int* blocksScores, int status, 
+    int type, Chain* query, ChainDatabaseCpu* chainDatabaseCpu, int blocksStart, 
+    int blocksLen, Scorer* scorer);
 
 //******************************************************************************
 
@@ -111,31 +177,23 @@ extern void alignPairCpu(Alignment** alignment, int type, Chain* query,
 extern void alignScoredPairCpu(Alignment** alignment, int type, Chain* query, 
     Chain* target, Scorer* scorer, int score) {
     
-    void (*function) (Alignment**, Chain*, Chain*, Scorer*, int);
-
     if (alignScoredPairSse(alignment, type, query, target, scorer, score) == 0) {
         return;
     }
 
     switch (type) {
     case HW_ALIGN: 
-        function = hwAlign;
-        break;
-    case NW_ALIGN: 
-        function = nwAlign;
-        break;
     case SW_ALIGN: 
-        function = swAlign;
-        break;
     case OV_ALIGN: 
-        function = ovAlign;
+        alignPairEngine(alignment, type, query, target, scorer, score);
+        break;
+    case NW_ALIGN: 
+        nwAlign(alignment, query, target, scorer, score);
         break;
     default:
         ERROR("invalid align type");
     }
     
-    function(alignment, query, target, scorer, score);
-    
     int outScore = alignmentGetScore(*alignment);
     ASSERT(score == NO_SCORE || score == outScore, "invalid alignment input score %s %s",
             chainGetName(query), chainGetName(target));
@@ -143,8 +201,6 @@ extern void alignScoredPairCpu(Alignment** alignment, int type, Chain* query,
 
 extern int scorePairCpu(int type, Chain* query, Chain* target, Scorer* scorer) {
 
-    int (*function) (Chain*, Chain*, Scorer*);
-
     if (type != HW_ALIGN) {
         if (chainGetLength(query) < chainGetLength(target)) {
             SWAP(query, target);
@@ -156,24 +212,35 @@ extern int scorePairCpu(int type, Chain* query, Chain* target, Scorer* scorer) {
         return score;
     }
 
-    switch (type) {
-    case HW_ALIGN: 
-        function = hwScore;
-        break;
-    case NW_ALIGN: 
-        function = nwScore;
-        break;
-    case SW_ALIGN: 
-        function = swScore;
-        break;
-    case OV_ALIGN: 
-        function = ovScore;
-        break;
-    default:
-        ERROR("invalid align type");
+    int band;
+    if (scoreBanded(&score, &band, type, query, target, scorer) == 0) {
+        return score;
+    }
+
+    return scorePairEngine(type, query, target, scorer);
+}
+
+extern void scorePairDualCpu(int* score, int* score2, int type, Chain* query, 
+    Chain* query2, Chain* target, Scorer* scorer) {
+
+    if (scorePairDualSse(score, score2, type, query, query2, target, scorer) != 0) {
+        *score = -1;
+        *score2 = -1;
+    }
+}
+
+extern void scorePairsCpu(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer) {
+
+    int status = scorePairsSse(scores, type, queries, targets, pairsLen, scorer);
+
+    // solve the overflowed pairs or all if the pairs can't be packed
+    int i;
+    for (i = 0; i < pairsLen; ++i) {
+        if (status != 0 || scores[i] == -1) {
+            scores[i] = scorePairCpu(type, queries[i], targets[i], scorer);
+        }
     }
-    
-    return function(query, target, scorer);
 }
 
 extern void scoreDatabaseCpu(int* scores, int type, Chain* query, 
@@ -220,6 +287,222 @@ extern void scoreDatabasePartiallyCpu(int* scores, int type, Chain* query,
     }
 }
 
+//------------------------------------------------------------------------------
+// DATABASE MODULES
+
+extern ChainDatabaseCpu* chainDatabaseCpuCreate(Chain** database, 
+    int databaseLen) {
+
+    ChainDatabaseCpu* chainDatabaseCpu = 
+        (ChainDatabaseCpu*) malloc(sizeof(struct ChainDatabaseCpu));
+
+    int lanes = CPU_DB_LANES;
+    int blocksLen = (databaseLen + lanes - 1) / lanes;
+
+    int i, j, k;
+
+    // longest chains first, so the biggest blocks get solved first
+    ChainLength* order = (ChainLength*) malloc(databaseLen * sizeof(ChainLength));
+
+    for (i = 0; i < databaseLen; ++i) {
+        order[i].idx = i;
+        order[i].length = chainGetLength(database[i]);
+    }
+
+    qsort(order, databaseLen, sizeof(ChainLength), chainLengthCmp);
+
+    int* indexes = (int*) malloc(blocksLen * lanes * sizeof(int));
+    int* lengths = (int*) malloc(blocksLen * lanes * sizeof(int));
+    int* blocksLens = (int*) malloc(blocksLen * sizeof(int));
+    int* packed = (int*) malloc(blocksLen * sizeof(int));
+
+    unsigned char packedCodes[] = { 
+        scorerEncode('A'), scorerEncode('C'), scorerEncode('G'), scorerEncode('T')
+    };
+
+    // 2 bit value of every code, -1 if the code can't be packed
+    char packedValues[256];
+    memset(packedValues, -1, sizeof(packedValues));
+
+    for (i = 0; i < 4; ++i) {
+        packedValues[packedCodes[i]] = i;
+    }
+
+    size_t codesLen = 0;
+    for (i = 0; i < blocksLen; ++i) {
+
+        blocksLens[i] = order[i * lanes].length;
+
+        // block is packed only if all of its chains are made of ACGT
+        packed[i] = 1;
+
+        for (j = 0; j < lanes && packed[i]; ++j) {
+
+            int lane = i * lanes + j;
+
+            if (lane >= databaseLen) {
+                break;
+            }
+
+            Chain* chain = database[order[lane].idx];
+            const char* chainCodes = chainGetCodes(chain);
+            int chainLen = chainGetLength(chain);
+
+            for (k = 0; k < chainLen; ++k) {
+                if (packedValues[(unsigned char) chainCodes[k]] == -1) {
+                    packed[i] = 0;
+                    break;
+                }
+            }
+        }
+
+        if (packed[i]) {
+            codesLen += (size_t) ((blocksLens[i] + 3) / 4) * lanes;
+        } else {
+            codesLen += (size_t) blocksLens[i] * lanes;
+        }
+    }
+
+    unsigned char* codes = (unsigned char*) malloc(codesLen);
+    unsigned char** blocks = (unsigned char**) malloc(blocksLen * sizeof(unsigned char*));
+
+    unsigned char* block = codes;
+
+    for (i = 0; i < blocksLen; ++i) {
+
+        size_t blockSize;
+        if (packed[i]) {
+            blockSize = (size_t) ((blocksLens[i] + 3) / 4) * lanes;
+            memset(block, 0, blockSize);
+        } else {
+            blockSize = (size_t) blocksLens[i] * lanes;
+            memset(block, SSE_PAD_CODE, blockSize);
+        }
+
+        blocks[i] = block;
+
+        for (j = 0; j < lanes; ++j) {
+
+            int lane = i * lanes + j;
+
+            if (lane >= databaseLen) {
+                indexes[lane] = -1;
+                lengths[lane] = 0;
+                continue;
+            }
+
+            Chain* chain = database[order[lane].idx];
+            const char* chainCodes = chainGetCodes(chain);
+            int chainLen = chainGetLength(chain);
+
+            if (packed[i]) {
+                for (k = 0; k < chainLen; ++k) {
+                    int value = packedValues[(unsigned char) chainCodes[k]];
+                    block[(k / 4) * lanes + j] |= value << (2 * (k % 4));
+                }
+            } else {
+                for (k = 0; k < chainLen; ++k) {
+                    block[k * lanes + j] = chainCodes[k];
+                }
+            }
+
+            indexes[lane] = order[lane].idx;
+            lengths[lane] = chainLen;
+        }
+
+        block += blockSize;
+    }
+
+    free(order);
+
+    chainDatabaseCpu->database = database;
+    chainDatabaseCpu->databaseLen = databaseLen;
+    chainDatabaseCpu->indexes = indexes;
+    chainDatabaseCpu->lengths = lengths;
+    chainDatabaseCpu->codes = codes;
+    chainDatabaseCpu->blocks = blocks;
+    chainDatabaseCpu->blocksLens = blocksLens;
+    chainDatabaseCpu->packed = packed;
+    chainDatabaseCpu->blocksLen = blocksLen;
+
+    memcpy(chainDatabaseCpu->packedCodes, packedCodes, sizeof(packedCodes));
+
+    return chainDatabaseCpu;
+}
+
+extern void chainDatabaseCpuDelete(ChainDatabaseCpu* chainDatabaseCpu) {
+
+    free(chainDatabaseCpu->indexes);
+    free(chainDatabaseCpu->lengths);
+    free(chainDatabaseCpu->codes);
+    free(chainDatabaseCpu->blocks);
+    free(chainDatabaseCpu->blocksLens);
+    free(chainDatabaseCpu->packed);
+
+    free(chainDatabaseCpu);
+    chainDatabaseCpu = NULL;
+}
+
+extern int chainDatabaseCpuGetBlocksLen(ChainDatabaseCpu* chainDatabaseCpu) {
+    return chainDatabaseCpu->blocksLen;
+}
+
+extern int chainDatabaseCpuGetBlock(const int** indexes, 
+    ChainDatabaseCpu* chainDatabaseCpu, int block) {
+    *indexes = chainDatabaseCpu->indexes + block * CPU_DB_LANES;
+    return CPU_DB_LANES;
+}
+
+extern void scoreChainDatabaseCpu(int* scores, int type, Chain* query, 
+    ChainDatabaseCpu* chainDatabaseCpu, int blocksStart, int blocksLen, 
+    Scorer* scorer) {
+
+    int lanes = CPU_DB_LANES;
+    int length = blocksLen * lanes;
+
+    int* blocksScores = (int*) malloc(length * sizeof(int));
+
+    int status = scoreInterleavedDatabaseSse(blocksScores, type, query, 
+        chainDatabaseCpu->blocks + blocksStart, 
+        chainDatabaseCpu->blocksLens + blocksStart, 
+        chainDatabaseCpu->packed + blocksStart, 
+        chainDatabaseCpu->lengths + blocksStart * lanes, 
+        chainDatabaseCpu->packedCodes, blocksLen, lanes, scorer);
+
+    scoreUnsolvedCpu(scores, blocksScores, status, type, query, chainDatabaseCpu,
+        blocksStart, blocksLen, scorer);
+
+    free(blocksScores);
+}
+
+extern void scoreChainDatabaseDualCpu(int* scores, int* scores2, int type, 
+    Chain* query, Chain* query2, ChainDatabaseCpu* chainDatabaseCpu, 
+    int blocksStart, int blocksLen, Scorer* scorer) {
+
+    int lanes = CPU_DB_LANES;
+    int length = blocksLen * lanes;
+
+    int* blocksScores = (int*) malloc(2 * length * sizeof(int));
+    int* blocksScores2 = blocksScores + length;
+
+    int status = scoreInterleavedDatabaseDualSse(blocksScores, blocksScores2, 
+        type, query, query2, chainDatabaseCpu->blocks + blocksStart, 
+        chainDatabaseCpu->blocksLens + blocksStart, 
+        chainDatabaseCpu->packed + blocksStart, 
+        chainDatabaseCpu->lengths + blocksStart * lanes, 
+        chainDatabaseCpu->packedCodes, blocksLen, lanes, scorer);
+
+    scoreUnsolvedCpu(scores, blocksScores, status, type, query, chainDatabaseCpu,
+        blocksStart, blocksLen, scorer);
+
+    scoreUnsolvedCpu(scores2, blocksScores2, status, type, query2, 
+        chainDatabaseCpu, blocksStart, blocksLen, scorer);
+
+    free(blocksScores);
+}
+
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // NW MODULES
 
@@ -252,6 +535,19 @@ extern void nwReconstructCpu(char** path, int* pathLen, int* outScore,
         return;
     }
     
+    // without the score the band is found by banded scoring, forced gaps are
+    // not handled by it
+    int band = MAX(rows, cols);
+
+    if (score == NO_SCORE && !queryFrontGap && !queryBackGap && 
+        !targetFrontGap && !targetBackGap) {
+
+        int bandScore;
+        if (scoreBanded(&bandScore, &band, NW_ALIGN, query, target, scorer) == 0) {
+            score = bandScore;
+        }
+    }
+
     int maxScore = scorerGetMaxScore(scorer);
     int minMatch = maxScore ? score / maxScore : 0;
     int t = MAX(rows, cols) - minMatch;
@@ -261,6 +557,8 @@ extern void nwReconstructCpu(char** path, int* pathLen, int* outScore,
         p = MAX(rows, cols);
     }
 
+    p = MIN(p, band);
+
     // perfect match, chains are equal
     if (t == 0) {
     
@@ -461,76 +759,8 @@ extern void nwReconstructCpu(char** path, int* pathLen, int* outScore,
 
 extern void nwFindScoreCpu(int* queryStart, int* targetStart, Chain* query, 
     int queryFrontGap, Chain* target, Scorer* scorer, int score) {
-    
-    *queryStart = -1;
-    *targetStart = -1;
-    
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
-    int gapDiff = gapOpen - gapExtend;
-
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int row;
-    int col; 
-
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
-
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
-
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = -gapOpen - col * gapExtend;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = -gapOpen - row * gapExtend + queryFrontGap * gapDiff;
-        int iAff = SCORE_MIN;
-        
-        int diag = (-gapOpen - (row - 1) * gapExtend + queryFrontGap * gapDiff) * (row > 0);
-                
-        for (col = 0; col < cols; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
-
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-            
-            if (scr == score) {
-                *queryStart = row;
-                *targetStart = col;
-                free(hBus);
-                return;
-            }
-                       
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
-    
-    free(hBus);
+    findScoreEngine(queryStart, targetStart, NW_ALIGN, query, queryFrontGap, 
+        target, scorer, score);
 }
 //------------------------------------------------------------------------------
 
@@ -539,323 +769,222 @@ extern void nwFindScoreCpu(int* queryStart, int* targetStart, Chain* query,
 
 extern void ovFindScoreCpu(int* queryStart, int* targetStart, Chain* query, 
     Chain* target, Scorer* scorer, int score) {
-    
-    *queryStart = -1;
-    *targetStart = -1;
-    
+    findScoreEngine(queryStart, targetStart, OV_ALIGN, query, 0, target, 
+        scorer, score);
+}
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// EXTEND MODULES
+
+extern void xDropExtendCpu(char** path, int* pathLen, int* queryLen, 
+    int* targetLen, int* outScore, Chain* query, Chain* target, Scorer* scorer, 
+    int xDrop) {
+
     int gapOpen = scorerGetGapOpen(scorer);
     int gapExtend = scorerGetGapExtend(scorer);
+    int maxScore = scorerGetMaxScore(scorer);
 
     int rows = chainGetLength(query);
     int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int row;
-    int col; 
 
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+    // live cells score at least -xDrop, which limits their diagonal distance
+    if (gapExtend > 0) {
+        long long rowsMax = cols + ((long long) maxScore * cols + xDrop) / gapExtend + 1;
+        rows = (int) MIN(rows, rowsMax);
+        long long colsMax = rows + ((long long) maxScore * rows + xDrop) / gapExtend + 1;
+        cols = (int) MIN(cols, colsMax);
+    }
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+    const char* queryCodes = chainGetCodes(query);
+    const char* targetCodes = chainGetCodes(target);
 
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = -gapOpen - col * gapExtend;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = -gapOpen - row * gapExtend;
-        int iAff = SCORE_MIN;
-        
-        int diag = (-gapOpen - (row - 1) * gapExtend) * (row > 0);
-                
-        for (col = 0; col < cols; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
+    int* hBuffer = (int*) malloc(2 * (cols + 1) * sizeof(int));
+    int* fBuffer = (int*) malloc(2 * (cols + 1) * sizeof(int));
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-            
-            if (scr == score && (row == rows - 1 || col == cols - 1)) {
-                *queryStart = row;
-                *targetStart = col;
-                free(hBus);
-                return;
-            }
-                       
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
-    
-    free(hBus);
-}
-//------------------------------------------------------------------------------
-//******************************************************************************
+    char* moves = (char*) malloc((cols + 1) * sizeof(char));
 
-//******************************************************************************
-// PRIVATE
+    ExtendRow* trace = (ExtendRow*) malloc((rows + 1) * sizeof(ExtendRow));
+    int traceLen = 0;
 
-//------------------------------------------------------------------------------
-// HW MODULES
+    int best = 0;
+    int bestRow = 0;
+    int bestCol = 0;
 
-static void hwAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score) {
-    
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
+    // previous row live cells
+    int start = 0;
+    int end = 1;
 
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int movesLen = cols * rows;
-    Move* moves = (Move*) malloc(movesLen * sizeof(Move));
-    
-    int row;
-    int col; 
+    int row, col;
+    for (row = 0; row <= rows; ++row) {
 
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+        int* hPrev = hBuffer + ((row + 1) % 2) * (cols + 1);
+        int* fPrev = fBuffer + ((row + 1) % 2) * (cols + 1);
+        int* h = hBuffer + (row % 2) * (cols + 1);
+        int* f = fBuffer + (row % 2) * (cols + 1);
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+        int first = -1;
+        int last = -1;
 
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = 0;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    int outScore = SCORE_MIN;
-    int endRow = 0;
-    int endCol = 0;
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = -gapOpen - row * gapExtend;
-        int iAff = SCORE_MIN;
-        
-        int diag = (-gapOpen - (row - 1) * gapExtend) * (row > 0);
-        
-        for (col = 0; col < cols; ++col) {
-        
-            int moveIdx = row * cols + col;
+        int e = EXTEND_NEG;
 
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            
-            if (ins == iAff - gapExtend) {
-                moves[moveIdx].hGaps = moves[moveIdx - 1].hGaps + 1;
-            } else {
-                moves[moveIdx].hGaps = 0;
+        for (col = start; col <= cols; ++col) {
+
+            int move = EXTEND_H_DIAG;
+            int score = EXTEND_NEG;
+
+            if (row == 0 && col == 0) {
+                score = 0;
+            } else if (row > 0 && col > 0 && col - 1 >= start && col - 1 < end) {
+                score = hPrev[col - 1] + scorerScore(scorer, 
+                    queryCodes[row - 1], targetCodes[col - 1]);
             }
-            // INSERT END
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-           
-            if (del == hBus[col].aff - gapExtend) {
-                moves[moveIdx].vGaps = moves[moveIdx - cols].vGaps + 1;
-            } else {
-                moves[moveIdx].vGaps = 0;
-            } 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-            
-            if (del == scr) {
-                moves[moveIdx].move = MOVE_UP;
-            } else if (ins == scr) {
-                moves[moveIdx].move = MOVE_LEFT;
-            } else {
-                moves[moveIdx].move = MOVE_DIAG;
+            // left neighbour is not live in the first column of the band
+            if (col > start) {
+
+                int open = h[col - 1] - gapOpen;
+                int extend = e - gapExtend;
+
+                if (open >= extend) {
+                    e = open;
+                    move |= EXTEND_E_OPEN;
+                } else {
+                    e = extend;
+                }
             }
-            
-            if (scr > outScore && row == rows - 1) {
-                outScore = scr;
-                endRow = row;
-                endCol = col;
+
+            int up = EXTEND_NEG;
+
+            if (row > 0 && col >= start && col < end) {
+
+                int open = hPrev[col] - gapOpen;
+                int extend = fPrev[col] - gapExtend;
+
+                if (open >= extend) {
+                    up = open;
+                    move |= EXTEND_F_OPEN;
+                } else {
+                    up = extend;
+                }
             }
-           
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
-    
-    row = endRow;
-    col = endCol;
-    
-    int pathEnd = endRow + endCol + 1;
-    int pathIdx = pathEnd;
-    
-    char* path = (char*) malloc(pathEnd * sizeof(char));
-    
-    while (row >= 0 && col >= 0) {
-        
-        int movesIdx = row * cols + col;
-        char move = moves[movesIdx].move;
-               
-        path[--pathIdx] = move;
-        
-        if (move == MOVE_DIAG) {
-            col--;
-            row--;
-        } else if (move == MOVE_LEFT) {
 
-            int gaps = moves[movesIdx].hGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_LEFT, gaps);
-            
-            col -= gaps + 1;
+            if (e > score) {
+                score = e;
+                move = (move & ~EXTEND_H_MASK) | EXTEND_H_LEFT;
+            }
 
-        } else if (move == MOVE_UP) {
+            if (up > score) {
+                score = up;
+                move = (move & ~EXTEND_H_MASK) | EXTEND_H_UP;
+            }
 
-            int gaps = moves[movesIdx].vGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_UP, gaps);
+            if (score < best - xDrop) {
+                score = e = up = EXTEND_NEG;
+            } else {
 
-            row -= gaps + 1;
-            
+                if (first == -1) {
+                    first = col;
+                }
+
+                last = col;
+
+                if (score > best) {
+                    best = score;
+                    bestRow = row;
+                    bestCol = col;
+                }
+            }
+
+            h[col] = score;
+            f[col] = up;
+            moves[col] = move;
+
+            // past the previous row only the left gaps can keep cells alive
+            if (col >= end && score == EXTEND_NEG) {
+                break;
+            }
         }
-        
-        // horizontal gaps till the end
-        if (col == -1 && row >= 0) {
-        
-            pathIdx -= row + 1;
-            memset(path + pathIdx, MOVE_UP, row + 1);
 
-            col = 0;
-            row = 0;
-            
+        if (first == -1) {
             break;
         }
+
+        trace[traceLen].start = first;
+        trace[traceLen].moves = (char*) malloc(last - first + 1);
+        memcpy(trace[traceLen].moves, moves + first, last - first + 1);
+        traceLen++;
+
+        start = first;
+        end = last + 1;
     }
-    
-    // don't count last move
-    if (row == -1) {
-        row++;
-        col++;
-    }
-        
-    int pathLen = pathEnd - pathIdx;
-    
-    // shift data to begining of the array
-    int shiftIdx;
-    for (shiftIdx = 0; shiftIdx < pathLen; ++shiftIdx) {
-        path[shiftIdx] = path[pathIdx + shiftIdx];
-    }
-    
-    free(hBus);
-    free(moves);
-    
-    *alignment = alignmentCreate(query, row, endRow, target, col, endCol, 
-        outScore, scorer, path, pathLen);
-}
 
-static int hwScore(Chain* query, Chain* target, Scorer* scorer) {
+    // path is built backwards from the end of the buffer
+    int bufferLen = bestRow + bestCol;
+    *path = (char*) malloc(bufferLen * sizeof(char));
 
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
+    int pathIdx = bufferLen - 1;
+    int matrix = EXTEND_H_DIAG;
 
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    int max = SCORE_MIN;
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int row;
-    int col; 
+    row = bestRow;
+    col = bestCol;
 
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+    while (row > 0 || col > 0) {
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+        char move = trace[row].moves[col - trace[row].start];
 
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = 0;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = -gapOpen - row * gapExtend;
-        int iAff = SCORE_MIN;
-        
-        int diag = (-gapOpen - (row - 1) * gapExtend) * (row > 0);
-        
-        for (col = 0; col < cols; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
+        if (matrix == EXTEND_H_DIAG) {
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-           
-            if (row == rows - 1) {
-                max = MAX(max, scr);
+            matrix = move & EXTEND_H_MASK;
+
+            if (matrix == EXTEND_H_DIAG) {
+                (*path)[pathIdx--] = MOVE_DIAG;
+                row--;
+                col--;
+            }
+
+        } else if (matrix == EXTEND_H_LEFT) {
+
+            (*path)[pathIdx--] = MOVE_LEFT;
+            col--;
+
+            if (move & EXTEND_E_OPEN) {
+                matrix = EXTEND_H_DIAG;
+            }
+
+        } else {
+
+            (*path)[pathIdx--] = MOVE_UP;
+            row--;
+
+            if (move & EXTEND_F_OPEN) {
+                matrix = EXTEND_H_DIAG;
             }
-            
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
         }
     }
-    
-    free(hBus);
-    
-    return max;
+
+    *pathLen = bufferLen - pathIdx - 1;
+    memmove(*path, *path + pathIdx + 1, *pathLen * sizeof(char));
+
+    *queryLen = bestRow;
+    *targetLen = bestCol;
+    *outScore = best;
+
+    for (row = 0; row < traceLen; ++row) {
+        free(trace[row].moves);
+    }
+
+    free(trace);
+    free(moves);
+    free(hBuffer);
+    free(fBuffer);
 }
 
 //------------------------------------------------------------------------------
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
 
 //------------------------------------------------------------------------------
 // NW MODULES
@@ -877,18 +1006,69 @@ static void nwAlign(Alignment** alignment, Chain* query, Chain* target,
         outScore, scorer, path, pathLen);
 }
 
-static int nwScore(Chain* query, Chain* target, Scorer* scorer) {
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// BANDED MODULES
+
+static int scoreBanded(int* score, int* band, int type, Chain* query, 
+    Chain* target, Scorer* scorer) {
+
+    int rows = chainGetLength(query);
+    int cols = chainGetLength(target);
+
+    if ((type != NW_ALIGN && type != HW_ALIGN) || rows == 0 || cols == 0) {
+        return -1;
+    }
+
+    int p = CPU_BAND_START;
+
+    long long work = 0;
+    long long maxWork = (long long) rows * cols / CPU_BAND_WORK;
+
+    while (1) {
+
+        // band of diagonals (col - row) which contains the main diagonal and 
+        // the end cell with p diagonals on both sides
+        int low = MIN(0, cols - rows) - p;
+        int high = MAX(0, cols - rows) + p;
+
+        // wide bands are solved faster without the band bookkeeping
+        if (2 * (long long) (high - low + 1) >= cols) {
+            return -1;
+        }
+
+        work += (long long) (rows + 1) * (high - low + 1);
+
+        if (work > maxWork) {
+            return -1;
+        }
+
+        int bound;
+        int bandScore = solveBand(&bound, type, query, target, scorer, low, high);
+
+        if (bandScore >= bound) {
+            *score = bandScore;
+            *band = p;
+            return 0;
+        }
+
+        p *= 2;
+    }
+}
+
+static int solveBand(int* bound, int type, Chain* query, Chain* target, 
+    Scorer* scorer, int low, int high) {
 
     int gapOpen = scorerGetGapOpen(scorer);
     int gapExtend = scorerGetGapExtend(scorer);
+    int maxGain = MAX(0, scorerGetMaxScore(scorer));
 
     int rows = chainGetLength(query);
     int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int row;
-    int col; 
+
+    // end diagonal, for hw the highest one
+    int end = cols - rows;
 
     const char* const rowCodes = chainGetCodes(query);
     const char* const colCodes = chainGetCodes(target);
@@ -896,637 +1076,196 @@ static int nwScore(Chain* query, Chain* target, Scorer* scorer) {
     const int* const scorerTable = scorerGetTable(scorer);
     int scorerMaxCode = scorerGetMaxCode(scorer);
 
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = -gapOpen - col * gapExtend;
-        hBus[col].aff = SCORE_MIN;
+    // matrix includes the border row and column, cells outside of the band are
+    // never read
+    int* hBuffer = (int*) malloc(2 * (cols + 1) * sizeof(int));
+    int* fBuffer = (int*) malloc(2 * (cols + 1) * sizeof(int));
+
+    int score = SCORE_MIN;
+
+    // every path leaving the band is bounded by the value of its first move
+    // out of the band and the maximal gain of the rest of the path
+    int outBound = SCORE_MIN;
+
+    // hw paths starting right of the band
+    if (type == HW_ALIGN && high < cols) {
+        int gain = maxGain * MAX(0, rows - (high + 1 - end)) - gapOpen - 
+            (high - end) * gapExtend;
+        outBound = MAX(outBound, gain);
     }
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = -gapOpen - row * gapExtend;
-        int iAff = SCORE_MIN;
-        
-        int diag = (-gapOpen - (row - 1) * gapExtend) * (row > 0);
-        
-        for (col = 0; col < cols; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-           
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
-    
-    int score = hBus[cols - 1].scr;
-    
-    free(hBus);
-    
-    return score;
-}
-
-//------------------------------------------------------------------------------
-
-//------------------------------------------------------------------------------
-// OV MODULES
-
-static void ovAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score) {
-    
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
-
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int movesLen = cols * rows;
-    Move* moves = (Move*) malloc(movesLen * sizeof(Move));
-    
-    int row;
-    int col; 
-
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
-
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
-
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = 0;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    int outScore = SCORE_MIN;
-    int endRow = 0;
-    int endCol = 0;
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = 0;
-        int iAff = SCORE_MIN;
-        
-        int diag = 0;
-        
-        for (col = 0; col < cols; ++col) {
-        
-            int moveIdx = row * cols + col;
-
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            
-            if (ins == iAff - gapExtend) {
-                moves[moveIdx].hGaps = moves[moveIdx - 1].hGaps + 1;
-            } else {
-                moves[moveIdx].hGaps = 0;
-            }
-            // INSERT END
-
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-           
-            if (del == hBus[col].aff - gapExtend) {
-                moves[moveIdx].vGaps = moves[moveIdx - cols].vGaps + 1;
-            } else {
-                moves[moveIdx].vGaps = 0;
-            } 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-            
-            if (del == scr) {
-                moves[moveIdx].move = MOVE_UP;
-            } else if (ins == scr) {
-                moves[moveIdx].move = MOVE_LEFT;
-            } else {
-                moves[moveIdx].move = MOVE_DIAG;
-            }
-            
-            if (scr > outScore && (row == rows - 1 || col == cols - 1)) {
-                outScore = scr;
-                endRow = row;
-                endCol = col;
-            }
-           
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
+    int row, col;
+    for (row = 0; row <= rows; ++row) {
 
-    row = endRow;
-    col = endCol;
-    
-    int pathEnd = endRow + endCol + 1;
-    int pathIdx = pathEnd;
-    
-    char* path = (char*) malloc(pathEnd * sizeof(char));
-    
-    while (row >= 0 && col >= 0) {
-        
-        int movesIdx = row * cols + col;
-        char move = moves[movesIdx].move;
-               
-        path[--pathIdx] = move;
-        
-        if (move == MOVE_DIAG) {
-            col--;
-            row--;
-        } else if (move == MOVE_LEFT) {
+        int* hPrev = hBuffer + ((row + 1) % 2) * (cols + 1);
+        int* fPrev = fBuffer + ((row + 1) % 2) * (cols + 1);
+        int* h = hBuffer + (row % 2) * (cols + 1);
+        int* f = fBuffer + (row % 2) * (cols + 1);
 
-            int gaps = moves[movesIdx].hGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_LEFT, gaps);
-            
-            col -= gaps + 1;
+        int start = MAX(0, row + low);
+        int stop = MIN(cols, row + high);
 
-        } else if (move == MOVE_UP) {
+        // previous row band
+        int prevStart = MAX(0, row - 1 + low);
+        int prevStop = MIN(cols, row - 1 + high);
 
-            int gaps = moves[movesIdx].vGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_UP, gaps);
+        int e = SCORE_MIN;
 
-            row -= gaps + 1;
-            
-        }
-    }
-    
-    // don't count last move (diagonal) out of the matrix
-    if (row == -1 || col == -1) {
-        row++;
-        col++;
-    }
+        for (col = start; col <= stop; ++col) {
 
-    if (pathEnd - pathIdx <= 0) {
-        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, outScore, scorer, NULL, 0);
-    } else {
+            int scr;
+            int up = SCORE_MIN;
 
-        int pathLen = pathEnd - pathIdx;
-        
-        // shift data to begining of the array
-        int shiftIdx;
-        for (shiftIdx = 0; shiftIdx < pathLen; ++shiftIdx) {
-            path[shiftIdx] = path[pathIdx + shiftIdx];
-        }
+            if (row == 0) {
 
-        *alignment = alignmentCreate(query, row, endRow, target, col, endCol, 
-            outScore, scorer, path, pathLen);
-    }
+                if (col == 0 || type == HW_ALIGN) {
+                    scr = 0;
+                } else {
+                    e = -gapOpen - (col - 1) * gapExtend;
+                    scr = e;
+                }
 
-    free(hBus);
-    free(moves);
-}
+            } else if (col == 0) {
 
-static int ovScore(Chain* query, Chain* target, Scorer* scorer) {
+                up = -gapOpen - (row - 1) * gapExtend;
+                scr = up;
 
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
+            } else {
 
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    int max = SCORE_MIN;
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-        
-    int row;
-    int col; 
+                scr = SCORE_MIN;
 
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+                if (col - 1 >= prevStart) {
+                    scr = hPrev[col - 1] + scorerTable[rowCodes[row - 1] * 
+                        scorerMaxCode + colCodes[col - 1]];
+                }
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+                if (col > start) {
+                    e = MAX(h[col - 1] - gapOpen, e - gapExtend);
+                }
 
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = 0;
-        hBus[col].aff = SCORE_MIN;
-    }
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = 0;
-        int iAff = SCORE_MIN;
-        
-        int diag = 0;
-        
-        for (col = 0; col < cols; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
+                if (col <= prevStop) {
+                    up = MAX(hPrev[col] - gapOpen, fPrev[col] - gapExtend);
+                }
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(mch, MAX(ins, del));
-           
-            if (row == rows - 1 || col == cols - 1) {
-                max = MAX(max, scr);
+                scr = MAX(scr, MAX(e, up));
             }
-            
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
-    }
-    
-    free(hBus);
-    
-    return max;
-}
-//------------------------------------------------------------------------------
-
-//------------------------------------------------------------------------------
-// SW MODULES
 
-static void swAlign(Alignment** alignment, Chain* query, Chain* target, 
-    Scorer* scorer, int score) {
-    
-    if (scorerGetMaxScore(scorer) <= 0) {
-        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, 0, scorer, NULL, 0);
-        return;
-    }
+            h[col] = scr;
+            f[col] = up;
 
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
+            // first move right of the band
+            if (col - row == high && col < cols) {
 
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
+                int out = MAX(scr - gapOpen, e - gapExtend);
+                int gain = maxGain * MAX(0, rows - row - (high + 1 - end)) - 
+                    gapOpen - (high - end) * gapExtend;
 
-    int movesLen = cols * rows;
-    Move* moves = (Move*) malloc(movesLen * sizeof(Move));
-    
-    int row;
-    int col; 
-    
-    for (col = 0; col < cols; ++col) {
-        hBus[col].scr = 0;
-        hBus[col].aff = SCORE_MIN;
-    }
-
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+                outBound = MAX(outBound, out + gain);
+            }
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+            // first move left of the band
+            if (col - row == low && row < rows) {
 
-    int outScore = 0;
-    int endRow = 0;
-    int endCol = 0;
-    
-    int pruning = 1;
-    int pruneLow = 0;
-    int pruneHigh = cols;
-    int pruneFactor = scorerGetMaxScore(scorer);
-    
-    int bestScore = MAX(outScore, score);
+                int out = MAX(scr - gapOpen, up - gapExtend);
+                int gain;
 
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = 0;
-        int iAff = SCORE_MIN;
-        
-        int diag = 0;
-        
-        if (pruning && row > rows / 2) {
-        
-            for (col = pruneLow; rows - row <= cols - col; ++col) {
-            
-                int scr = hBus[col].scr; 
-                if (col > 0) {
-                    scr = MAX(scr, hBus[col - 1].scr);
-                }
-                
-                if (scr + (rows - row) * pruneFactor < bestScore) {
-                    pruneLow = col;
+                if (type == HW_ALIGN) {
+                    gain = maxGain * MIN(rows - row - 1, cols - col);
                 } else {
-                    break;
+                    gain = maxGain * MAX(0, cols - col - (end - low + 1)) - 
+                        gapOpen - (end - low) * gapExtend;
                 }
-            }
 
-            if (pruneLow != 0) {
-                diag = hBus[pruneLow - 1].scr;
-            }
-        }
-        
-        if (pruning) {
-        
-            pruneHigh = cols;
-            for (col = cols - 1; cols - col <= rows - row; --col) {
-            
-                int scr = hBus[col].scr; 
-                if (col > 0) {
-                    scr = MAX(scr, hBus[col - 1].scr);
-                }
-                
-                if (scr + (cols - col) * pruneFactor < bestScore) {
-                    pruneHigh = col;
-                } else {
-                    break;
-                }
-            }
-            
-            if (pruneHigh < cols) {
-                hBus[pruneHigh].scr = 0;
-                hBus[pruneHigh].aff = SCORE_MIN;
+                outBound = MAX(outBound, out + gain);
             }
         }
-        
-        for (col = pruneLow; col < pruneHigh; ++col) {
-        
-            int moveIdx = row * cols + col;
-
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            
-            if (ins == iAff - gapExtend) {
-                moves[moveIdx].hGaps = moves[moveIdx - 1].hGaps + 1;
-            } else {
-                moves[moveIdx].hGaps = 0;
-            }
-            // INSERT END
 
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-           
-            if (del == hBus[col].aff - gapExtend) {
-                moves[moveIdx].vGaps = moves[moveIdx - cols].vGaps + 1;
-            } else {
-                moves[moveIdx].vGaps = 0;
-            } 
-            // DELETE END
-            
-            int scr = MAX(MAX(0, mch), MAX(ins, del));
-            
-            if (del == scr) {
-                moves[moveIdx].move = MOVE_UP;
-            } else if (ins == scr) {
-                moves[moveIdx].move = MOVE_LEFT;
-            } else if (mch == scr) {
-                moves[moveIdx].move = MOVE_DIAG;
+        if (row == rows) {
+            if (type == HW_ALIGN) {
+                for (col = start; col <= stop; ++col) {
+                    score = MAX(score, h[col]);
+                }
             } else {
-                moves[moveIdx].move = MOVE_STOP;
-            }
-            
-            if (scr > outScore) {
-                outScore = scr;
-                endRow = row;
-                endCol = col;
-                bestScore = MAX(bestScore, scr);
+                score = h[cols];
             }
-           
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
         }
     }
-    
-    if ((endRow == 0 || endCol == 0) && bestScore == 0) {
 
-        free(hBus);
-        free(moves);
+    free(hBuffer);
+    free(fBuffer);
 
-        *alignment = alignmentCreate(query, 0, 0, target, 0, 0, 0, scorer, NULL, 0);
+    *bound = outBound;
 
-        return;
-    }
+    return score;
+}
 
-    row = endRow;
-    col = endCol;
-    
-    int pathEnd = endRow + endCol + 1;
-    int pathIdx = pathEnd;
-    
-    char* path = (char*) malloc(pathEnd * sizeof(char));
-    
-    while (row >= 0 && col >= 0) {
-        
-        int movesIdx = row * cols + col;
-        char move = moves[movesIdx].move;
-               
-        path[--pathIdx] = move;
-        
-        if (move == MOVE_DIAG) {
-            col--;
-            row--;
-        } else if (move == MOVE_LEFT) {
+//------------------------------------------------------------------------------
 
-            int gaps = moves[movesIdx].hGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_LEFT, gaps);
-            
-            col -= gaps + 1;
+//------------------------------------------------------------------------------
+// DATABASE MODULES
 
-        } else if (move == MOVE_UP) {
+static void scoreUnsolvedCpu(int* scores, int* blocksScores, int status, 
+    int type, Chain* query, ChainDatabaseCpu* chainDatabaseCpu, int blocksStart, 
+    int blocksLen, Scorer* scorer) {
 
-            int gaps = moves[movesIdx].vGaps;
-            
-            pathIdx -= gaps;
-            memset(path + pathIdx, MOVE_UP, gaps);
+    int lanes = CPU_DB_LANES;
+    int length = blocksLen * lanes;
 
-            row -= gaps + 1;
-            
+    int* indexes = chainDatabaseCpu->indexes + blocksStart * lanes;
+    Chain** database = chainDatabaseCpu->database;
+
+    // solve the overflowed chains or all if the interleaved layout isn't supported
+    Chain** unsolved = (Chain**) malloc(length * sizeof(Chain*));
+    int* unsolvedIndexes = (int*) malloc(length * sizeof(int));
+    int unsolvedLen = 0;
+
+    int i;
+    for (i = 0; i < length; ++i) {
+
+        int idx = indexes[i];
+
+        if (idx == -1) {
+            continue;
+        }
+
+        if (status == 0 && blocksScores[i] != -1) {
+            scores[idx] = blocksScores[i];
         } else {
-            // don't count the stop move, it came from the diagonal
-            row++;
-            col++;
-            pathIdx++;
-            break;
+            unsolved[unsolvedLen] = database[idx];
+            unsolvedIndexes[unsolvedLen] = idx;
+            unsolvedLen++;
         }
     }
-    
-    // don't count last move (diagonal) out of the matrix
-    if (row == -1 || col == -1) {
-        row++;
-        col++;
-    }
-        
-    int pathLen = pathEnd - pathIdx;
-    
-    // shift data to begining of the array
-    int shiftIdx;
-    for (shiftIdx = 0; shiftIdx < pathLen; ++shiftIdx) {
-        path[shiftIdx] = path[pathIdx + shiftIdx];
-    }
-    
-    free(hBus);
-    free(moves);
-    
-    *alignment = alignmentCreate(query, row, endRow, target, col, endCol, 
-        outScore, scorer, path, pathLen);
-}
 
-static int swScore(Chain* query, Chain* target, Scorer* scorer) {
+    if (unsolvedLen > 0) {
+
+        scoreDatabaseCpu(blocksScores, type, query, unsolved, unsolvedLen, scorer);
 
-    if (scorerGetMaxScore(scorer) <= 0) {
-        return 0;
+        for (i = 0; i < unsolvedLen; ++i) {
+            scores[unsolvedIndexes[i]] = blocksScores[i];
+        }
     }
 
-    int gapOpen = scorerGetGapOpen(scorer);
-    int gapExtend = scorerGetGapExtend(scorer);
+    free(unsolved);
+    free(unsolvedIndexes);
+}
 
-    int rows = chainGetLength(query);
-    int cols = chainGetLength(target);
-    
-    int max = 0;
-    
-    HBus* hBus = (HBus*) malloc(cols * sizeof(HBus));
-    memset(hBus, 0, cols * sizeof(HBus));
+//------------------------------------------------------------------------------
 
-    int row;
-    int col; 
+//------------------------------------------------------------------------------
+// UTILS
 
-    const char* const rowCodes = chainGetCodes(query);
-    const char* const colCodes = chainGetCodes(target);
+static int chainLengthCmp(const void* a_, const void* b_) {
 
-    const int* const scorerTable = scorerGetTable(scorer);
-    int scorerMaxCode = scorerGetMaxCode(scorer);
+    ChainLength* a = (ChainLength*) a_;
+    ChainLength* b = (ChainLength*) b_;
 
-    int pruning = 1;
-    int pruneLow = 0;
-    int pruneHigh = cols;
-    int pruneFactor = scorerGetMaxScore(scorer);
-    
-    for (row = 0; row < rows; ++row) {
-    
-        int iScr = 0;
-        int iAff = SCORE_MIN;
-        
-        int diag = 0;
-        
-        if (pruning && row > rows / 2) {
-        
-            for (col = pruneLow; rows - row <= cols - col; ++col) {
-            
-                int scr = hBus[col].scr; 
-                if (col > 0) {
-                    scr = MAX(scr, hBus[col - 1].scr);
-                }
-                
-                if (scr + (rows - row) * pruneFactor < max) {
-                    pruneLow = col;
-                } else {
-                    break;
-                }
-            }
-
-            if (pruneLow != 0) {
-                diag = hBus[pruneLow - 1].scr;
-            }
-        }
-        
-        if (pruning) {
-        
-            pruneHigh = cols;
-            for (col = cols - 1; cols - col <= rows - row; --col) {
-            
-                int scr = hBus[col].scr; 
-                if (col > 0) {
-                    scr = MAX(scr, hBus[col - 1].scr);
-                }
-                
-                if (scr + (cols - col) * pruneFactor < max) {
-                    pruneHigh = col;
-                } else {
-                    break;
-                }
-            }
-            
-            if (pruneHigh < cols) {
-                hBus[pruneHigh].scr = 0;
-                hBus[pruneHigh].aff = SCORE_MIN;
-            }
-        }
-        
-        for (col = pruneLow; col < pruneHigh; ++col) {
-        
-            // MATCHING
-            int mch = scorerTable[rowCodes[row] * scorerMaxCode + colCodes[col]] + diag;
-            // MATCHING END
-            
-            // INSERT                
-            int ins = MAX(iScr - gapOpen, iAff - gapExtend); 
-            // INSERT END
-
-            // DELETE 
-            int del = MAX(hBus[col].scr - gapOpen, hBus[col].aff - gapExtend); 
-            // DELETE END
-            
-            int scr = MAX(MAX(0, mch), MAX(ins, del));
-           
-            max = MAX(max, scr);
-            
-            // UPDATE BUSES  
-            iScr = scr;
-            iAff = ins;
-            
-            diag = hBus[col].scr;
-            
-            hBus[col].scr = scr;
-            hBus[col].aff = del;
-            // UPDATE BUSES END
-        }
+    if (a->length == b->length) {
+        return a->idx - b->idx;
     }
-    
-    free(hBus);
-    
-    return max;
+
+    return b->length - a->length;
 }
+
 //------------------------------------------------------------------------------
 //******************************************************************************
@@ -127,6 +127,29 @@ returns the coordinates of the cell with the provided score, (-1, -1) otherwise.
 extern void ovFindScoreCpu(int* queryStart, int* targetStart, Chain* query, 
     Chain* target, Scorer* scorer, int score);
 
+/*!
+@brief X-drop extension implementation.
+
+Function aligns prefixes of the query and the target which both start at the 
+first element, used for extending an alignment from a fixed cell. Cells which 
+score more than xDrop below the best cell found so far are pruned, so only a 
+narrow band around the best extension is solved. Empty extension has score 0.
+For path format see ::Alignment.
+
+@param path output path
+@param pathLen output path length
+@param queryLen output number of query elements in the extension
+@param targetLen output number of target elements in the extension
+@param outScore output extension score
+@param query query chain
+@param target target chain
+@param scorer scorer object used for alignment
+@param xDrop maximal score drop below the best cell
+*/
+extern void xDropExtendCpu(char** path, int* pathLen, int* queryLen, 
+    int* targetLen, int* outScore, Chain* query, Chain* target, Scorer* scorer, 
+    int xDrop);
+
 /*!
 @brief Pairwise scoring function.
 
@@ -140,12 +163,144 @@ Scoring types are equivalent to aligning types.
 */
 extern int scorePairCpu(int type, Chain* query, Chain* target, Scorer* scorer);
 
+/*!
+@brief Two queries against one target scoring function.
+
+Function provides scores of the query and the query2 against the same target.
+Queries of the same length, for example both strands of a nucleotide query, are
+scored in a single pass over the target. Scores which can't be solved that way
+are set to -1, they should be solved with scorePairCpu(), independently of each 
+other.
+
+@param score output, score of the query or -1
+@param score2 output, score of the query2 or -1
+@param type scoring type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query first query chain
+@param query2 second query chain
+@param target target chain
+@param scorer scorer object used for alignment
+*/
+extern void scorePairDualCpu(int* score, int* score2, int type, Chain* query, 
+    Chain* query2, Chain* target, Scorer* scorer);
+
+/*!
+@brief Independent pairs scoring function.
+
+Function provides scores of pairs made of queries[i] and targets[i]. Pairs are
+packed into SIMD lanes when possible, others are scored one by one with 
+scorePairCpu().
+
+@param scores output, array of scores of length pairsLen
+@param type scoring type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param targets target chains array
+@param pairsLen number of pairs
+@param scorer scorer object used for alignment
+*/
+extern void scorePairsCpu(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer);
+
 extern void scoreDatabaseCpu(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer);
 
 extern void scoreDatabasePartiallyCpu(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer, int maxScore);
 
+/*!
+@brief CPU database scoring object.
+
+ChainDatabaseCpu keeps the chain database in the interleaved layout. Chains are
+sorted by length and grouped into blocks, every block is padded to the length 
+of its longest chain and stored column by column so the SIMD kernels read one
+contiguous vector of codes per column. Blocks made only of ACGT codes, like the
+nucleotide databases, are stored with 2 bits per code which cuts their memory
+four times.
+*/
+typedef struct ChainDatabaseCpu ChainDatabaseCpu;
+
+/*!
+@brief ChainDatabaseCpu constructor.
+
+@param database chain array
+@param databaseLen chain array length
+
+@return chainDatabaseCpu object
+*/
+extern ChainDatabaseCpu* chainDatabaseCpuCreate(Chain** database, 
+    int databaseLen);
+
+/*!
+@brief ChainDatabaseCpu destructor.
+
+@param chainDatabaseCpu chainDatabaseCpu object
+*/
+extern void chainDatabaseCpuDelete(ChainDatabaseCpu* chainDatabaseCpu);
+
+/*!
+@brief Blocks number getter.
+
+@param chainDatabaseCpu chainDatabaseCpu object
+
+@return number of blocks in the interleaved layout
+*/
+extern int chainDatabaseCpuGetBlocksLen(ChainDatabaseCpu* chainDatabaseCpu);
+
+/*!
+@brief Block chains getter.
+
+Blocks are ordered by the chain lengths, the first block holds the longest 
+chains. Every lane of the block holds the index of its chain in the database 
+array with which the chainDatabaseCpu was created, or -1 if the lane is empty.
+
+@param indexes output, database indexes of the block lanes
+@param chainDatabaseCpu chainDatabaseCpu object
+@param block block index
+
+@return number of lanes in the block
+*/
+extern int chainDatabaseCpuGetBlock(const int** indexes, 
+    ChainDatabaseCpu* chainDatabaseCpu, int block);
+
+/*!
+@brief Interleaved database scoring function.
+
+Function scores the query with every chain from the given range of blocks. 
+Scores are stored at the indexes of chains in the database array with which the
+chainDatabaseCpu was created, other scores are left intact.
+
+@param scores output, array of scores of length databaseLen
+@param type scoring type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query query chain
+@param chainDatabaseCpu cpu chain database object
+@param blocksStart index of the first block to score
+@param blocksLen number of blocks to score
+@param scorer scorer object used for alignment
+*/
+extern void scoreChainDatabaseCpu(int* scores, int type, Chain* query, 
+    ChainDatabaseCpu* chainDatabaseCpu, int blocksStart, int blocksLen, 
+    Scorer* scorer);
+
+/*!
+@brief Interleaved database dual scoring function.
+
+Function works as scoreChainDatabaseCpu() for two queries of the same length, 
+for example a nucleotide query and its complement. Both queries are scored in 
+one pass over the blocks, scores of the second query are stored to scores2.
+
+@param scores output, array of scores of the first query of length databaseLen
+@param scores2 output, array of scores of the second query of length databaseLen
+@param type scoring type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param query first query chain
+@param query2 second query chain, of the same length as the first one
+@param chainDatabaseCpu cpu chain database object
+@param blocksStart index of the first block to score
+@param blocksLen number of blocks to score
+@param scorer scorer object used for alignment
+*/
+extern void scoreChainDatabaseDualCpu(int* scores, int* scores2, int type, 
+    Chain* query, Chain* query2, ChainDatabaseCpu* chainDatabaseCpu, 
+    int blocksStart, int blocksLen, Scorer* scorer);
+
 #ifdef __cplusplus 
 }
 #endif
@@ -33,23 +33,30 @@ Contact the author by mkorpar@gmail.com.
 #include "db_alignment.h"
 #include "error.h"
 #include "gpu_module.h"
+#include "hit_cache.h"
 #include "post_proc.h"
 #include "scorer.h"
 #include "thread.h"
 #include "threadpool.h"
+#include "tune.h"
 #include "utils.h"
 
 #include "database.h"
 
-#define CPU_THREAD_CHUNK    1000
-#define CPU_PACKED_CHUNK    25
-
-#define GPU_DB_MIN_CELLS    49000000ll
-#define GPU_MIN_CELLS       40000000ll
 #define GPU_MIN_LEN         256
 
+#define FNV_OFFSET          14695981039346656037ull
+#define FNV_PRIME           1099511628211ull
+
+typedef struct Stream {
+    DbHitsCallback hitsCallback;
+    DbAlignmentsCallback alignmentsCallback;
+    void* param;
+} Stream;
+
 typedef struct Context {
     DbAlignment*** dbAlignments;
+    DbHit** dbHits;
     int* dbAlignmentsLen;
     int type;
     Chain** queries;
@@ -64,6 +71,7 @@ typedef struct Context {
     int indexesLen;
     int* cards;
     int cardsLen;
+    Stream* stream;
     Thread* thread;
 } Context;
 
@@ -107,6 +115,7 @@ typedef struct AlignContext {
     int* cards;
     int cardsLen;
     long long cells;
+    DbAlignment** source; // same residues aligned by another context, or NULL
 } AlignContext;
 
 typedef struct AlignContexts {
@@ -122,19 +131,41 @@ typedef struct AlignContextsPacked {
 
 typedef struct ScoreCpuContext {
     int* scores;
+    int* scores2;
     int type;
     Chain* query;
+    Chain* query2;
     Chain** database;
     int databaseLen;
+    ChainDatabaseCpu* chainDatabaseCpu;
+    int blocksStart;
+    int blocksLen;
     Scorer* scorer;
 } ScoreCpuContext;
 
+typedef struct ChainKey {
+    unsigned long long hash;
+    int length;
+    int idx;
+} ChainKey;
+
+typedef struct PairKey {
+    int query;
+    int target;
+    int idx;
+} PairKey;
+
 struct ChainDatabase {
+    ChainDatabaseCpu* chainDatabaseCpu;
     ChainDatabaseGpu* chainDatabaseGpu;
     Chain** database;
     int databaseStart;
     int databaseLen;
-    long databaseElems;
+    long databaseElems; // of the unique chains
+    Chain** uniques; // chains with distinct residues, the scored ones
+    int uniquesLen;
+    int* groups; // unique index of every chain, NULL if there are no duplicates
+    HitCache* hitCache;
 };
 
 //******************************************************************************
@@ -145,6 +176,9 @@ extern ChainDatabase* chainDatabaseCreate(Chain** database, int databaseStart,
 
 extern void chainDatabaseDelete(ChainDatabase* chainDatabase);
 
+extern void chainDatabaseSetHitCache(ChainDatabase* chainDatabase, 
+    HitCache* hitCache);
+
 extern void alignDatabase(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
     int type, Chain* query, ChainDatabase* chainDatabase, Scorer* scorer, 
     int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
@@ -157,25 +191,72 @@ extern void shotgunDatabase(DbAlignment**** dbAlignments, int** dbAlignmentsLen,
     void* valueFunctionParam, double valueThreshold, int* indexes, 
     int indexesLen, int* cards, int cardsLen, Thread* thread);
 
+extern void shotgunDatabaseStream(int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, DbHitsCallback hitsCallback, 
+    DbAlignmentsCallback alignmentsCallback, void* callbackParam, 
+    Thread* thread);
+
+extern void shotgunDatabaseHits(DbHit*** dbHits, int** dbHitsLen, int type, 
+    Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
+    Scorer* scorer, int maxAlignments, ValueFunction valueFunction, 
+    void* valueFunctionParam, double valueThreshold, int* indexes, 
+    int indexesLen, int* cards, int cardsLen, Thread* thread);
+
+extern void alignDatabaseHits(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    Chain** database, DbHit** dbHits, int* dbHitsLen, Scorer* scorer, 
+    int* cards, int cardsLen);
+
+extern void deleteShotgunDatabaseHits(DbHit** dbHits, int* dbHitsLen, 
+    int queriesLen);
+
 //******************************************************************************
 
 //******************************************************************************
 // PRIVATE
 
-static void databaseSearch(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
-    int type, Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
+static void databaseSearch(DbAlignment*** dbAlignments, DbHit** dbHits, 
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
     Scorer* scorer, int maxAlignments, ValueFunction valueFunction, 
     void* valueFunctionParam, double valueThreshold, int* indexes, 
-    int indexesLen, int* cards, int cardsLen, Thread* thread);
+    int indexesLen, int* cards, int cardsLen, Stream* stream, Thread* thread);
 
 static void* databaseSearchThread(void* param);
 
-static void databaseSearchStep(DbAlignment*** dbAlignments, 
+static void databaseSearchSteps(DbAlignment*** dbAlignments, DbHit** dbHits,
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, Stream* stream);
+
+static void databaseSearchCached(DbAlignment*** dbAlignments, DbHit** dbHits,
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* cards, int cardsLen, Stream* stream);
+
+static void databaseSearchStep(DbAlignment*** dbAlignments, DbHit** dbHits,
     int* dbAlignmentsLen, int type, Chain** queries, int queriesStart, 
     int queriesLen, ChainDatabase* chainDatabase, Scorer* scorer, 
     int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
     double valueThreshold, int* indexes, int indexesLen, int* cards, 
-    int cardsLen);
+    int cardsLen, Stream* stream);
+
+static void alignHits(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
+    int type, Chain** queries, int queriesStart, int queriesLen, 
+    Chain** database, DbHit** dbHits, Scorer* scorer, int* cards, 
+    int cardsLen, Stream* stream);
+
+static void copyAlignments(AlignContext* contexts, int contextsLen);
+
+static int streamAlignments(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLen, int queriesStart, int queriesDone, int queriesLen,
+    int* cpuEnds, int cpuDone, AlignContext* copies, int* copyEnds, 
+    Stream* stream);
 
 static void* alignThread(void* param);
 
@@ -188,16 +269,39 @@ static void* extractThread(void* param);
 static void* extractsThread(void* param);
 
 static void scoreCpu(int** scores, int type, Chain** queries, 
-    int queriesLen, Chain** database, int databaseLen, Scorer* scorer, 
-    int* indexes, int indexesLen);
+    int queriesLen, Chain** database, int databaseLen, 
+    ChainDatabaseCpu* chainDatabaseCpu, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen);
+
+static void scoreCpuBlocks(int* scores, int type, Chain** queries, 
+    int queriesLen, Chain** database, int databaseLen, 
+    ChainDatabaseCpu* chainDatabaseCpu, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold);
 
 static void* scoreCpuThread(void* param);
 
+static void pruneBlocks(int* limit, double** best, int* bestLen, int* scores, 
+    Chain* query, Chain** database, ChainDatabaseCpu* chainDatabaseCpu, 
+    int blocksStart, int blocksEnd, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold);
+
 static void filterIndexesArray(int** indexesNew, int* indexesNewLen, 
     int* indexes, int indexesLen, int minIndex, int maxIndex);
 
+static void chainsGroup(int** groups, Chain*** uniques, int* uniquesLen, 
+    Chain** chains, int chainsLen);
+
 static int dbAlignmentDataCmp(const void* a_, const void* b_);
 
+static int valueCmp(const void* a_, const void* b_);
+
+static int chainKeyCmp(const void* a_, const void* b_);
+
+static int pairKeyCmp(const void* a_, const void* b_);
+
 //******************************************************************************
 
 //******************************************************************************
@@ -214,14 +318,37 @@ extern ChainDatabase* chainDatabaseCreate(Chain** database, int databaseStart,
     db->databaseStart = databaseStart;
     db->databaseLen = databaseLen;
     
+    // identical chains are scored once, scores are shared by the whole group
+    chainsGroup(&(db->groups), &(db->uniques), &(db->uniquesLen), db->database,
+        databaseLen);
+
+    if (db->uniquesLen == databaseLen) {
+        free(db->groups);
+        free(db->uniques);
+        db->groups = NULL;
+        db->uniques = db->database;
+    }
+
+    LOG("%d of %d chains are unique", db->uniquesLen, databaseLen);
+
     int i;
     long databaseElems = 0;
-    for (i = 0; i < databaseLen; ++i) {
-        databaseElems += chainGetLength(db->database[i]);
+    for (i = 0; i < db->uniquesLen; ++i) {
+        databaseElems += chainGetLength(db->uniques[i]);
     }
     db->databaseElems = databaseElems;
+
+    db->hitCache = NULL;
+
+    // interleaved layout is used only by the cpu scoring
+    if (cardsLen == 0) {
+        db->chainDatabaseCpu = chainDatabaseCpuCreate(db->uniques, 
+            db->uniquesLen);
+    } else {
+        db->chainDatabaseCpu = NULL;
+    }
     
-    db->chainDatabaseGpu = chainDatabaseGpuCreate(db->database, databaseLen, 
+    db->chainDatabaseGpu = chainDatabaseGpuCreate(db->uniques, db->uniquesLen, 
         cards, cardsLen);
     
     TIMER_STOP;
@@ -231,21 +358,35 @@ extern ChainDatabase* chainDatabaseCreate(Chain** database, int databaseStart,
 
 extern void chainDatabaseDelete(ChainDatabase* chainDatabase) {
 
+    if (chainDatabase->chainDatabaseCpu != NULL) {
+        chainDatabaseCpuDelete(chainDatabase->chainDatabaseCpu);
+    }
+
     chainDatabaseGpuDelete(chainDatabase->chainDatabaseGpu);
+
+    if (chainDatabase->groups != NULL) {
+        free(chainDatabase->groups);
+        free(chainDatabase->uniques);
+    }
     
     free(chainDatabase); 
     chainDatabase = NULL;
 }
 
+extern void chainDatabaseSetHitCache(ChainDatabase* chainDatabase, 
+    HitCache* hitCache) {
+    chainDatabase->hitCache = hitCache;
+}
+
 extern void alignDatabase(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
     int type, Chain* query, ChainDatabase* chainDatabase, Scorer* scorer, 
     int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
     double valueThreshold, int* indexes, int indexesLen, int* cards, 
     int cardsLen, Thread* thread) {
 
-    databaseSearch(dbAlignments, dbAlignmentsLen, type, &query, 1,
+    databaseSearch(dbAlignments, NULL, dbAlignmentsLen, type, &query, 1,
         chainDatabase, scorer, maxAlignments, valueFunction, valueFunctionParam,
-        valueThreshold, indexes, indexesLen, cards, cardsLen, thread);
+        valueThreshold, indexes, indexesLen, cards, cardsLen, NULL, thread);
 }
 
 extern void shotgunDatabase(DbAlignment**** dbAlignments, int** dbAlignmentsLen, 
@@ -257,9 +398,74 @@ extern void shotgunDatabase(DbAlignment**** dbAlignments, int** dbAlignmentsLen,
     *dbAlignments = (DbAlignment***) malloc(queriesLen * sizeof(DbAlignment**));
     *dbAlignmentsLen = (int*) malloc(queriesLen * sizeof(int));
     
-    databaseSearch(*dbAlignments, *dbAlignmentsLen, type, queries, queriesLen,
+    databaseSearch(*dbAlignments, NULL, *dbAlignmentsLen, type, queries, 
+        queriesLen, chainDatabase, scorer, maxAlignments, valueFunction, 
+        valueFunctionParam, valueThreshold, indexes, indexesLen, cards, 
+        cardsLen, NULL, thread);
+}
+
+extern void shotgunDatabaseStream(int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, DbHitsCallback hitsCallback, 
+    DbAlignmentsCallback alignmentsCallback, void* callbackParam, 
+    Thread* thread) {
+
+    // released by the search thread
+    Stream* stream = (Stream*) malloc(sizeof(Stream));
+    stream->hitsCallback = hitsCallback;
+    stream->alignmentsCallback = alignmentsCallback;
+    stream->param = callbackParam;
+
+    DbAlignment*** dbAlignments = 
+        (DbAlignment***) malloc(queriesLen * sizeof(DbAlignment**));
+    int* dbAlignmentsLen = (int*) malloc(queriesLen * sizeof(int));
+
+    databaseSearch(dbAlignments, NULL, dbAlignmentsLen, type, queries, 
+        queriesLen, chainDatabase, scorer, maxAlignments, valueFunction, 
+        valueFunctionParam, valueThreshold, indexes, indexesLen, cards, 
+        cardsLen, stream, thread);
+}
+
+extern void shotgunDatabaseHits(DbHit*** dbHits, int** dbHitsLen, int type, 
+    Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
+    Scorer* scorer, int maxAlignments, ValueFunction valueFunction, 
+    void* valueFunctionParam, double valueThreshold, int* indexes, 
+    int indexesLen, int* cards, int cardsLen, Thread* thread) {
+
+    *dbHits = (DbHit**) malloc(queriesLen * sizeof(DbHit*));
+    *dbHitsLen = (int*) malloc(queriesLen * sizeof(int));
+    
+    databaseSearch(NULL, *dbHits, *dbHitsLen, type, queries, queriesLen,
         chainDatabase, scorer, maxAlignments, valueFunction, valueFunctionParam, 
-        valueThreshold, indexes, indexesLen, cards, cardsLen, thread);
+        valueThreshold, indexes, indexesLen, cards, cardsLen, NULL, thread);
+}
+
+extern void alignDatabaseHits(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    Chain** database, DbHit** dbHits, int* dbHitsLen, Scorer* scorer, 
+    int* cards, int cardsLen) {
+
+    *dbAlignments = (DbAlignment***) malloc(queriesLen * sizeof(DbAlignment**));
+    *dbAlignmentsLen = (int*) malloc(queriesLen * sizeof(int));
+
+    memcpy(*dbAlignmentsLen, dbHitsLen, queriesLen * sizeof(int));
+
+    alignHits(*dbAlignments, *dbAlignmentsLen, type, queries, 0, queriesLen,
+        database, dbHits, scorer, cards, cardsLen, NULL);
+}
+
+extern void deleteShotgunDatabaseHits(DbHit** dbHits, int* dbHitsLen, 
+    int queriesLen) {
+
+    int i;
+    for (i = 0; i < queriesLen; ++i) {
+        free(dbHits[i]);
+    }
+
+    free(dbHits);
+    free(dbHitsLen);
 }
 
 //******************************************************************************
@@ -270,15 +476,17 @@ extern void shotgunDatabase(DbAlignment**** dbAlignments, int** dbAlignmentsLen,
 //------------------------------------------------------------------------------
 // SEARCH
 
-static void databaseSearch(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
-    int type, Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
-    Scorer* scorer, int maxAlignments, ValueFunction valueFunction, 
-    void* valueFunctionParam, double valueThreshold, int* indexes, 
-    int indexesLen, int* cards, int cardsLen, Thread* thread) {
+static void databaseSearch(DbAlignment*** dbAlignments, DbHit** dbHits, 
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, Stream* stream, Thread* thread) {
     
     Context* param = (Context*) malloc(sizeof(Context));
     
     param->dbAlignments = dbAlignments;
+    param->dbHits = dbHits;
     param->dbAlignmentsLen = dbAlignmentsLen;
     param->type = type;
     param->queries = queries;
@@ -293,6 +501,7 @@ static void databaseSearch(DbAlignment*** dbAlignments, int* dbAlignmentsLen,
     param->indexesLen = indexesLen;
     param->cards = cards;
     param->cardsLen = cardsLen;
+    param->stream = stream;
     
     if (thread == NULL) {
         databaseSearchThread(param);
@@ -306,6 +515,7 @@ static void* databaseSearchThread(void* param) {
     Context* context = (Context*) param;
     
     DbAlignment*** dbAlignments = context->dbAlignments;
+    DbHit** dbHits = context->dbHits;
     int* dbAlignmentsLen = context->dbAlignmentsLen;
     int type = context->type;
     Chain** queries = context->queries;
@@ -318,6 +528,7 @@ static void* databaseSearchThread(void* param) {
     double valueThreshold = context->valueThreshold;
     int* cards = context->cards;
     int cardsLen = context->cardsLen;
+    Stream* stream = context->stream;
     
     int databaseStart = chainDatabase->databaseStart;
     int databaseLen = chainDatabase->databaseLen;
@@ -356,7 +567,54 @@ static void* databaseSearchThread(void* param) {
  
     //**************************************************************************
     // DO THE ALIGN
-     
+
+    // cached hits are keyed by the whole database part
+    if (chainDatabase->hitCache != NULL && indexes == NULL) {
+        databaseSearchCached(dbAlignments, dbHits, dbAlignmentsLen, type, 
+            queries, queriesLen, chainDatabase, scorer, maxAlignments, 
+            valueFunction, valueFunctionParam, valueThreshold, cards, 
+            cardsLen, stream);
+    } else {
+        databaseSearchSteps(dbAlignments, dbHits, dbAlignmentsLen, type, 
+            queries, queriesLen, chainDatabase, scorer, maxAlignments, 
+            valueFunction, valueFunctionParam, valueThreshold, indexes, 
+            indexesLen, cards, cardsLen, stream);
+    }
+
+    //**************************************************************************
+ 
+    //**************************************************************************
+    // CLEAN MEMORY
+
+    free(indexes); // copy
+
+    // streamed alignments are owned by the callbacks
+    if (stream != NULL) {
+        free(dbAlignments);
+        free(dbAlignmentsLen);
+        free(stream);
+    }
+    
+    free(param);
+
+    //**************************************************************************
+    
+    TIMER_STOP;
+        
+    return NULL;
+}
+
+static void databaseSearchSteps(DbAlignment*** dbAlignments, DbHit** dbHits,
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, Stream* stream) {
+
+    int databaseLen = chainDatabase->databaseLen;
+
+    int i;
+
     double memory = (double) databaseLen * queriesLen * sizeof(int); // scores
     memory = (memory * 1.15) / 1024.0 / 1024.0; // 15% offset and to MB
     
@@ -375,59 +633,197 @@ static void* databaseSearchThread(void* param) {
 
         LOG("Solving %d-%d", offset, offset + length);
 
-        databaseSearchStep(dbAlignments + offset, dbAlignmentsLen + offset, 
+        databaseSearchStep(
+            dbAlignments == NULL ? NULL : dbAlignments + offset, 
+            dbHits == NULL ? NULL : dbHits + offset, dbAlignmentsLen + offset, 
             type, queries + offset, offset, length, chainDatabase, scorer, 
             maxAlignments, valueFunction, valueFunctionParam, valueThreshold, 
-            indexes, indexesLen, cards, cardsLen);
+            indexes, indexesLen, cards, cardsLen, stream);
 
         offset += length;
     }
+}
+
+static void databaseSearchCached(DbAlignment*** dbAlignments, DbHit** dbHits,
+    int* dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* cards, int cardsLen, Stream* stream) {
+
+    HitCache* hitCache = chainDatabase->hitCache;
+    int databaseStart = chainDatabase->databaseStart;
+    int databaseLen = chainDatabase->databaseLen;
+
+    int i, j;
+
+    DbHit** hits = dbHits;
+
+    if (hits == NULL) {
+        hits = (DbHit**) malloc(queriesLen * sizeof(DbHit*));
+    }
 
     //**************************************************************************
- 
+    // READ CACHED HITS
+
+    Chain** missed = (Chain**) malloc(queriesLen * sizeof(Chain*));
+    int* missedIdxs = (int*) malloc(queriesLen * sizeof(int));
+    int missedLen = 0;
+
+    for (i = 0; i < queriesLen; ++i) {
+
+        int found = hitCacheGet(&(hits[i]), &(dbAlignmentsLen[i]), hitCache, 
+            queries[i], databaseStart, databaseLen, type, scorer, 
+            maxAlignments, valueThreshold);
+
+        if (found) {
+            for (j = 0; j < dbAlignmentsLen[i]; ++j) {
+                hits[i][j].queryIdx = i;
+            }
+        } else {
+            missed[missedLen] = queries[i];
+            missedIdxs[missedLen] = i;
+            missedLen++;
+        }
+    }
+
+    LOG("%d of %d queries found in the hit cache", queriesLen - missedLen, 
+        queriesLen);
+
     //**************************************************************************
-    // CLEAN MEMORY
 
-    free(indexes); // copy
-    
-    free(param);
+    //**************************************************************************
+    // SEARCH AND STORE MISSED QUERIES
+
+    if (missedLen > 0) {
+
+        DbHit** missedHits = (DbHit**) malloc(missedLen * sizeof(DbHit*));
+        int* missedHitsLen = (int*) malloc(missedLen * sizeof(int));
+
+        databaseSearchSteps(NULL, missedHits, missedHitsLen, type, missed, 
+            missedLen, chainDatabase, scorer, maxAlignments, valueFunction, 
+            valueFunctionParam, valueThreshold, NULL, 0, cards, cardsLen, NULL);
+
+        for (i = 0; i < missedLen; ++i) {
+
+            int idx = missedIdxs[i];
+
+            hits[idx] = missedHits[i];
+            dbAlignmentsLen[idx] = missedHitsLen[i];
+
+            for (j = 0; j < dbAlignmentsLen[idx]; ++j) {
+                hits[idx][j].queryIdx = idx;
+            }
+
+            hitCachePut(hitCache, hits[idx], dbAlignmentsLen[idx], queries[idx],
+                databaseStart, databaseLen, type, scorer, maxAlignments, 
+                valueThreshold);
+        }
+
+        free(missedHits);
+        free(missedHitsLen);
+    }
+
+    free(missed);
+    free(missedIdxs);
+
+    if (stream != NULL && stream->hitsCallback != NULL) {
+        for (i = 0; i < queriesLen; ++i) {
+            stream->hitsCallback(i, hits[i], dbAlignmentsLen[i], stream->param);
+        }
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // ALIGN BEST TARGETS
+
+    if (dbHits == NULL) {
+
+        // hits target indexes are relative to the start of the whole database
+        alignHits(dbAlignments, dbAlignmentsLen, type, queries, 0, queriesLen,
+            chainDatabase->database - databaseStart, hits, scorer, cards, 
+            cardsLen, stream);
+
+        for (i = 0; i < queriesLen; ++i) {
+            free(hits[i]);
+        }
+        free(hits);
+    }
 
     //**************************************************************************
-    
-    TIMER_STOP;
-        
-    return NULL;
 }
 
-static void databaseSearchStep(DbAlignment*** dbAlignments, 
+static void databaseSearchStep(DbAlignment*** dbAlignments, DbHit** dbHits,
     int* dbAlignmentsLen, int type, Chain** queries, int queriesStart, 
     int queriesLen, ChainDatabase* chainDatabase, Scorer* scorer, 
     int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
     double valueThreshold, int* indexes, int indexesLen, int* cards, 
-    int cardsLen) {
+    int cardsLen, Stream* stream) {
     
     Chain** database = chainDatabase->database;
     int databaseStart = chainDatabase->databaseStart;
     int databaseLen = chainDatabase->databaseLen;
     long databaseElems = chainDatabase->databaseElems;
+    ChainDatabaseCpu* chainDatabaseCpu = chainDatabase->chainDatabaseCpu;
     ChainDatabaseGpu* chainDatabaseGpu = chainDatabase->chainDatabaseGpu;
+    Chain** uniques = chainDatabase->uniques;
+    int uniquesLen = chainDatabase->uniquesLen;
+    int* groups = chainDatabase->groups;
     
-    int i, j, k;
+    int i, j;
+
+    //**************************************************************************
+    // COLLAPSE DUPLICATES
+
+    // identical queries are scored and extracted once, results are shared by 
+    // the whole group
+    int* queryGroups;
+    Chain** uniqueQueries;
+    int uniqueQueriesLen;
+
+    chainsGroup(&queryGroups, &uniqueQueries, &uniqueQueriesLen, queries, 
+        queriesLen);
+
+    // database is scored on the unique chains
+    int* uniqueIndexes = indexes;
+    int uniqueIndexesLen = indexesLen;
+
+    if (indexes != NULL && groups != NULL) {
+
+        uniqueIndexes = (int*) malloc(indexesLen * sizeof(int));
+        uniqueIndexesLen = 0;
+
+        char* used = (char*) calloc(uniquesLen, sizeof(char));
+
+        for (i = 0; i < indexesLen; ++i) {
+
+            int group = groups[indexes[i]];
+
+            if (!used[group]) {
+                used[group] = 1;
+                uniqueIndexes[uniqueIndexesLen++] = group;
+            }
+        }
+
+        free(used);
+    }
+
+    //**************************************************************************
     
     //**************************************************************************
     // CALCULATE CELL NUMBER
     
     long queriesElems = 0;
-    for (i = 0; i < queriesLen; ++i) {
-        queriesElems += chainGetLength(queries[i]);
+    for (i = 0; i < uniqueQueriesLen; ++i) {
+        queriesElems += chainGetLength(uniqueQueries[i]);
     }
     
     if (indexes != NULL) {
     
         databaseElems = 0;
         
-        for (i = 0; i < indexesLen; ++i) {
-            databaseElems += chainGetLength(database[indexes[i]]);
+        for (i = 0; i < uniqueIndexesLen; ++i) {
+            databaseElems += chainGetLength(uniques[uniqueIndexes[i]]);
         }
     }
     
@@ -440,12 +836,46 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
     
     int* scores;
     
-    if (cells < GPU_DB_MIN_CELLS || cardsLen == 0) {
-        scoreCpu(&scores, type, queries, queriesLen, database, 
-            databaseLen, scorer, indexes, indexesLen);
+    if (cells < tuneGet(TUNE_GPU_DB_SCORE_CELLS) || cardsLen == 0) {
+        scoreCpu(&scores, type, uniqueQueries, uniqueQueriesLen, uniques, 
+            uniquesLen, chainDatabaseCpu, scorer, maxAlignments, valueFunction, 
+            valueFunctionParam, valueThreshold, uniqueIndexes, uniqueIndexesLen);
     } else {
-        scoreDatabasesGpu(&scores, type, queries, queriesLen, chainDatabaseGpu, 
-            scorer, indexes, indexesLen, cards, cardsLen, NULL);
+        scoreDatabasesGpu(&scores, type, uniqueQueries, uniqueQueriesLen, 
+            chainDatabaseGpu, scorer, uniqueIndexes, uniqueIndexesLen, cards, 
+            cardsLen, NULL);
+    }
+
+    // share the scores with the duplicates, targets outside of the indexes 
+    // stay unscored
+    if (groups != NULL) {
+
+        int* uniqueScores = scores;
+        scores = (int*) malloc(uniqueQueriesLen * databaseLen * sizeof(int));
+
+        for (i = 0; i < uniqueQueriesLen; ++i) {
+
+            int* row = scores + i * databaseLen;
+            int* uniqueRow = uniqueScores + i * uniquesLen;
+
+            if (indexes == NULL) {
+                for (j = 0; j < databaseLen; ++j) {
+                    row[j] = uniqueRow[groups[j]];
+                }
+            } else {
+
+                for (j = 0; j < databaseLen; ++j) {
+                    row[j] = NO_SCORE;
+                }
+
+                for (j = 0; j < indexesLen; ++j) {
+                    row[indexes[j]] = uniqueRow[groups[indexes[j]]];
+                }
+            }
+        }
+
+        free(uniqueScores);
+        free(uniqueIndexes);
     }
     
     //**************************************************************************
@@ -456,15 +886,16 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
     TIMER_START("Extract best");
     
     DbAlignmentData** dbAlignmentsData = 
-        (DbAlignmentData**) malloc(queriesLen * sizeof(DbAlignmentData*));
+        (DbAlignmentData**) malloc(uniqueQueriesLen * sizeof(DbAlignmentData*));
+    int* dbAlignmentsDataLen = (int*) malloc(uniqueQueriesLen * sizeof(int));
 
     ExtractContext* eContexts = 
-        (ExtractContext*) malloc(queriesLen * sizeof(ExtractContext));
+        (ExtractContext*) malloc(uniqueQueriesLen * sizeof(ExtractContext));
     
-    for (i = 0; i < queriesLen; ++i) {
+    for (i = 0; i < uniqueQueriesLen; ++i) {
         eContexts[i].dbAlignmentData = &(dbAlignmentsData[i]);
-        eContexts[i].dbAlignmentLen = &(dbAlignmentsLen[i]);
-        eContexts[i].query = queries[i];
+        eContexts[i].dbAlignmentLen = &(dbAlignmentsDataLen[i]);
+        eContexts[i].query = uniqueQueries[i];
         eContexts[i].database = database;
         eContexts[i].databaseLen = databaseLen;
         eContexts[i].scores = scores + i * databaseLen;
@@ -478,14 +909,14 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
 
     if (cardsLen == 0) {
 
-        size_t tasksSize = queriesLen * sizeof(ThreadPoolTask*);
+        size_t tasksSize = uniqueQueriesLen * sizeof(ThreadPoolTask*);
         ThreadPoolTask** tasks = (ThreadPoolTask**) malloc(tasksSize);
 
-        for (i = 0; i < queriesLen; ++i) {
+        for (i = 0; i < uniqueQueriesLen; ++i) {
             tasks[i] = threadPoolSubmit(extractThread, (void*) &(eContexts[i]));
         }
         
-        for (i = 0; i < queriesLen; ++i) {
+        for (i = 0; i < uniqueQueriesLen; ++i) {
             threadPoolTaskWait(tasks[i]);
             threadPoolTaskDelete(tasks[i]);
         }
@@ -494,14 +925,14 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
 
     } else {
 
-        int chunks = MIN(queriesLen, cardsLen);
+        int chunks = MIN(uniqueQueriesLen, cardsLen);
 
         int cardsChunk = cardsLen / chunks;
         int cardsAdd = cardsLen % chunks;
         int cardsOff = 0;
 
-        int contextsChunk = queriesLen / chunks;
-        int contextsAdd = queriesLen % chunks;
+        int contextsChunk = uniqueQueriesLen / chunks;
+        int contextsAdd = uniqueQueriesLen % chunks;
         int contextsOff = 0;
 
         size_t contextsSize = chunks * sizeof(ExtractContexts);
@@ -545,7 +976,76 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
     TIMER_STOP;
 
     //**************************************************************************
+
+    //**************************************************************************
+    // CONVERT TO HITS
+
+    DbHit** hits = dbHits;
     
+    if (hits == NULL) {
+        hits = (DbHit**) malloc(queriesLen * sizeof(DbHit*));
+    }
+
+    for (i = 0; i < queriesLen; ++i) {
+
+        DbAlignmentData* data = dbAlignmentsData[queryGroups[i]];
+        dbAlignmentsLen[i] = dbAlignmentsDataLen[queryGroups[i]];
+
+        hits[i] = (DbHit*) malloc(dbAlignmentsLen[i] * sizeof(DbHit));
+
+        for (j = 0; j < dbAlignmentsLen[i]; ++j) {
+            hits[i][j].queryIdx = queriesStart + i;
+            hits[i][j].targetIdx = data[j].idx + databaseStart;
+            hits[i][j].score = data[j].score;
+            hits[i][j].value = data[j].value;
+        }
+    }
+
+    for (i = 0; i < uniqueQueriesLen; ++i) {
+        free(dbAlignmentsData[i]);
+    }
+
+    free(dbAlignmentsDataLen);
+    free(dbAlignmentsData);
+    free(uniqueQueries);
+    free(queryGroups);
+
+    // provisional results, nothing is aligned yet
+    if (stream != NULL && stream->hitsCallback != NULL) {
+        for (i = 0; i < queriesLen; ++i) {
+            stream->hitsCallback(queriesStart + i, hits[i], dbAlignmentsLen[i], 
+                stream->param);
+        }
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // ALIGN BEST TARGETS
+
+    if (dbHits == NULL) {
+
+        // hits target indexes are relative to the start of the whole database
+        alignHits(dbAlignments, dbAlignmentsLen, type, queries, queriesStart, 
+            queriesLen, database - databaseStart, hits, scorer, cards, 
+            cardsLen, stream);
+
+        for (i = 0; i < queriesLen; ++i) {
+            free(hits[i]);
+        }
+        free(hits);
+    }
+
+    //**************************************************************************
+}
+
+static void alignHits(DbAlignment*** dbAlignments, int* dbAlignmentsLen, 
+    int type, Chain** queries, int queriesStart, int queriesLen, 
+    Chain** database, DbHit** dbHits, Scorer* scorer, int* cards, 
+    int cardsLen, Stream* stream) {
+
+    int i, j, k;
+
     //**************************************************************************
     // ALIGN BEST TARGETS MULTITHREADED
     
@@ -569,24 +1069,128 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
     size_t aContextsSize = aTasksLen * sizeof(AlignContext);
     AlignContext* aContextsCpu = (AlignContext*) malloc(aContextsSize);
     AlignContext* aContextsGpu = (AlignContext*) malloc(aContextsSize);
+    AlignContext* aContextsCopy = (AlignContext*) malloc(aContextsSize);
     int aContextsCpuLen = 0;
     int aContextsGpuLen = 0;
+    int aContextsCopyLen = 0;
+
+    // number of cpu contexts up to and including every query and number of
+    // copy contexts whose source is in a query up to and including it
+    int* cpuEnds = (int*) malloc((queriesLen + 1) * sizeof(int));
+    int* copyEnds = (int*) malloc((queriesLen + 1) * sizeof(int));
+
+    //**************************************************************************
+    // FIND PAIRS WITH THE SAME RESIDUES
+
+    // only the first of the pairs with identical query and target residues is
+    // aligned, the rest copy its alignment
+    int* queryGroups;
+    Chain** uniqueQueries;
+    int uniqueQueriesLen;
+
+    chainsGroup(&queryGroups, &uniqueQueries, &uniqueQueriesLen, queries, 
+        queriesLen);
+
+    Chain** targets = (Chain**) malloc(aTasksLen * sizeof(Chain*));
+
+    for (i = 0, k = 0; i < queriesLen; ++i) {
+        for (j = 0; j < dbAlignmentsLen[i]; ++j, ++k) {
+            targets[k] = database[dbHits[i][j].targetIdx];
+        }
+    }
+
+    int* targetGroups;
+    Chain** uniqueTargets;
+    int uniqueTargetsLen;
+
+    chainsGroup(&targetGroups, &uniqueTargets, &uniqueTargetsLen, targets, 
+        aTasksLen);
+
+    PairKey* pairs = (PairKey*) malloc(aTasksLen * sizeof(PairKey));
+
+    for (i = 0, k = 0; i < queriesLen; ++i) {
+        for (j = 0; j < dbAlignmentsLen[i]; ++j, ++k) {
+            pairs[k].query = queryGroups[i];
+            pairs[k].target = targetGroups[k];
+            pairs[k].idx = k;
+        }
+    }
+
+    qsort(pairs, aTasksLen, sizeof(PairKey), pairKeyCmp);
+
+    // pair index of the aligned pair with the same residues
+    int* sources = (int*) malloc(aTasksLen * sizeof(int));
+
+    for (i = 0; i < aTasksLen; ++i) {
+        if (i > 0 && pairs[i - 1].query == pairs[i].query && 
+            pairs[i - 1].target == pairs[i].target) {
+            sources[pairs[i].idx] = sources[pairs[i - 1].idx];
+        } else {
+            sources[pairs[i].idx] = pairs[i].idx;
+        }
+    }
+
+    DbAlignment*** slots = 
+        (DbAlignment***) malloc(aTasksLen * sizeof(DbAlignment**));
+
+    int* slotQueries = (int*) malloc(aTasksLen * sizeof(int));
+
+    for (i = 0, k = 0; i < queriesLen; ++i) {
+        for (j = 0; j < dbAlignmentsLen[i]; ++j, ++k) {
+            slots[k] = &(dbAlignments[i][j]);
+            slotQueries[k] = i;
+        }
+    }
+
+    // copies are ordered by the query of their source, a streamed query hands
+    // its alignments over to the callback so every copy of them has to be made
+    // before that, including the copies which belong to later queries
+    for (i = 0; i < queriesLen; ++i) {
+        copyEnds[i] = 0;
+    }
+
+    for (k = 0; k < aTasksLen; ++k) {
+        if (sources[k] != k) {
+            copyEnds[slotQueries[sources[k]]]++;
+        }
+    }
+
+    for (i = 0; i < queriesLen; ++i) {
+        int count = copyEnds[i];
+        copyEnds[i] = aContextsCopyLen;
+        aContextsCopyLen += count;
+    }
+
+    free(pairs);
+    free(uniqueTargets);
+    free(targetGroups);
+    free(targets);
+    free(uniqueQueries);
+    free(queryGroups);
+
+    //**************************************************************************
+
+    long long gpuMinCells = tuneGet(TUNE_GPU_DB_MIN_CELLS);
     
-    for (i = 0, k = 0; i < queriesLen; ++i, ++k) {
+    for (i = 0, k = 0; i < queriesLen; ++i) {
     
         Chain* query = queries[i];
         int rows = chainGetLength(query);
 
         for (j = 0; j < dbAlignmentsLen[i]; ++j, ++k) {
             
-            DbAlignmentData data = dbAlignmentsData[i][j];
-            Chain* target = database[data.idx];
+            DbHit hit = dbHits[i][j];
+            Chain* target = database[hit.targetIdx];
 
             int cols = chainGetLength(target);
             long long cells = (long long) rows * cols;
 
             AlignContext* context;
-            if (cols < GPU_MIN_LEN || cells < GPU_MIN_CELLS || cardsLen == 0) {
+            if (sources[k] != k) {
+                context = &(aContextsCopy[copyEnds[slotQueries[sources[k]]]++]);
+                context->cards = NULL;
+                context->cardsLen = 0;
+            } else if (cols < GPU_MIN_LEN || cells < gpuMinCells || cardsLen == 0) {
                 context = &(aContextsCpu[aContextsCpuLen++]);
                 context->cards = NULL;
                 context->cardsLen = 0;
@@ -597,26 +1201,36 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
             context->dbAlignment = &(dbAlignments[i][j]);
             context->type = type;
             context->query = query;
-            context->queryIdx = i;
+            context->queryIdx = hit.queryIdx;
             context->target = target;
-            context->targetIdx = data.idx + databaseStart;
-            context->value = data.value;
-            context->score = data.score;
+            context->targetIdx = hit.targetIdx;
+            context->value = hit.value;
+            context->score = hit.score;
             context->scorer = scorer;
             context->cells = cells;
+            context->source = sources[k] == k ? NULL : slots[sources[k]];
         }
+
+        cpuEnds[i] = aContextsCpuLen;
     }
+
+    free(slotQueries);
+    free(slots);
+    free(sources);
     
-    LOG("Aligning %d cpu, %d gpu", aContextsCpuLen, aContextsGpuLen);
+    LOG("Aligning %d cpu, %d gpu, %d copied", aContextsCpuLen, aContextsGpuLen,
+        aContextsCopyLen);
 
     // run cpu tasks
     int aCpuTasksLen;
     AlignContextsPacked* aContextsCpuPacked;
+    int aCpuTaskContexts;
 
-    if (aContextsCpuLen < 10000) {
+    if (aContextsCpuLen < tuneGet(TUNE_CPU_PACKED_MIN)) {
 
         aCpuTasksLen = aContextsCpuLen;
         aContextsCpuPacked = NULL;
+        aCpuTaskContexts = 1;
 
         for (i = 0; i < aCpuTasksLen; ++i) {
             aTasks[i] = threadPoolSubmit(alignThread, &(aContextsCpu[i]));
@@ -624,17 +1238,20 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
 
     } else {
 
-        aCpuTasksLen = aContextsCpuLen / CPU_PACKED_CHUNK;
-        aCpuTasksLen += (aContextsCpuLen % CPU_PACKED_CHUNK) != 0;
+        int chunk = (int) tuneGet(TUNE_CPU_PACKED_CHUNK);
+        aCpuTaskContexts = chunk;
+
+        aCpuTasksLen = aContextsCpuLen / chunk;
+        aCpuTasksLen += (aContextsCpuLen % chunk) != 0;
 
         size_t contextsSize = aCpuTasksLen * sizeof(AlignContextsPacked);
         AlignContextsPacked* contexts = (AlignContextsPacked*) malloc(contextsSize);
 
         for (i = 0; i < aCpuTasksLen; ++i) {
 
-            int length = MIN(CPU_PACKED_CHUNK, aContextsCpuLen - i * CPU_PACKED_CHUNK);
+            int length = MIN(chunk, aContextsCpuLen - i * chunk);
 
-            contexts[i].contexts = aContextsCpu + i * CPU_PACKED_CHUNK;
+            contexts[i].contexts = aContextsCpu + i * chunk;
             contexts[i].contextsLen = length;
         }
 
@@ -713,31 +1330,90 @@ static void databaseSearchStep(DbAlignment*** dbAlignments,
         free(contexts);
     }
 
-    // wait for cpu tasks
+    // wait for cpu tasks, gpu tasks are done, stream every finished query
+    int queriesDone = 0;
+
     for (i = 0; i < aCpuTasksLen; ++i) {
+
         threadPoolTaskWait(aTasks[i]);
         threadPoolTaskDelete(aTasks[i]);
+
+        if (stream != NULL) {
+            int cpuDone = MIN((i + 1) * aCpuTaskContexts, aContextsCpuLen);
+            queriesDone = streamAlignments(dbAlignments, dbAlignmentsLen, 
+                queriesStart, queriesDone, queriesLen, cpuEnds, cpuDone, 
+                aContextsCopy, copyEnds, stream);
+        }
+    }
+
+    if (stream != NULL) {
+        streamAlignments(dbAlignments, dbAlignmentsLen, queriesStart, 
+            queriesDone, queriesLen, cpuEnds, aContextsCpuLen, aContextsCopy, 
+            copyEnds, stream);
+    } else {
+        copyAlignments(aContextsCopy, aContextsCopyLen);
     }
 
+    free(cpuEnds);
+    free(copyEnds);
     free(aContextsCpuPacked);
     free(aContextsCpu);
     free(aContextsGpu);
+    free(aContextsCopy);
     free(aTasks);
     
     TIMER_STOP;
     
     //**************************************************************************
-    
-    //**************************************************************************
-    // CLEAN MEMORY
+}
 
-    for (i = 0; i < queriesLen; ++i) {
-        free(dbAlignmentsData[i]);
+static void copyAlignments(AlignContext* contexts, int contextsLen) {
+
+    int i;
+    for (i = 0; i < contextsLen; ++i) {
+
+        AlignContext* context = &(contexts[i]);
+        DbAlignment* source = *(context->source);
+
+        int pathLen = dbAlignmentGetPathLen(source);
+
+        char* path = (char*) malloc(pathLen);
+        dbAlignmentCopyPath(source, path);
+
+        *(context->dbAlignment) = dbAlignmentCreate(context->query, 
+            dbAlignmentGetQueryStart(source), dbAlignmentGetQueryEnd(source), 
+            context->queryIdx, context->target, 
+            dbAlignmentGetTargetStart(source), dbAlignmentGetTargetEnd(source), 
+            context->targetIdx, context->value, context->score, 
+            context->scorer, path, pathLen);
     }
-    free(dbAlignmentsData);
+}
 
-    //**************************************************************************
+static int streamAlignments(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLen, int queriesStart, int queriesDone, int queriesLen,
+    int* cpuEnds, int cpuDone, AlignContext* copies, int* copyEnds, 
+    Stream* stream) {
+
+    // cpu contexts are created in the order of the queries, copied pairs are
+    // aligned by the same or an earlier query and are made from the query
+    // which aligned them, before it is handed over to the callback
+    while (queriesDone < queriesLen && cpuEnds[queriesDone] <= cpuDone) {
+
+        int i = queriesDone;
+
+        int copiesStart = i == 0 ? 0 : copyEnds[i - 1];
+        copyAlignments(copies + copiesStart, copyEnds[i] - copiesStart);
+
+        stream->alignmentsCallback(queriesStart + i, dbAlignments[i], 
+            dbAlignmentsLen[i], stream->param);
+
+        dbAlignments[i] = NULL;
+        queriesDone++;
+    }
+
+    return queriesDone;
 }
+
 //------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
@@ -850,7 +1526,12 @@ static void* extractThread(void* param) {
         packed[i].idx = i;
         packed[i].value = values[i];
         packed[i].score = scores[i];
-        packed[i].name = chainGetName(database[i]);
+        // lazy names are not read for ordering
+        if (chainHasLazyName(database[i])) {
+            packed[i].name = NULL;
+        } else {
+            packed[i].name = chainGetName(database[i]);
+        }
 
         if (packed[i].value <= valueThreshold) {
             thresholded++;
@@ -894,8 +1575,10 @@ static void* extractsThread(void* param) {
 // CPU MODULES
 
 static void scoreCpu(int** scores_, int type, Chain** queries, 
-    int queriesLen, Chain** database_, int databaseLen_, Scorer* scorer, 
-    int* indexes, int indexesLen) {
+    int queriesLen, Chain** database_, int databaseLen_, 
+    ChainDatabaseCpu* chainDatabaseCpu, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen) {
     
     TIMER_START("CPU database scoring");
     
@@ -935,7 +1618,21 @@ static void scoreCpu(int** scores_, int type, Chain** queries,
     //**************************************************************************
     // SOLVE MULTITHREADED
 
-    int maxLen = (queriesLen * databaseLen) / CPU_THREAD_CHUNK + queriesLen; 
+    // interleaved layout covers the whole database
+    if (indexes == NULL && chainDatabaseCpu != NULL) {
+
+        scoreCpuBlocks(scores, type, queries, queriesLen, database, 
+            databaseLen, chainDatabaseCpu, scorer, maxAlignments, 
+            valueFunction, valueFunctionParam, valueThreshold);
+
+        TIMER_STOP;
+
+        return;
+    }
+
+    int threadChunk = (int) tuneGet(TUNE_CPU_THREAD_CHUNK);
+
+    int maxLen = (queriesLen * databaseLen) / threadChunk + queriesLen;
     int length = 0;
 
     size_t contextsSize = maxLen * sizeof(ScoreCpuContext);
@@ -945,13 +1642,16 @@ static void scoreCpu(int** scores_, int type, Chain** queries,
     ThreadPoolTask** tasks = (ThreadPoolTask**) malloc(tasksSize);
 
     for (i = 0; i < queriesLen; ++i) {
-        for (j = 0; j < databaseLen; j += CPU_THREAD_CHUNK) {
+        for (j = 0; j < databaseLen; j += threadChunk) {
 
             contexts[length].scores = scores + i * databaseLen + j;
+            contexts[length].scores2 = NULL;
             contexts[length].type = type;
             contexts[length].query = queries[i];
+            contexts[length].query2 = NULL;
             contexts[length].database = database + j;
-            contexts[length].databaseLen = MIN(CPU_THREAD_CHUNK, databaseLen - j);
+            contexts[length].databaseLen = MIN(threadChunk, databaseLen - j);
+            contexts[length].chainDatabaseCpu = NULL;
             contexts[length].scorer = scorer;
 
             tasks[length] = threadPoolSubmit(scoreCpuThread, &(contexts[length]));
@@ -995,6 +1695,148 @@ static void scoreCpu(int** scores_, int type, Chain** queries,
     TIMER_STOP;
 }
 
+static void scoreCpuBlocks(int* scores, int type, Chain** queries, 
+    int queriesLen, Chain** database, int databaseLen, 
+    ChainDatabaseCpu* chainDatabaseCpu, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold) {
+
+    int threadBlocks = (int) tuneGet(TUNE_CPU_THREAD_BLOCKS);
+    int blocksLen = chainDatabaseCpuGetBlocksLen(chainDatabaseCpu);
+
+    int i, j;
+
+    // blocks are ordered by the target lengths so the tail blocks hold the 
+    // shortest targets, which are the first to fall out of the best hits
+    int prune = valueFunction != NULL && maxAlignments > 0;
+
+    int* limits = (int*) malloc(queriesLen * sizeof(int));
+    double** best = (double**) malloc(queriesLen * sizeof(double*));
+    int* bestLens = (int*) malloc(queriesLen * sizeof(int));
+
+    for (i = 0; i < queriesLen; ++i) {
+        limits[i] = blocksLen;
+        best[i] = NULL;
+        bestLens[i] = 0;
+    }
+
+    // pruned targets are left unscored
+    if (prune) {
+        for (i = 0; i < queriesLen * databaseLen; ++i) {
+            scores[i] = NO_SCORE;
+        }
+    }
+
+    // first round scores enough targets to make a reasonable cutoff
+    int roundLen = blocksLen;
+
+    if (prune) {
+        const int* indexes;
+        int lanes = chainDatabaseCpuGetBlock(&indexes, chainDatabaseCpu, 0);
+        long long targets = 2 * (long long) MAX(maxAlignments, 1);
+        roundLen = (int) MIN((targets + lanes - 1) / lanes, blocksLen);
+        roundLen = MAX(threadBlocks, roundLen + threadBlocks - 1);
+        roundLen = (roundLen / threadBlocks) * threadBlocks;
+    }
+
+    int maxLen = (queriesLen * blocksLen) / threadBlocks + queriesLen;
+
+    size_t contextsSize = maxLen * sizeof(ScoreCpuContext);
+    ScoreCpuContext* contexts = (ScoreCpuContext*) malloc(contextsSize);
+
+    size_t tasksSize = maxLen * sizeof(ThreadPoolTask*);
+    ThreadPoolTask** tasks = (ThreadPoolTask**) malloc(tasksSize);
+
+    int roundStart = 0;
+
+    while (roundStart < blocksLen) {
+
+        int roundEnd = (int) MIN((long long) roundStart + roundLen, blocksLen);
+        int length = 0;
+
+        for (i = 0; i < queriesLen; ++i) {
+
+            // consecutive queries of the same length, for example both strands
+            // of a nucleotide query, are scored in a single pass
+            int dual = type == SW_ALIGN && i + 1 < queriesLen &&
+                chainGetLength(queries[i]) == chainGetLength(queries[i + 1]);
+
+            int limit = dual ? MAX(limits[i], limits[i + 1]) : limits[i];
+            int end = MIN(roundEnd, limit);
+
+            for (j = roundStart; j < end; j += threadBlocks) {
+
+                contexts[length].scores = scores + i * databaseLen;
+                contexts[length].scores2 = dual ? scores + (i + 1) * databaseLen : NULL;
+                contexts[length].type = type;
+                contexts[length].query = queries[i];
+                contexts[length].query2 = dual ? queries[i + 1] : NULL;
+                contexts[length].database = database;
+                contexts[length].databaseLen = databaseLen;
+                contexts[length].chainDatabaseCpu = chainDatabaseCpu;
+                contexts[length].blocksStart = j;
+                contexts[length].blocksLen = MIN(threadBlocks, end - j);
+                contexts[length].scorer = scorer;
+
+                tasks[length] = threadPoolSubmit(scoreCpuThread, &(contexts[length]));
+
+                length++;
+            }
+
+            i += dual;
+        }
+
+        for (i = 0; i < length; ++i) {
+            threadPoolTaskWait(tasks[i]);
+            threadPoolTaskDelete(tasks[i]);
+        }
+
+        if (!prune || roundEnd == blocksLen) {
+            break;
+        }
+
+        for (i = 0; i < queriesLen; ++i) {
+
+            int dual = type == SW_ALIGN && i + 1 < queriesLen &&
+                chainGetLength(queries[i]) == chainGetLength(queries[i + 1]);
+
+            int limit = dual ? MAX(limits[i], limits[i + 1]) : limits[i];
+            int end = MIN(roundEnd, limit);
+
+            for (j = i; j <= i + dual; ++j) {
+                pruneBlocks(&(limits[j]), &(best[j]), &(bestLens[j]), 
+                    scores + j * databaseLen, queries[j], database, 
+                    chainDatabaseCpu, roundStart, end, scorer, maxAlignments, 
+                    valueFunction, valueFunctionParam, valueThreshold);
+            }
+
+            i += dual;
+        }
+
+        int maxLimit = 0;
+        for (i = 0; i < queriesLen; ++i) {
+            maxLimit = MAX(maxLimit, limits[i]);
+        }
+
+        roundStart = roundEnd;
+        roundLen = (int) MIN(2 * (long long) roundLen, blocksLen);
+
+        if (roundStart >= maxLimit) {
+            break;
+        }
+    }
+
+    for (i = 0; i < queriesLen; ++i) {
+        free(best[i]);
+    }
+
+    free(tasks);
+    free(contexts);
+    free(bestLens);
+    free(best);
+    free(limits);
+}
+
 static void* scoreCpuThread(void* param) {
 
     ScoreCpuContext* context = (ScoreCpuContext*) param;
@@ -1004,15 +1846,186 @@ static void* scoreCpuThread(void* param) {
     Chain* query = context->query;
     Chain** database = context->database;
     int databaseLen = context->databaseLen;
+    ChainDatabaseCpu* chainDatabaseCpu = context->chainDatabaseCpu;
     Scorer* scorer = context->scorer;
 
-    scoreDatabaseCpu(scores, type, query, database, databaseLen, scorer);
+    if (chainDatabaseCpu != NULL && context->query2 != NULL) {
+        scoreChainDatabaseDualCpu(scores, context->scores2, type, query, 
+            context->query2, chainDatabaseCpu, context->blocksStart, 
+            context->blocksLen, scorer);
+    } else if (chainDatabaseCpu != NULL) {
+        scoreChainDatabaseCpu(scores, type, query, chainDatabaseCpu, 
+            context->blocksStart, context->blocksLen, scorer);
+    } else {
+        scoreDatabaseCpu(scores, type, query, database, databaseLen, scorer);
+    }
 
     return NULL;
 }
 
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// PRUNING
+
+static void pruneBlocks(int* limit, double** best, int* bestLen, int* scores, 
+    Chain* query, Chain** database, ChainDatabaseCpu* chainDatabaseCpu, 
+    int blocksStart, int blocksEnd, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold) {
+
+    const int* indexes;
+    int lanes = chainDatabaseCpuGetBlock(&indexes, chainDatabaseCpu, 0);
+
+    int i, j, k;
+
+    int length = (blocksEnd - blocksStart) * lanes;
+
+    Chain** targets = (Chain**) malloc(MAX(length, lanes) * sizeof(Chain*));
+    int* targetsScores = (int*) malloc(MAX(length, lanes) * sizeof(int));
+    double* values = (double*) malloc(MAX(length, lanes) * sizeof(double));
+
+    //**************************************************************************
+    // VALUE NEWLY SCORED TARGETS
+
+    int targetsLen = 0;
+
+    for (i = blocksStart; i < blocksEnd; ++i) {
+
+        chainDatabaseCpuGetBlock(&indexes, chainDatabaseCpu, i);
+
+        for (j = 0; j < lanes; ++j) {
+            if (indexes[j] != -1) {
+                targets[targetsLen] = database[indexes[j]];
+                targetsScores[targetsLen] = scores[indexes[j]];
+                targetsLen++;
+            }
+        }
+    }
+
+    if (targetsLen > 0) {
+        valueFunction(values, targetsScores, query, targets, targetsLen, 
+            NULL, 0, valueFunctionParam);
+    }
+
+    // only the maxAlignments best values under the threshold are kept
+    *best = (double*) realloc(*best, (*bestLen + targetsLen) * sizeof(double));
+
+    for (i = 0; i < targetsLen; ++i) {
+        if (values[i] <= valueThreshold) {
+            (*best)[(*bestLen)++] = values[i];
+        }
+    }
+
+    if (*bestLen > maxAlignments) {
+        qselect((void*) *best, *bestLen, sizeof(double), maxAlignments, valueCmp);
+        *bestLen = maxAlignments;
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // DROP TAIL BLOCKS WHICH CAN NOT REACH THE CUTOFF
+
+    double cutoff = valueThreshold;
+
+    // found hits can only be replaced by better ones
+    if (*bestLen == maxAlignments) {
+
+        cutoff = (*best)[0];
+
+        for (i = 1; i < *bestLen; ++i) {
+            cutoff = MAX(cutoff, (*best)[i]);
+        }
+    }
+
+    // every residue is aligned at most once and gaps only cost, so no 
+    // alignment scores more than the best substitutions of the residues of
+    // either chain, values decrease with the score so the bound score gives
+    // the best value a target can have
+    int maxCode = scorerGetMaxCode(scorer);
+    int* present = (int*) calloc(maxCode, sizeof(int));
+    int* queryGains = (int*) calloc(maxCode, sizeof(int));
+    int* targetGains = (int*) calloc(maxCode, sizeof(int));
+
+    const char* queryCodes = chainGetCodes(query);
+    int queryLen = chainGetLength(query);
+    int queryBound = 0;
+
+    for (i = 0; i < queryLen; ++i) {
+        present[(int) queryCodes[i]] = 1;
+    }
+
+    for (i = 0; i < maxCode; ++i) {
+        for (j = 0; j < maxCode; ++j) {
+
+            int score = scorerScore(scorer, (char) i, (char) j);
+            queryGains[i] = MAX(queryGains[i], score);
+
+            if (present[i]) {
+                targetGains[j] = MAX(targetGains[j], score);
+            }
+        }
+    }
+
+    for (i = 0; i < queryLen; ++i) {
+        queryBound += queryGains[(int) queryCodes[i]];
+    }
+
+    while (*limit > blocksEnd) {
+
+        chainDatabaseCpuGetBlock(&indexes, chainDatabaseCpu, *limit - 1);
+
+        targetsLen = 0;
+
+        for (j = 0; j < lanes; ++j) {
+            if (indexes[j] != -1) {
+
+                Chain* target = database[indexes[j]];
+                const char* targetCodes = chainGetCodes(target);
+                int targetLen = chainGetLength(target);
+                int targetBound = 0;
+
+                for (k = 0; k < targetLen && targetBound < queryBound; ++k) {
+                    targetBound += targetGains[(int) targetCodes[k]];
+                }
+
+                targets[targetsLen] = target;
+                targetsScores[targetsLen] = MIN(targetBound, queryBound);
+                targetsLen++;
+            }
+        }
+
+        if (targetsLen > 0) {
+            valueFunction(values, targetsScores, query, targets, targetsLen, 
+                NULL, 0, valueFunctionParam);
+        }
+
+        for (j = 0; j < targetsLen; ++j) {
+            if (!(values[j] > cutoff)) {
+                break;
+            }
+        }
+
+        if (j < targetsLen) {
+            break;
+        }
+
+        (*limit)--;
+    }
+
+    //**************************************************************************
+
+    free(targetGains);
+    free(queryGains);
+    free(present);
+    free(values);
+    free(targetsScores);
+    free(targets);
+}
+
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // UTILS
 
@@ -1040,6 +2053,117 @@ static void filterIndexesArray(int** indexesNew, int* indexesNewLen,
     }
 }
 
+static void chainsGroup(int** groups, Chain*** uniques, int* uniquesLen, 
+    Chain** chains, int chainsLen) {
+
+    int i, j;
+
+    ChainKey* keys = (ChainKey*) malloc(chainsLen * sizeof(ChainKey));
+
+    for (i = 0; i < chainsLen; ++i) {
+
+        const char* codes = chainGetCodes(chains[i]);
+        int length = chainGetLength(chains[i]);
+
+        unsigned long long hash = FNV_OFFSET;
+
+        for (j = 0; j < length; ++j) {
+            hash ^= (unsigned char) codes[j];
+            hash *= FNV_PRIME;
+        }
+
+        keys[i].hash = hash;
+        keys[i].length = length;
+        keys[i].idx = i;
+    }
+
+    qsort(keys, chainsLen, sizeof(ChainKey), chainKeyCmp);
+
+    // first chain of every group, groups are in the order of the chains
+    int* firsts = (int*) malloc(chainsLen * sizeof(int));
+
+    for (i = 0; i < chainsLen; ++i) {
+
+        int idx = keys[i].idx;
+        firsts[idx] = idx;
+
+        // hash collisions are rejected by comparing the residues
+        for (j = i - 1; j >= 0; --j) {
+
+            if (keys[j].hash != keys[i].hash || keys[j].length != keys[i].length) {
+                break;
+            }
+
+            int other = firsts[keys[j].idx];
+
+            if (!memcmp(chainGetCodes(chains[idx]), chainGetCodes(chains[other]),
+                keys[i].length)) {
+                firsts[idx] = other;
+                break;
+            }
+        }
+    }
+
+    *groups = (int*) malloc(chainsLen * sizeof(int));
+    *uniques = (Chain**) malloc(chainsLen * sizeof(Chain*));
+    *uniquesLen = 0;
+
+    for (i = 0; i < chainsLen; ++i) {
+        if (firsts[i] == i) {
+            (*groups)[i] = *uniquesLen;
+            (*uniques)[(*uniquesLen)++] = chains[i];
+        } else {
+            (*groups)[i] = (*groups)[firsts[i]];
+        }
+    }
+
+    free(firsts);
+    free(keys);
+}
+
+static int valueCmp(const void* a_, const void* b_) {
+
+    double a = *((double*) a_);
+    double b = *((double*) b_);
+
+    if (a < b) return -1;
+    if (a > b) return 1;
+
+    return 0;
+}
+
+static int chainKeyCmp(const void* a_, const void* b_) {
+
+    ChainKey* a = (ChainKey*) a_;
+    ChainKey* b = (ChainKey*) b_;
+
+    if (a->hash != b->hash) {
+        return a->hash < b->hash ? -1 : 1;
+    }
+
+    if (a->length != b->length) {
+        return a->length - b->length;
+    }
+
+    return a->idx - b->idx;
+}
+
+static int pairKeyCmp(const void* a_, const void* b_) {
+
+    PairKey* a = (PairKey*) a_;
+    PairKey* b = (PairKey*) b_;
+
+    if (a->query != b->query) {
+        return a->query - b->query;
+    }
+
+    if (a->target != b->target) {
+        return a->target - b->target;
+    }
+
+    return a->idx - b->idx;
+}
+
 static int dbAlignmentDataCmp(const void* a_, const void* b_) {
 
     DbAlignmentData* a = (DbAlignmentData*) a_;
@@ -1048,6 +2172,11 @@ static int dbAlignmentDataCmp(const void* a_, const void* b_) {
     if (a->value == b->value) {
 
         if (a->score == b->score) {
+
+            if (a->name == NULL || b->name == NULL) {
+                return a->idx - b->idx;
+            }
+
             return strcmp(a->name, b->name);
         }
 
@@ -45,12 +45,16 @@ to reduce the preperation time in repetitive aligning.
 */
 typedef struct ChainDatabase ChainDatabase;
 
+struct HitCache;
+
 /*!
 Database alignments are often scored by other methods than the alignment score.
 ValueFunction defines function type for valueing the align scores between a 
 query and the database. Function should calculate the values and store them in
 the values array which has length equal to databaseLen. Better alignment scores 
-should have smaller value.
+should have smaller value. Value of a target must not increase with its score,
+database scoring relies on it to skip targets whose best possible score can not
+make it into the results.
 
 @param values output, values of the align scores
 @param scores scores between the query and targets in the database
@@ -64,9 +68,56 @@ should have smaller value.
 typedef void (*ValueFunction)(double* values, int* scores, Chain* query, 
     Chain** database, int databaseLen, int* cards, int cardsLen, void* param);
 
+/*!
+@brief Database hit.
+
+Query and target pair selected by the database search before it is aligned, see
+shotgunDatabaseHits(). Target index is the index in the database array with 
+which the chainDatabase was created and query index is the index in the 
+queries array.
+*/
+typedef struct DbHit {
+    int queryIdx;
+    int targetIdx;
+    int score;
+    double value;
+} DbHit;
+
+/*!
+@brief Provisional database hits callback, see shotgunDatabaseStream().
+
+Called with the hits of the query before they are aligned. Hits are owned by 
+the database search and are valid only during the call.
+
+@param queryIdx index of the query in the queries array
+@param dbHits query hits, sorted in the same order as the final alignments
+@param dbHitsLen dbHits array length
+@param param callback parameter given to the shotgunDatabaseStream()
+*/
+typedef void (*DbHitsCallback)(int queryIdx, DbHit* dbHits, int dbHitsLen, 
+    void* param);
+
+/*!
+@brief Final database alignments callback, see shotgunDatabaseStream().
+
+Called with the final alignments of the query as soon as they are aligned. 
+Alignments array is owned by the callback and should be deleted with the 
+deleteDatabase() function.
+
+@param queryIdx index of the query in the queries array
+@param dbAlignments query alignments, same as one shotgunDatabase() output array
+@param dbAlignmentsLen dbAlignments array length
+@param param callback parameter given to the shotgunDatabaseStream()
+*/
+typedef void (*DbAlignmentsCallback)(int queryIdx, DbAlignment** dbAlignments, 
+    int dbAlignmentsLen, void* param);
+
 /*!
 @brief ChainDatabase constructor.
 
+Chains with identical residues are grouped and every group is scored only once,
+all of its members are reported with their own names and indexes.
+
 @param database chain array
 @param databaseStart index of the first chain to solve
 @param databaseLen length offset from databaseStart to last chain that needs to 
@@ -86,6 +137,20 @@ extern ChainDatabase* chainDatabaseCreate(Chain** database, int databaseStart,
 */
 extern void chainDatabaseDelete(ChainDatabase* chainDatabase);
 
+/*!
+@brief Attaches a persistent hits cache to the chainDatabase.
+
+Database searches of the chainDatabase, which are not limited by the indexes,
+first look for the hits of every query in the cache. Only the queries which are
+not found are scored and their hits are stored in the cache. The cache is not
+owned by the chainDatabase.
+
+@param chainDatabase chainDatabase object
+@param hitCache hitCache object, see hit_cache.h, NULL detaches the cache
+*/
+extern void chainDatabaseSetHitCache(ChainDatabase* chainDatabase, 
+    struct HitCache* hitCache);
+
 /*!
 @brief Database aligning function.
 
@@ -158,6 +223,121 @@ extern void shotgunDatabase(DbAlignment**** dbAlignments, int** dbAlignmentsLen,
     void* valueFunctionParam, double valueThreshold, int* indexes, 
     int indexesLen, int* cards, int cardsLen, Thread* thread);
 
+/*!
+@brief Streaming shotgun aligning function.
+
+Function is the same as the shotgunDatabase() but instead of returning when 
+every query is done it delivers the alignments of every query to the 
+alignmentsCallback as soon as they are ready. If the hitsCallback is given the
+selected hits of every query are delivered to it before they are aligned, as a
+provisional result. Queries are searched in memory bounded steps, callbacks for
+the queries of one step are called in order of the queries, sequentially, from 
+the thread the search is executed on. Single query streaming search replaces 
+the alignDatabase() function.
+
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param queriesLen query chains array length
+@param chainDatabase chain database object
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of alignments to return, if negative number
+    of alignments wont be limited
+@param valueFunction function for valueing the alignment scores
+@param valueThreshold maximum value of returned alignments
+@param valueFunctionParam additional parameters for the value function
+@param indexes array of indexes of which chains from the database to score, 
+    if NULL all are solved
+@param indexesLen indexes array length
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length, greater or equal to 1
+@param hitsCallback provisional hits callback, can be NULL
+@param alignmentsCallback final alignments callback
+@param callbackParam additional parameter for both callbacks
+@param thread thread on which the function will be executed, if NULL function is
+    executed on the current thread
+*/
+extern void shotgunDatabaseStream(int type, Chain** queries, int queriesLen, 
+    ChainDatabase* chainDatabase, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* indexes, int indexesLen, int* cards, 
+    int cardsLen, DbHitsCallback hitsCallback, 
+    DbAlignmentsCallback alignmentsCallback, void* callbackParam, 
+    Thread* thread);
+
+/*!
+@brief Shotgun scoring function.
+
+Function is the same as the shotgunDatabase() but the selected pairs are not 
+aligned. For every query an array of hits, sorted in the same order as the 
+shotgunDatabase() output, is outputed. Hits are cheap to exchange and merge,
+aligning can be done later only for the pairs that are really needed.
+
+@param dbHits output dbHits array of arrays, one for each query, new array of
+    arrays is created
+@param dbHitsLen output, lengths of the output dbHits arrays, one for each 
+    query, new array is created
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param queriesLen query chains array length
+@param chainDatabase chain database object
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of hits to return, if negative number
+    of hits wont be limited
+@param valueFunction function for valueing the alignment scores
+@param valueThreshold maximum value of returned hits
+@param valueFunctionParam additional parameters for the value function
+@param indexes array of indexes of which chains from the database to score, 
+    if NULL all are solved
+@param indexesLen indexes array length
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length, greater or equal to 1
+@param thread thread on which the function will be executed, if NULL function is
+    executed on the current thread
+*/
+extern void shotgunDatabaseHits(DbHit*** dbHits, int** dbHitsLen, int type, 
+    Chain** queries, int queriesLen, ChainDatabase* chainDatabase, 
+    Scorer* scorer, int maxAlignments, ValueFunction valueFunction, 
+    void* valueFunctionParam, double valueThreshold, int* indexes, 
+    int indexesLen, int* cards, int cardsLen, Thread* thread);
+
+/*!
+@brief Database hits aligning function.
+
+Function aligns the hits outputed by the shotgunDatabaseHits() and creates the
+same output as the shotgunDatabase() would. Hits in the i-th dbHits array must 
+be the hits of the i-th query and their target indexes must be valid indexes 
+of the database array. Only the chains used by the hits need to be present in 
+the database array.
+
+@param dbAlignments output dbAlignments array of arrays, one for each query, 
+    new array of arrays is created
+@param dbAlignmentsLen output, lengths of the output dbAlignments arrays, one
+    for each query, new array is created
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param queriesLen query chains array length
+@param database chain array indexed by the hits target indexes
+@param dbHits hits array of arrays, one for each query
+@param dbHitsLen lengths of the dbHits arrays
+@param scorer scorer object used for alignment
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length, greater or equal to 1
+*/
+extern void alignDatabaseHits(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLen, int type, Chain** queries, int queriesLen, 
+    Chain** database, DbHit** dbHits, int* dbHitsLen, Scorer* scorer, 
+    int* cards, int cardsLen);
+
+/*!
+@brief Deletes the shotgunDatabaseHits() output.
+
+@param dbHits hits array of arrays
+@param dbHitsLen lengths of the dbHits arrays
+@param queriesLen number of the dbHits arrays
+*/
+extern void deleteShotgunDatabaseHits(DbHit** dbHits, int* dbHitsLen, 
+    int queriesLen);
+
 #ifdef __cplusplus 
 }
 #endif
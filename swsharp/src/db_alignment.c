@@ -25,6 +25,7 @@ Contact the author by mkorpar@gmail.com.
 
 #include "alignment.h"
 #include "chain.h"
+#include "path.h"
 #include "scorer.h"
 
 #include "db_alignment.h"
@@ -41,8 +42,7 @@ struct DbAlignment {
     double value;
     int score;
     Scorer* scorer;
-    char* path;
-    int pathLen;
+    Path* path;
 };
 
 //******************************************************************************
@@ -52,6 +52,11 @@ struct DbAlignment {
 
 //******************************************************************************
 // PRIVATE
+
+static DbAlignment* dbAlignmentCreatePath(Chain* query, int queryStart, 
+    int queryEnd, int queryIdx, Chain* target, int targetStart, int targetEnd, 
+    int targetIdx, double value, int score, Scorer* scorer, Path* path);
+
 //******************************************************************************
 
 //******************************************************************************
@@ -63,52 +68,23 @@ struct DbAlignment {
 extern DbAlignment* dbAlignmentCreate(Chain* query, int queryStart, int queryEnd,
     int queryIdx, Chain* target, int targetStart, int targetEnd, int targetIdx, 
     double value, int score, Scorer* scorer, char* path, int pathLen) {
-    
-    DbAlignment* dbAlignment = (DbAlignment*) malloc(sizeof(struct DbAlignment));
 
-    dbAlignment->query = query;
-    dbAlignment->queryStart = queryStart;
-    dbAlignment->queryEnd = queryEnd;
-    dbAlignment->queryIdx = queryIdx;
-    dbAlignment->target = target;
-    dbAlignment->targetStart = targetStart;
-    dbAlignment->targetEnd = targetEnd;
-    dbAlignment->targetIdx = targetIdx;
-    dbAlignment->value = value;
-    dbAlignment->score = score;
-    dbAlignment->scorer = scorer;
-    dbAlignment->path = path;
-    dbAlignment->pathLen = pathLen;
-    
-    return dbAlignment;
+    Path* encoded = pathCreate(path, pathLen);
+    free(path);
+
+    return dbAlignmentCreatePath(query, queryStart, queryEnd, queryIdx, target, 
+        targetStart, targetEnd, targetIdx, value, score, scorer, encoded);
 }
 
 extern DbAlignment* dbAlignmentCopy(DbAlignment* other) {
-
-    DbAlignment* dbAlignment = (DbAlignment*) malloc(sizeof(struct DbAlignment));
-
-    dbAlignment->query = other->query;
-    dbAlignment->queryStart = other->queryStart;
-    dbAlignment->queryEnd = other->queryEnd;
-    dbAlignment->queryIdx = other->queryIdx;
-    dbAlignment->target = other->target;
-    dbAlignment->targetStart = other->targetStart;
-    dbAlignment->targetEnd = other->targetEnd;
-    dbAlignment->targetIdx = other->targetIdx;
-    dbAlignment->value = other->value;
-    dbAlignment->score = other->score;
-    dbAlignment->scorer = other->scorer;
-    dbAlignment->pathLen = other->pathLen;
-    
-    size_t pathSize = other->pathLen * sizeof(char);
-    dbAlignment->path = (char*) malloc(pathSize);
-    memcpy(dbAlignment->path, other->path, pathSize);
-    
-    return dbAlignment;
+    return dbAlignmentCreatePath(other->query, other->queryStart, 
+        other->queryEnd, other->queryIdx, other->target, other->targetStart, 
+        other->targetEnd, other->targetIdx, other->value, other->score, 
+        other->scorer, pathCopy(other->path));
 }
 
 extern void dbAlignmentDelete(DbAlignment* dbAlignment) {
-    free(dbAlignment->path);
+    pathDelete(dbAlignment->path);
     free(dbAlignment); 
     dbAlignment = NULL;
 }
@@ -119,11 +95,23 @@ extern void dbAlignmentDelete(DbAlignment* dbAlignment) {
 // GETTERS
 
 extern char dbAlignmentGetMove(DbAlignment* dbAlignment, int index) {
-    return dbAlignment->path[index];
+    return pathGetMove(dbAlignment->path, index);
 }
 
 extern int dbAlignmentGetPathLen(DbAlignment* dbAlignment) {
-    return dbAlignment->pathLen;
+    return pathGetLen(dbAlignment->path);
+}
+
+extern int dbAlignmentGetRunsLen(DbAlignment* dbAlignment) {
+    return pathGetRunsLen(dbAlignment->path);
+}
+
+extern char dbAlignmentGetRunMove(DbAlignment* dbAlignment, int index) {
+    return pathGetRunMove(dbAlignment->path, index);
+}
+
+extern int dbAlignmentGetRunLen(DbAlignment* dbAlignment, int index) {
+    return pathGetRunLen(dbAlignment->path, index);
 }
 
 extern Chain* dbAlignmentGetQuery(DbAlignment* dbAlignment) {
@@ -176,18 +164,118 @@ extern double dbAlignmentGetValue(DbAlignment* dbAlignment) {
 // FUNCTIONS
 
 extern void dbAlignmentCopyPath(DbAlignment* dbAlignment, char* dest) {
-    memcpy(dest, dbAlignment->path, dbAlignment->pathLen);
+    pathCopyMoves(dbAlignment->path, dest);
 }
 
 extern Alignment* dbAlignmentToAlignment(DbAlignment* dbAlignment) {
 
-    char* path = (char*) malloc(dbAlignment->pathLen);
-    memcpy(path, dbAlignment->path, dbAlignment->pathLen);
+    int pathLen = pathGetLen(dbAlignment->path);
+
+    char* path = (char*) malloc(pathLen);
+    pathCopyMoves(dbAlignment->path, path);
 
     return alignmentCreate(dbAlignment->query, dbAlignment->queryStart, 
         dbAlignment->queryEnd, dbAlignment->target, dbAlignment->targetStart, 
         dbAlignment->targetEnd, dbAlignment->score, dbAlignment->scorer,
-        path, dbAlignment->pathLen);
+        path, pathLen);
+}
+
+extern DbAlignment* dbAlignmentDeserialize(char* bytes, Chain** queries, 
+    Chain** database, Scorer* scorer) {
+
+    int ptr = 0;
+    
+    int queryStart;
+    memcpy(&queryStart, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+    
+    int queryEnd;
+    memcpy(&queryEnd, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    int queryIdx;
+    memcpy(&queryIdx, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    int targetStart;
+    memcpy(&targetStart, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    int targetEnd;
+    memcpy(&targetEnd, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    int targetIdx;
+    memcpy(&targetIdx, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+    
+    int score;
+    memcpy(&score, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+    
+    double value;
+    memcpy(&value, bytes + ptr, sizeof(double));
+    ptr += sizeof(double);
+    
+    int runsLen;
+    memcpy(&runsLen, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+    
+    Path* path = pathCreateFromRuns(bytes + ptr, runsLen);
+    
+    Chain* query = queries[queryIdx];
+    Chain* target = database[targetIdx];
+
+    return dbAlignmentCreatePath(query, queryStart, queryEnd, queryIdx, target, 
+        targetStart, targetEnd, targetIdx, value, score, scorer, path);
+}
+
+extern void dbAlignmentSerialize(char** bytes, int* bytesLen, 
+    DbAlignment* dbAlignment) {
+
+    *bytesLen = 0;
+    *bytesLen += sizeof(int) * 3; // query start, end and index
+    *bytesLen += sizeof(int) * 3; // target start, end and index
+    *bytesLen += sizeof(int); // score
+    *bytesLen += sizeof(double); // value
+    int runsLen = pathGetRunsLen(dbAlignment->path);
+
+    *bytesLen += sizeof(int); // runsLen
+    *bytesLen += runsLen; // path runs
+
+    *bytes = (char*) malloc(*bytesLen);
+
+    int ptr = 0;
+
+    memcpy(*bytes + ptr, &dbAlignment->queryStart, sizeof(int));
+    ptr += sizeof(int);
+    
+    memcpy(*bytes + ptr, &dbAlignment->queryEnd, sizeof(int));
+    ptr += sizeof(int);
+    
+    memcpy(*bytes + ptr, &dbAlignment->queryIdx, sizeof(int));
+    ptr += sizeof(int);
+    
+    memcpy(*bytes + ptr, &dbAlignment->targetStart, sizeof(int));
+    ptr += sizeof(int);
+
+    memcpy(*bytes + ptr, &dbAlignment->targetEnd, sizeof(int));
+    ptr += sizeof(int);
+
+    memcpy(*bytes + ptr, &dbAlignment->targetIdx, sizeof(int));
+    ptr += sizeof(int);
+
+    memcpy(*bytes + ptr, &dbAlignment->score, sizeof(int));
+    ptr += sizeof(int);
+    
+    memcpy(*bytes + ptr, &dbAlignment->value, sizeof(double));
+    ptr += sizeof(double);
+    
+    memcpy(*bytes + ptr, &runsLen, sizeof(int));
+    ptr += sizeof(int);
+
+    memcpy(*bytes + ptr, pathGetRuns(dbAlignment->path), runsLen);
+    ptr += runsLen;
 }
 
 //------------------------------------------------------------------------------
@@ -197,4 +285,26 @@ extern Alignment* dbAlignmentToAlignment(DbAlignment* dbAlignment) {
 //******************************************************************************
 // PRIVATE
 
+static DbAlignment* dbAlignmentCreatePath(Chain* query, int queryStart, 
+    int queryEnd, int queryIdx, Chain* target, int targetStart, int targetEnd, 
+    int targetIdx, double value, int score, Scorer* scorer, Path* path) {
+    
+    DbAlignment* dbAlignment = (DbAlignment*) malloc(sizeof(struct DbAlignment));
+
+    dbAlignment->query = query;
+    dbAlignment->queryStart = queryStart;
+    dbAlignment->queryEnd = queryEnd;
+    dbAlignment->queryIdx = queryIdx;
+    dbAlignment->target = target;
+    dbAlignment->targetStart = targetStart;
+    dbAlignment->targetEnd = targetEnd;
+    dbAlignment->targetIdx = targetIdx;
+    dbAlignment->value = value;
+    dbAlignment->score = score;
+    dbAlignment->scorer = scorer;
+    dbAlignment->path = path;
+    
+    return dbAlignment;
+}
+
 //******************************************************************************
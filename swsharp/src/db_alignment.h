@@ -52,7 +52,7 @@ typedef struct DbAlignment DbAlignment;
 Alignment object is constructed from the query and target sequence aligned and 
 their coresponding start and stop positions, alignment score, scorer which was
 used for alignment and the alignment path. None of the input objects are copied
-via the constructor.
+via the constructor, the path array is encoded and released by the constructor.
 
 @param query query sequnce
 @param queryStart query start position
@@ -105,6 +105,39 @@ extern char dbAlignmentGetMove(DbAlignment* dbAlignment, int index);
 */
 extern int dbAlignmentGetPathLen(DbAlignment* dbAlignment);
 
+/*!
+@brief Path runs length getter.
+
+Path is stored run-length encoded, runs are at most 64 moves long and
+consecutive runs can have the same move. Iterating over runs is faster than 
+calling dbAlignmentGetMove() for every move.
+
+@param dbAlignment database alignment object 
+
+@return number of path runs
+*/
+extern int dbAlignmentGetRunsLen(DbAlignment* dbAlignment);
+
+/*!
+@brief Path run move getter.
+
+@param dbAlignment database alignment object 
+@param index run index, greater or equal to zero and less than runs length
+
+@return run move
+*/
+extern char dbAlignmentGetRunMove(DbAlignment* dbAlignment, int index);
+
+/*!
+@brief Path run length getter.
+
+@param dbAlignment database alignment object 
+@param index run index, greater or equal to zero and less than runs length
+
+@return number of moves in the run
+*/
+extern int dbAlignmentGetRunLen(DbAlignment* dbAlignment, int index);
+
 /*!
 @brief Query getter.
 
@@ -224,6 +257,35 @@ extern void dbAlignmentCopyPath(DbAlignment* dbAlignment, char* dest);
 */
 extern Alignment* dbAlignmentToAlignment(DbAlignment* dbAlignment);
 
+/*!
+@brief DbAlignment deserialization method.
+
+Method deserializes dbAlignment object from a byte buffer. Query and target are
+found by the serialized indexes.
+
+@param bytes byte buffer
+@param queries query chains array indexed by the query index
+@param database target chains array indexed by the target index
+@param scorer scorer object used for alignment
+
+@return dbAlignment object
+*/
+extern DbAlignment* dbAlignmentDeserialize(char* bytes, Chain** queries, 
+    Chain** database, Scorer* scorer);
+
+/*!
+@brief DbAlignment serialization method.
+
+Method serializes dbAlignment object to a byte buffer. Query and target chains 
+are not serialized, only their indexes are.
+
+@param bytes output byte buffer
+@param bytesLen output byte buffer length
+@param dbAlignment dbAlignment object
+*/
+extern void dbAlignmentSerialize(char** bytes, int* bytesLen, 
+    DbAlignment* dbAlignment);
+
 #ifdef __cplusplus 
 }
 #endif
@@ -36,6 +36,17 @@ Contact the author by mkorpar@gmail.com.
 
 #define SCORER_CONSTANTS_LEN (sizeof(scorerConstants) / sizeof(ScorerConstants))
 
+// maximal score range for which score dependent terms are cached, wider
+// ranges are rare and would need a large mostly empty cache for every query
+#define CACHE_MAX_LEN   (1 << 14)
+
+// maximal number of entries of the score and target length dependent cache
+#define PAIR_CACHE_MAX_LEN  (1 << 14)
+
+// for x >= 10, erf(x) is 1.0 and exp(-x^2 / 2) falls below half of the 
+// precision of the p2 term in calculateEValueProt, skipping them is exact
+#define ERF_SATURATION  10.0
+
 struct EValueParams {
     double lambda;
     double K;
@@ -69,6 +80,24 @@ typedef struct ScorerConstants {
     int isDna;
 } ScorerConstants;
 
+// score dependent terms of calculateEValueProt, fixed for one query
+typedef struct ProtTerms {
+    double p1;
+    double cPm;
+    double bj;
+    double sqrtVj;
+    double expY;
+    int filled;
+} ProtTerms;
+
+// score and target length dependent terms of calculateEValueProt
+typedef struct PairTerms {
+    int score;
+    int targetLen;
+    double P_n_F;
+    double p2;
+} PairTerms;
+
 // lambda, k, H, a, C, Alpha, Sigma
 static ScorerConstants scorerConstants[] = {
     { "BLOSUM_62", -1, -1, 0.3176, 0.134, 0.4012, 0.7916, 0.623757, 4.964660, 4.964660, 0},
@@ -114,6 +143,17 @@ static __constant__ double paramsTau_;
 static void eValuesCpu(double* values, int* scores, Chain* query, 
     Chain** database, int databaseLen, EValueParams* eValueParams);
 
+static void eValuesCpuProt(double* values, int* scores, int queryLen, 
+    Chain** database, int databaseLen, int minScore, int maxScore, 
+    EValueParams* params);
+
+static void eValuesCpuDna(double* values, int* scores, int queryLen, 
+    Chain** database, int databaseLen, int minScore, int maxScore, 
+    EValueParams* params);
+
+static void protTermsCreate(ProtTerms* terms, int score, int queryLen, 
+    EValueParams* params);
+
 #ifdef __CUDACC__
 static void eValuesGpu(double* values, int* scores, Chain* query, 
     Chain** database, int databaseLen, int* cards, int cardsLen, 
@@ -248,28 +288,220 @@ extern void eValues(double* values, int* scores, Chain* query,
 static void eValuesCpu(double* values, int* scores, Chain* query, 
     Chain** database, int databaseLen, EValueParams* eValueParams) {
 
-    double (*function) (int, int, int, EValueParams*);
+    int queryLen = chainGetLength(query);
+
+    int minScore = 0;
+    int maxScore = -1;
+
+    for (int i = 0; i < databaseLen; ++i) {
+
+        int score = scores[i];
+
+        if (score == NO_SCORE) {
+            continue;
+        }
+
+        if (maxScore < minScore) {
+            minScore = score;
+            maxScore = score;
+        } else {
+            minScore = score < minScore ? score : minScore;
+            maxScore = MAX(maxScore, score);
+        }
+    }
+
+    // no scores or too many distinct ones, cache would not pay off
+    if (maxScore < minScore || (long long) maxScore - minScore >= CACHE_MAX_LEN) {
+
+        double (*function) (int, int, int, EValueParams*);
+
+        if (eValueParams->isDna) {
+            function = calculateEValueDna;
+        } else {
+            function = calculateEValueProt;
+        }
+
+        for (int i = 0; i < databaseLen; ++i) {
+            
+            int score = scores[i];
+            int targetLen = chainGetLength(database[i]);
+
+            if (score == NO_SCORE) {
+                values[i] = INFINITY;
+                continue;
+            }
+            
+            values[i] = function(score, queryLen, targetLen, eValueParams);
+        }
+
+        return;
+    }
 
     if (eValueParams->isDna) {
-        function = calculateEValueDna;
+        eValuesCpuDna(values, scores, queryLen, database, databaseLen, 
+            minScore, maxScore, eValueParams);
     } else {
-        function = calculateEValueProt;
+        eValuesCpuProt(values, scores, queryLen, database, databaseLen, 
+            minScore, maxScore, eValueParams);
     }
+}
 
-    int queryLen = chainGetLength(query);
+static void eValuesCpuProt(double* values, int* scores, int queryLen, 
+    Chain** database, int databaseLen, int minScore, int maxScore, 
+    EValueParams* params) {
+
+    // terms which depend only on the score are solved once for every score,
+    // operations are ordered as in calculateEValueProt to get the same values
+
+    int termsLen = maxScore - minScore + 1;
+    ProtTerms* terms = (ProtTerms*) calloc(termsLen, sizeof(ProtTerms));
+
+    // random hits share few distinct scores and target lengths, direct mapped
+    // cache keeps the last terms solved for every slot
+    int pairsLen = 1;
+    while (pairsLen < databaseLen && pairsLen < PAIR_CACHE_MAX_LEN) {
+        pairsLen <<= 1;
+    }
+
+    PairTerms* pairs = (PairTerms*) malloc(pairsLen * sizeof(PairTerms));
+    for (int i = 0; i < pairsLen; ++i) {
+        pairs[i].score = 0;
+        pairs[i].targetLen = -1;
+    }
+
+    // this is 1/sqrt(2.0*PI)
+    static double const_val = 0.39894228040143267793994605993438;
+
+    double k_ = params->K;
 
     for (int i = 0; i < databaseLen; ++i) {
-        
+
+        int y_ = scores[i];
+
+        if (y_ == NO_SCORE) {
+            values[i] = INFINITY;
+            continue;
+        }
+
+        ProtTerms* t = &(terms[y_ - minScore]);
+
+        if (!t->filled) {
+            protTermsCreate(t, y_, queryLen, params);
+        }
+
+        int n_ = chainGetLength(database[i]);
+
+        double db_scale_factor = (double) params->length / (double) n_;
+
+        double n_lj_y = n_ - t->bj;
+        double n_F = n_lj_y / t->sqrtVj;
+
+        double P_n_F, p2;
+
+        if (n_F >= ERF_SATURATION) {
+            P_n_F = 1.0;
+            p2 = n_lj_y;
+        } else {
+
+            unsigned int hash = (unsigned int) y_ * 2654435761u ^ n_;
+            PairTerms* pair = &(pairs[hash & (pairsLen - 1)]);
+
+            if (pair->targetLen != n_ || pair->score != y_) {
+                pair->score = y_;
+                pair->targetLen = n_;
+                pair->P_n_F = 0.5 + 0.5 * erf(n_F);
+                pair->p2 = n_lj_y * pair->P_n_F + 
+                    t->sqrtVj * const_val * exp(-0.5*n_F*n_F);
+            }
+
+            P_n_F = pair->P_n_F;
+            p2 = pair->p2;
+        }
+
+        double area = t->p1 * p2 + t->cPm * P_n_F;
+
+        values[i] = area * k_ * t->expY * db_scale_factor;
+    }
+
+    free(terms);
+    free(pairs);
+}
+
+static void eValuesCpuDna(double* values, int* scores, int queryLen, 
+    Chain** database, int databaseLen, int minScore, int maxScore, 
+    EValueParams* params) {
+
+    int termsLen = maxScore - minScore + 1;
+    double* terms = (double*) malloc(termsLen * sizeof(double));
+
+    double lambda = params->lambda;
+    double logK = params->logK;
+
+    for (int i = 0; i < termsLen; ++i) {
+        terms[i] = -1;
+    }
+
+    for (int i = 0; i < databaseLen; ++i) {
+
         int score = scores[i];
-        int targetLen = chainGetLength(database[i]);
 
         if (score == NO_SCORE) {
             values[i] = INFINITY;
             continue;
         }
-        
-        values[i] = function(score, queryLen, targetLen, eValueParams);
+
+        double* term = &(terms[score - minScore]);
+
+        if (*term < 0) {
+            *term = exp(-lambda * score + logK);
+        }
+
+        int targetLen = chainGetLength(database[i]);
+
+        values[i] = (double) queryLen * targetLen * (*term);
     }
+
+    free(terms);
+}
+
+static void protTermsCreate(ProtTerms* terms, int score, int queryLen, 
+    EValueParams* params) {
+
+    int y_ = score;
+    int m_ = queryLen;
+
+    double lambda_    = params->lambda;
+    double ai_hat_    = params->a;
+    double bi_hat_    = params->b;
+    double alphai_hat_= params->alpha;
+    double betai_hat_ = params->beta;
+    double sigma_hat_ = params->sigma;
+    double tau_hat_   = params->tau;
+
+    // here we consider symmetric matrix only
+    double aj_hat_    = ai_hat_;
+    double bj_hat_    = bi_hat_;
+    double alphaj_hat_= alphai_hat_;
+    double betaj_hat_ = betai_hat_;
+
+    // this is 1/sqrt(2.0*PI)
+    static double const_val = 0.39894228040143267793994605993438;
+
+    double m_li_y = m_ - (ai_hat_*y_ + bi_hat_);
+    double vi_y = MAX(2.0*alphai_hat_/lambda_, alphai_hat_*y_+betai_hat_);
+    double sqrt_vi_y = sqrt(vi_y);
+    double m_F = m_li_y/sqrt_vi_y;
+    double P_m_F = 0.5 + 0.5 * erf(m_F);
+
+    double vj_y = MAX(2.0*alphaj_hat_/lambda_, alphaj_hat_*y_+betaj_hat_);
+    double c_y = MAX(2.0*sigma_hat_/lambda_, sigma_hat_*y_+tau_hat_);
+
+    terms->p1 = m_li_y * P_m_F + sqrt_vi_y * const_val * exp(-0.5*m_F*m_F);
+    terms->cPm = c_y * P_m_F;
+    terms->bj = aj_hat_*y_ + bj_hat_;
+    terms->sqrtVj = sqrt(vj_y);
+    terms->expY = exp(-lambda_ * y_);
+    terms->filled = 1;
 }
 
 #ifdef __CUDACC__
@@ -0,0 +1,364 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "chain.h"
+#include "database.h"
+#include "error.h"
+#include "scorer.h"
+
+#include "hit_cache.h"
+
+#define CACHE_MAGIC     0x43485753 // SWHC
+#define CACHE_VERSION   2
+
+#define FNV_OFFSET      14695981039346656037ull
+#define FNV_PRIME       1099511628211ull
+
+struct HitCache {
+    char* path;
+    unsigned long long databaseId;
+};
+
+// fixed part of the entry, followed by the scorer name, query codes, the number
+// of hits and the hits
+typedef struct EntryHeader {
+    int magic;
+    int version;
+    unsigned long long databaseId;
+    int databaseStart;
+    int databaseLen;
+    int type;
+    int gapOpen;
+    int gapExtend;
+    unsigned long long tableHash;
+    int maxAlignments;
+    double valueThreshold;
+    int nameLen;
+    int queryLen;
+} EntryHeader;
+
+// query index is not stored, it is relative to the caller queries array
+typedef struct EntryHit {
+    int targetIdx;
+    int score;
+    double value;
+} EntryHit;
+
+//******************************************************************************
+// PUBLIC
+
+extern HitCache* hitCacheCreate(const char* path, unsigned long long databaseId);
+
+extern void hitCacheDelete(HitCache* hitCache);
+
+extern unsigned long long hitCacheDatabaseId(const char* databasePath);
+
+extern int hitCacheGet(DbHit** hits, int* hitsLen, HitCache* hitCache, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold);
+
+extern void hitCachePut(HitCache* hitCache, DbHit* hits, int hitsLen, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void entryHeaderCreate(EntryHeader* header, HitCache* hitCache, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold);
+
+static char* entryPath(HitCache* hitCache, EntryHeader* header, Chain* query, 
+    Scorer* scorer);
+
+static unsigned long long hash(unsigned long long h, const void* data, 
+    size_t len);
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+extern HitCache* hitCacheCreate(const char* path, unsigned long long databaseId) {
+
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+
+    struct stat info;
+    ASSERT(stat(path, &info) == 0 && (info.st_mode & S_IFDIR), 
+        "invalid hit cache directory %s", path);
+
+    HitCache* hitCache = (HitCache*) malloc(sizeof(struct HitCache));
+
+    hitCache->path = (char*) malloc(strlen(path) + 1);
+    strcpy(hitCache->path, path);
+
+    hitCache->databaseId = databaseId;
+
+    return hitCache;
+}
+
+extern void hitCacheDelete(HitCache* hitCache) {
+    free(hitCache->path);
+    free(hitCache);
+    hitCache = NULL;
+}
+
+extern unsigned long long hitCacheDatabaseId(const char* databasePath) {
+
+    static const char ext[] = ".swsharp";
+
+    char* serializedPath = (char*) malloc(strlen(databasePath) + sizeof(ext));
+    sprintf(serializedPath, "%s%s", databasePath, ext);
+
+    const char* paths[] = { databasePath, serializedPath };
+
+    unsigned long long id = FNV_OFFSET;
+
+    int i;
+    for (i = 0; i < 2; ++i) {
+
+        struct stat info;
+
+        long long size = -1;
+        long long time = -1;
+
+        if (stat(paths[i], &info) == 0) {
+            size = (long long) info.st_size;
+            time = (long long) info.st_mtime;
+        }
+
+        id = hash(id, &size, sizeof(long long));
+        id = hash(id, &time, sizeof(long long));
+    }
+
+    free(serializedPath);
+
+    return id;
+}
+
+extern int hitCacheGet(DbHit** hits, int* hitsLen, HitCache* hitCache, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold) {
+
+    EntryHeader header;
+    entryHeaderCreate(&header, hitCache, query, databaseStart, databaseLen, 
+        type, scorer, maxAlignments, valueThreshold);
+
+    char* path = entryPath(hitCache, &header, query, scorer);
+    FILE* file = fopen(path, "rb");
+
+    free(path);
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    const char* name = scorerGetName(scorer);
+    const char* codes = chainGetCodes(query);
+
+    char* nameRead = (char*) malloc(header.nameLen + 1);
+    char* codesRead = (char*) malloc(header.queryLen + 1);
+
+    EntryHeader headerRead;
+
+    // hash collisions are rejected by comparing the whole key
+    int found = fread(&headerRead, sizeof(EntryHeader), 1, file) == 1;
+
+    found = found && memcmp(&headerRead, &header, sizeof(EntryHeader)) == 0;
+
+    found = found && 
+        fread(nameRead, 1, header.nameLen, file) == (size_t) header.nameLen &&
+        fread(codesRead, 1, header.queryLen, file) == (size_t) header.queryLen &&
+        memcmp(nameRead, name, header.nameLen) == 0 &&
+        memcmp(codesRead, codes, header.queryLen) == 0;
+
+    int length = 0;
+    found = found && fread(&length, sizeof(int), 1, file) == 1 && length >= 0;
+
+    EntryHit* entryHits = NULL;
+
+    if (found) {
+        entryHits = (EntryHit*) malloc(length * sizeof(EntryHit) + 1);
+        found = fread(entryHits, sizeof(EntryHit), length, file) == (size_t) length;
+    }
+
+    if (found) {
+
+        *hits = (DbHit*) malloc(length * sizeof(DbHit));
+        *hitsLen = length;
+
+        int i;
+        for (i = 0; i < length; ++i) {
+            (*hits)[i].queryIdx = 0;
+            (*hits)[i].targetIdx = entryHits[i].targetIdx;
+            (*hits)[i].score = entryHits[i].score;
+            (*hits)[i].value = entryHits[i].value;
+        }
+    }
+
+    free(entryHits);
+    free(codesRead);
+    free(nameRead);
+
+    fclose(file);
+
+    return found;
+}
+
+extern void hitCachePut(HitCache* hitCache, DbHit* hits, int hitsLen, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold) {
+
+    EntryHeader header;
+    entryHeaderCreate(&header, hitCache, query, databaseStart, databaseLen, 
+        type, scorer, maxAlignments, valueThreshold);
+
+    char* path = entryPath(hitCache, &header, query, scorer);
+
+    // entry is written to a temporary file first, readers never see a part
+    char* tmpPath = (char*) malloc(strlen(path) + 32);
+    sprintf(tmpPath, "%s.%d.tmp", path, (int) getpid());
+
+    FILE* file = fopen(tmpPath, "wb");
+
+    if (file == NULL) {
+        free(tmpPath);
+        free(path);
+        return;
+    }
+
+    EntryHit* entryHits = (EntryHit*) malloc(hitsLen * sizeof(EntryHit) + 1);
+
+    int i;
+    for (i = 0; i < hitsLen; ++i) {
+        entryHits[i].targetIdx = hits[i].targetIdx;
+        entryHits[i].score = hits[i].score;
+        entryHits[i].value = hits[i].value;
+    }
+
+    int ok = 
+        fwrite(&header, sizeof(EntryHeader), 1, file) == 1 &&
+        fwrite(scorerGetName(scorer), 1, header.nameLen, file) == (size_t) header.nameLen &&
+        fwrite(chainGetCodes(query), 1, header.queryLen, file) == (size_t) header.queryLen &&
+        fwrite(&hitsLen, sizeof(int), 1, file) == 1 &&
+        fwrite(entryHits, sizeof(EntryHit), hitsLen, file) == (size_t) hitsLen;
+
+    ok = fclose(file) == 0 && ok;
+
+    if (ok) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        ok = rename(tmpPath, path) == 0;
+    }
+
+    if (!ok) {
+        remove(tmpPath);
+    }
+
+    free(entryHits);
+    free(tmpPath);
+    free(path);
+}
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void entryHeaderCreate(EntryHeader* header, HitCache* hitCache, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold) {
+
+    // zeroed to have defined padding bytes, header is compared with memcmp
+    memset(header, 0, sizeof(EntryHeader));
+
+    header->magic = CACHE_MAGIC;
+    header->version = CACHE_VERSION;
+    header->databaseId = hitCache->databaseId;
+    header->databaseStart = databaseStart;
+    header->databaseLen = databaseLen;
+    header->type = type;
+    header->gapOpen = scorerGetGapOpen(scorer);
+    header->gapExtend = scorerGetGapExtend(scorer);
+
+    // names of custom scorers do not have to describe their tables
+    int maxCode = scorerGetMaxCode(scorer);
+    header->tableHash = hash(FNV_OFFSET, scorerGetTable(scorer), 
+        maxCode * maxCode * sizeof(int));
+
+    header->maxAlignments = maxAlignments;
+    header->valueThreshold = valueThreshold;
+    header->nameLen = strlen(scorerGetName(scorer));
+    header->queryLen = chainGetLength(query);
+}
+
+static char* entryPath(HitCache* hitCache, EntryHeader* header, Chain* query, 
+    Scorer* scorer) {
+
+    unsigned long long key = FNV_OFFSET;
+
+    key = hash(key, header, sizeof(EntryHeader));
+    key = hash(key, scorerGetName(scorer), header->nameLen);
+    key = hash(key, chainGetCodes(query), header->queryLen);
+
+    char* path = (char*) malloc(strlen(hitCache->path) + 32);
+    sprintf(path, "%s/%016llx", hitCache->path, key);
+
+    return path;
+}
+
+static unsigned long long hash(unsigned long long h, const void* data, 
+    size_t len) {
+
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        h ^= bytes[i];
+        h *= FNV_PRIME;
+    }
+
+    return h;
+}
+
+//******************************************************************************
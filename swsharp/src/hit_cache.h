@@ -0,0 +1,134 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+/**
+@file
+
+@brief Persistent database hits cache header.
+
+Database search results depend only on the query residues, the database, the
+scorer, the aligning type, the maximal number of hits and the value threshold.
+HitCache stores the hits of every solved query on the disk under the key built
+from all of them, so repeated queries are not scored again. Cache is used by 
+attaching it to a chain database with chainDatabaseSetHitCache().
+
+Cached hit values are not recalculated, the cache must be used with the same
+value function for the same database identity.
+*/
+
+#ifndef __SW_SHARP_HIT_CACHEH__
+#define __SW_SHARP_HIT_CACHEH__
+
+#include "chain.h"
+#include "database.h"
+#include "scorer.h"
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Persistent database hits cache object.
+*/
+typedef struct HitCache HitCache;
+
+/*!
+@brief HitCache constructor.
+
+Cache entries are stored as files in the given directory, directory is created
+if it does not exist. Database identity is part of every key and it should 
+change whenever the database changes, see hitCacheDatabaseId().
+
+@param path cache directory path
+@param databaseId database identity
+
+@return hitCache object
+*/
+extern HitCache* hitCacheCreate(const char* path, unsigned long long databaseId);
+
+/*!
+@brief HitCache destructor.
+
+Stored entries stay on the disk.
+
+@param hitCache hitCache object
+*/
+extern void hitCacheDelete(HitCache* hitCache);
+
+/*!
+@brief Database identity getter.
+
+Identity is created from the size and the modification time of the database 
+file and of its serialized version, see dumpFastaChains().
+
+@param databasePath database file path
+
+@return database identity
+*/
+extern unsigned long long hitCacheDatabaseId(const char* databasePath);
+
+/*!
+@brief Reads cached hits.
+
+Hits query indexes are set to zero and target indexes are relative to the 
+database array with which the chainDatabase of the databaseStart was created.
+
+@param hits output hits array, new array is created on success
+@param hitsLen output hits array length
+@param hitCache hitCache object
+@param query query chain
+@param databaseStart index of the first database chain in the searched part
+@param databaseLen number of database chains in the searched part
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of hits
+@param valueThreshold maximum value of the hits
+
+@return 1 if the hits were found in the cache, 0 otherwise
+*/
+extern int hitCacheGet(DbHit** hits, int* hitsLen, HitCache* hitCache, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold);
+
+/*!
+@brief Stores the hits in the cache.
+
+Failures to write the entry are ignored, the cache is only an optimization.
+
+@param hitCache hitCache object
+@param hits hits array
+@param hitsLen hits array length
+@param query query chain
+@param databaseStart index of the first database chain in the searched part
+@param databaseLen number of database chains in the searched part
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of hits
+@param valueThreshold maximum value of the hits
+*/
+extern void hitCachePut(HitCache* hitCache, DbHit* hits, int hitsLen, 
+    Chain* query, int databaseStart, int databaseLen, int type, Scorer* scorer, 
+    int maxAlignments, double valueThreshold);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __SW_SHARP_HIT_CACHEH__
@@ -0,0 +1,257 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+
+#include "path.h"
+
+// run byte layout
+#define RUN_MOVE(run) ((char) (((unsigned char) (run)) >> 6))
+#define RUN_LEN(run) ((((unsigned char) (run)) & (PATH_RUN_MAX - 1)) + 1)
+#define RUN_CREATE(move, len) ((char) (((move) << 6) | ((len) - 1)))
+
+// index and runs are stored in the same allocation after the struct
+struct Path {
+    int length;
+    int runsLen;
+    int indexLen;
+    int* index;
+    char* runs;
+};
+
+//******************************************************************************
+// PUBLIC
+
+extern Path* pathCreate(const char* moves, int movesLen);
+
+extern Path* pathCreateFromRuns(const char* runs, int runsLen);
+
+extern Path* pathCopy(Path* path);
+
+extern void pathDelete(Path* path);
+
+extern char pathGetMove(Path* path, int index);
+
+extern int pathGetLen(Path* path);
+
+extern int pathGetRunsLen(Path* path);
+
+extern const char* pathGetRuns(Path* path);
+
+extern char pathGetRunMove(Path* path, int index);
+
+extern int pathGetRunLen(Path* path, int index);
+
+extern void pathCopyMoves(Path* path, char* dest);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static Path* pathAllocate(int runsLen);
+
+static void pathIndex(Path* path);
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+//------------------------------------------------------------------------------
+// CONSTRUCTOR, DESTRUCTOR
+
+extern Path* pathCreate(const char* moves, int movesLen) {
+
+    int runsLen = 0;
+    int i = 0;
+
+    while (i < movesLen) {
+
+        int n = 1;
+        while (i + n < movesLen && n < PATH_RUN_MAX && moves[i + n] == moves[i]) {
+            n++;
+        }
+
+        runsLen++;
+        i += n;
+    }
+
+    Path* path = pathAllocate(runsLen);
+
+    int run = 0;
+    i = 0;
+
+    while (i < movesLen) {
+
+        int n = 1;
+        while (i + n < movesLen && n < PATH_RUN_MAX && moves[i + n] == moves[i]) {
+            n++;
+        }
+
+        path->runs[run++] = RUN_CREATE(moves[i], n);
+        i += n;
+    }
+
+    pathIndex(path);
+
+    return path;
+}
+
+extern Path* pathCreateFromRuns(const char* runs, int runsLen) {
+
+    Path* path = pathAllocate(runsLen);
+    memcpy(path->runs, runs, runsLen);
+
+    pathIndex(path);
+
+    return path;
+}
+
+extern Path* pathCopy(Path* path) {
+
+    Path* copy = pathAllocate(path->runsLen);
+    
+    copy->length = path->length;
+    memcpy(copy->index, path->index, path->indexLen * sizeof(int));
+    memcpy(copy->runs, path->runs, path->runsLen);
+
+    return copy;
+}
+
+extern void pathDelete(Path* path) {
+    free(path);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// GETTERS
+
+extern char pathGetMove(Path* path, int index) {
+
+    // last indexed run starting at or before the move
+    int low = 0;
+    int high = path->indexLen - 1;
+
+    while (low < high) {
+
+        int mid = (low + high + 1) / 2;
+
+        if (path->index[mid] <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    int run = low * PATH_INDEX_STEP;
+    int position = path->index[low];
+
+    while (position + RUN_LEN(path->runs[run]) <= index) {
+        position += RUN_LEN(path->runs[run]);
+        run++;
+    }
+
+    return RUN_MOVE(path->runs[run]);
+}
+
+extern int pathGetLen(Path* path) {
+    return path->length;
+}
+
+extern int pathGetRunsLen(Path* path) {
+    return path->runsLen;
+}
+
+extern const char* pathGetRuns(Path* path) {
+    return path->runs;
+}
+
+extern char pathGetRunMove(Path* path, int index) {
+    return RUN_MOVE(path->runs[index]);
+}
+
+extern int pathGetRunLen(Path* path, int index) {
+    return RUN_LEN(path->runs[index]);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// FUNCTIONS
+
+extern void pathCopyMoves(Path* path, char* dest) {
+
+    int i;
+    for (i = 0; i < path->runsLen; ++i) {
+
+        int n = RUN_LEN(path->runs[i]);
+
+        memset(dest, RUN_MOVE(path->runs[i]), n);
+        dest += n;
+    }
+}
+
+//------------------------------------------------------------------------------
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static Path* pathAllocate(int runsLen) {
+
+    int indexLen = (runsLen + PATH_INDEX_STEP - 1) / PATH_INDEX_STEP;
+
+    size_t size = sizeof(struct Path) + indexLen * sizeof(int) + runsLen;
+    Path* path = (Path*) malloc(size);
+
+    path->length = 0;
+    path->runsLen = runsLen;
+    path->indexLen = indexLen;
+    path->index = (int*) (path + 1);
+    path->runs = (char*) (path->index + indexLen);
+
+    return path;
+}
+
+static void pathIndex(Path* path) {
+
+    int length = 0;
+
+    int i;
+    for (i = 0; i < path->runsLen; ++i) {
+
+        if (i % PATH_INDEX_STEP == 0) {
+            path->index[i / PATH_INDEX_STEP] = length;
+        }
+
+        length += RUN_LEN(path->runs[i]);
+    }
+
+    path->length = length;
+}
+
+//******************************************************************************
@@ -0,0 +1,164 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+/**
+@file
+
+@brief Run-length encoded alignment path header.
+*/
+
+#ifndef __SW_SHARP_PATHH__
+#define __SW_SHARP_PATHH__
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Run-length encoded alignment path.
+
+Path stores alignment moves as runs, each run takes one byte and holds the move
+in the upper two bits and the run length minus one in the lower six bits, so a
+run is at most #PATH_RUN_MAX moves long and consecutive runs can have the same
+move. Random access to moves is provided through an index of the move positions
+of every #PATH_INDEX_STEP-th run.
+*/
+typedef struct Path Path;
+
+/*!
+@brief Maximal number of moves in a single run.
+*/
+#define PATH_RUN_MAX 64
+
+/*!
+@brief Distance in runs between two indexed runs.
+*/
+#define PATH_INDEX_STEP 64
+
+/*!
+@brief Path constructor.
+
+@param moves alignment moves, not used after the call
+@param movesLen moves length
+
+@return path object
+*/
+extern Path* pathCreate(const char* moves, int movesLen);
+
+/*!
+@brief Path constructor from runs.
+
+@param runs runs in the format described in #Path, not used after the call
+@param runsLen runs length
+
+@return path object
+*/
+extern Path* pathCreateFromRuns(const char* runs, int runsLen);
+
+/*!
+@brief Path copy constructor.
+
+@param path path object
+
+@return copy of the path object
+*/
+extern Path* pathCopy(Path* path);
+
+/*!
+@brief Path destructor.
+
+@param path path object
+*/
+extern void pathDelete(Path* path);
+
+/*!
+@brief Move getter.
+
+Move is found with a binary search over the index followed by a scan of at most
+#PATH_INDEX_STEP runs.
+
+@param path path object
+@param index move index, greater or equal to zero and less than path length
+
+@return move
+*/
+extern char pathGetMove(Path* path, int index);
+
+/*!
+@brief Length getter.
+
+@param path path object
+
+@return number of moves in the path
+*/
+extern int pathGetLen(Path* path);
+
+/*!
+@brief Runs length getter.
+
+@param path path object
+
+@return number of runs in the path
+*/
+extern int pathGetRunsLen(Path* path);
+
+/*!
+@brief Runs getter.
+
+@param path path object
+
+@return runs in the format described in #Path
+*/
+extern const char* pathGetRuns(Path* path);
+
+/*!
+@brief Run move getter.
+
+@param path path object
+@param index run index
+
+@return move of the run
+*/
+extern char pathGetRunMove(Path* path, int index);
+
+/*!
+@brief Run length getter.
+
+@param path path object
+@param index run index
+
+@return number of moves in the run
+*/
+extern int pathGetRunLen(Path* path, int index);
+
+/*!
+@brief Copies moves to the given buffer.
+
+Buffer must be at least path length long.
+
+@param path path object
+@param dest destination buffer
+*/
+extern void pathCopyMoves(Path* path, char* dest);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __SW_SHARP_PATHH__
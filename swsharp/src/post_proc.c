@@ -19,20 +19,106 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 Contact the author by mkorpar@gmail.com.
 */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "alignment.h"
 #include "chain.h"
 #include "error.h"
 #include "db_alignment.h"
 #include "scorer.h"
+#include "threadpool.h"
 #include "utils.h"
 
 #include "post_proc.h"
 
+#define OUTPUT_BUFFER_SIZE 65536
+
+// alignments formatted by a single task and tasks formatted at once
+#define OUTPUT_TASK_ALIGNMENTS 2048
+#define OUTPUT_TASKS 64
+
+typedef struct OutputBuffer {
+    char* data;
+    size_t length;
+    size_t size;
+} OutputBuffer;
+
+typedef void (*FormatDatabaseFunction) (OutputBuffer* buffer, 
+    DbAlignment** dbAlignments, int dbAlignmentsLen);
+
+typedef struct FormatContext {
+    OutputBuffer buffer;
+    FormatDatabaseFunction function;
+    DbAlignment*** dbAlignments;
+    int* dbAlignmentsLens;
+    int dbAlignmentsLen;
+} FormatContext;
+
+#define DB_DUMP_MAGIC "SWDBDUMP"
+#define DB_DUMP_VERSION 2
+
+// version 1 header ends before the database generation
+#define DB_DUMP_HEADER_V1 offsetof(DbDumpHeader, databaseLen)
+
+// path byte holds the move in the upper 2 bits and the run length - 1
+#define DB_DUMP_RUN 64
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+typedef struct DbDumpHeader {
+    char magic[8];
+    int version;
+    int queriesLen;
+    int chainsLen;
+    int scorerBytesLen;
+    long long hitsLen;
+    long long chainsBytesLen;
+    long long pathsBytesLen;
+    int databaseLen;
+    int reserved;
+    long long databaseCells;
+    int searchType;
+    int maxAlignments;
+    double maxEValue;
+    long long queriesBytesLen;
+} DbDumpHeader;
+
+// search record of a query, followed by the query name in the queries section
+typedef struct DbDumpQuery {
+    unsigned long long codesHash;
+    int codesLen;
+    int nameLen;
+} DbDumpQuery;
+
+typedef struct DbDumpHit {
+    int queryChain;
+    int targetChain;
+    int queryIdx;
+    int targetIdx;
+    int queryStart;
+    int queryEnd;
+    int targetStart;
+    int targetEnd;
+    int score;
+    int pathLen;
+    double value;
+    long long pathOffset;
+    int pathBytesLen;
+    int reserved;
+} DbDumpHit;
+
 typedef void (*OutputFunction) (Alignment* alignment, FILE* file);
 
 typedef void (*OutputDatabaseFunction) (DbAlignment** dbAlignments, 
@@ -54,6 +140,12 @@ static void printFastaName(const char* name, FILE* file);
 
 static int dbAlignmentCmp(const void* a_, const void* b_);
 
+static int chainPointerCmp(const void* a_, const void* b_);
+
+static void fileMap(char** data, size_t* size, char* path);
+
+static void fileUnmap(char* data, size_t size);
+
 // single output
 static OutputFunction outputFunction(int type);
 
@@ -82,6 +174,50 @@ static void outputDatabaseBlastM8(DbAlignment** dbAlignments,
 static void outputDatabaseBlastM9(DbAlignment** dbAlignments, 
     int dbAlignmentsLen, FILE* file);
 
+// binary database output
+static void readDbDumpHeader(DbDumpHeader* header, size_t* headerSize, 
+    char* data, size_t size, char* path);
+
+static void outputShotgunDatabaseDump(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, int databaseLen, 
+    long long databaseCells, Chain** queries, int type, int maxAlignments, 
+    double maxEValue, FILE* file);
+
+static unsigned long long dumpCodesHash(Chain* chain);
+
+static int zipDumpPath(char* bytes, DbAlignment* dbAlignment);
+
+static void unzipDumpPath(char* path, const char* bytes, int bytesLen);
+
+// buffered database output
+static FormatDatabaseFunction formatDatabaseFunction(int type);
+
+static void outputShotgunDatabaseBuffered(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, FILE* file, 
+    FormatDatabaseFunction function);
+
+static void* formatDatabaseThread(void* param);
+
+static void formatDatabaseBlastM8(OutputBuffer* buffer, 
+    DbAlignment** dbAlignments, int dbAlignmentsLen);
+
+static void formatDatabaseBlastM9(OutputBuffer* buffer, 
+    DbAlignment** dbAlignments, int dbAlignmentsLen);
+
+static void bufferCreate(OutputBuffer* buffer);
+
+static void bufferDelete(OutputBuffer* buffer);
+
+static void bufferReserve(OutputBuffer* buffer, size_t length);
+
+static void bufferPutString(OutputBuffer* buffer, const char* str, int length);
+
+static void bufferPutInt(OutputBuffer* buffer, int x);
+
+static void bufferPutFixed(OutputBuffer* buffer, double x);
+
+static void bufferPutExponent(OutputBuffer* buffer, double x);
+
 //******************************************************************************
 
 //******************************************************************************
@@ -124,15 +260,18 @@ extern int checkAlignment(Alignment* alignment) {
     int queryIdx = queryEnd;
     int targetIdx = targetEnd;
     
-    int i;
-    for (i = alignmentGetPathLen(alignment) - 1; i >= 0; --i) {
+    int i, j;
+    for (i = alignmentGetRunsLen(alignment) - 1; i >= 0; --i) {
+
+        int length = alignmentGetRunLen(alignment, i);
          
-        switch (alignmentGetMove(alignment, i)) {
+        switch (alignmentGetRunMove(alignment, i)) {
         case MOVE_LEFT:
             
             score -= isTargetGap ? gapExtend : gapOpen;
+            score -= (length - 1) * gapExtend;
             
-            targetIdx--;
+            targetIdx -= length;
             
             isQueryGap = 0;
             isTargetGap = 1;
@@ -141,20 +280,24 @@ extern int checkAlignment(Alignment* alignment) {
         case MOVE_UP:
             
             score -= isQueryGap ? gapExtend : gapOpen;
+            score -= (length - 1) * gapExtend;
             
-            queryIdx--;
+            queryIdx -= length;
             
             isQueryGap = 1;
             isTargetGap = 0;
             
             break;
         case MOVE_DIAG:
+
+            for (j = 0; j < length; ++j) {
         
-            score += scorerScore(scorer, chainGetCode(query, queryIdx), 
-                chainGetCode(target, targetIdx));
+                score += scorerScore(scorer, chainGetCode(query, queryIdx), 
+                    chainGetCode(target, targetIdx));
 
-            queryIdx--;
-            targetIdx--;
+                queryIdx--;
+                targetIdx--;
+            }
             
             isQueryGap = 0;
             isTargetGap = 0;
@@ -193,6 +336,174 @@ extern Alignment* readAlignment(char* path) {
     return alignment;
 }
 
+extern void readShotgunDatabase(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, int* dbAlignmentsLen, Chain*** chains, 
+    int* chainsLen, Scorer** scorer, char* path, int* indexes, int indexesLen) {
+
+    int i, j;
+
+    char* data;
+    size_t size;
+    fileMap(&data, &size, path);
+
+    DbDumpHeader header;
+    size_t scorerOffset;
+    readDbDumpHeader(&header, &scorerOffset, data, size, path);
+
+    size_t hitOffsetsOffset = scorerOffset + header.scorerBytesLen;
+    size_t chainOffsetsOffset = hitOffsetsOffset + 
+        (header.queriesLen + 1) * sizeof(long long);
+    size_t hitsOffset = chainOffsetsOffset + header.chainsLen * sizeof(long long);
+    size_t chainsOffset = hitsOffset + header.hitsLen * sizeof(DbDumpHit);
+    size_t pathsOffset = chainsOffset + header.chainsBytesLen;
+
+    ASSERT(pathsOffset + header.pathsBytesLen <= size, 
+        "invalid database alignments %s", path);
+
+    if (indexes == NULL) {
+        indexesLen = header.queriesLen;
+    }
+
+    for (i = 0; indexes != NULL && i < indexesLen; ++i) {
+        ASSERT(indexes[i] >= 0 && indexes[i] < header.queriesLen, 
+            "invalid query index %d", indexes[i]);
+    }
+
+    *scorer = NULL;
+    if (header.scorerBytesLen > 0) {
+        *scorer = scorerDeserialize(data + scorerOffset);
+    }
+
+    *chainsLen = header.chainsLen;
+    *chains = (Chain**) calloc(header.chainsLen, sizeof(Chain*));
+
+    *dbAlignmentsLen = indexesLen;
+    *dbAlignmentsLens = (int*) malloc(indexesLen * sizeof(int));
+    *dbAlignments = (DbAlignment***) malloc(indexesLen * sizeof(DbAlignment**));
+
+    for (i = 0; i < indexesLen; ++i) {
+
+        int query = indexes == NULL ? i : indexes[i];
+
+        long long hitOffsets[2];
+        memcpy(hitOffsets, data + hitOffsetsOffset + query * sizeof(long long), 
+            2 * sizeof(long long));
+
+        int hitsLen = hitOffsets[1] - hitOffsets[0];
+
+        (*dbAlignmentsLens)[i] = hitsLen;
+        (*dbAlignments)[i] = (DbAlignment**) malloc(hitsLen * sizeof(DbAlignment*));
+
+        for (j = 0; j < hitsLen; ++j) {
+
+            DbDumpHit hit;
+            memcpy(&hit, data + hitsOffset + (hitOffsets[0] + j) * sizeof(DbDumpHit), 
+                sizeof(DbDumpHit));
+
+            int idxs[] = { hit.queryChain, hit.targetChain };
+
+            int k;
+            for (k = 0; k < 2; ++k) {
+
+                if ((*chains)[idxs[k]] != NULL) {
+                    continue;
+                }
+
+                long long chainOffset;
+                memcpy(&chainOffset, data + chainOffsetsOffset + 
+                    idxs[k] * sizeof(long long), sizeof(long long));
+
+                (*chains)[idxs[k]] = chainDeserialize(data + chainsOffset + chainOffset);
+            }
+
+            char* alignmentPath = (char*) malloc(hit.pathLen);
+            unzipDumpPath(alignmentPath, data + pathsOffset + hit.pathOffset, 
+                hit.pathBytesLen);
+
+            (*dbAlignments)[i][j] = dbAlignmentCreate((*chains)[hit.queryChain], 
+                hit.queryStart, hit.queryEnd, hit.queryIdx, 
+                (*chains)[hit.targetChain], hit.targetStart, hit.targetEnd, 
+                hit.targetIdx, hit.value, hit.score, *scorer, alignmentPath, 
+                hit.pathLen);
+        }
+    }
+
+    fileUnmap(data, size);
+}
+
+extern void readShotgunDatabaseGeneration(int* databaseLen, 
+    long long* databaseCells, char* path) {
+
+    char* data;
+    size_t size;
+    fileMap(&data, &size, path);
+
+    DbDumpHeader header;
+    size_t headerSize;
+    readDbDumpHeader(&header, &headerSize, data, size, path);
+
+    *databaseLen = header.databaseLen;
+    *databaseCells = header.databaseCells;
+
+    fileUnmap(data, size);
+}
+
+extern int checkShotgunDatabaseSearch(char* path, Chain** queries, 
+    int queriesLen, int type, int maxAlignments, double maxEValue) {
+
+    char* data;
+    size_t size;
+    fileMap(&data, &size, path);
+
+    DbDumpHeader header;
+    size_t scorerOffset;
+    readDbDumpHeader(&header, &scorerOffset, data, size, path);
+
+    size_t queriesOffset = scorerOffset + header.scorerBytesLen + 
+        (header.queriesLen + 1) * sizeof(long long) + 
+        header.chainsLen * sizeof(long long) + 
+        header.hitsLen * sizeof(DbDumpHit) + header.chainsBytesLen + 
+        header.pathsBytesLen;
+
+    // dumps without the search record can't be checked
+    int valid = header.queriesBytesLen > 0 && 
+        queriesOffset + header.queriesBytesLen <= size && 
+        header.queriesLen == queriesLen && header.searchType == type && 
+        header.maxAlignments == maxAlignments && 
+        header.maxEValue == maxEValue;
+
+    size_t offset = queriesOffset;
+    size_t end = queriesOffset + header.queriesBytesLen;
+
+    int i;
+    for (i = 0; valid && i < queriesLen; ++i) {
+
+        DbDumpQuery record;
+
+        if (offset + sizeof(DbDumpQuery) > end) {
+            valid = 0;
+            break;
+        }
+
+        memcpy(&record, data + offset, sizeof(DbDumpQuery));
+        offset += sizeof(DbDumpQuery);
+
+        const char* name = chainGetName(queries[i]);
+        int nameLen = strlen(name);
+
+        valid = record.codesLen == chainGetLength(queries[i]) && 
+            record.codesHash == dumpCodesHash(queries[i]) && 
+            record.nameLen == nameLen && offset + nameLen <= end && 
+            memcmp(data + offset, name, nameLen) == 0;
+
+        offset += nameLen;
+    }
+
+    fileUnmap(data, size);
+
+    return valid;
+}
+
 extern void outputAlignment(Alignment* alignment, char* path, int type) {
 
     int queryStart = alignmentGetQueryStart(alignment);
@@ -242,6 +553,11 @@ extern void outputScore(int score, Chain* query, Chain* target, Scorer* scorer,
 extern void outputDatabase(DbAlignment** dbAlignments, int dbAlignmentsLen, 
     char* path, int type) {
 
+    if (type == SW_OUT_DB_DUMP) {
+        outputShotgunDatabase(&dbAlignments, &dbAlignmentsLen, 1, path, type);
+        return;
+    }
+
     FILE* file = path == NULL ? stdout : fileSafeOpen(path, "w");
 
     OutputDatabaseFunction function = outputDatabaseFunction(type);
@@ -252,16 +568,52 @@ extern void outputDatabase(DbAlignment** dbAlignments, int dbAlignmentsLen,
 
 extern void outputShotgunDatabase(DbAlignment*** dbAlignments, 
     int* dbAlignmentsLens, int dbAlignmentsLen, char* path, int type) {
-    
-    FILE* file = path == NULL ? stdout : fileSafeOpen(path, "w");
 
-    OutputDatabaseFunction function = outputDatabaseFunction(type);
+    const char* mode = type == SW_OUT_DB_DUMP ? "wb" : "w";
+    FILE* file = path == NULL ? stdout : fileSafeOpen(path, mode);
 
-    int i;
-    for (i = 0; i < dbAlignmentsLen; ++i) {
-        function(dbAlignments[i], dbAlignmentsLens[i], file);
+    outputShotgunDatabaseFile(dbAlignments, dbAlignmentsLens, dbAlignmentsLen, 
+        file, type);
+
+    if (file != stdout) fclose(file);
+}
+
+extern void outputShotgunDatabaseFile(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, FILE* file, int type) {
+
+    if (type == SW_OUT_DB_DUMP) {
+        outputShotgunDatabaseDump(dbAlignments, dbAlignmentsLens, 
+            dbAlignmentsLen, 0, 0, NULL, 0, 0, 0, file);
+        return;
     }
-    
+
+    FormatDatabaseFunction format = formatDatabaseFunction(type);
+
+    if (format != NULL) {
+        outputShotgunDatabaseBuffered(dbAlignments, dbAlignmentsLens, 
+            dbAlignmentsLen, file, format);
+    } else {
+
+        OutputDatabaseFunction function = outputDatabaseFunction(type);
+
+        int i;
+        for (i = 0; i < dbAlignmentsLen; ++i) {
+            function(dbAlignments[i], dbAlignmentsLens[i], file);
+        }
+    }
+}
+
+extern void outputShotgunDatabaseGeneration(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, char* path, int databaseLen, 
+    long long databaseCells, Chain** queries, int type, int maxAlignments, 
+    double maxEValue) {
+
+    FILE* file = path == NULL ? stdout : fileSafeOpen(path, "wb");
+
+    outputShotgunDatabaseDump(dbAlignments, dbAlignmentsLens, dbAlignmentsLen, 
+        databaseLen, databaseCells, queries, type, maxAlignments, maxEValue, 
+        file);
+
     if (file != stdout) fclose(file);
 }
 
@@ -363,45 +715,54 @@ static void aligmentStr(char** queryStr, char** targetStr,
     *queryStr = (char*) malloc(pathLen * sizeof(char));
     *targetStr = (char*) malloc(pathLen * sizeof(char));
     
-    int i;
-    for (i = 0; i < pathLen; ++i) {
+    int runsLen = alignmentGetRunsLen(alignment);
+    int idx = 0;
 
-        char queryChr;
-        char targetChr;
-        
-        switch (alignmentGetMove(alignment, i)) {
-        case MOVE_LEFT:
-        
-            queryChr = gapItem;
-            targetChr = chainGetChar(target, targetIdx);
+    int i, j;
+    for (i = 0; i < runsLen; ++i) {
 
-            targetIdx++;
+        char move = alignmentGetRunMove(alignment, i);
+        int length = alignmentGetRunLen(alignment, i);
 
-            break;
-        case MOVE_UP:
-        
-            queryChr = chainGetChar(query, queryIdx);
-            targetChr = gapItem;
+        for (j = 0; j < length; ++j, ++idx) {
+
+            char queryChr;
+            char targetChr;
             
-            queryIdx++;
+            switch (move) {
+            case MOVE_LEFT:
             
-            break;
-        case MOVE_DIAG:
-        
-            queryChr = chainGetChar(query, queryIdx);
-            targetChr = chainGetChar(target, targetIdx);
+                queryChr = gapItem;
+                targetChr = chainGetChar(target, targetIdx);
+
+                targetIdx++;
+
+                break;
+            case MOVE_UP:
             
-            queryIdx++;
-            targetIdx++;
+                queryChr = chainGetChar(query, queryIdx);
+                targetChr = gapItem;
+                
+                queryIdx++;
+                
+                break;
+            case MOVE_DIAG:
             
-            break;
-        default:
-            // error
-            return;
+                queryChr = chainGetChar(query, queryIdx);
+                targetChr = chainGetChar(target, targetIdx);
+                
+                queryIdx++;
+                targetIdx++;
+                
+                break;
+            default:
+                // error
+                return;
+            }
+            
+            (*queryStr)[idx] = queryChr;
+            (*targetStr)[idx] = targetChr;
         }
-        
-        (*queryStr)[i] = queryChr;
-        (*targetStr)[i] = targetChr;
     }
 }
 
@@ -436,16 +797,22 @@ static int dbAlignmentCmp(const void* a_, const void* b_) {
     
     double aVal = dbAlignmentGetValue(a);
     int aScr = dbAlignmentGetScore(a);
-    const char* aName = chainGetName(dbAlignmentGetTarget(a));
+    Chain* aTarget = dbAlignmentGetTarget(a);
 
     double bVal = dbAlignmentGetValue(b);
     int bScr = dbAlignmentGetScore(b);
-    const char* bName = chainGetName(dbAlignmentGetTarget(b));
+    Chain* bTarget = dbAlignmentGetTarget(b);
 
     if (aVal == bVal) {
 
         if (aScr == bScr) {
-            return strcmp(aName, bName);
+
+            // lazy names are not read for ordering
+            if (chainHasLazyName(aTarget) || chainHasLazyName(bTarget)) {
+                return dbAlignmentGetTargetIdx(a) - dbAlignmentGetTargetIdx(b);
+            }
+
+            return strcmp(chainGetName(aTarget), chainGetName(bTarget));
         }
 
         return bScr - aScr;
@@ -455,6 +822,56 @@ static int dbAlignmentCmp(const void* a_, const void* b_) {
     return 1;
 }
 
+static int chainPointerCmp(const void* a_, const void* b_) {
+
+    Chain* a = *((Chain**) a_);
+    Chain* b = *((Chain**) b_);
+
+    if (a == b) return 0;
+    if (a < b) return -1;
+    return 1;
+}
+
+static void fileMap(char** data, size_t* size, char* path) {
+
+#ifdef _WIN32
+
+    FILE* file = fileSafeOpen(path, "rb");
+
+    *size = fileLength(file);
+    *data = (char*) malloc(*size);
+
+    ASSERT(fread(*data, sizeof(char), *size, file) == *size, "IO error");
+
+    fclose(file);
+
+#else
+
+    int fd = open(path, O_RDONLY);
+    ASSERT(fd != -1, "cannot open %s", path);
+
+    struct stat fileStat;
+    ASSERT(fstat(fd, &fileStat) == 0 && fileStat.st_size > 0, 
+        "invalid file %s", path);
+
+    *size = fileStat.st_size;
+    *data = (char*) mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    ASSERT(*data != MAP_FAILED, "cannot map %s", path);
+
+    close(fd);
+
+#endif
+}
+
+static void fileUnmap(char* data, size_t size) {
+#ifdef _WIN32
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
 //------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
@@ -611,28 +1028,32 @@ static void outputPlot(Alignment* alignment, FILE* file) {
 
     int queryIdx = queryStart;
     int targetIdx = targetStart;
-    int pathLen = alignmentGetPathLen(alignment);
+    int runsLen = alignmentGetRunsLen(alignment);
     
-    int i;
-    for (i = 0; i < pathLen; ++i) {
-    
-        fprintf(file, "%d %d\n", queryIdx, targetIdx);
+    int i, j;
+    for (i = 0; i < runsLen; ++i) {
     
-        char move = alignmentGetMove(alignment, i);
-        
-        switch (move) {
-        case MOVE_LEFT:
-            targetIdx++;
-            break;
-        case MOVE_UP:
-            queryIdx++;
-            break;
-        case MOVE_DIAG:
-            queryIdx++;
-            targetIdx++;
-            break;
-        default:
-            return;
+        char move = alignmentGetRunMove(alignment, i);
+        int length = alignmentGetRunLen(alignment, i);
+
+        for (j = 0; j < length; ++j) {
+
+            fprintf(file, "%d %d\n", queryIdx, targetIdx);
+            
+            switch (move) {
+            case MOVE_LEFT:
+                targetIdx++;
+                break;
+            case MOVE_UP:
+                queryIdx++;
+                break;
+            case MOVE_DIAG:
+                queryIdx++;
+                targetIdx++;
+                break;
+            default:
+                return;
+            }
         }
     }
 }
@@ -656,36 +1077,34 @@ static void outputStat(Alignment* alignment, FILE* file) {
     
     int queryIdx = queryStart;
     int targetIdx = targetStart;
+    int runsLen = alignmentGetRunsLen(alignment);
     
-    int i;
-    for (i = 0; i < pathLen; ++i) {
+    int i, j;
+    for (i = 0; i < runsLen; ++i) {
     
-        char move = alignmentGetMove(alignment, i);
+        char move = alignmentGetRunMove(alignment, i);
+        int length = alignmentGetRunLen(alignment, i);
 
-        if (move == MOVE_DIAG) {
-        
-            char queryChr = chainGetChar(query, queryIdx);
-            char targetChr = chainGetChar(target, targetIdx);
-        
-            if (queryChr == targetChr) {
-                identity++;
-            }
-            
-            similarity++;
-        } else {
-            gaps++;
-        }
-        
         switch (move) {
         case MOVE_LEFT:
-            targetIdx++;
+            gaps += length;
+            targetIdx += length;
             break;
         case MOVE_UP:
-            queryIdx++;
+            gaps += length;
+            queryIdx += length;
             break;
         case MOVE_DIAG:
-            queryIdx++;
-            targetIdx++;
+
+            for (j = 0; j < length; ++j) {
+                identity += chainGetCode(query, queryIdx + j) == 
+                    chainGetCode(target, targetIdx + j);
+            }
+            
+            similarity += length;
+            queryIdx += length;
+            targetIdx += length;
+
             break;
         default:
             return;
@@ -961,91 +1380,684 @@ static void outputDatabaseBlastM0(DbAlignment** dbAlignments,
     
 static void outputDatabaseBlastM8(DbAlignment** dbAlignments, 
     int dbAlignmentsLen, FILE* file) {
+
+    OutputBuffer buffer;
+    bufferCreate(&buffer);
+
+    formatDatabaseBlastM8(&buffer, dbAlignments, dbAlignmentsLen);
+    fwrite(buffer.data, 1, buffer.length, file);
+
+    bufferDelete(&buffer);
+}
     
-    const char gapItem = '-';
-     
+static void outputDatabaseBlastM9(DbAlignment** dbAlignments, 
+    int dbAlignmentsLen, FILE* file) {
+
+    OutputBuffer buffer;
+    bufferCreate(&buffer);
+
+    formatDatabaseBlastM9(&buffer, dbAlignments, dbAlignmentsLen);
+    fwrite(buffer.data, 1, buffer.length, file);
+
+    bufferDelete(&buffer);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// BINARY OUTPUT DATABASE
+
+static void readDbDumpHeader(DbDumpHeader* header, size_t* headerSize, 
+    char* data, size_t size, char* path) {
+
+    memset(header, 0, sizeof(DbDumpHeader));
+
+    ASSERT(size >= DB_DUMP_HEADER_V1, "invalid database alignments %s", path);
+    memcpy(header, data, DB_DUMP_HEADER_V1);
+
+    ASSERT(memcmp(header->magic, DB_DUMP_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version >= 1 && header->version <= DB_DUMP_VERSION, 
+        "invalid database alignments %s", path);
+
+    if (header->version == 1) {
+        *headerSize = DB_DUMP_HEADER_V1;
+    } else {
+        ASSERT(size >= sizeof(DbDumpHeader), "invalid database alignments %s", path);
+        memcpy(header, data, sizeof(DbDumpHeader));
+        *headerSize = sizeof(DbDumpHeader);
+    }
+}
+
+static void outputShotgunDatabaseDump(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, int databaseLen, 
+    long long databaseCells, Chain** queries, int type, int maxAlignments, 
+    double maxEValue, FILE* file) {
+
     int i, j;
+
+    long long hitsLen = 0;
+    Scorer* scorer = NULL;
+
     for (i = 0; i < dbAlignmentsLen; ++i) {
-    
-        int length = dbAlignmentGetPathLen(dbAlignments[i]);
+
+        hitsLen += dbAlignmentsLens[i];
+
+        if (scorer == NULL && dbAlignmentsLens[i] > 0) {
+            scorer = dbAlignmentGetScorer(dbAlignments[i][0]);
+        }
+    }
+
+    //**************************************************************************
+    // COLLECT USED CHAINS
+
+    Chain** chains = (Chain**) malloc(2 * hitsLen * sizeof(Chain*) + 1);
+    int chainsLen = 0;
+
+    for (i = 0; i < dbAlignmentsLen; ++i) {
+        for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+            chains[chainsLen++] = dbAlignmentGetQuery(dbAlignments[i][j]);
+            chains[chainsLen++] = dbAlignmentGetTarget(dbAlignments[i][j]);
+        }
+    }
+
+    qsort(chains, chainsLen, sizeof(Chain*), chainPointerCmp);
+
+    int uniqueLen = 0;
+    for (i = 0; i < chainsLen; ++i) {
+        if (uniqueLen == 0 || chains[uniqueLen - 1] != chains[i]) {
+            chains[uniqueLen++] = chains[i];
+        }
+    }
+
+    chainsLen = uniqueLen;
+
+    // chains are stored in the order of the first use to keep dumps stable
+    int* chainIds = (int*) malloc(chainsLen * sizeof(int) + 1);
+    Chain** orderedChains = (Chain**) malloc(chainsLen * sizeof(Chain*) + 1);
+    int orderedLen = 0;
+
+    for (i = 0; i < chainsLen; ++i) {
+        chainIds[i] = -1;
+    }
+
+    for (i = 0; i < dbAlignmentsLen; ++i) {
+        for (j = 0; j < 2 * dbAlignmentsLens[i]; ++j) {
+
+            Chain* chain = j % 2 == 0 ? 
+                dbAlignmentGetQuery(dbAlignments[i][j / 2]) : 
+                dbAlignmentGetTarget(dbAlignments[i][j / 2]);
+
+            Chain** found = (Chain**) bsearch(&chain, chains, chainsLen, 
+                sizeof(Chain*), chainPointerCmp);
+
+            int idx = found - chains;
+
+            if (chainIds[idx] == -1) {
+                chainIds[idx] = orderedLen;
+                orderedChains[orderedLen++] = chain;
+            }
+        }
+    }
+
+    char** chainsBytes = (char**) malloc(chainsLen * sizeof(char*) + 1);
+    int* chainsBytesLens = (int*) malloc(chainsLen * sizeof(int) + 1);
+    long long* chainOffsets = (long long*) malloc(chainsLen * sizeof(long long) + 1);
+
+    long long chainsBytesLen = 0;
+
+    for (i = 0; i < chainsLen; ++i) {
+        chainSerialize(&(chainsBytes[i]), &(chainsBytesLens[i]), orderedChains[i]);
+        chainOffsets[i] = chainsBytesLen;
+        chainsBytesLen += chainsBytesLens[i];
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // CREATE HIT RECORDS
+
+    long long* hitOffsets = 
+        (long long*) malloc((dbAlignmentsLen + 1) * sizeof(long long));
+
+    DbDumpHit* hits = (DbDumpHit*) malloc(hitsLen * sizeof(DbDumpHit) + 1);
+
+    long long pathsBytesLen = 0;
+    long long hitIdx = 0;
+
+    for (i = 0; i < dbAlignmentsLen; ++i) {
+
+        hitOffsets[i] = hitIdx;
+
+        for (j = 0; j < dbAlignmentsLens[i]; ++j, ++hitIdx) {
+
+            DbAlignment* dbAlignment = dbAlignments[i][j];
+            DbDumpHit* hit = &(hits[hitIdx]);
+
+            Chain* query = dbAlignmentGetQuery(dbAlignment);
+            Chain* target = dbAlignmentGetTarget(dbAlignment);
+
+            Chain** queryChain = (Chain**) bsearch(&query, chains, chainsLen, 
+                sizeof(Chain*), chainPointerCmp);
+            Chain** targetChain = (Chain**) bsearch(&target, chains, chainsLen, 
+                sizeof(Chain*), chainPointerCmp);
+
+            hit->queryChain = chainIds[queryChain - chains];
+            hit->targetChain = chainIds[targetChain - chains];
+            hit->queryIdx = dbAlignmentGetQueryIdx(dbAlignment);
+            hit->targetIdx = dbAlignmentGetTargetIdx(dbAlignment);
+            hit->queryStart = dbAlignmentGetQueryStart(dbAlignment);
+            hit->queryEnd = dbAlignmentGetQueryEnd(dbAlignment);
+            hit->targetStart = dbAlignmentGetTargetStart(dbAlignment);
+            hit->targetEnd = dbAlignmentGetTargetEnd(dbAlignment);
+            hit->score = dbAlignmentGetScore(dbAlignment);
+            hit->pathLen = dbAlignmentGetPathLen(dbAlignment);
+            hit->value = dbAlignmentGetValue(dbAlignment);
+            hit->pathOffset = pathsBytesLen;
+            hit->pathBytesLen = zipDumpPath(NULL, dbAlignment);
+            hit->reserved = 0;
+
+            pathsBytesLen += hit->pathBytesLen;
+        }
+    }
+
+    hitOffsets[dbAlignmentsLen] = hitIdx;
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // WRITE
+
+    char* scorerBytes = NULL;
+    int scorerBytesLen = 0;
+
+    if (scorer != NULL) {
+        scorerSerialize(&scorerBytes, &scorerBytesLen, scorer);
+    }
+
+    DbDumpHeader header;
+    memset(&header, 0, sizeof(DbDumpHeader));
+    memcpy(header.magic, DB_DUMP_MAGIC, sizeof(header.magic));
+    header.version = DB_DUMP_VERSION;
+    header.queriesLen = dbAlignmentsLen;
+    header.chainsLen = chainsLen;
+    header.scorerBytesLen = scorerBytesLen;
+    header.hitsLen = hitsLen;
+    header.chainsBytesLen = chainsBytesLen;
+    header.pathsBytesLen = pathsBytesLen;
+    header.databaseLen = databaseLen;
+    header.databaseCells = databaseCells;
+
+    // queries and the search parameters the alignments were computed with
+    if (queries != NULL) {
+
+        header.searchType = type;
+        header.maxAlignments = maxAlignments;
+        header.maxEValue = maxEValue;
+
+        for (i = 0; i < dbAlignmentsLen; ++i) {
+            header.queriesBytesLen += sizeof(DbDumpQuery) + 
+                strlen(chainGetName(queries[i]));
+        }
+    }
+
+    fwrite(&header, sizeof(DbDumpHeader), 1, file);
+    fwrite(scorerBytes, sizeof(char), scorerBytesLen, file);
+    fwrite(hitOffsets, sizeof(long long), dbAlignmentsLen + 1, file);
+    fwrite(chainOffsets, sizeof(long long), chainsLen, file);
+    fwrite(hits, sizeof(DbDumpHit), hitsLen, file);
+
+    for (i = 0; i < chainsLen; ++i) {
+        fwrite(chainsBytes[i], sizeof(char), chainsBytesLens[i], file);
+        free(chainsBytes[i]);
+    }
+
+    char* pathBytes = NULL;
+    int pathBytesSize = 0;
+
+    for (i = 0; i < dbAlignmentsLen; ++i) {
+        for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+
+            int length = hits[hitOffsets[i] + j].pathBytesLen;
+
+            if (length > pathBytesSize) {
+                pathBytesSize = 2 * length;
+                pathBytes = (char*) realloc(pathBytes, pathBytesSize);
+            }
+
+            zipDumpPath(pathBytes, dbAlignments[i][j]);
+            fwrite(pathBytes, sizeof(char), length, file);
+        }
+    }
+
+    for (i = 0; queries != NULL && i < dbAlignmentsLen; ++i) {
+
+        const char* name = chainGetName(queries[i]);
+
+        DbDumpQuery record;
+        memset(&record, 0, sizeof(DbDumpQuery));
+        record.codesHash = dumpCodesHash(queries[i]);
+        record.codesLen = chainGetLength(queries[i]);
+        record.nameLen = strlen(name);
+
+        fwrite(&record, sizeof(DbDumpQuery), 1, file);
+        fwrite(name, sizeof(char), record.nameLen, file);
+    }
+
+    //**************************************************************************
+
+    free(pathBytes);
+    free(scorerBytes);
+    free(hits);
+    free(hitOffsets);
+    free(chainOffsets);
+    free(chainsBytesLens);
+    free(chainsBytes);
+    free(orderedChains);
+    free(chainIds);
+    free(chains);
+}
+
+static unsigned long long dumpCodesHash(Chain* chain) {
+
+    const char* codes = chainGetCodes(chain);
+    int codesLen = chainGetLength(chain);
+
+    unsigned long long hash = FNV_OFFSET;
+
+    int i;
+    for (i = 0; i < codesLen; ++i) {
+        hash ^= (unsigned char) codes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static int zipDumpPath(char* bytes, DbAlignment* dbAlignment) {
+
+    int runsLen = dbAlignmentGetRunsLen(dbAlignment);
+    int bytesLen = 0;
+
+    int i;
+    for (i = 0; i < runsLen; ++i) {
+
+        char move = dbAlignmentGetRunMove(dbAlignment, i);
+        int n = dbAlignmentGetRunLen(dbAlignment, i);
+
+        // path runs are never longer than the dump runs
+        if (bytes != NULL) {
+            bytes[bytesLen] = (char) ((move << 6) | (n - 1));
+        }
+
+        bytesLen++;
+    }
+
+    return bytesLen;
+}
+
+static void unzipDumpPath(char* path, const char* bytes, int bytesLen) {
+
+    int i;
+    for (i = 0; i < bytesLen; ++i) {
+
+        unsigned char byte = (unsigned char) bytes[i];
+        int n = (byte & (DB_DUMP_RUN - 1)) + 1;
+
+        memset(path, byte >> 6, n);
+        path += n;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// BUFFERED OUTPUT DATABASE
+
+static FormatDatabaseFunction formatDatabaseFunction(int type) {
+    switch (type) {
+    case SW_OUT_DB_BLASTM8:
+        return formatDatabaseBlastM8;
+    case SW_OUT_DB_BLASTM9:
+        return formatDatabaseBlastM9;
+    default:
+        return NULL;
+    }
+}
+
+static void outputShotgunDatabaseBuffered(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, FILE* file, 
+    FormatDatabaseFunction function) {
+
+    FormatContext* contexts = 
+        (FormatContext*) malloc(OUTPUT_TASKS * sizeof(FormatContext));
+
+    ThreadPoolTask** tasks = 
+        (ThreadPoolTask**) malloc(OUTPUT_TASKS * sizeof(ThreadPoolTask*));
+
+    int i;
+    for (i = 0; i < OUTPUT_TASKS; ++i) {
+        bufferCreate(&(contexts[i].buffer));
+    }
+
+    int start = 0;
+
+    while (start < dbAlignmentsLen) {
+
+        int tasksLen = 0;
+
+        // every task gets consecutive queries with enough alignments
+        while (start < dbAlignmentsLen && tasksLen < OUTPUT_TASKS) {
+
+            int end = start;
+            int alignments = 0;
+
+            while (end < dbAlignmentsLen && alignments < OUTPUT_TASK_ALIGNMENTS) {
+                alignments += dbAlignmentsLens[end] + 1;
+                end++;
+            }
+
+            FormatContext* context = &(contexts[tasksLen]);
+            context->buffer.length = 0;
+            context->function = function;
+            context->dbAlignments = dbAlignments + start;
+            context->dbAlignmentsLens = dbAlignmentsLens + start;
+            context->dbAlignmentsLen = end - start;
+
+            tasks[tasksLen] = threadPoolSubmit(formatDatabaseThread, context);
+            tasksLen++;
+
+            start = end;
+        }
+
+        // output in query order
+        for (i = 0; i < tasksLen; ++i) {
+
+            threadPoolTaskWait(tasks[i]);
+            threadPoolTaskDelete(tasks[i]);
+
+            OutputBuffer* buffer = &(contexts[i].buffer);
+            fwrite(buffer->data, 1, buffer->length, file);
+        }
+    }
+
+    for (i = 0; i < OUTPUT_TASKS; ++i) {
+        bufferDelete(&(contexts[i].buffer));
+    }
+
+    free(contexts);
+    free(tasks);
+}
+
+static void* formatDatabaseThread(void* param) {
+
+    FormatContext* context = (FormatContext*) param;
+
+    int i;
+    for (i = 0; i < context->dbAlignmentsLen; ++i) {
+        context->function(&(context->buffer), context->dbAlignments[i], 
+            context->dbAlignmentsLens[i]);
+    }
+
+    return NULL;
+}
+
+static void formatDatabaseBlastM8(OutputBuffer* buffer, 
+    DbAlignment** dbAlignments, int dbAlignmentsLen) {
+
+    int i, j;
+    for (i = 0; i < dbAlignmentsLen; ++i) {
+
+        DbAlignment* dbAlignment = dbAlignments[i];
+
+        Chain* query = dbAlignmentGetQuery(dbAlignment);
+        Chain* target = dbAlignmentGetTarget(dbAlignment);
+
+        int queryStart = dbAlignmentGetQueryStart(dbAlignment);
+        int targetStart = dbAlignmentGetTargetStart(dbAlignment);
+
+        const char* queryCodes = chainGetCodes(query) + queryStart;
+        const char* targetCodes = chainGetCodes(target) + targetStart;
+
+        int length = dbAlignmentGetPathLen(dbAlignment);
         int gapOpenings = 0;
         int gapOpenedQuery = 0;
         int gapOpenedTarget = 0;
         int identity = 0;
         int mismatches = 0;
-        
-        char* queryStr;
-        char* targetStr;
-        Alignment* alignment = dbAlignmentToAlignment(dbAlignments[i]);
-        aligmentStr(&queryStr, &targetStr, alignment, gapItem);
-        alignmentDelete(alignment);
-    
-        for (j = 0; j < length; ++j) {
-            if (queryStr[j] == targetStr[j]) {
-                identity++;
-                gapOpenedQuery = 0;
-                gapOpenedTarget = 0;
-            } else if (queryStr[j] == gapItem) {
-                if (!gapOpenedQuery) {
-                    gapOpenings++;
+
+        int runsLen = dbAlignmentGetRunsLen(dbAlignment);
+
+        // codes decode to distinct letters so they are compared directly,
+        // mismatches do not close an opened gap
+        for (j = 0; j < runsLen; ++j) {
+
+            int run = dbAlignmentGetRunLen(dbAlignment, j);
+            int k;
+
+            switch (dbAlignmentGetRunMove(dbAlignment, j)) {
+            case MOVE_DIAG:
+                for (k = 0; k < run; ++k) {
+                    if (queryCodes[k] == targetCodes[k]) {
+                        identity++;
+                        gapOpenedQuery = 0;
+                        gapOpenedTarget = 0;
+                    } else {
+                        mismatches++;
+                    }
                 }
+                queryCodes += run;
+                targetCodes += run;
+                break;
+            case MOVE_LEFT:
+                gapOpenings += !gapOpenedQuery;
                 gapOpenedQuery = 1;
                 gapOpenedTarget = 0;
-            } else if (targetStr[j] == gapItem) {
-                if (!gapOpenedTarget) {
-                    gapOpenings++;
-                }
+                targetCodes += run;
+                break;
+            case MOVE_UP:
+                gapOpenings += !gapOpenedTarget;
                 gapOpenedQuery = 0;
                 gapOpenedTarget = 1;
-            } else if (queryStr[j] != targetStr[j]) {
-                mismatches++;
+                queryCodes += run;
+                break;
             }
         }
-        
-        free(queryStr);
-        free(targetStr);
-        
-        Chain* query = dbAlignmentGetQuery(dbAlignments[i]);
+
+        // names are copied raw so unlike %.*s the length must not pass the end
         const char* queryName = chainGetName(query);
         const char* queryOff = strchr(queryName, ' ');
-        int queryLen = queryOff == NULL ? 30 : MIN(30, queryOff - queryName);
+        int queryLen = queryOff == NULL ? strlen(queryName) : queryOff - queryName;
+        queryLen = MIN(30, queryLen);
         
-        Chain* target = dbAlignmentGetTarget(dbAlignments[i]);
         const char* targetName = chainGetName(target);
         const char* targetOff = strchr(targetName, ' ');
-        int targetLen = targetOff == NULL ? 30 : MIN(30, targetOff - targetName);
-
-        fprintf(file, "%.*s\t", queryLen, queryName);
-        fprintf(file, "%.*s\t", targetLen, targetName);
-        fprintf(file, "%.2f\t", (100.f * identity) / length);
-        fprintf(file, "%d\t", length);
-        fprintf(file, "%d\t", mismatches);
-        fprintf(file, "%d\t", gapOpenings);
-        fprintf(file, "%d\t", dbAlignmentGetQueryStart(dbAlignments[i]) + 1);
-        fprintf(file, "%d\t", dbAlignmentGetQueryEnd(dbAlignments[i]) + 1);
-        fprintf(file, "%d\t", dbAlignmentGetTargetStart(dbAlignments[i]) + 1);
-        fprintf(file, "%d\t", dbAlignmentGetTargetEnd(dbAlignments[i]) + 1);
-
-        double value = dbAlignmentGetValue(dbAlignments[i]);
+        int targetLen = targetOff == NULL ? strlen(targetName) : targetOff - targetName;
+        targetLen = MIN(30, targetLen);
+
+        bufferPutString(buffer, queryName, queryLen);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutString(buffer, targetName, targetLen);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutFixed(buffer, (100.f * identity) / length);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, length);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, mismatches);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, gapOpenings);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, queryStart + 1);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, dbAlignmentGetQueryEnd(dbAlignment) + 1);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, targetStart + 1);
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, dbAlignmentGetTargetEnd(dbAlignment) + 1);
+        bufferPutString(buffer, "\t", 1);
+
+        double value = dbAlignmentGetValue(dbAlignment);
         if (value > 10e-3 && value < 100) {
-            fprintf(file, "%.2f\t", dbAlignmentGetValue(dbAlignments[i]));
+            bufferPutFixed(buffer, value);
         } else {
-            fprintf(file, "%.2e\t", dbAlignmentGetValue(dbAlignments[i]));
+            bufferPutExponent(buffer, value);
         }
 
-        fprintf(file, "%-d ", dbAlignmentGetScore(dbAlignments[i]));
-        fprintf(file, "\n");
+        bufferPutString(buffer, "\t", 1);
+        bufferPutInt(buffer, dbAlignmentGetScore(dbAlignment));
+        bufferPutString(buffer, " \n", 2);
     }
 }
-    
-static void outputDatabaseBlastM9(DbAlignment** dbAlignments, 
-    int dbAlignmentsLen, FILE* file) {
-    
-    fprintf(file, "# Fields:\n"
-                  "Query id,Subject id,%% identity,alignment length,mismatches,"
-                  "gap openings,q. start,q. end,s. start,s. end,e-value,score\n");
+
+static void formatDatabaseBlastM9(OutputBuffer* buffer, 
+    DbAlignment** dbAlignments, int dbAlignmentsLen) {
+
+    static const char header[] = "# Fields:\n"
+        "Query id,Subject id,% identity,alignment length,mismatches,"
+        "gap openings,q. start,q. end,s. start,s. end,e-value,score\n";
+
+    bufferPutString(buffer, header, sizeof(header) - 1);
               
-    outputDatabaseBlastM8(dbAlignments, dbAlignmentsLen, file);
+    formatDatabaseBlastM8(buffer, dbAlignments, dbAlignmentsLen);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// OUTPUT BUFFER
+
+static void bufferCreate(OutputBuffer* buffer) {
+    buffer->data = (char*) malloc(OUTPUT_BUFFER_SIZE);
+    buffer->length = 0;
+    buffer->size = OUTPUT_BUFFER_SIZE;
+}
+
+static void bufferDelete(OutputBuffer* buffer) {
+    free(buffer->data);
+}
+
+static void bufferReserve(OutputBuffer* buffer, size_t length) {
+
+    if (buffer->length + length <= buffer->size) {
+        return;
+    }
+
+    while (buffer->length + length > buffer->size) {
+        buffer->size *= 2;
+    }
+
+    buffer->data = (char*) realloc(buffer->data, buffer->size);
+}
+
+static void bufferPutString(OutputBuffer* buffer, const char* str, int length) {
+    bufferReserve(buffer, length);
+    memcpy(buffer->data + buffer->length, str, length);
+    buffer->length += length;
+}
+
+static void bufferPutInt(OutputBuffer* buffer, int x) {
+
+    char digits[16];
+    int length = 0;
+
+    bufferReserve(buffer, 12);
+
+    unsigned int y = x;
+
+    if (x < 0) {
+        buffer->data[buffer->length++] = '-';
+        y = -y;
+    }
+
+    do {
+        digits[length++] = '0' + y % 10;
+        y /= 10;
+    } while (y != 0);
+
+    while (length > 0) {
+        buffer->data[buffer->length++] = digits[--length];
+    }
+}
+
+// equivalent to "%.2f", values whose rounding can not be decided from the
+// scaled double are left to printf
+static void bufferPutFixed(OutputBuffer* buffer, double x) {
+
+    double scaled = x * 100;
+
+    if (!(x >= 0 && scaled < 2e9) || 
+        fabs(scaled - floor(scaled) - 0.5) < 1e-6) {
+        
+        bufferReserve(buffer, 512);
+        buffer->length += sprintf(buffer->data + buffer->length, "%.2f", x);
+
+        return;
+    }
+
+    int rounded = (int) rint(scaled);
+
+    bufferPutInt(buffer, rounded / 100);
+
+    bufferReserve(buffer, 3);
+    buffer->data[buffer->length++] = '.';
+    buffer->data[buffer->length++] = '0' + (rounded / 10) % 10;
+    buffer->data[buffer->length++] = '0' + rounded % 10;
+}
+
+// equivalent to "%.2e", same as above for the undecidable values
+static void bufferPutExponent(OutputBuffer* buffer, double x) {
+
+    int exponent = 0;
+    double scaled = 0;
+
+    if (x > 1e-300 && x < 1e300) {
+
+        exponent = (int) floor(log10(x));
+
+        scaled = x * pow(10, 2 - exponent);
+
+        if (scaled < 100) {
+            exponent--;
+            scaled = x * pow(10, 2 - exponent);
+        } else if (scaled >= 1000) {
+            exponent++;
+            scaled = x * pow(10, 2 - exponent);
+        }
+    }
+
+    if (!(x == 0 || (scaled >= 100 && scaled < 1000)) ||
+        fabs(scaled - floor(scaled) - 0.5) < 1e-6) {
+
+        bufferReserve(buffer, 32);
+        buffer->length += sprintf(buffer->data + buffer->length, "%.2e", x);
+
+        return;
+    }
+
+    int rounded = (int) rint(scaled);
+
+    if (rounded == 1000) {
+        rounded = 100;
+        exponent++;
+    }
+
+    bufferReserve(buffer, 8);
+
+    buffer->data[buffer->length++] = '0' + rounded / 100;
+    buffer->data[buffer->length++] = '.';
+    buffer->data[buffer->length++] = '0' + (rounded / 10) % 10;
+    buffer->data[buffer->length++] = '0' + rounded % 10;
+    buffer->data[buffer->length++] = 'e';
+    buffer->data[buffer->length++] = exponent < 0 ? '-' : '+';
+
+    if (exponent < 0) {
+        exponent = -exponent;
+    }
+
+    if (exponent < 10) {
+        buffer->data[buffer->length++] = '0';
+    }
+
+    bufferPutInt(buffer, exponent);
 }
 
 //------------------------------------------------------------------------------
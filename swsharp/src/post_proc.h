@@ -105,6 +105,17 @@ Format outputs only the scores and the names of the output alignments.
 */
 #define SW_OUT_DB_LIGHT     3
 
+/*!
+@brief Database alignment binary output format.
+
+Format is a compact binary dump of the database alignments which can be read
+with the readShotgunDatabase() function and rendered to any other database
+output format. It consists of a header, a per query table of hit offsets, fixed
+size hit records, the used chains, the run-length compressed paths and the
+optional search record of the queries.
+*/
+#define SW_OUT_DB_DUMP      4
+
 /*!
 @brief Checks if the alignment is correct.
 
@@ -126,6 +137,67 @@ with the #SW_OUT_DUMP type.
 */
 extern Alignment* readAlignment(char* path);
 
+/*!
+@brief Reads the database alignments from the binary file.
+
+The binary file must previously be created with the outputShotgunDatabase() or
+the outputDatabase() function with the #SW_OUT_DB_DUMP type. File is memory 
+mapped and only the alignments of the requested queries are created, together 
+with the chains they use. Chains and scorer are owned by the caller, chains 
+array should be deleted with the deleteFastaChains() function and scorer with
+the scorerDelete() function.
+
+@param dbAlignments output database alignments array of arrays, one array for
+    every requested query
+@param dbAlignmentsLens output database alignments arrays lengths
+@param dbAlignmentsLen output database alignments array of arrays length
+@param chains output array of chains used by the alignments, unused are NULL
+@param chainsLen output chains array length
+@param scorer output scorer object used for the alignments, NULL if the file
+    contains no alignments
+@param path input binary file path
+@param indexes indexes of the queries to read, if NULL all queries are read
+@param indexesLen indexes array length
+*/
+extern void readShotgunDatabase(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, int* dbAlignmentsLen, Chain*** chains, 
+    int* chainsLen, Scorer** scorer, char* path, int* indexes, int indexesLen);
+
+/*!
+@brief Reads the database generation of the database alignments binary file.
+
+Generation is the number of database chains and their residues the alignments 
+were computed against, see outputShotgunDatabaseGeneration(). Both are 0 if the
+file was created without the generation.
+
+@param databaseLen output number of searched database chains
+@param databaseCells output number of searched database residues
+@param path input binary file path
+*/
+extern void readShotgunDatabaseGeneration(int* databaseLen, 
+    long long* databaseCells, char* path);
+
+/*!
+@brief Checks if the database alignments binary file belongs to the search.
+
+Files written by outputShotgunDatabaseGeneration() record the name and a hash 
+of the residues of every query, the aligning type, the maximal number of 
+alignments per query and the maximal value. Stored alignments can be continued
+only by the search with the same queries in the same order and the same 
+parameters.
+
+@param path input binary file path
+@param queries query chains array
+@param queriesLen query chains array length
+@param type aligning type
+@param maxAlignments maximal number of alignments per query
+@param maxEValue maximal value of the alignments
+
+@return 1 if the file has the search record matching the arguments, 0 otherwise
+*/
+extern int checkShotgunDatabaseSearch(char* path, Chain** queries, 
+    int queriesLen, int type, int maxAlignments, double maxEValue);
+
 /*!
 @brief Pairwise alignment output function.
 
@@ -155,7 +227,7 @@ extern void outputScore(int score, Chain* query, Chain* target, Scorer* scorer,
 @param dbAlignmentsLen database alignments array length
 @param path output file path, if NULL output goes to standard output
 @param type output format type, can be #SW_OUT_DB_BLASTM0 , #SW_OUT_DB_BLASTM8,
-    #SW_OUT_DB_BLASTM9 or #SW_OUT_DB_LIGHT
+    #SW_OUT_DB_BLASTM9, #SW_OUT_DB_LIGHT or #SW_OUT_DB_DUMP
 */
 extern void outputDatabase(DbAlignment** dbAlignments, int dbAlignmentsLen, 
     char* path, int type);
@@ -168,10 +240,52 @@ extern void outputDatabase(DbAlignment** dbAlignments, int dbAlignmentsLen,
 @param dbAlignmentsLen database alignments array of arrays length
 @param path output file path, if NULL output goes to standard output
 @param type output format type, can be #SW_OUT_DB_BLASTM0 , #SW_OUT_DB_BLASTM8,
-    #SW_OUT_DB_BLASTM9 or #SW_OUT_DB_LIGHT
+    #SW_OUT_DB_BLASTM9, #SW_OUT_DB_LIGHT or #SW_OUT_DB_DUMP
 */
 extern void outputShotgunDatabase(DbAlignment*** dbAlignments, 
     int* dbAlignmentsLens, int dbAlignmentsLen, char* path, int type);
+
+/*!
+@brief Shotgun database alignment output function for an opened file.
+
+Works as the outputShotgunDatabase() function but writes to the given file, 
+which is not closed. Used when the output does not go to a path, for example 
+to a memory stream or a socket.
+
+@param dbAlignments database alignments array of arrays
+@param dbAlignmentsLens database alignments arrays lengths
+@param dbAlignmentsLen database alignments array of arrays length
+@param file output file opened for writing
+@param type output format type, can be #SW_OUT_DB_BLASTM0 , #SW_OUT_DB_BLASTM8,
+    #SW_OUT_DB_BLASTM9, #SW_OUT_DB_LIGHT or #SW_OUT_DB_DUMP
+*/
+extern void outputShotgunDatabaseFile(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, FILE* file, int type);
+
+/*!
+@brief Shotgun database alignment binary output function with the generation.
+
+Works as the outputShotgunDatabase() function with the #SW_OUT_DB_DUMP type but
+also records the database generation the alignments were computed against, so
+the search can later continue only over the chains appended to the database. 
+If the queries are given, the search record checked with 
+checkShotgunDatabaseSearch() is stored as well.
+
+@param dbAlignments database alignments array of arrays
+@param dbAlignmentsLens database alignments arrays lengths
+@param dbAlignmentsLen database alignments array of arrays length
+@param path output file path, if NULL output goes to standard output
+@param databaseLen number of searched database chains
+@param databaseCells number of searched database residues
+@param queries query chains of the alignments arrays, can be NULL
+@param type aligning type
+@param maxAlignments maximal number of alignments per query
+@param maxEValue maximal value of the alignments
+*/
+extern void outputShotgunDatabaseGeneration(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, int dbAlignmentsLen, char* path, int databaseLen, 
+    long long databaseCells, Chain** queries, int type, int maxAlignments, 
+    double maxEValue);
     
 /*!
 @brief Chain array delete utility.
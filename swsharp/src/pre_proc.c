@@ -24,6 +24,13 @@ Contact the author by mkorpar@gmail.com.
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
 #include "chain.h"
 #include "constants.h"
 #include "error.h"
@@ -34,6 +41,18 @@ Contact the author by mkorpar@gmail.com.
 
 #define SCORERS_LEN (sizeof(scorers) / sizeof(ScorerEntry))
 
+// bytes hashed at each end of the file part a generation was made from
+#define GENERATION_HASH_BYTES (64 * 1024)
+
+// one generation of an append only database, bytes is the fasta file size and
+// hash identifies its content, see fastaPrefixHash
+typedef struct FastaGeneration {
+    long long bytes;
+    long long cells;
+    int chains;
+    unsigned int hash;
+} FastaGeneration;
+
 typedef struct ScorerEntry {
     const char* name;
     int (*table)[26 * 26];
@@ -62,11 +81,30 @@ static ScorerEntry scorers[] = {
 
 static char* fastaChainsSerializedPath(const char* path);
 
+static char* fastaChainsGenerationsPath(const char* path);
+
+static char* temporaryPath(const char* path);
+
+static void replaceFile(const char* tmpPath, const char* path);
+
+static unsigned int fastaPrefixHash(FILE* handle, long long bytes);
+
+static FastaGeneration* readFastaGenerations(int* generationsLen, 
+    const char* path);
+
+static void writeFastaGenerations(FastaGeneration* generations, 
+    int generationsLen, const char* path);
+
+static void dumpFastaChainsPart(int* length, long long* cells, FILE* file, 
+    FILE* handle, int serialized);
+
+static int appendFastaChains(const char* path, const char* serializedPath);
+
 static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
-    FILE* handle, const size_t maxBytes);
+    FILE* handle, const size_t maxBytes, int lazy);
 
 static int readFastaChainsPartSerialized(Chain*** chains, int* chainsLen,
-    FILE* handle, const size_t maxBytes);
+    FILE* handle, const size_t maxBytes, int lazy);
 
 static int skipFastaChainsPartNormal(Chain*** chains, int* chainsLen,
     FILE* handle, const size_t skip);
@@ -220,9 +258,31 @@ extern int readFastaChainsPart(Chain*** chains, int* chainsLen,
     int status;
 
     if (serialized) {
-        status = readFastaChainsPartSerialized(chains, chainsLen, handle, maxBytes);
+        status = readFastaChainsPartSerialized(chains, chainsLen, handle, 
+            maxBytes, 0);
+    } else {
+        status = readFastaChainsPartNormal(chains, chainsLen, handle, 
+            maxBytes, 0);
+    }
+
+    TIMER_STOP;
+
+    return status;
+}
+
+extern int readFastaChainsPartLazy(Chain*** chains, int* chainsLen,
+    FILE* handle, int serialized, const size_t maxBytes) {
+
+    TIMER_START("Reading database lazily (serialized %d)", serialized);
+
+    int status;
+
+    if (serialized) {
+        status = readFastaChainsPartSerialized(chains, chainsLen, handle, 
+            maxBytes, 1);
     } else {
-        status = readFastaChainsPartNormal(chains, chainsLen, handle, maxBytes);
+        status = readFastaChainsPartNormal(chains, chainsLen, handle, 
+            maxBytes, 1);
     }
 
     TIMER_STOP;
@@ -306,71 +366,91 @@ extern void statFastaChains(int* chains_, long long* cells_, const char* path_)
     if (cells_ != NULL) *cells_ = cells;
 }
 
-extern void dumpFastaChains(char* path_) {
+extern void statFastaChainsGenerations(int** chainsLens, long long** cells, 
+    int* generationsLen, const char* path) {
 
-    static const size_t readChunk = 200 * 1024 * 1024; // 200MB
+    int len;
+    FastaGeneration* generations = readFastaGenerations(&len, path);
+
+    if (generations == NULL) {
+
+        len = 1;
+        generations = (FastaGeneration*) calloc(1, sizeof(FastaGeneration));
+
+        statFastaChains(&(generations[0].chains), &(generations[0].cells), path);
+    }
+
+    *chainsLens = (int*) malloc(len * sizeof(int));
+    *cells = (long long*) malloc(len * sizeof(long long));
+    *generationsLen = len;
+
+    int i;
+    for (i = 0; i < len; ++i) {
+        (*chainsLens)[i] = generations[i].chains;
+        (*cells)[i] = generations[i].cells;
+    }
+
+    free(generations);
+}
+
+extern void dumpFastaChains(char* path_) {
 
     char* path = fastaChainsSerializedPath(path_);
     FILE* file = fopen(path, "r");
 
     if (file != NULL) {
-        WARNING(1, "File %s exists, chains are not dumped.", path);
-    } else {
 
-        Chain** chains;
-        int chainsStart = 0;
-        int chainsLen;
+        fclose(file);
 
-        FILE* handle;
-        int serialized;
+        if (appendFastaChains(path_, path)) {
+            free(path);
+            return;
+        }
 
-        readFastaChainsPartInit(&chains, &chainsLen, &handle, &serialized, path_);
+        // file was not only appended to, stale dump is not read while rebuilt
+        WARNING(1, "File %s changed, serialized database is rebuilt.", path_);
+        remove(path);
+    }
 
-        int length;
-        long long cells;
-        statFastaChains(&length, &cells, path_);
+    Chain** chains;
+    int chainsLen;
 
-        file = fileSafeOpen(path, "w");
+    FILE* handle;
+    int serialized;
 
-        fwrite(&length, sizeof(int), 1, file);
-        fwrite(&cells, sizeof(long long), 1, file);
+    readFastaChainsPartInit(&chains, &chainsLen, &handle, &serialized, path_);
 
-        LOG("Dumping chains to: %s", path);
+    int length;
+    long long cells;
+    statFastaChains(&length, &cells, path_);
 
-        while (1) {
+    // dump is written to a temporary file first, readers never see a part
+    char* tmpPath = temporaryPath(path);
+    file = fileSafeOpen(tmpPath, "wb");
 
-            int status = readFastaChainsPart(&chains, &chainsLen, handle, 
-                serialized, readChunk);
+    fwrite(&length, sizeof(int), 1, file);
+    fwrite(&cells, sizeof(long long), 1, file);
 
-            int chainIdx;
-            for (chainIdx = chainsStart; chainIdx < chainsLen; ++chainIdx) {
-            
-                Chain* chain = chains[chainIdx];
-                
-                char* buffer;
-                int bufferLen;
-                chainSerialize(&buffer, &bufferLen, chain);
-                
-                fwrite(&bufferLen, sizeof(int), 1, file);
-                fwrite(buffer, sizeof(char), bufferLen, file);
-                
-                free(buffer);
-                chainDelete(chain);
-            }
+    LOG("Dumping chains to: %s", path);
 
-            if (status == 0) {
-                break;
-            }
+    dumpFastaChainsPart(NULL, NULL, file, handle, serialized);
 
-            chainsStart = chainsLen;
-        }
+    fclose(file);
+    replaceFile(tmpPath, path);
 
-        free(chains);
-        fclose(handle);
-    }
+    FastaGeneration generation;
+    memset(&generation, 0, sizeof(FastaGeneration));
+    generation.bytes = fileLength(handle);
+    generation.cells = cells;
+    generation.chains = length;
+    generation.hash = fastaPrefixHash(handle, generation.bytes);
 
+    writeFastaGenerations(&generation, 1, path_);
+
+    fclose(handle);
+
+    free(tmpPath);
     free(path);
-    fclose(file);
 }
 
 //------------------------------------------------------------------------------
@@ -434,8 +514,262 @@ static char* fastaChainsSerializedPath(const char* path_) {
     return path;
 }
 
+static char* fastaChainsGenerationsPath(const char* path_) {
+
+    static const char ext[] = ".swsharp.gen";
+
+    char* path = (char*) malloc(strlen(path_) + sizeof(ext) + 1);
+    sprintf(path, "%s%s", path_, ext);
+
+    return path;
+}
+
+static FastaGeneration* readFastaGenerations(int* generationsLen, 
+    const char* path_) {
+
+    char* path = fastaChainsGenerationsPath(path_);
+    FILE* file = fopen(path, "rb");
+
+    free(path);
+
+    if (file == NULL) {
+        *generationsLen = 0;
+        return NULL;
+    }
+
+    int len;
+    ASSERT(fread(&len, sizeof(int), 1, file) == 1 && len > 0, "io error");
+
+    FastaGeneration* generations = 
+        (FastaGeneration*) malloc(len * sizeof(FastaGeneration));
+
+    ASSERT(fread(generations, sizeof(FastaGeneration), len, file) == len, 
+        "io error");
+
+    fclose(file);
+
+    *generationsLen = len;
+
+    return generations;
+}
+
+static void writeFastaGenerations(FastaGeneration* generations, 
+    int generationsLen, const char* path_) {
+
+    char* path = fastaChainsGenerationsPath(path_);
+    char* tmpPath = temporaryPath(path);
+
+    FILE* file = fileSafeOpen(tmpPath, "wb");
+
+    fwrite(&generationsLen, sizeof(int), 1, file);
+    fwrite(generations, sizeof(FastaGeneration), generationsLen, file);
+
+    fclose(file);
+    replaceFile(tmpPath, path);
+
+    free(tmpPath);
+    free(path);
+}
+
+static char* temporaryPath(const char* path) {
+
+    char* tmpPath = (char*) malloc(strlen(path) + 32);
+    sprintf(tmpPath, "%s.%d.tmp", path, (int) getpid());
+
+    return tmpPath;
+}
+
+static void replaceFile(const char* tmpPath, const char* path) {
+#ifdef _WIN32
+    remove(path);
+#endif
+    ASSERT(rename(tmpPath, path) == 0, "cannot replace %s", path);
+}
+
+static unsigned int fastaPrefixHash(FILE* handle, long long bytes) {
+
+    // FNV-1a of both ends of the first bytes of the file, a replaced file is
+    // detected without reading all of it
+    unsigned int hash = 2166136261u;
+
+    char* buffer = (char*) malloc(GENERATION_HASH_BYTES);
+
+    long long starts[2] = { 0, bytes - GENERATION_HASH_BYTES };
+
+    int i;
+    for (i = 0; i < 2; ++i) {
+
+        long long start = MAX(starts[i], 0);
+        int length = (int) MIN(bytes - start, GENERATION_HASH_BYTES);
+
+        fseek(handle, start, SEEK_SET);
+        ASSERT(fread(buffer, 1, length, handle) == length, "io error");
+
+        int j;
+        for (j = 0; j < length; ++j) {
+            hash = (hash ^ (unsigned char) buffer[j]) * 16777619u;
+        }
+    }
+
+    free(buffer);
+
+    fseek(handle, 0L, SEEK_SET);
+
+    return hash;
+}
+
+static void dumpFastaChainsPart(int* length, long long* cells, FILE* file, 
+    FILE* handle, int serialized) {
+
+    static const size_t readChunk = 200 * 1024 * 1024; // 200MB
+
+    Chain** chains = NULL;
+    int chainsStart = 0;
+    int chainsLen = 0;
+
+    int length_ = 0;
+    long long cells_ = 0;
+
+    while (1) {
+
+        int status = readFastaChainsPart(&chains, &chainsLen, handle, 
+            serialized, readChunk);
+
+        int chainIdx;
+        for (chainIdx = chainsStart; chainIdx < chainsLen; ++chainIdx) {
+        
+            Chain* chain = chains[chainIdx];
+            
+            char* buffer;
+            int bufferLen;
+            chainSerialize(&buffer, &bufferLen, chain);
+            
+            fwrite(&bufferLen, sizeof(int), 1, file);
+            fwrite(buffer, sizeof(char), bufferLen, file);
+
+            length_++;
+            cells_ += chainGetLength(chain);
+            
+            free(buffer);
+            chainDelete(chain);
+        }
+
+        if (status == 0) {
+            break;
+        }
+
+        chainsStart = chainsLen;
+    }
+
+    free(chains);
+
+    if (length != NULL) *length = length_;
+    if (cells != NULL) *cells = cells_;
+}
+
+static int appendFastaChains(const char* path, const char* serializedPath) {
+
+    int generationsLen;
+    FastaGeneration* generations = readFastaGenerations(&generationsLen, path);
+
+    FILE* handle = fileSafeOpen(path, "r");
+    long long bytes = fileLength(handle);
+
+    // dumps older than the generations are taken as up to date
+    if (generations == NULL) {
+
+        generationsLen = 1;
+        generations = (FastaGeneration*) calloc(1, sizeof(FastaGeneration));
+        generations[0].bytes = bytes;
+        generations[0].hash = fastaPrefixHash(handle, bytes);
+
+        statFastaChains(&(generations[0].chains), &(generations[0].cells), path);
+        writeFastaGenerations(generations, generationsLen, path);
+    }
+
+    FastaGeneration* last = &(generations[generationsLen - 1]);
+
+    FILE* file = fileSafeOpen(serializedPath, "rb");
+
+    int dumpChains;
+    ASSERT(fread(&dumpChains, sizeof(int), 1, file) == 1, "io error");
+
+    // the dumped part has to be unchanged and end on a record boundary
+    int valid = bytes >= last->bytes && dumpChains == last->chains &&
+        fastaPrefixHash(handle, last->bytes) == last->hash;
+
+    if (valid && bytes > last->bytes && last->bytes > 0) {
+
+        char boundary[2];
+        fseek(handle, last->bytes - 1, SEEK_SET);
+
+        valid = fread(boundary, 1, 2, handle) == 2 && 
+            boundary[0] == '\n' && boundary[1] == '>';
+    }
+
+    if (!valid || bytes == last->bytes) {
+        fclose(file);
+        fclose(handle);
+        free(generations);
+        return valid;
+    }
+
+    // appended to a copy which replaces the dump, readers never see a part
+    char* tmpPath = temporaryPath(serializedPath);
+    FILE* tmpFile = fileSafeOpen(tmpPath, "wb");
+
+    char* buffer = (char*) malloc(1024 * 1024);
+
+    fseek(file, 0L, SEEK_SET);
+
+    size_t read;
+    while ((read = fread(buffer, 1, 1024 * 1024, file)) > 0) {
+        ASSERT(fwrite(buffer, 1, read, tmpFile) == read, "io error");
+    }
+
+    free(buffer);
+    fclose(file);
+
+    file = tmpFile;
+
+    // append only growth, new chains start where the last generation ended
+    fseek(handle, last->bytes, SEEK_SET);
+
+    LOG("Appending chains to: %s", serializedPath);
+
+    int length;
+    long long cells;
+    dumpFastaChainsPart(&length, &cells, file, handle, 0);
+
+    generations = (FastaGeneration*) realloc(generations, 
+        (generationsLen + 1) * sizeof(FastaGeneration));
+
+    FastaGeneration* generation = &(generations[generationsLen]);
+    memset(generation, 0, sizeof(FastaGeneration));
+    generation->bytes = bytes;
+    generation->cells = generations[generationsLen - 1].cells + cells;
+    generation->chains = generations[generationsLen - 1].chains + length;
+    generation->hash = fastaPrefixHash(handle, bytes);
+
+    fseek(file, 0L, SEEK_SET);
+    fwrite(&(generation->chains), sizeof(int), 1, file);
+    fwrite(&(generation->cells), sizeof(long long), 1, file);
+
+    fclose(file);
+    fclose(handle);
+
+    replaceFile(tmpPath, serializedPath);
+
+    writeFastaGenerations(generations, generationsLen + 1, path);
+
+    free(tmpPath);
+    free(generations);
+
+    return 1;
+}
+
 static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
-    FILE* handle, const size_t maxBytes) {
+    FILE* handle, const size_t maxBytes, int lazy) {
 
     static const int chainsStep = 100000;
 
@@ -461,6 +795,13 @@ static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
     char buffer[1024 * 1024];
     int isName = 1;
 
+    // every part is constructed in its own arena
+    ChainArena* arena = lazy ? chainArenaCreateLazy(handle) : chainArenaCreate();
+
+    // lazy names are located by their offset in the file
+    long long nameOffset = 0;
+    int nameBytes = 0;
+
     size_t bytesRead = 0;
     long int bytesOver = 0;
     int status = 0;
@@ -468,6 +809,8 @@ static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
     int isEnd = feof(handle);
 
     while (!isEnd) {
+
+        long long bufferOffset = ftell(handle);
         
         int read = fread(buffer, sizeof(char), 1024 * 1024, handle);
         isEnd = feof(handle);
@@ -491,7 +834,15 @@ static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
 
                 isName = 1;
                 
-                Chain* chain = chainCreate(name, nameLen, str, strLen);
+                Chain* chain;
+
+                if (lazy) {
+                    chain = chainArenaCreateLazyChain(arena, nameOffset, 
+                        nameBytes, str, strLen);
+                } else {
+                    chain = chainArenaCreateChain(arena, name, nameLen, str, 
+                        strLen);
+                }
                 
                 if (*chainsLen + 1 == chainsSize) {
                     chainsSize += chainsStep;
@@ -508,16 +859,22 @@ static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
                 if (c == '\n') {
                     name[nameLen] = 0;
                     isName = 0;
+                    nameBytes = nameLen == 0 ? 0 : 
+                        (int) (bufferOffset + i - nameOffset);
                 } else if (!(nameLen == 0 && (c == '>' || isspace(c)))) {
                     if (c != '\r') {
 
+                        if (nameLen == 0) {
+                            nameOffset = bufferOffset + i;
+                        }
+
                         if (nameLen == nameSize) {
                             nameSize *= 2;
                             name = (char*) realloc(name, nameSize * sizeof(char));
                         }
 
                         name[nameLen++] = c;
-                    }              
+                    }
                 }
             } else {
                 if (strLen == strSize) {
@@ -534,11 +891,13 @@ static int readFastaChainsPartNormal(Chain*** chains, int* chainsLen,
     free(str);
     free(name);
 
+    chainArenaDelete(arena);
+
     return status;
 }
 
 static int readFastaChainsPartSerialized(Chain*** chains, int* chainsLen,
-    FILE* handle, const size_t maxBytes) {
+    FILE* handle, const size_t maxBytes, int lazy) {
 
     if (feof(handle)) {
         return 0;
@@ -564,6 +923,11 @@ static int readFastaChainsPartSerialized(Chain*** chains, int* chainsLen,
     size_t bytesRead = 0;
     int status = 0;
 
+    // every part is constructed in its own arena
+    ChainArena* arena = lazy ? chainArenaCreateLazy(handle) : chainArenaCreate();
+
+    long long offset = ftell(handle);
+
     while (!feof(handle)) {
 
         if (fread(&chainSize, sizeof(int), 1, handle) != 1) {
@@ -578,6 +942,8 @@ static int readFastaChainsPartSerialized(Chain*** chains, int* chainsLen,
             break;
         }
 
+        offset += sizeof(int);
+
         if (chainSize > bufferSize) {
             bufferSize = 2 * chainSize;
             buffer = (char*) realloc(buffer, bufferSize);
@@ -585,12 +951,23 @@ static int readFastaChainsPartSerialized(Chain*** chains, int* chainsLen,
         
         ASSERT(fread(buffer, 1, chainSize, handle) == chainSize, "io error");
 
-        Chain* chain = chainDeserialize(buffer);
+        Chain* chain;
+
+        if (lazy) {
+            chain = chainArenaDeserializeLazyChain(arena, buffer, offset);
+        } else {
+            chain = chainArenaDeserializeChain(arena, buffer);
+        }
+
         (*chains)[(*chainsLen)++] = chain;
+
+        offset += chainSize;
     }
     
     free(buffer);
 
+    chainArenaDelete(arena);
+
     return status;
 }
 
@@ -657,6 +1034,12 @@ static int skipFastaChainsPartNormal(Chain*** chains, int* chainsLen,
 
             bytesOver++;
         }
+
+        // last block is read, loop wont come around to return the overhead
+        if (chainsRead >= skip && isEnd) {
+            fseek(handle, -bytesOver, SEEK_CUR);
+            status = 1;
+        }
     }
 
     int chainIdx;
@@ -79,11 +79,47 @@ extern void readFastaChainsPartInit(Chain*** chains, int* chainsLen,
 extern int readFastaChainsPart(Chain*** chains, int* chainsLen,
     FILE* handle, int serialized, const size_t maxBytes);
 
+/*!
+@brief Fasta chain part reading function with lazily read names.
+
+Function works in the same way as the readFastaChainsPart() but chain names are
+not held in memory, they are read from the handle file when first requested.
+Handle can be closed before the chains are deleted.
+
+@param chains output chain array object
+@param chainsLen output chain array length
+@param handle file handle from readFastaChainsPartInit()
+@param serialized bool from readFastaChainsPartInit()
+@param maxBytes maximal number of bytes read, 0 for no limit
+
+@return 1 if there are more chains in the file, 0 otherwise
+*/
+extern int readFastaChainsPartLazy(Chain*** chains, int* chainsLen,
+    FILE* handle, int serialized, const size_t maxBytes);
+
 extern int skipFastaChainsPart(Chain*** chains, int* chainsLen,
     FILE* handle, int serialized, const size_t skip);
 
 extern void statFastaChains(int* chains, long long* cells, const char* path);
 
+/*!
+@brief Fasta database generations reading function.
+
+Databases which grow only by appending new chains to the end of the file are
+updated by the dumpFastaChains() function, every update records a new 
+generation. Generation i consists of the first chainsLens[i] chains of the 
+database with cells[i] residues in total. Databases without the recorded 
+generations have only one generation holding all the chains. Arrays are owned
+by the caller.
+
+@param chainsLens output number of chains of every generation
+@param cells output number of residues of every generation
+@param generationsLen output generations arrays length
+@param path original Fasta chain database file path
+*/
+extern void statFastaChainsGenerations(int** chainsLens, long long** cells, 
+    int* generationsLen, const char* path);
+
 /*!
 @brief Fasta database serialization function.
 
@@ -91,6 +127,11 @@ Function creates a file named path.swsharp which represents the serialized
 version of the chain database which was read from the given path. Since reading 
 of the serialized version of the database is much faster than reading the 
 original one, this function is used for caching the databases for future usage.
+If the serialized version already exists and the original file has grown since,
+chains appended to the original file are appended to the serialized version
+and a new generation is recorded in path.swsharp.gen, see 
+statFastaChainsGenerations(). If the original file was changed in any other way
+the serialized version is rebuilt.
 
 @param path original Fasta chain database file path
 */
@@ -33,13 +33,13 @@ Contact the author by mkorpar@gmail.com.
 #include "scorer.h"
 #include "thread.h"
 #include "threadpool.h"
+#include "tune.h"
 #include "utils.h"
 
 #include "reconstruct.h"
 
 #define MIN_DUAL_LEN        20000
 #define MIN_BLOCK_SIZE      256 // > MINIMAL THREADS IN LINEAR_DATA * 2 !!!!
-#define MAX_BLOCK_CELLS     5000000.0
 
 typedef struct Context {
     char** path;
@@ -320,7 +320,7 @@ static void* hirschberg(void* param) {
     double cells = (double) (2 * p + abs(rows - cols) + 1) * cols;
     
     if (rows < MIN_BLOCK_SIZE || cols < MIN_BLOCK_SIZE || 
-        cells < MAX_BLOCK_CELLS || cardsLen == 0) {
+        cells < tuneGet(TUNE_RECONSTRUCT_CELLS) || cardsLen == 0) {
         
         chainDelete(rowSubchain);
         chainDelete(colSubchain);
@@ -49,6 +49,14 @@ static int sswDatabaseWrapper(int* scores, int type, Chain* query,
 static int swimdWrapper(int* scores, int type, Chain* query, Chain** database, 
     int databaseLen, Scorer* scorer, int solveChar);
 
+static void queryFirstAlphabet(int** table, unsigned char** codes, 
+    Chain** queries, int queriesLen, Scorer* scorer);
+
+static int denseAlphabet(int8_t** matrix, unsigned char* map, Chain** chains, 
+    int chainsLen, Scorer* scorer);
+
+static int8_t* denseCodes(const unsigned char* map, Chain* chain);
+
 //******************************************************************************
 
 //******************************************************************************
@@ -146,6 +154,105 @@ extern int scorePairSse(int* score, int type, Chain* query, Chain* target,
     return 0;
 }
 
+extern int scorePairDualSse(int* score, int* score2, int type, Chain* query, 
+    Chain* query2, Chain* target, Scorer* scorer) {
+
+    int queryLen = chainGetLength(query);
+    int targetLen = chainGetLength(target);
+
+    if (type != SW_ALIGN || chainGetLength(query2) != queryLen) {
+        return -1;
+    }
+
+    int gapOpen = scorerGetGapOpen(scorer);
+    int gapExtend = scorerGetGapExtend(scorer);
+
+    if (abs(gapOpen) > 127 || abs(gapExtend) > 127) {
+        return -1;
+    }
+
+    Chain* chains[] = { query, query2, target };
+
+    int8_t* mat;
+    unsigned char map[256];
+
+    const int32_t n = denseAlphabet(&mat, map, chains, 3, scorer);
+
+    if (n == -1) {
+        return -1;
+    }
+
+    int8_t* read = denseCodes(map, query);
+    int8_t* read2 = denseCodes(map, query2);
+    int8_t* ref = denseCodes(map, target);
+
+    uint16_t scores[2];
+    ssw_score_dual(read, read2, queryLen, ref, targetLen, mat, n, 
+        (uint8_t) gapOpen, (uint8_t) gapExtend, scores);
+
+    // overflowed scores are set to -1
+    *score = scores[0] == 255 ? -1 : scores[0];
+    *score2 = scores[1] == 255 ? -1 : scores[1];
+
+    free(read);
+    free(read2);
+    free(ref);
+    free(mat);
+
+    return 0;
+}
+
+extern int scorePairsSse(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer) {
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+
+    if (type != SW_ALIGN) {
+        return -1;
+    }
+
+    int gapOpen = scorerGetGapOpen(scorer);
+    int gapExtend = scorerGetGapExtend(scorer);
+
+    int* table = (int*) scorerGetTable(scorer);
+    int maxCode = scorerGetMaxCode(scorer);
+
+    unsigned char** queriesCodes = 
+        (unsigned char**) malloc(pairsLen * sizeof(unsigned char*));
+    unsigned char** targetsCodes = 
+        (unsigned char**) malloc(pairsLen * sizeof(unsigned char*));
+
+    int* queriesLens = (int*) malloc(pairsLen * sizeof(int));
+    int* targetsLens = (int*) malloc(pairsLen * sizeof(int));
+
+    int i;
+    for (i = 0; i < pairsLen; ++i) {
+        queriesCodes[i] = (unsigned char*) chainGetCodes(queries[i]);
+        targetsCodes[i] = (unsigned char*) chainGetCodes(targets[i]);
+        queriesLens[i] = chainGetLength(queries[i]);
+        targetsLens[i] = chainGetLength(targets[i]);
+    }
+
+    int status = swimdSearchPairsSW(queriesCodes, queriesLens, targetsCodes, 
+        targetsLens, pairsLen, gapOpen, gapExtend, table, maxCode, scores);
+
+    free(queriesCodes);
+    free(targetsCodes);
+    free(queriesLens);
+    free(targetsLens);
+
+    // overflowed scores are set to -1
+    if (status == 0 || status == SWIMD_ERR_OVERFLOW) {
+        return 0;
+    }
+
+    return -1;
+
+#else
+    return -1;
+#endif
+}
+
 extern int scoreDatabaseSse(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer) {
 
@@ -170,6 +277,90 @@ extern int scoreDatabasePartiallySse(int* scores, int type, Chain* query,
     return -1;
 }
 
+extern int scoreInterleavedDatabaseSse(int* scores, int type, Chain* query, 
+    unsigned char** blocks, int* blocksLens, int* packed, int* lengths,
+    unsigned char* packedCodes, int blocksLen, int lanes, Scorer* scorer) {
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+
+    if (type != SW_ALIGN) {
+        return -1;
+    }
+
+    int gapOpen = scorerGetGapOpen(scorer);
+    int gapExtend = scorerGetGapExtend(scorer);
+
+    int maxCode = scorerGetMaxCode(scorer);
+    int queryLen = chainGetLength(query);
+
+    int* table;
+    unsigned char* queryPtr;
+
+    queryFirstAlphabet(&table, &queryPtr, &query, 1, scorer);
+
+    int status = swimdSearchInterleavedDatabaseCharSW(queryPtr, queryLen, 
+        blocks, blocksLen, blocksLens, packed, lengths, packedCodes, lanes, 
+        gapOpen, gapExtend, table, maxCode, scores);
+
+    free(table);
+    free(queryPtr);
+
+    // overflowed scores are set to -1
+    if (status == 0 || status == SWIMD_ERR_OVERFLOW) {
+        return 0;
+    }
+
+    return -1;
+
+#else
+    return -1;
+#endif
+}
+
+extern int scoreInterleavedDatabaseDualSse(int* scores, int* scores2, int type, 
+    Chain* query, Chain* query2, unsigned char** blocks, int* blocksLens, 
+    int* packed, int* lengths, unsigned char* packedCodes, int blocksLen, 
+    int lanes, Scorer* scorer) {
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+
+    if (type != SW_ALIGN || chainGetLength(query) != chainGetLength(query2)) {
+        return -1;
+    }
+
+    int gapOpen = scorerGetGapOpen(scorer);
+    int gapExtend = scorerGetGapExtend(scorer);
+
+    int maxCode = scorerGetMaxCode(scorer);
+    int queryLen = chainGetLength(query);
+
+    Chain* queries[] = { query, query2 };
+
+    int* table;
+    unsigned char* codes[2];
+
+    queryFirstAlphabet(&table, codes, queries, 2, scorer);
+
+    int status = swimdSearchInterleavedDatabaseCharSWDual(codes[0], codes[1], 
+        queryLen, blocks, blocksLen, blocksLens, packed, lengths, packedCodes, 
+        lanes, gapOpen, gapExtend, table, maxCode, scores, scores2);
+
+    free(table);
+    free(codes[0]);
+    free(codes[1]);
+
+    // overflowed scores are set to -1
+    if (status == 0 || status == SWIMD_ERR_OVERFLOW) {
+        return 0;
+    }
+
+    return -1;
+
+#else
+    return -1;
+#endif
+}
+
 //******************************************************************************
 
 //******************************************************************************
@@ -216,26 +407,20 @@ static int sswWrapper(s_align** a, int type, Chain* query, Chain* target,
         return -1;
     }
 
-    const int32_t n = scorerGetMaxCode(scorer);
-    int8_t* mat = (int8_t*) malloc(n * n * sizeof(int8_t));
-
-    const int* table = scorerGetTable(scorer);
-
-    int i;
-    for (i = 0; i < n * n; ++i) {
+    // profiles are built only for the letters of the pair
+    Chain* chains[] = { query, target };
 
-        int val = table[i];
+    int8_t* mat;
+    unsigned char map[256];
 
-        // can't use ssw
-        if (abs(val) > 127) {
-            free(mat);
-            return -1;
-        }
+    const int32_t n = denseAlphabet(&mat, map, chains, 2, scorer);
 
-        mat[i] = (int8_t) val;
+    // can't use ssw
+    if (n == -1) {
+        return -1;
     }
 
-    const int8_t* read = (const int8_t*) chainGetCodes(query);
+    int8_t* read = denseCodes(map, query);
     const int32_t readLen = chainGetLength(query);
 
     s_profile* prof = ssw_init(read, readLen, mat, n, 2);
@@ -243,7 +428,7 @@ static int sswWrapper(s_align** a, int type, Chain* query, Chain* target,
     const uint8_t weight_gapO = (const uint8_t) gapOpen;
     const uint8_t weight_gapE = (const uint8_t) gapExtend;
 
-    const int8_t* ref = (const int8_t*) chainGetCodes(target);
+    int8_t* ref = denseCodes(map, target);
     const int32_t refLen = chainGetLength(target);
 
     int8_t score_size;
@@ -259,6 +444,8 @@ static int sswWrapper(s_align** a, int type, Chain* query, Chain* target,
         0, 0, score_size);
 
     init_destroy(prof);
+    free(read);
+    free(ref);
     free(mat);
 
     return 0;
@@ -278,26 +465,24 @@ static int sswDatabaseWrapper(int* scores, int type, Chain* query,
         return -1;
     }
 
-    const int32_t n = scorerGetMaxCode(scorer);
-    int8_t* mat = (int8_t*) malloc(n * n * sizeof(int8_t));
+    // profile is built only for the letters of the query and the database
+    Chain** chains = (Chain**) malloc((databaseLen + 1) * sizeof(Chain*));
+    chains[0] = query;
+    memcpy(chains + 1, database, databaseLen * sizeof(Chain*));
 
-    const int* table = scorerGetTable(scorer);
+    int8_t* mat;
+    unsigned char map[256];
 
-    int i;
-    for (i = 0; i < n * n; ++i) {
-
-        int val = table[i];
+    const int32_t n = denseAlphabet(&mat, map, chains, databaseLen + 1, scorer);
 
-        // can't use ssw
-        if (abs(val) > 127) {
-            free(mat);
-            return -1;
-        }
+    free(chains);
 
-        mat[i] = (int8_t) val;
+    // can't use ssw
+    if (n == -1) {
+        return -1;
     }
 
-    const int8_t* read = (const int8_t*) chainGetCodes(query);
+    int8_t* read = denseCodes(map, query);
     const int32_t readLen = chainGetLength(query);
 
     s_profile* prof = ssw_init(read, readLen, mat, n, 2);
@@ -305,11 +490,12 @@ static int sswDatabaseWrapper(int* scores, int type, Chain* query,
     const uint8_t weight_gapO = (const uint8_t) gapOpen;
     const uint8_t weight_gapE = (const uint8_t) gapExtend;
 
+    int i;
     for (i = 0; i < databaseLen; ++i) {
 
         Chain* target = database[i];
 
-        const int8_t* ref = (const int8_t*) chainGetCodes(target);
+        int8_t* ref = denseCodes(map, target);
         const int32_t refLen = chainGetLength(target);
 
         s_align* a = ssw_align(prof, ref, refLen, weight_gapO, weight_gapE,
@@ -318,9 +504,11 @@ static int sswDatabaseWrapper(int* scores, int type, Chain* query,
         scores[i] = a->score1;
 
         align_destroy(a);
+        free(ref);
     }
 
     init_destroy(prof);
+    free(read);
     free(mat);
 
     return 0;
@@ -402,5 +590,133 @@ static int swimdWrapper(int* scores, int type, Chain* query, Chain** database,
 #endif
 }
 
-//******************************************************************************
+static void queryFirstAlphabet(int** table, unsigned char** codes, 
+    Chain** queries, int queriesLen, Scorer* scorer) {
+
+    int i, j;
+
+    int maxCode = scorerGetMaxCode(scorer);
+
+    // table rows are ordered with the query letters first, so the profile is
+    // calculated only for them, database codes index the columns unchanged
+    unsigned char map[256];
+    unsigned char order[256];
+    int orderLen = 0;
+
+    memset(map, 255, sizeof(map));
+
+    for (i = 0; i < queriesLen; ++i) {
+
+        const char* queryCodes = chainGetCodes(queries[i]);
+        int queryLen = chainGetLength(queries[i]);
+
+        for (j = 0; j < queryLen; ++j) {
+
+            unsigned char code = (unsigned char) queryCodes[j];
+
+            if (map[code] == 255) {
+                map[code] = orderLen;
+                order[orderLen++] = code;
+            }
+        }
+    }
+
+    for (i = 0; i < maxCode; ++i) {
+        if (map[i] == 255) {
+            map[i] = orderLen;
+            order[orderLen++] = i;
+        }
+    }
+
+    *table = (int*) malloc(maxCode * maxCode * sizeof(int));
 
+    for (i = 0; i < maxCode; ++i) {
+        for (j = 0; j < maxCode; ++j) {
+            (*table)[i * maxCode + j] = scorerScore(scorer, order[i], j);
+        }
+    }
+
+    for (i = 0; i < queriesLen; ++i) {
+
+        const char* queryCodes = chainGetCodes(queries[i]);
+        int queryLen = chainGetLength(queries[i]);
+
+        codes[i] = (unsigned char*) malloc(queryLen);
+
+        for (j = 0; j < queryLen; ++j) {
+            codes[i][j] = map[(unsigned char) queryCodes[j]];
+        }
+    }
+}
+
+static int denseAlphabet(int8_t** matrix, unsigned char* map, Chain** chains, 
+    int chainsLen, Scorer* scorer) {
+
+    int i, j;
+
+    int maxCode = scorerGetMaxCode(scorer);
+
+    char used[256] = { 0 };
+
+    for (i = 0; i < chainsLen; ++i) {
+
+        const char* codes = chainGetCodes(chains[i]);
+        int length = chainGetLength(chains[i]);
+
+        for (j = 0; j < length; ++j) {
+            used[(unsigned char) codes[j]] = 1;
+        }
+    }
+
+    // codes are renumbered in their order, only the used ones
+    unsigned char order[256];
+    int n = 0;
+
+    for (i = 0; i < maxCode; ++i) {
+        if (used[i]) {
+            map[i] = n;
+            order[n++] = i;
+        }
+    }
+
+    // empty chains still need a valid matrix
+    if (n == 0) {
+        map[0] = 0;
+        order[n++] = 0;
+    }
+
+    *matrix = (int8_t*) malloc(n * n * sizeof(int8_t));
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < n; ++j) {
+
+            int val = scorerScore(scorer, order[i], order[j]);
+
+            if (abs(val) > 127) {
+                free(*matrix);
+                return -1;
+            }
+
+            (*matrix)[i * n + j] = (int8_t) val;
+        }
+    }
+
+    return n;
+}
+
+static int8_t* denseCodes(const unsigned char* map, Chain* chain) {
+
+    const char* codes = chainGetCodes(chain);
+    int length = chainGetLength(chain);
+
+    int8_t* dense = (int8_t*) malloc(length * sizeof(int8_t));
+
+    int i;
+    for (i = 0; i < length; ++i) {
+        dense[i] = (int8_t) map[(unsigned char) codes[i]];
+    }
+
+    return dense;
+}
+
+//******************************************************************************
@@ -39,12 +39,77 @@ extern int alignScoredPairSse(Alignment** alignment, int type, Chain* query,
 extern int scorePairSse(int* score, int type, Chain* query, Chain* target,
     Scorer* scorer);
 
+/*!
+@brief Two queries against one target scoring function.
+
+Queries of the same length, for example both strands of a nucleotide query, are
+scored in one striped pass over the target, each of them in half of the lanes.
+Only #SW_ALIGN is supported. Scores which overflowed 8 bits are set to -1.
+
+@return 0 if scores are calculated, -1 otherwise
+*/
+extern int scorePairDualSse(int* score, int* score2, int type, Chain* query, 
+    Chain* query2, Chain* target, Scorer* scorer);
+
+/*!
+@brief Independent pairs scoring function.
+
+Pair i is made of queries[i] and targets[i], different pairs are packed into 
+SIMD lanes sorted by their lengths. Only #SW_ALIGN with scorers which are scalar
+on the codes used by the pairs is supported. Scores which overflowed are set
+to -1.
+
+@return 0 if scores are calculated, -1 otherwise
+*/
+extern int scorePairsSse(int* scores, int type, Chain** queries, 
+    Chain** targets, int pairsLen, Scorer* scorer);
+
 extern int scoreDatabaseSse(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer);
 
 extern int scoreDatabasePartiallySse(int* scores, int type, Chain* query, 
     Chain** database, int databaseLen, Scorer* scorer, int maxScore);
 
+/*!
+@brief Code used to pad shorter chains in interleaved database blocks.
+
+Padding code scores 0 with every code, so it doesn't change the local alignment
+score.
+*/
+#define SSE_PAD_CODE 255
+
+/*!
+@brief Interleaved database scoring function.
+
+Database is given as blocks of lanes chains stored column by column, codes of
+all chains in block i at position j are stored at blocks[i] + j * lanes. Chains 
+shorter than blocksLens[i] are padded with #SSE_PAD_CODE. Blocks with nonzero
+packed[i] are stored with 2 bits per code, 4 columns per byte, where values 0-3
+stand for packedCodes and lengths[i * lanes + j] is the length of the chain in 
+lane j. Only #SW_ALIGN is supported. Score of the chain in lane j of block i is 
+stored at i * lanes + j, or set to -1 if it couldn't be solved with the 
+interleaved layout.
+
+@return 0 if scores are calculated, -1 otherwise
+*/
+extern int scoreInterleavedDatabaseSse(int* scores, int type, Chain* query, 
+    unsigned char** blocks, int* blocksLens, int* packed, int* lengths,
+    unsigned char* packedCodes, int blocksLen, int lanes, Scorer* scorer);
+
+/*!
+@brief Interleaved database dual scoring function.
+
+Function works as scoreInterleavedDatabaseSse() but scores two queries of the 
+same length, for example a nucleotide query and its complement, in one pass over
+the blocks. Scores of the second query are stored to scores2.
+
+@return 0 if scores are calculated, -1 otherwise
+*/
+extern int scoreInterleavedDatabaseDualSse(int* scores, int* scores2, int type, 
+    Chain* query, Chain* query2, unsigned char** blocks, int* blocksLens, 
+    int* packed, int* lengths, unsigned char* packedCodes, int blocksLen, 
+    int lanes, Scorer* scorer);
+
 #ifdef __cplusplus 
 }
 #endif
@@ -726,6 +726,140 @@ cigar* banded_sw (const int8_t* ref,
 	return result;
 }
 
+/* Generate the profile of two reads scored in the same pass, the low half of 
+   the lanes holds the striped read1 and the high half the striped read2. */
+__m128i* qP_byte_dual (const int8_t* read1,
+					   const int8_t* read2,
+					   const int32_t readLen,
+					   const int8_t* mat,
+					   const int32_t n,
+					   uint8_t bias) {
+
+	int32_t segLen = (readLen + 7) / 8; /* 8 pieces of each read in one register */
+	__m128i* vProfile = (__m128i*)malloc(n * segLen * sizeof(__m128i));
+	int8_t* t = (int8_t*)vProfile;
+	int32_t nt, i, j, segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			for (segNum = 0; LIKELY(segNum < 16) ; segNum ++) {
+				const int8_t* read = segNum < 8 ? read1 : read2;
+				j = i + (segNum & 7) * segLen;
+				*t++ = j>= readLen ? bias : mat[nt * n + read[j]] + bias;
+			}
+		}
+	}
+	return vProfile;
+}
+
+/* Striped Smith-Waterman of two reads against the same reference in one pass.
+   The lane where the second read starts is cleared after every shift, so the 
+   two halves of the register are independent matrices. Only the best score of
+   each read is returned, 255 if it overflowed. */
+void sw_sse2_byte_dual (const int8_t* ref,
+						int32_t refLen,
+						int32_t readLen,
+						const uint8_t weight_gapO, /* will be used as - */
+						const uint8_t weight_gapE, /* will be used as - */
+						__m128i* vProfile,
+						uint8_t bias,
+						uint16_t* scores) {
+
+	int32_t segLen = (readLen + 7) / 8;
+
+	__m128i vZero = _mm_set1_epi32(0);
+	__m128i vHalf = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, 0, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	__m128i* pvHStore = (__m128i*) calloc(segLen, sizeof(__m128i));
+	__m128i* pvHLoad = (__m128i*) calloc(segLen, sizeof(__m128i));
+	__m128i* pvE = (__m128i*) calloc(segLen, sizeof(__m128i));
+
+	int32_t i, j;
+	__m128i vGapO = _mm_set1_epi8(weight_gapO);
+	__m128i vGapE = _mm_set1_epi8(weight_gapE);
+	__m128i vBias = _mm_set1_epi8(bias);
+
+	__m128i vMaxScore = vZero;
+	__m128i vTemp;
+
+	for (i = 0; LIKELY(i < refLen); ++i) {
+		int32_t cmp;
+		__m128i e, vF = vZero;
+
+		__m128i vH = pvHStore[segLen - 1];
+		vH = _mm_and_si128(_mm_slli_si128 (vH, 1), vHalf);
+		__m128i* vP = vProfile + ref[i] * segLen;
+
+		__m128i* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = _mm_adds_epu8(vH, _mm_load_si128(vP + j));
+			vH = _mm_subs_epu8(vH, vBias);
+
+			e = _mm_load_si128(pvE + j);
+			vH = _mm_max_epu8(vH, e);
+			vH = _mm_max_epu8(vH, vF);
+			vMaxScore = _mm_max_epu8(vMaxScore, vH);
+
+			_mm_store_si128(pvHStore + j, vH);
+
+			vH = _mm_subs_epu8(vH, vGapO);
+			e = _mm_subs_epu8(e, vGapE);
+			e = _mm_max_epu8(e, vH);
+			_mm_store_si128(pvE + j, e);
+
+			vF = _mm_subs_epu8(vF, vGapE);
+			vF = _mm_max_epu8(vF, vH);
+
+			vH = _mm_load_si128(pvHLoad + j);
+		}
+
+		/* Lazy_F loop, same as in sw_sse2_byte */
+		j = 0;
+		vH = _mm_load_si128 (pvHStore + j);
+		vF = _mm_and_si128(_mm_slli_si128 (vF, 1), vHalf);
+		vTemp = _mm_subs_epu8 (vH, vGapO);
+		vTemp = _mm_subs_epu8 (vF, vTemp);
+		vTemp = _mm_cmpeq_epi8 (vTemp, vZero);
+		cmp  = _mm_movemask_epi8 (vTemp);
+
+		while (cmp != 0xffff) {
+			vH = _mm_max_epu8 (vH, vF);
+			vMaxScore = _mm_max_epu8(vMaxScore, vH);
+			_mm_store_si128 (pvHStore + j, vH);
+			vF = _mm_subs_epu8 (vF, vGapE);
+			j++;
+			if (j >= segLen) {
+				j = 0;
+				vF = _mm_and_si128(_mm_slli_si128 (vF, 1), vHalf);
+			}
+			vH = _mm_load_si128 (pvHStore + j);
+
+			vTemp = _mm_subs_epu8 (vH, vGapO);
+			vTemp = _mm_subs_epu8 (vF, vTemp);
+			vTemp = _mm_cmpeq_epi8 (vTemp, vZero);
+			cmp  = _mm_movemask_epi8 (vTemp);
+		}
+	}
+
+	uint8_t lanes[16];
+	_mm_storeu_si128((__m128i*) lanes, vMaxScore);
+
+	for (i = 0; i < 2; ++i) {
+		uint8_t max = 0;
+		for (j = 0; j < 8; ++j) {
+			if (lanes[i * 8 + j] > max) max = lanes[i * 8 + j];
+		}
+		scores[i] = max + bias >= 255 ? 255 : max;
+	}
+
+	free(pvE);
+	free(pvHLoad);
+	free(pvHStore);
+}
+
 int8_t* seq_reverse(const int8_t* seq, int32_t end)	/* end is 0-based alignment ending position */	
 {									
 	int8_t* reverse = (int8_t*)calloc(end + 1, sizeof(int8_t));	
@@ -859,3 +993,23 @@ void align_destroy (s_align* a) {
 	free(a->cigar);
 	free(a);
 }
+
+void ssw_score_dual (const int8_t* read1,
+					 const int8_t* read2,
+					 const int32_t readLen,
+					 const int8_t* ref,
+					 int32_t refLen,
+					 const int8_t* mat,
+					 const int32_t n,
+					 const uint8_t weight_gapO,
+					 const uint8_t weight_gapE,
+					 uint16_t* scores) {
+
+	int32_t bias = 0, i;
+	for (i = 0; i < n*n; i++) if (mat[i] < bias) bias = mat[i];
+	bias = abs(bias);
+
+	__m128i* vP = qP_byte_dual(read1, read2, readLen, mat, n, bias);
+	sw_sse2_byte_dual(ref, refLen, readLen, weight_gapO, weight_gapE, vP, bias, scores);
+	free(vP);
+}
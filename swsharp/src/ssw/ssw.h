@@ -118,6 +118,32 @@ s_align* ssw_align (const s_profile* prof,
 					const int32_t filterd,
 					const int32_t maskLen);
 
+/*!	@function	Do Striped Smith-Waterman scoring of two reads against the same target in one pass.
+	@param	read1	pointer to the first query sequence, coded as in ssw_init
+	@param	read2	pointer to the second query sequence, coded as in ssw_init
+	@param	readLen	length of both query sequences
+	@param	ref	pointer to the target sequence
+	@param	refLen	length of the target sequence
+	@param	mat	pointer to the substitution matrix
+	@param	n	the square root of the number of elements in mat
+	@param	weight_gapO	the absolute value of gap open penalty
+	@param	weight_gapE	the absolute value of gap extension penalty
+	@param	scores	output array of 2 best alignment scores, one for each read; 255 if the score overflowed, such reads 
+					should be scored with ssw_align
+	@note	Half of the lanes of every register hold each read, so the target is streamed once for both of them, for 
+			example for both strands of a nucleotide query. Only 8 bit scores are calculated.
+*/
+void ssw_score_dual (const int8_t* read1,
+					 const int8_t* read2,
+					 const int32_t readLen,
+					 const int8_t* ref,
+					 int32_t refLen,
+					 const int8_t* mat,
+					 const int32_t n,
+					 const uint8_t weight_gapO,
+					 const uint8_t weight_gapE,
+					 uint16_t* scores);
+
 /*!	@function	Release the memory allocated by function ssw_align.
 	@param	a	pointer to the alignment result structure
 */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <limits>
 
@@ -14,13 +15,26 @@ extern "C" {
 #ifdef __AVX2__
 
 const int SIMD_REG_SIZE = 256; //!< number of bits in register
+#define SIMD_ALIGN 32 //!< alignment of arrays that are loaded into register
 typedef __m256i __mxxxi; //!< represents register containing integers
 #define _mmxxx_load_si  _mm256_load_si256
+#define _mmxxx_loadu_si _mm256_loadu_si256
 #define _mmxxx_store_si _mm256_store_si256
 #define _mmxxx_and_si   _mm256_and_si256
+#define _mmxxx_or_si    _mm256_or_si256
+#define _mmxxx_castsi_si128 _mm256_castsi256_si128
+#define _mmxxx_shuffle_epi8 _mm256_shuffle_epi8
+#define _mmxxx_blendv_epi8  _mm256_blendv_epi8
+#define _mmxxx_cmpeq_epi8   _mm256_cmpeq_epi8
+#define _mmxxx_cmpeq_epi16  _mm256_cmpeq_epi16
+#define _mmxxx_cmpeq_epi32  _mm256_cmpeq_epi32
+#define _mmxxx_srli_epi16   _mm256_srli_epi16
 
 #define _mmxxx_adds_epi8 _mm256_adds_epi8
+#define _mmxxx_adds_epu8 _mm256_adds_epu8
+#define _mmxxx_sub_epi8  _mm256_sub_epi8
 #define _mmxxx_subs_epi8 _mm256_subs_epi8
+#define _mmxxx_subs_epu8 _mm256_subs_epu8
 #define _mmxxx_min_epu8  _mm256_min_epu8
 #define _mmxxx_min_epi8  _mm256_min_epi8
 #define _mmxxx_max_epu8  _mm256_max_epu8
@@ -32,23 +46,38 @@ typedef __m256i __mxxxi; //!< represents register containing integers
 #define _mmxxx_min_epi16  _mm256_min_epi16
 #define _mmxxx_max_epi16  _mm256_max_epi16
 #define _mmxxx_set1_epi16 _mm256_set1_epi16
+#define _mmxxx_cvtepi8_epi16 _mm256_cvtepi8_epi16
 
 #define _mmxxx_add_epi32 _mm256_add_epi32
 #define _mmxxx_sub_epi32 _mm256_sub_epi32
 #define _mmxxx_min_epi32  _mm256_min_epi32
 #define _mmxxx_max_epi32  _mm256_max_epi32
 #define _mmxxx_set1_epi32 _mm256_set1_epi32
+#define _mmxxx_cvtepi8_epi32 _mm256_cvtepi8_epi32
 
 #else // SSE4.1
 
 const int SIMD_REG_SIZE = 128;
+#define SIMD_ALIGN 16
 typedef __m128i __mxxxi;
 #define _mmxxx_load_si  _mm_load_si128
+#define _mmxxx_loadu_si _mm_loadu_si128
 #define _mmxxx_store_si _mm_store_si128
 #define _mmxxx_and_si   _mm_and_si128
+#define _mmxxx_or_si    _mm_or_si128
+#define _mmxxx_castsi_si128(a) (a)
+#define _mmxxx_shuffle_epi8 _mm_shuffle_epi8
+#define _mmxxx_blendv_epi8  _mm_blendv_epi8
+#define _mmxxx_cmpeq_epi8   _mm_cmpeq_epi8
+#define _mmxxx_cmpeq_epi16  _mm_cmpeq_epi16
+#define _mmxxx_cmpeq_epi32  _mm_cmpeq_epi32
+#define _mmxxx_srli_epi16   _mm_srli_epi16
 
 #define _mmxxx_adds_epi8 _mm_adds_epi8
+#define _mmxxx_adds_epu8 _mm_adds_epu8
+#define _mmxxx_sub_epi8  _mm_sub_epi8
 #define _mmxxx_subs_epi8 _mm_subs_epi8
+#define _mmxxx_subs_epu8 _mm_subs_epu8
 #define _mmxxx_min_epu8  _mm_min_epu8
 #define _mmxxx_min_epi8  _mm_min_epi8
 #define _mmxxx_max_epu8  _mm_max_epu8
@@ -60,12 +89,14 @@ typedef __m128i __mxxxi;
 #define _mmxxx_min_epi16  _mm_min_epi16
 #define _mmxxx_max_epi16  _mm_max_epi16
 #define _mmxxx_set1_epi16 _mm_set1_epi16
+#define _mmxxx_cvtepi8_epi16 _mm_cvtepi8_epi16
 
 #define _mmxxx_add_epi32 _mm_add_epi32
 #define _mmxxx_sub_epi32 _mm_sub_epi32
 #define _mmxxx_min_epi32  _mm_min_epi32
 #define _mmxxx_max_epi32  _mm_max_epi32
 #define _mmxxx_set1_epi32 _mm_set1_epi32
+#define _mmxxx_cvtepi8_epi32 _mm_cvtepi8_epi32
 
 #endif
 
@@ -87,6 +118,8 @@ struct SimdSW<char> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epu8(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epu8(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi8(a); }
+    static inline __mxxxi cmpeq(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_cmpeq_epi8(a, b); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return a; } //!< Converts scores stored as bytes (one per channel)
 };
 
 template<>
@@ -100,6 +133,8 @@ struct SimdSW<short> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epi16(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epi16(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi16(a); }
+    static inline __mxxxi cmpeq(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_cmpeq_epi16(a, b); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return _mmxxx_cvtepi8_epi16(_mmxxx_castsi_si128(a)); }
 };
 
 template<>
@@ -113,6 +148,8 @@ struct SimdSW<int> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epi32(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epi32(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi32(a); }
+    static inline __mxxxi cmpeq(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_cmpeq_epi32(a, b); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return _mmxxx_cvtepi8_epi32(_mmxxx_castsi_si128(a)); }
 };
 //--------------------------------------------------------------------------------------//
 
@@ -122,6 +159,109 @@ static bool loadNextSequence(int &nextDbSeqIdx, int dbLength, int &currDbSeqIdx,
                              int &numEndedDbSeqs);
 
 
+//------------------------------------ QUERY PROFILE -----------------------------------//
+// Query profile is calculated like in Rognes' SWIPE: each row of score matrix is split
+// into two tables of 16 bytes (letters 0-15 and 16-31) and residues of all channels are
+// loaded into one register which is then used as index for pshufb. That way profile
+// for one letter costs two shuffles instead of one load per channel.
+// Works only if alphabet has at most 32 letters and all scores fit in char, otherwise
+// profile is calculated by gathering scores one by one.
+
+/**
+ * Splits score matrix into shuffle tables.
+ * @return True if shuffle profile can be used for given score matrix, false otherwise.
+ */
+static bool initShuffleProfile(int* scoreMatrix, int alphabetLength,
+                               __mxxxi tablesLo[], __mxxxi tablesHi[]) {
+    if (alphabetLength > 32)
+        return false;
+    for (int i = 0; i < alphabetLength * alphabetLength; i++)
+        if (scoreMatrix[i] < -128 || 127 < scoreMatrix[i])
+            return false;
+
+    char tableLo[SIMD_REG_SIZE / 8] __attribute__((aligned(SIMD_ALIGN)));
+    char tableHi[SIMD_REG_SIZE / 8] __attribute__((aligned(SIMD_ALIGN)));
+    for (int letter = 0; letter < alphabetLength; letter++) {
+        int* scoreMatrixRow = scoreMatrix + letter*alphabetLength;
+        // pshufb works on each 128 bit lane separately, so table is repeated in every lane
+        for (int i = 0; i < SIMD_REG_SIZE / 8; i++) {
+            int lo = i % 16;
+            int hi = lo + 16;
+            tableLo[i] = lo < alphabetLength ? scoreMatrixRow[lo] : 0;
+            tableHi[i] = hi < alphabetLength ? scoreMatrixRow[hi] : 0;
+        }
+        tablesLo[letter] = _mmxxx_load_si((__mxxxi const*)tableLo);
+        tablesHi[letter] = _mmxxx_load_si((__mxxxi const*)tableHi);
+    }
+    return true;
+}
+
+/**
+ * Profile is read only at letters of query, so letters above the largest letter of
+ * query need not be calculated. Callers that order the alphabet so that letters of
+ * query come first get the shortest profile.
+ * @return Number of letters that profile has to be calculated for.
+ */
+static int queryProfileLength(const unsigned char query[], int queryLength, int alphabetLength) {
+    int length = 0;
+    for (int i = 0; i < queryLength; i++)
+        length = std::max(length, query[i] + 1);
+    return std::min(length, alphabetLength);
+}
+
+/**
+ * Calculates query profile P from register of residues (one byte per channel), for
+ * the first profileLength letters.
+ * Residues that are not in alphabet (like SWIMD_PAD_CODE) get score 0.
+ */
+template<class SIMD>
+static inline void calculateShuffleProfile(__mxxxi P[], const __mxxxi& residues, int profileLength,
+                                           const __mxxxi tablesLo[], const __mxxxi tablesHi[]) {
+    // pshufb returns 0 where index has highest bit set, so for letters < 16 index for
+    // high table is negative, and for letters >= 16 index for low table is >= 128
+    const __mxxxi idxLo = _mmxxx_adds_epu8(residues, _mmxxx_set1_epi8(0x70));
+    const __mxxxi idxHi = _mmxxx_sub_epi8(residues, _mmxxx_set1_epi8(16));
+    for (int letter = 0; letter < profileLength; letter++) {
+        __mxxxi bytes = _mmxxx_or_si(_mmxxx_shuffle_epi8(tablesLo[letter], idxLo),
+                                     _mmxxx_shuffle_epi8(tablesHi[letter], idxHi));
+        P[letter] = SIMD::fromBytes(bytes);
+    }
+}
+
+/**
+ * Calculates query profile P for current residues of database sequences.
+ * Channels with null sequence get arbitrary values.
+ */
+template<class SIMD>
+static inline void calculateProfile(__mxxxi P[], unsigned char* currDbSeqsPos[],
+                                    int* scoreMatrix, int alphabetLength, int profileLength,
+                                    bool shuffle,
+                                    const __mxxxi tablesLo[], const __mxxxi tablesHi[]) {
+    if (shuffle) {
+        unsigned char residues[SIMD_REG_SIZE / 8] __attribute__((aligned(SIMD_ALIGN))) = {0};
+        for (int i = 0; i < SIMD::numSeqs; i++) {
+            unsigned char* dbSeqPos = currDbSeqsPos[i];
+            if (dbSeqPos != 0)
+                residues[i] = *dbSeqPos;
+        }
+        calculateShuffleProfile<SIMD>(P, _mmxxx_load_si((__mxxxi const*)residues),
+                                      profileLength, tablesLo, tablesHi);
+    } else {
+        typename SIMD::type profileRow[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN))) = {0};
+        for (int letter = 0; letter < profileLength; letter++) {
+            int* scoreMatrixRow = scoreMatrix + letter*alphabetLength;
+            for (int i = 0; i < SIMD::numSeqs; i++) {
+                unsigned char* dbSeqPos = currDbSeqsPos[i];
+                if (dbSeqPos != 0)
+                    profileRow[i] = (typename SIMD::type)scoreMatrixRow[*dbSeqPos];
+            }
+            P[letter] = _mmxxx_load_si((__mxxxi const*)profileRow);
+        }
+    }
+}
+//--------------------------------------------------------------------------------------//
+
+
 // For debugging
 template<class SIMD>
 void print_mmxxxi(__mxxxi mm) {
@@ -210,6 +350,13 @@ static int searchDatabaseSW_(unsigned char query[], int queryLength,
     }
 
     __mxxxi maxH = scoreZeroes;  // Best score in sequence
+
+    // Score matrix split for shuffle based query profile
+    __mxxxi profileTablesLo[alphabetLength];
+    __mxxxi profileTablesHi[alphabetLength];
+    const bool shuffleProfile = initShuffleProfile(scoreMatrix, alphabetLength,
+                                                   profileTablesLo, profileTablesHi);
+    const int profileLength = queryProfileLength(query, queryLength, alphabetLength);
     // ------------------------------------------------------------------ //
 
 
@@ -217,18 +364,9 @@ static int searchDatabaseSW_(unsigned char query[], int queryLength,
     // For each column
     while (numEndedDbSeqs < dbLength) {
         // -------------------- CALCULATE QUERY PROFILE ------------------------- //
-        // TODO: Rognes uses pshufb here, I don't know how/why?
         __mxxxi P[alphabetLength];
-        typename SIMD::type profileRow[SIMD::numSeqs] __attribute__((aligned(16)));
-        for (unsigned char letter = 0; letter < alphabetLength; letter++) {
-            int* scoreMatrixRow = scoreMatrix + letter*alphabetLength;
-            for (int i = 0; i < SIMD::numSeqs; i++) {
-                unsigned char* dbSeqPos = currDbSeqsPos[i];
-                if (dbSeqPos != 0)
-                    profileRow[i] = (typename SIMD::type)scoreMatrixRow[*dbSeqPos];
-            }
-            P[letter] = _mmxxx_load_si((__mxxxi const*)profileRow);
-        }
+        calculateProfile<SIMD>(P, currDbSeqsPos, scoreMatrix, alphabetLength,
+                               profileLength, shuffleProfile, profileTablesLo, profileTablesHi);
         // ---------------------------------------------------------------------- //
         
         // Previous cells: u - up, l - left, ul - up left
@@ -323,7 +461,7 @@ static int searchDatabaseSW_(unsigned char query[], int queryLength,
         // --------------------- CHECK AND HANDLE SEQUENCE END ------------------ //
         if (overflowDetected || shortestDbSeqLength == columnsSinceLastSeqEnd) { // If at least one sequence ended
             shortestDbSeqLength = -1;
-            typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(16)));
+            typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
 
             for (int i = 0; i < SIMD::numSeqs; i++) {
                 if (currDbSeqsPos[i] != 0) { // If not null sequence
@@ -449,6 +587,463 @@ static int searchDatabaseSW(unsigned char query[], int queryLength,
 }
 
 
+/**
+ * Smith-Waterman search over database in interleaved layout, see
+ * swimdSearchInterleavedDatabaseCharSW. Each block is solved in groups of
+ * SIMD::numSeqs lanes, one column at a time. Since sequences in block are padded
+ * to the same length there is no need to track sequence ends, and padding residues
+ * score 0 which can not increase local score.
+ * Packed blocks are decoded with one shift and one shuffle per column, and lanes
+ * which ended are masked with SWIMD_PAD_CODE.
+ * If DUAL is true second query of the same length is solved in the same pass, it
+ * shares decoded columns and profile, and its independent row recurrence is
+ * interleaved with the one of the first query.
+ */
+template<bool DUAL>
+static int searchInterleavedDatabaseSW_(unsigned char query[], unsigned char query2[],
+                                        int queryLength,
+                                        unsigned char** dbBlocks, int dbBlocksLen, int dbBlockLengths[],
+                                        int dbBlocksPacked[], int dbLaneLengths[],
+                                        unsigned char packedCodes[], int lanes, int gapOpen,
+                                        int gapExt, int* scoreMatrix, int alphabetLength,
+                                        int scores[], int scores2[]) {
+    typedef SimdSW<char> SIMD;
+
+    const SIMD::type LOWER_BOUND = std::numeric_limits<SIMD::type>::min();
+    const SIMD::type UPPER_BOUND = std::numeric_limits<SIMD::type>::max();
+
+    // ----------------------- CHECK ARGUMENTS -------------------------- //
+    if (lanes % SIMD::numSeqs != 0) {
+        return SWIMD_ERR_UNSUPPORTED;
+    }
+    if (gapOpen < LOWER_BOUND || UPPER_BOUND < gapOpen || gapExt < LOWER_BOUND || UPPER_BOUND < gapExt) {
+        return SWIMD_ERR_OVERFLOW;
+    }
+
+    __mxxxi profileTablesLo[alphabetLength];
+    __mxxxi profileTablesHi[alphabetLength];
+    if (!initShuffleProfile(scoreMatrix, alphabetLength, profileTablesLo, profileTablesHi)) {
+        return SWIMD_ERR_UNSUPPORTED;
+    }
+
+    // Profile is calculated for letters of both queries
+    unsigned char letters[DUAL ? 2 * queryLength : queryLength];
+    std::copy(query, query + queryLength, letters);
+    if (DUAL) {
+        std::copy(query2, query2 + queryLength, letters + queryLength);
+    }
+
+    const int profileLength = queryProfileLength(letters, DUAL ? 2 * queryLength : queryLength,
+                                                 alphabetLength);
+    // ------------------------------------------------------------------ //
+
+
+    // ------------------------ INITIALIZATION -------------------------- //
+    const __mxxxi scoreZeroes = SIMD::set1(LOWER_BOUND); // negative range is used
+
+    // Q is gap open penalty, R is gap ext penalty.
+    const __mxxxi Q = SIMD::set1(gapOpen);
+    const __mxxxi R = SIMD::set1(gapExt);
+
+    // Decodes 2 bit residues of packed blocks, table is repeated in every 128 bit lane
+    __mxxxi packedTable = _mmxxx_set1_epi32(0);
+    if (dbBlocksPacked != 0) {
+        packedTable = _mmxxx_set1_epi32(packedCodes[0] | (packedCodes[1] << 8) |
+                                        (packedCodes[2] << 16) | (packedCodes[3] << 24));
+    }
+    const __mxxxi packedMask = _mmxxx_set1_epi8(3);
+    const __mxxxi byteZeroes = _mmxxx_set1_epi8(0);
+    const __mxxxi byteOnes = _mmxxx_set1_epi8(1);
+
+    __mxxxi prevHs[queryLength];
+    __mxxxi prevEs[queryLength];
+    __mxxxi prevHs2[DUAL ? queryLength : 1];
+    __mxxxi prevEs2[DUAL ? queryLength : 1];
+    __mxxxi P[alphabetLength];
+    // ------------------------------------------------------------------ //
+
+    bool overflowOccured = false;
+
+    for (int block = 0; block < dbBlocksLen; block++) {
+        for (int lane = 0; lane < lanes; lane += SIMD::numSeqs) {
+            for (int i = 0; i < queryLength; i++) {
+                prevHs[i] = prevEs[i] = scoreZeroes;
+                if (DUAL) {
+                    prevHs2[i] = prevEs2[i] = scoreZeroes;
+                }
+            }
+            __mxxxi maxH = scoreZeroes;
+            __mxxxi ofTest = scoreZeroes; // If using negative range: if ulH_P >= 0 then we have overflow
+            __mxxxi maxH2 = scoreZeroes;
+            __mxxxi ofTest2 = scoreZeroes;
+
+            // For each column, residues of all lanes are stored contiguously
+            unsigned char* column = dbBlocks[block] + lane;
+
+            bool packed = dbBlocksPacked != 0 && dbBlocksPacked[block];
+            int* laneLengths = packed ? dbLaneLengths + block * lanes + lane : 0;
+
+            // Columns before shortest lane end need no masking
+            int minLength = dbBlockLengths[block];
+            for (int i = 0; packed && i < SIMD::numSeqs; i++) {
+                minLength = std::min(minLength, laneLengths[i]);
+            }
+
+            __mxxxi packedColumn = byteZeroes;
+            __mxxxi remaining = byteZeroes; // columns left in each lane, saturated to 255
+
+            for (int c = 0; c < dbBlockLengths[block]; c++) {
+                __mxxxi residues;
+                if (packed) {
+                    // Four columns are stored in one byte, lowest bits first
+                    if (c % 4 == 0) {
+                        packedColumn = _mmxxx_loadu_si((__mxxxi const*)(column + (c / 4) * lanes));
+                    }
+                    residues = _mmxxx_shuffle_epi8(packedTable, _mmxxx_and_si(packedColumn, packedMask));
+                    packedColumn = _mmxxx_srli_epi16(packedColumn, 2);
+
+                    if (c >= minLength) {
+                        if ((c - minLength) % 255 == 0) {
+                            unsigned char unpacked[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+                            for (int i = 0; i < SIMD::numSeqs; i++) {
+                                unpacked[i] = std::max(0, std::min(255, laneLengths[i] - c));
+                            }
+                            remaining = _mmxxx_load_si((__mxxxi const*)unpacked);
+                        }
+                        residues = _mmxxx_or_si(residues, _mmxxx_cmpeq_epi8(remaining, byteZeroes));
+                        remaining = _mmxxx_subs_epu8(remaining, byteOnes);
+                    }
+                } else {
+                    residues = _mmxxx_loadu_si((__mxxxi const*)(column + c * lanes));
+                }
+
+                calculateShuffleProfile<SIMD>(P, residues, profileLength,
+                                              profileTablesLo, profileTablesHi);
+
+                __mxxxi uF, uH, ulH;
+                uF = uH = ulH = scoreZeroes;
+                __mxxxi uF2, uH2, ulH2;
+                uF2 = uH2 = ulH2 = scoreZeroes;
+
+                // ----------------------- CORE LOOP (ONE COLUMN) ----------------------- //
+                for (int r = 0; r < queryLength; r++) {
+                    __mxxxi E = SIMD::max(SIMD::sub(prevHs[r], Q), SIMD::sub(prevEs[r], R));
+                    __mxxxi F = SIMD::max(SIMD::sub(uH, Q), SIMD::sub(uF, R));
+                    __mxxxi H = SIMD::max(F, E);
+                    __mxxxi ulH_P = SIMD::add(ulH, P[query[r]]);
+                    H = SIMD::max(H, ulH_P);
+
+                    ofTest = _mmxxx_and_si(ofTest, ulH_P);
+                    maxH = SIMD::max(maxH, H);
+
+                    uF = F;
+                    uH = H;
+                    ulH = prevHs[r];
+
+                    prevEs[r] = E;
+                    prevHs[r] = H;
+
+                    if (DUAL) {
+                        __mxxxi E2 = SIMD::max(SIMD::sub(prevHs2[r], Q), SIMD::sub(prevEs2[r], R));
+                        __mxxxi F2 = SIMD::max(SIMD::sub(uH2, Q), SIMD::sub(uF2, R));
+                        __mxxxi H2 = SIMD::max(F2, E2);
+                        __mxxxi ulH_P2 = SIMD::add(ulH2, P[query2[r]]);
+                        H2 = SIMD::max(H2, ulH_P2);
+
+                        ofTest2 = _mmxxx_and_si(ofTest2, ulH_P2);
+                        maxH2 = SIMD::max(maxH2, H2);
+
+                        uF2 = F2;
+                        uH2 = H2;
+                        ulH2 = prevHs2[r];
+
+                        prevEs2[r] = E2;
+                        prevHs2[r] = H2;
+                    }
+                }
+                // ---------------------------------------------------------------------- //
+            }
+
+            SIMD::type unpackedMaxH[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+            SIMD::type unpackedOfTest[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+            _mmxxx_store_si((__mxxxi*)unpackedMaxH, maxH);
+            _mmxxx_store_si((__mxxxi*)unpackedOfTest, ofTest);
+
+            int* laneScores = scores + block * lanes + lane;
+            for (int i = 0; i < SIMD::numSeqs; i++) {
+                if (unpackedOfTest[i] >= 0) {
+                    laneScores[i] = -1;
+                    overflowOccured = true;
+                } else {
+                    laneScores[i] = unpackedMaxH[i] - LOWER_BOUND;
+                }
+            }
+
+            if (DUAL) {
+                _mmxxx_store_si((__mxxxi*)unpackedMaxH, maxH2);
+                _mmxxx_store_si((__mxxxi*)unpackedOfTest, ofTest2);
+
+                laneScores = scores2 + block * lanes + lane;
+                for (int i = 0; i < SIMD::numSeqs; i++) {
+                    if (unpackedOfTest[i] >= 0) {
+                        laneScores[i] = -1;
+                        overflowOccured = true;
+                    } else {
+                        laneScores[i] = unpackedMaxH[i] - LOWER_BOUND;
+                    }
+                }
+            }
+        }
+    }
+
+    if (overflowOccured) {
+        return SWIMD_ERR_OVERFLOW;
+    }
+    return 0;
+}
+
+/**
+ * Smith-Waterman scoring of independent pairs, see swimdSearchPairsSW. Pairs given by
+ * idxs are solved in groups of SIMD::numSeqs lanes, each lane holds its own row and
+ * column sequence. Shorter sequences are padded at the end, rows with SWIMD_PAD_CODE - 1
+ * and columns with SWIMD_PAD_CODE, so padding never matches and scores mismatch which
+ * is never positive. Padded cells lie after all real cells of the lane and can not
+ * increase its local score.
+ * Substitution score is calculated by comparing row and column residues of all lanes.
+ * @return True if score of some pair overflowed, its score is then set to -1.
+ */
+template<class SIMD>
+static bool searchPairsSW_(unsigned char** rowSeqs, int rowLengths[], unsigned char** colSeqs,
+                           int colLengths[], int idxs[], int idxsLen, int gapOpen, int gapExt,
+                           int match, int mismatch, int scores[]) {
+
+    const typename SIMD::type LOWER_BOUND = std::numeric_limits<typename SIMD::type>::min();
+    const typename SIMD::type UPPER_BOUND = std::numeric_limits<typename SIMD::type>::max();
+
+    // ----------------------- CHECK ARGUMENTS -------------------------- //
+    if (gapOpen < LOWER_BOUND || UPPER_BOUND < gapOpen || gapExt < LOWER_BOUND || UPPER_BOUND < gapExt ||
+        match < LOWER_BOUND || UPPER_BOUND < match || mismatch < LOWER_BOUND) {
+        for (int i = 0; i < idxsLen; i++) {
+            scores[idxs[i]] = -1;
+        }
+        return true;
+    }
+    // ------------------------------------------------------------------ //
+
+
+    // ------------------------ INITIALIZATION -------------------------- //
+    const __mxxxi zeroes = SIMD::set1(0);
+    __mxxxi scoreZeroes; // 0 normally, but lower bound if using negative range
+    if (SIMD::negRange)
+        scoreZeroes = SIMD::set1(LOWER_BOUND);
+    else
+        scoreZeroes = zeroes;
+
+    // Q is gap open penalty, R is gap ext penalty.
+    const __mxxxi Q = SIMD::set1(gapOpen);
+    const __mxxxi R = SIMD::set1(gapExt);
+
+    const __mxxxi matchScore = SIMD::set1(match);
+    const __mxxxi mismatchScore = SIMD::set1(mismatch);
+    // ------------------------------------------------------------------ //
+
+    bool overflowOccured = false;
+
+    for (int group = 0; group < idxsLen; group += SIMD::numSeqs) {
+        int lanesLen = std::min(SIMD::numSeqs, idxsLen - group);
+
+        int rows = 0;
+        int cols = 0;
+        for (int i = 0; i < lanesLen; i++) {
+            rows = std::max(rows, rowLengths[idxs[group + i]]);
+            cols = std::max(cols, colLengths[idxs[group + i]]);
+        }
+
+        typename SIMD::type residues[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+
+        // Row residues of all lanes are gathered once for the whole group
+        __mxxxi rowResidues[rows];
+        for (int r = 0; r < rows; r++) {
+            for (int i = 0; i < SIMD::numSeqs; i++) {
+                int idx = i < lanesLen ? idxs[group + i] : -1;
+                residues[i] = idx != -1 && r < rowLengths[idx] ? rowSeqs[idx][r] : SWIMD_PAD_CODE - 1;
+            }
+            rowResidues[r] = _mmxxx_load_si((__mxxxi const*)residues);
+        }
+
+        __mxxxi prevHs[rows];
+        __mxxxi prevEs[rows];
+        for (int r = 0; r < rows; r++) {
+            prevHs[r] = prevEs[r] = scoreZeroes;
+        }
+
+        __mxxxi maxH = scoreZeroes;
+        __mxxxi ofTest = scoreZeroes; // If using negative range: if ulH_P >= 0 then we have overflow
+
+        for (int c = 0; c < cols; c++) {
+            for (int i = 0; i < SIMD::numSeqs; i++) {
+                int idx = i < lanesLen ? idxs[group + i] : -1;
+                residues[i] = idx != -1 && c < colLengths[idx] ? colSeqs[idx][c] : SWIMD_PAD_CODE;
+            }
+            const __mxxxi colResidues = _mmxxx_load_si((__mxxxi const*)residues);
+
+            __mxxxi uF, uH, ulH;
+            uF = uH = ulH = scoreZeroes;
+
+            // ----------------------- CORE LOOP (ONE COLUMN) ----------------------- //
+            for (int r = 0; r < rows; r++) {
+                __mxxxi E = SIMD::max(SIMD::sub(prevHs[r], Q), SIMD::sub(prevEs[r], R));
+                __mxxxi F = SIMD::max(SIMD::sub(uH, Q), SIMD::sub(uF, R));
+                __mxxxi H = SIMD::max(F, E);
+                if (!SIMD::negRange)
+                    H = SIMD::max(H, zeroes);
+
+                __mxxxi P = _mmxxx_blendv_epi8(mismatchScore, matchScore,
+                                               SIMD::cmpeq(rowResidues[r], colResidues));
+                __mxxxi ulH_P = SIMD::add(ulH, P);
+                H = SIMD::max(H, ulH_P);
+
+                if (SIMD::negRange)
+                    ofTest = _mmxxx_and_si(ofTest, ulH_P);
+                maxH = SIMD::max(maxH, H);
+
+                uF = F;
+                uH = H;
+                ulH = prevHs[r];
+
+                prevEs[r] = E;
+                prevHs[r] = H;
+            }
+            // ---------------------------------------------------------------------- //
+        }
+
+        typename SIMD::type unpackedMaxH[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+        typename SIMD::type unpackedOfTest[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+        _mmxxx_store_si((__mxxxi*)unpackedMaxH, maxH);
+        _mmxxx_store_si((__mxxxi*)unpackedOfTest, ofTest);
+
+        for (int i = 0; i < lanesLen; i++) {
+            bool overflowed;
+            if (SIMD::negRange)
+                overflowed = unpackedOfTest[i] >= 0;
+            else
+                overflowed = unpackedMaxH[i] == UPPER_BOUND;
+
+            if (overflowed) {
+                scores[idxs[group + i]] = -1;
+                overflowOccured = true;
+            } else {
+                scores[idxs[group + i]] = unpackedMaxH[i] - (SIMD::negRange ? LOWER_BOUND : 0);
+            }
+        }
+    }
+
+    return overflowOccured;
+}
+
+/**
+ * Orders pairs by length of rows and then by length of columns.
+ */
+struct PairLengthsLess {
+    const int* rowLengths;
+    const int* colLengths;
+    PairLengthsLess(const int* rowLengths_, const int* colLengths_)
+        : rowLengths(rowLengths_), colLengths(colLengths_) {}
+    bool operator()(int a, int b) const {
+        if (rowLengths[a] != rowLengths[b])
+            return rowLengths[a] < rowLengths[b];
+        return colLengths[a] < colLengths[b];
+    }
+};
+
+/**
+ * Checks that score matrix reduces to match and mismatch on letters used by the pairs,
+ * like nucleotide matrices do on ACGT, so substitution scores can be obtained by
+ * comparing residues. Such matrix is symmetric, so shorter sequence of every pair is
+ * used for rows and the longer one for columns. Pairs are sorted by lengths so lanes
+ * of one group are padded as little as possible, and pairs which overflowed char are
+ * solved again with short.
+ */
+static int searchPairsSW(unsigned char** queries, int queryLengths[], unsigned char** targets,
+                         int targetLengths[], int pairsLen, int gapOpen, int gapExt,
+                         int* scoreMatrix, int alphabetLength, int scores[]) {
+    if (alphabetLength >= SWIMD_PAD_CODE - 1) {
+        return SWIMD_ERR_UNSUPPORTED;
+    }
+
+    bool used[256] = {false};
+    for (int i = 0; i < pairsLen; i++) {
+        for (int j = 0; j < queryLengths[i]; j++)
+            used[queries[i][j]] = true;
+        for (int j = 0; j < targetLengths[i]; j++)
+            used[targets[i][j]] = true;
+    }
+
+    int match = 0;
+    int mismatch = 0; // padding scores 0 if there are no mismatching letters
+    bool matchSet = false;
+    bool mismatchSet = false;
+    for (int r = 0; r < alphabetLength; r++) {
+        if (!used[r])
+            continue;
+        for (int c = 0; c < alphabetLength; c++) {
+            if (!used[c])
+                continue;
+            int score = scoreMatrix[r * alphabetLength + c];
+            int& value = r == c ? match : mismatch;
+            bool& set = r == c ? matchSet : mismatchSet;
+            if (set && value != score)
+                return SWIMD_ERR_UNSUPPORTED;
+            value = score;
+            set = true;
+        }
+    }
+    if (mismatch > 0) {
+        return SWIMD_ERR_UNSUPPORTED;
+    }
+
+    unsigned char** rowSeqs = new unsigned char*[pairsLen];
+    unsigned char** colSeqs = new unsigned char*[pairsLen];
+    int* rowLengths = new int[pairsLen];
+    int* colLengths = new int[pairsLen];
+    int* idxs = new int[pairsLen];
+    for (int i = 0; i < pairsLen; i++) {
+        bool swap = queryLengths[i] > targetLengths[i];
+        rowSeqs[i] = swap ? targets[i] : queries[i];
+        colSeqs[i] = swap ? queries[i] : targets[i];
+        rowLengths[i] = swap ? targetLengths[i] : queryLengths[i];
+        colLengths[i] = swap ? queryLengths[i] : targetLengths[i];
+        idxs[i] = i;
+    }
+
+    std::sort(idxs, idxs + pairsLen, PairLengthsLess(rowLengths, colLengths));
+
+    int resultCode = 0;
+    if (searchPairsSW_< SimdSW<char> >(rowSeqs, rowLengths, colSeqs, colLengths, idxs, pairsLen,
+                                       gapOpen, gapExt, match, mismatch, scores)) {
+        int overflowedLen = 0;
+        for (int i = 0; i < pairsLen; i++) {
+            if (scores[idxs[i]] == -1)
+                idxs[overflowedLen++] = idxs[i];
+        }
+
+        if (searchPairsSW_< SimdSW<short> >(rowSeqs, rowLengths, colSeqs, colLengths, idxs,
+                                            overflowedLen, gapOpen, gapExt, match, mismatch,
+                                            scores)) {
+            resultCode = SWIMD_ERR_OVERFLOW;
+        }
+    }
+
+    delete[] rowSeqs;
+    delete[] colSeqs;
+    delete[] rowLengths;
+    delete[] colLengths;
+    delete[] idxs;
+    return resultCode;
+}
+
+
+
 
 
 
@@ -472,6 +1067,7 @@ struct Simd<char> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epi8(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epi8(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi8(a); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return a; } //!< Converts scores stored as bytes (one per channel)
 };
 
 template<>
@@ -484,6 +1080,7 @@ struct Simd<short> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epi16(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epi16(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi16(a); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return _mmxxx_cvtepi8_epi16(_mmxxx_castsi_si128(a)); }
 };
 
 template<>
@@ -496,6 +1093,7 @@ struct Simd<int> {
     static inline __mxxxi min(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_min_epi32(a, b); }
     static inline __mxxxi max(const __mxxxi& a, const __mxxxi& b) { return _mmxxx_max_epi32(a, b); }
     static inline __mxxxi set1(int a) { return _mmxxx_set1_epi32(a); }
+    static inline __mxxxi fromBytes(const __mxxxi& a) { return _mmxxx_cvtepi8_epi32(_mmxxx_castsi_si128(a)); }
 };
 //--------------------------------------------------------------------------------------//
 
@@ -596,6 +1194,13 @@ static int searchDatabase_(unsigned char query[], int queryLength,
     }
 
     __mxxxi maxLastRowH = LOWER_BOUND_SIMD; // Keeps track of maximum H in last row
+
+    // Score matrix split for shuffle based query profile
+    __mxxxi profileTablesLo[alphabetLength];
+    __mxxxi profileTablesHi[alphabetLength];
+    const bool shuffleProfile = initShuffleProfile(scoreMatrix, alphabetLength,
+                                                   profileTablesLo, profileTablesHi);
+    const int profileLength = queryProfileLength(query, queryLength, alphabetLength);
     // ------------------------------------------------------------------ //
 
 
@@ -603,18 +1208,9 @@ static int searchDatabase_(unsigned char query[], int queryLength,
     // For each column
     while (numEndedDbSeqs < dbLength) {
         // -------------------- CALCULATE QUERY PROFILE ------------------------- //
-        // TODO: Rognes uses pshufb here, I don't know how/why?
         __mxxxi P[alphabetLength];
-        typename SIMD::type profileRow[SIMD::numSeqs] __attribute__((aligned(16)));
-        for (unsigned char letter = 0; letter < alphabetLength; letter++) {
-            int* scoreMatrixRow = scoreMatrix + letter*alphabetLength;
-            for (int i = 0; i < SIMD::numSeqs; i++) {
-                unsigned char* dbSeqPos = currDbSeqsPos[i];
-                if (dbSeqPos != 0)
-                    profileRow[i] = (typename SIMD::type)scoreMatrixRow[*dbSeqPos];
-            }
-            P[letter] = _mmxxx_load_si((__mxxxi const*)profileRow);
-        }
+        calculateProfile<SIMD>(P, currDbSeqsPos, scoreMatrix, alphabetLength,
+                               profileLength, shuffleProfile, profileTablesLo, profileTablesHi);
         // ---------------------------------------------------------------------- //
 
         // u - up
@@ -623,7 +1219,7 @@ static int searchDatabase_(unsigned char query[], int queryLength,
         // Database sequence has fixed start and end only in NW
         if (MODE == SWIMD_MODE_NW) {
             if (seqJustLoaded) {
-                typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(16)));
+                typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
                 for (int i = 0; i < SIMD::numSeqs; i++) 
                     resetMask[i] = justLoaded[i] ?  0 : -1;
                 const __mxxxi resetMaskPacked = _mmxxx_load_si((__mxxxi const*)resetMask);
@@ -766,8 +1362,8 @@ static int searchDatabase_(unsigned char query[], int queryLength,
                 }
             }
             //------------ Reset prevEs, prevHs, maxLastRowH(, ulH and uH) ------------//
-            typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(16)));
-            typename SIMD::type setMask[SIMD::numSeqs] __attribute__((aligned(16))); // inverse of resetMask
+            typename SIMD::type resetMask[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN)));
+            typename SIMD::type setMask[SIMD::numSeqs] __attribute__((aligned(SIMD_ALIGN))); // inverse of resetMask
             for (int i = 0; i < SIMD::numSeqs; i++) {
                 resetMask[i] = justLoaded[i] ?  0 : -1;
                 setMask[i]   = justLoaded[i] ? -1 :  0;
@@ -918,3 +1514,47 @@ extern int swimdSearchDatabaseCharSW(
     return resultCode;
 #endif
 }
+
+
+extern int swimdSearchInterleavedDatabaseCharSW(
+    unsigned char query[], int queryLength, unsigned char** dbBlocks, int dbBlocksLen,
+    int dbBlockLengths[], int dbBlocksPacked[], int dbLaneLengths[],
+    unsigned char packedCodes[], int lanes, int gapOpen, int gapExt, int* scoreMatrix,
+    int alphabetLength, int scores[]) {
+#if !defined(__SSE4_1__) && !defined(__AVX2__)
+    return SWIMD_ERR_NO_SIMD_SUPPORT;
+#else
+    return searchInterleavedDatabaseSW_<false>(query, 0, queryLength, dbBlocks, dbBlocksLen,
+                                               dbBlockLengths, dbBlocksPacked, dbLaneLengths,
+                                               packedCodes, lanes, gapOpen, gapExt,
+                                               scoreMatrix, alphabetLength, scores, 0);
+#endif
+}
+
+extern int swimdSearchInterleavedDatabaseCharSWDual(
+    unsigned char query[], unsigned char query2[], int queryLength,
+    unsigned char** dbBlocks, int dbBlocksLen,
+    int dbBlockLengths[], int dbBlocksPacked[], int dbLaneLengths[],
+    unsigned char packedCodes[], int lanes, int gapOpen, int gapExt, int* scoreMatrix,
+    int alphabetLength, int scores[], int scores2[]) {
+#if !defined(__SSE4_1__) && !defined(__AVX2__)
+    return SWIMD_ERR_NO_SIMD_SUPPORT;
+#else
+    return searchInterleavedDatabaseSW_<true>(query, query2, queryLength, dbBlocks, dbBlocksLen,
+                                              dbBlockLengths, dbBlocksPacked, dbLaneLengths,
+                                              packedCodes, lanes, gapOpen, gapExt,
+                                              scoreMatrix, alphabetLength, scores, scores2);
+#endif
+}
+
+extern int swimdSearchPairsSW(
+    unsigned char** queries, int queryLengths[], unsigned char** targets,
+    int targetLengths[], int pairsLen, int gapOpen, int gapExt, int* scoreMatrix,
+    int alphabetLength, int scores[]) {
+#if !defined(__SSE4_1__) && !defined(__AVX2__)
+    return SWIMD_ERR_NO_SIMD_SUPPORT;
+#else
+    return searchPairsSW(queries, queryLengths, targets, targetLengths, pairsLen,
+                         gapOpen, gapExt, scoreMatrix, alphabetLength, scores);
+#endif
+}
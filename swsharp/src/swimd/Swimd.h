@@ -17,6 +17,10 @@ extern "C" {
 #define SWIMD_ERR_OVERFLOW 1 //!< Returned when score overflow happens. Happens only if score can't fit in int.
 #define SWIMD_ERR_NO_SIMD_SUPPORT 2 //!< Returned if available SIMD is not SSE4.1 or higher.
 #define SWIMD_ERR_INVALID_MODE 3 //!< Returned when given mode is invalid.
+#define SWIMD_ERR_UNSUPPORTED 4 //!< Returned when arguments can not be handled by interleaved search.
+
+// Code used to pad sequences in interleaved database, scores 0 with every letter.
+#define SWIMD_PAD_CODE 255
     
 // Modes
 #define SWIMD_MODE_NW 0
@@ -92,6 +96,77 @@ extern "C" {
         int dbSeqLengths[], int gapOpen, int gapExt, int* scoreMatrix,
         int alphabetLength, int scores[]);
 
+    /**
+     * Same like swimdSearchDatabaseCharSW, but database is given in interleaved layout.
+     * Database sequences are grouped into blocks of lanes sequences, and each block is
+     * stored column by column: residues of all sequences of block i at position c are
+     * stored contiguously at dbBlocks[i] + c * lanes. Sequences shorter than
+     * dbBlockLengths[i] are padded with SWIMD_PAD_CODE, so sorting sequences by
+     * length before grouping keeps padding small.
+     * Each column is loaded as one vector and there is no tracking of sequence ends.
+     * Blocks whose sequences use only four letters can be stored packed, two bits per
+     * residue: residue of lane j at position c is stored in bits 2 * (c % 4) of byte
+     * dbBlocks[i][(c / 4) * lanes + j], and is decoded with packedCodes.
+     * Works only for alphabets of at most 32 letters and scores that fit in char.
+     * @param [in] dbBlocks Array of blocks.
+     * @param [in] dbBlocksLen Number of blocks.
+     * @param [in] dbBlockLengths Number of columns of each block.
+     * @param [in] dbBlocksPacked Nonzero for packed blocks, can be 0 if none is packed.
+     * @param [in] dbLaneLengths Length of sequence in lane j of block i is stored at
+     *             i * lanes + j, used only for packed blocks.
+     * @param [in] packedCodes Letters that 2 bit values 0-3 of packed blocks stand for.
+     * @param [in] lanes Number of sequences in each block, must be multiple of 32.
+     * @param [out] scores Score of sequence in lane j of block i is stored at
+     *              i * lanes + j (-1 if overflowed).
+     * @return 0 if all okay, SWIMD_ERR_OVERFLOW if some scores overflowed, other
+     *         error code if interleaved search can not be used.
+     */
+    int swimdSearchInterleavedDatabaseCharSW(
+        unsigned char query[], int queryLength, unsigned char** dbBlocks, int dbBlocksLen,
+        int dbBlockLengths[], int dbBlocksPacked[], int dbLaneLengths[],
+        unsigned char packedCodes[], int lanes, int gapOpen, int gapExt, int* scoreMatrix,
+        int alphabetLength, int scores[]);
+
+    /**
+     * Same like swimdSearchInterleavedDatabaseCharSW, but two queries of the same
+     * length, for example a nucleotide query and its reverse complement, are
+     * searched in one pass over the database. Columns and profile are calculated
+     * once for both queries.
+     * @param [in] query2 Second query, of length queryLength.
+     * @param [out] scores2 Scores of the second query, stored like scores.
+     * @return 0 if all okay, SWIMD_ERR_OVERFLOW if some scores of any query
+     *         overflowed, other error code if interleaved search can not be used.
+     */
+    int swimdSearchInterleavedDatabaseCharSWDual(
+        unsigned char query[], unsigned char query2[], int queryLength,
+        unsigned char** dbBlocks, int dbBlocksLen,
+        int dbBlockLengths[], int dbBlocksPacked[], int dbLaneLengths[],
+        unsigned char packedCodes[], int lanes, int gapOpen, int gapExt, int* scoreMatrix,
+        int alphabetLength, int scores[], int scores2[]);
+
+    /**
+     * Smith-Waterman scores of independent pairs, pair i is made of queries[i] and
+     * targets[i]. Different pairs are packed into lanes of one SIMD register, sorted
+     * by length so lanes of one register are padded as little as possible.
+     * Scores are calculated with char precision, and pairs which overflowed are
+     * solved again with short precision.
+     * Works only if score matrix restricted to letters used by the pairs is scalar
+     * (same match on diagonal, same nonpositive mismatch elsewhere), like nucleotide
+     * matrices on ACGT are.
+     * @param [in] queries Array of query sequences.
+     * @param [in] queryLengths Array of lengths of query sequences.
+     * @param [in] targets Array of target sequences.
+     * @param [in] targetLengths Array of lengths of target sequences.
+     * @param [in] pairsLen Number of pairs.
+     * @param [out] scores Score of every pair (-1 if overflowed).
+     * @return 0 if all okay, SWIMD_ERR_OVERFLOW if some scores overflowed, other
+     *         error code if pairs search can not be used.
+     */
+    int swimdSearchPairsSW(
+        unsigned char** queries, int queryLengths[], unsigned char** targets,
+        int targetLengths[], int pairsLen, int gapOpen, int gapExt, int* scoreMatrix,
+        int alphabetLength, int scores[]);
+
 #ifdef __cplusplus 
 }
 #endif
@@ -102,10 +102,12 @@ And the executable can be run with:
 #include "cuda_utils.h"
 #include "database.h"
 #include "gpu_module.h"
+#include "hit_cache.h"
 #include "post_proc.h"
 #include "pre_proc.h"
 #include "reconstruct.h"
 #include "threadpool.h"
+#include "tune.h"
 
 #ifdef __cplusplus 
 extern "C" {
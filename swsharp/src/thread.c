@@ -51,6 +51,10 @@ struct AppleSemaphore {
 //******************************************************************************
 // PRIVATE
 
+#ifdef _WIN32
+static BOOL CALLBACK onceRoutine(PINIT_ONCE once, PVOID param, PVOID* context);
+#endif
+
 //******************************************************************************
 
 //******************************************************************************
@@ -93,6 +97,19 @@ extern void mutexUnlock(Mutex* mutex) {
 
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// ONCE
+
+extern void onceCall(Once* once, void (*routine)()) {
+#ifdef _WIN32
+    InitOnceExecuteOnce(once, onceRoutine, (PVOID) routine, NULL);
+#else 
+    pthread_once(once, routine);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
 //------------------------------------------------------------------------------
 // SEMAPHORES
 
@@ -206,4 +223,11 @@ extern void threadSleep(unsigned int ms) {
 //******************************************************************************
 // PRIVATE
 
+#ifdef _WIN32
+static BOOL CALLBACK onceRoutine(PINIT_ONCE once, PVOID param, PVOID* context) {
+    ((void (*)()) param)();
+    return TRUE;
+}
+#endif
+
 //******************************************************************************
@@ -44,6 +44,16 @@ extern "C" {
 */
 typedef CRITICAL_SECTION Mutex;
 
+/*!
+@brief One time initialization type.
+*/
+typedef INIT_ONCE Once;
+
+/*!
+@brief One time initialization object initializer.
+*/
+#define ONCE_INIT INIT_ONCE_STATIC_INIT
+
 /*!
 @brief Semaphore type.
 */
@@ -61,6 +71,16 @@ typedef HANDLE Thread;
 */
 typedef pthread_mutex_t Mutex;
 
+/*!
+@brief One time initialization type.
+*/
+typedef pthread_once_t Once;
+
+/*!
+@brief One time initialization object initializer.
+*/
+#define ONCE_INIT PTHREAD_ONCE_INIT
+
 /*!
 @brief Semaphore type.
 */
@@ -77,6 +97,16 @@ typedef pthread_t Thread;
 */
 typedef pthread_mutex_t Mutex;
 
+/*!
+@brief One time initialization type.
+*/
+typedef pthread_once_t Once;
+
+/*!
+@brief One time initialization object initializer.
+*/
+#define ONCE_INIT PTHREAD_ONCE_INIT
+
 /*!
 @brief Semaphore type.
 */
@@ -116,6 +146,17 @@ extern void mutexLock(Mutex* mutex);
 */
 extern void mutexUnlock(Mutex* mutex);
 
+/*!
+@brief Calls the routine exactly once.
+
+Threads calling the function with the same once object, initialized with
+#ONCE_INIT, wait until the first of them finishes the routine.
+
+@param once one time initialization object
+@param routine routine that is called
+*/
+extern void onceCall(Once* once, void (*routine)());
+
 /*!
 @brief Semaphore constructor.
 
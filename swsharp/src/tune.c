@@ -0,0 +1,305 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "thread.h"
+
+#include "tune.h"
+
+#define PROFILE_NAME    ".swsharp_tune"
+#define ENV_PREFIX      "SWSHARP_"
+
+typedef struct TuneParam {
+    const char* name;
+    long long defaultValue;
+    long long profileValue;
+    long long envValue;
+    long long explicitValue;
+} TuneParam;
+
+static TuneParam params[] = {
+    { "cpu_thread_chunk", 1000, 0, 0, 0 },
+    { "cpu_thread_blocks", 16, 0, 0, 0 },
+    { "cpu_packed_chunk", 25, 0, 0, 0 },
+    { "cpu_packed_min", 10000, 0, 0, 0 },
+    { "gpu_min_cells", 1000000, 0, 0, 0 },
+    { "gpu_db_min_cells", 40000000, 0, 0, 0 },
+    { "gpu_db_score_cells", 49000000, 0, 0, 0 },
+    { "reconstruct_cells", 5000000, 0, 0, 0 },
+    { "read_bytes", 1000000000, 0, 0, 0 } // ~1GB
+};
+
+static Once initialized = ONCE_INIT;
+
+//******************************************************************************
+// PUBLIC
+
+extern void tuneInitialize();
+
+extern long long tuneGet(int param);
+
+extern void tuneSet(int param, long long value);
+
+extern void tuneReset(int param);
+
+extern long long tuneGetDefault(int param);
+
+extern const char* tuneGetName(int param);
+
+extern const char* tuneProfilePath();
+
+extern int tuneWrite(const char* path);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void loadParams();
+
+static int findParam(const char* name);
+
+static void readProfile(const char* path);
+
+static void readEnvironment();
+
+static long long parseValue(const char* str);
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+extern void tuneInitialize() {
+    onceCall(&initialized, loadParams);
+}
+
+extern long long tuneGet(int param) {
+
+    ASSERT(param >= 0 && param < TUNE_PARAMS_LEN, "invalid tune parameter");
+
+    tuneInitialize();
+
+    TuneParam* p = &(params[param]);
+
+    if (p->explicitValue > 0) {
+        return p->explicitValue;
+    }
+
+    if (p->envValue > 0) {
+        return p->envValue;
+    }
+
+    if (p->profileValue > 0) {
+        return p->profileValue;
+    }
+
+    return p->defaultValue;
+}
+
+extern void tuneSet(int param, long long value) {
+    ASSERT(param >= 0 && param < TUNE_PARAMS_LEN, "invalid tune parameter");
+    ASSERT(value > 0, "invalid %s value: %lld", params[param].name, value);
+    params[param].explicitValue = value;
+}
+
+extern void tuneReset(int param) {
+    ASSERT(param >= 0 && param < TUNE_PARAMS_LEN, "invalid tune parameter");
+    params[param].explicitValue = 0;
+}
+
+extern long long tuneGetDefault(int param) {
+    ASSERT(param >= 0 && param < TUNE_PARAMS_LEN, "invalid tune parameter");
+    return params[param].defaultValue;
+}
+
+extern const char* tuneGetName(int param) {
+    ASSERT(param >= 0 && param < TUNE_PARAMS_LEN, "invalid tune parameter");
+    return params[param].name;
+}
+
+extern const char* tuneProfilePath() {
+
+    static char path[4096];
+
+    const char* env = getenv(ENV_PREFIX "TUNE_PROFILE");
+    if (env != NULL && env[0] != '\0') {
+        return env;
+    }
+
+#ifdef _WIN32
+    const char* home = getenv("USERPROFILE");
+#else
+    const char* home = getenv("HOME");
+#endif
+
+    if (home == NULL || home[0] == '\0') {
+        return NULL;
+    }
+
+    int len = snprintf(path, sizeof(path), "%s/%s", home, PROFILE_NAME);
+    if (len < 0 || len >= (int) sizeof(path)) {
+        return NULL;
+    }
+
+    return path;
+}
+
+extern int tuneWrite(const char* path) {
+
+    if (path == NULL) {
+        path = tuneProfilePath();
+    }
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+
+    fprintf(f, "# swsharp tuning profile\n");
+
+    // environment overrides and defaults were not measured, skip them
+    int i;
+    for (i = 0; i < TUNE_PARAMS_LEN; ++i) {
+
+        long long value = params[i].explicitValue;
+        if (value <= 0) {
+            value = params[i].profileValue;
+        }
+
+        if (value > 0) {
+            fprintf(f, "%s %lld\n", params[i].name, value);
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+static void loadParams() {
+    readProfile(tuneProfilePath());
+    readEnvironment();
+}
+
+static int findParam(const char* name) {
+
+    int i;
+    for (i = 0; i < TUNE_PARAMS_LEN; ++i) {
+        if (strcmp(params[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void readProfile(const char* path) {
+
+    if (path == NULL) {
+        return;
+    }
+
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return;
+    }
+
+    char line[256];
+    char name[128];
+    char value[128];
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+
+        if (line[0] == '#' || sscanf(line, "%127s %127s", name, value) != 2) {
+            continue;
+        }
+
+        int param = findParam(name);
+        long long parsed = parseValue(value);
+
+        // unknown or malformed entries come from other versions, skip them
+        if (param == -1 || parsed <= 0) {
+            continue;
+        }
+
+        params[param].profileValue = parsed;
+    }
+
+    fclose(f);
+}
+
+static void readEnvironment() {
+
+    char key[128];
+
+    int i, j;
+    for (i = 0; i < TUNE_PARAMS_LEN; ++i) {
+
+        const char* name = params[i].name;
+        int offset = strlen(ENV_PREFIX);
+
+        strcpy(key, ENV_PREFIX);
+        for (j = 0; name[j] != '\0'; ++j) {
+            key[offset + j] = toupper(name[j]);
+        }
+        key[offset + j] = '\0';
+
+        const char* env = getenv(key);
+        if (env == NULL) {
+            continue;
+        }
+
+        long long value = parseValue(env);
+        ASSERT(value > 0, "invalid %s value: %s", key, env);
+
+        params[i].envValue = value;
+    }
+}
+
+static long long parseValue(const char* str) {
+
+    char* end;
+    long long value = strtoll(str, &end, 10);
+
+    if (end == str || *end != '\0') {
+        return -1;
+    }
+
+    return value;
+}
+
+//******************************************************************************
@@ -0,0 +1,177 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+/**
+@file
+
+@brief Host specific tuning parameters header.
+
+Scheduling constants, such as task chunk sizes and the CPU/GPU switching
+thresholds, depend on the machine they run on. Their values are read from a
+tuning profile, which is written by the swsharptune module, and can be
+overridden explicitly.
+
+The value of a parameter is taken from the first of the following sources that
+defines it:
+    - an explicit tuneSet() call
+    - an environment variable SWSHARP_<NAME>, for example 
+      SWSHARP_CPU_THREAD_CHUNK
+    - the tuning profile, read from the file given by the environment variable
+      SWSHARP_TUNE_PROFILE or from ~/.swsharp_tune if it is not set
+    - the built in default value
+
+The profile is loaded once, on the first tuneGet() call from any thread.
+*/
+
+#ifndef __SW_SHARP_TUNEH__
+#define __SW_SHARP_TUNEH__
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Number of database chains scored in one CPU task.
+*/
+#define TUNE_CPU_THREAD_CHUNK       0
+
+/*!
+@brief Number of interleaved database blocks scored in one CPU task.
+*/
+#define TUNE_CPU_THREAD_BLOCKS      1
+
+/*!
+@brief Number of database alignments solved in one packed CPU task.
+*/
+#define TUNE_CPU_PACKED_CHUNK       2
+
+/*!
+@brief Minimal number of CPU database alignments for which they are packed.
+*/
+#define TUNE_CPU_PACKED_MIN         3
+
+/*!
+@brief Minimal number of cells for which a pairwise alignment is done on GPU.
+*/
+#define TUNE_GPU_MIN_CELLS          4
+
+/*!
+@brief Minimal number of cells for which a database alignment is done on GPU.
+*/
+#define TUNE_GPU_DB_MIN_CELLS       5
+
+/*!
+@brief Minimal number of database cells for which scoring is done on GPU.
+*/
+#define TUNE_GPU_DB_SCORE_CELLS     6
+
+/*!
+@brief Minimal number of cells for which a reconstruction block is split.
+*/
+#define TUNE_RECONSTRUCT_CELLS      7
+
+/*!
+@brief Number of database bytes read at once.
+*/
+#define TUNE_READ_BYTES             8
+
+/*!
+@brief Number of tuning parameters.
+*/
+#define TUNE_PARAMS_LEN             9
+
+/*!
+@brief Loads the tuning profile and the environment overrides.
+
+Function is called implicitly on the first tuneGet() call. The profile is
+loaded only once, further calls have no effect.
+*/
+extern void tuneInitialize();
+
+/*!
+@brief Tuning parameter getter.
+
+@param param tuning parameter, one of the TUNE_* constants
+
+@return value of the parameter
+*/
+extern long long tuneGet(int param);
+
+/*!
+@brief Explicitly overrides a tuning parameter.
+
+Explicit value has priority over the environment and the tuning profile.
+
+@param param tuning parameter, one of the TUNE_* constants
+@param value new parameter value, must be positive
+*/
+extern void tuneSet(int param, long long value);
+
+/*!
+@brief Removes the explicit override of a tuning parameter.
+
+@param param tuning parameter, one of the TUNE_* constants
+*/
+extern void tuneReset(int param);
+
+/*!
+@brief Tuning parameter default value getter.
+
+@param param tuning parameter, one of the TUNE_* constants
+
+@return built in default value of the parameter
+*/
+extern long long tuneGetDefault(int param);
+
+/*!
+@brief Tuning parameter name getter.
+
+Name is used as the key in the tuning profile.
+
+@param param tuning parameter, one of the TUNE_* constants
+
+@return name of the parameter
+*/
+extern const char* tuneGetName(int param);
+
+/*!
+@brief Default tuning profile path getter.
+
+@return path to the profile file, NULL if it can not be determined
+*/
+extern const char* tuneProfilePath();
+
+/*!
+@brief Writes the calibrated parameter values as a tuning profile.
+
+Only values set with tuneSet() and values loaded from the previous profile are
+written. Environment overrides and built in defaults are left out.
+
+@param path output file path, if NULL tuneProfilePath() is used
+
+@return 0 on success, -1 if the file can not be written
+*/
+extern int tuneWrite(const char* path);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __SW_SHARP_TUNEH__
@@ -6,6 +6,8 @@
 #include "swsharp/evalue.h"
 #include "swsharp/swsharp.h"
 
+#include "process_module.h"
+
 #define ASSERT(expr, fmt, ...)\
     do {\
         if (!(expr)) {\
@@ -21,6 +23,13 @@ typedef struct CharInt {
     const int code;
 } CharInt;
 
+typedef int (*ReadPartFunction)(Chain***, int*, FILE*, int, const size_t);
+
+typedef struct StreamOutput {
+    FILE* file;
+    int format;
+} StreamOutput;
+
 typedef struct ValueFunctionParam {
     Scorer* scorer;
     int totalLength;
@@ -39,8 +48,14 @@ static struct option options[] = {
     {"max-aligns", required_argument, 0, 'M'},
     {"algorithm", required_argument, 0, 'A'},
     {"nocache", no_argument, 0, 'C'},
+    {"hit-cache", required_argument, 0, 'H'},
+    {"incremental", required_argument, 0, 'I'},
+    {"query-batch", required_argument, 0, 'B'},
+    {"lazy-names", no_argument, 0, 'L'},
+    {"both-strands", no_argument, 0, 'S'},
     {"cpu", no_argument, 0, 'P'},
     {"threads", required_argument, 0, 'T'},
+    {"processes", required_argument, 0, 'p'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
 };
@@ -49,7 +64,8 @@ static CharInt outFormats[] = {
     { "bm0", SW_OUT_DB_BLASTM0 },
     { "bm8", SW_OUT_DB_BLASTM8 },
     { "bm9", SW_OUT_DB_BLASTM9 },
-    { "light", SW_OUT_DB_LIGHT }
+    { "light", SW_OUT_DB_LIGHT },
+    { "dump", SW_OUT_DB_DUMP }
 };
 
 static CharInt algorithms[] = {
@@ -69,6 +85,22 @@ static int getAlgorithm(char* optarg);
 static void valueFunction(double* values, int* scores, Chain* query, 
     Chain** database, int databaseLen, int* cards, int cardsLen, void* param);
 
+static void outputStreamed(int queryIdx, DbAlignment** dbAlignments, 
+    int dbAlignmentsLen, void* param);
+
+static int readIncremental(DbAlignment**** dbAlignments, int** dbAlignmentsLens, 
+    Chain*** chains, int* chainsLen, int type, Chain** queries, int queriesLen, 
+    char* databasePath, Scorer* scorer, int maxAlignments, float maxEValue, 
+    EValueParams* eValueParams, int* cards, int cardsLen, char* path);
+
+static int readQueryBatch(Chain*** queries, int* queriesLen, FILE* handle, 
+    int serialized, size_t bytes);
+
+static void addComplements(Chain*** queries, int* queriesLen);
+
+static void mergeStrands(DbAlignment*** dbAlignments, int* dbAlignmentsLens, 
+    int dbAlignmentsLen, int maxAlignments);
+
 int main(int argc, char* argv[]) {
 
     char* queryPath = NULL;
@@ -92,10 +124,22 @@ int main(int argc, char* argv[]) {
     
     int cache = 1;
 
+    char* hitCachePath = NULL;
+
+    char* incrementalPath = NULL;
+
+    size_t queryBatch = 0;
+
+    int lazyNames = 0;
+
+    int bothStrands = 0;
+
     int forceCpu = 0;
 
     int threads = 8;
 
+    int processes = 1;
+
     while (1) {
 
         char argument = getopt_long(argc, argv, "i:j:g:e:hT:", options, NULL);
@@ -141,12 +185,30 @@ int main(int argc, char* argv[]) {
         case 'C':
             cache = 0;
             break;
+        case 'H':
+            hitCachePath = optarg;
+            break;
+        case 'I':
+            incrementalPath = optarg;
+            break;
+        case 'B':
+            queryBatch = (size_t) atoll(optarg) * 1024 * 1024;
+            break;
+        case 'L':
+            lazyNames = 1;
+            break;
+        case 'S':
+            bothStrands = 1;
+            break;
         case 'P':
             forceCpu = 1;
             break;
         case 'T':
             threads = atoi(optarg);
             break;
+        case 'p':
+            processes = atoi(optarg);
+            break;
         case 'h':
         default:
             help();
@@ -172,16 +234,28 @@ int main(int argc, char* argv[]) {
     ASSERT(maxEValue > 0, "invalid evalue");
     
     ASSERT(threads >= 0, "invalid thread number");
-    threadPoolInitialize(threads);
+
+    ASSERT(processes > 0, "invalid process number");
+    ASSERT(processes == 1 || cardsLen == 0, "processes are supported only with --cpu");
+    ASSERT(processes == 1 || incrementalPath == NULL, 
+        "incremental search is not supported with processes");
+    ASSERT(queryBatch == 0 || incrementalPath == NULL, 
+        "incremental search is not supported with query batches");
+    ASSERT(queryBatch == 0 || outFormat != SW_OUT_DB_DUMP, 
+        "dump output is not supported with query batches");
+    ASSERT(!bothStrands || incrementalPath == NULL, 
+        "incremental search is not supported with both strands");
+
+    // workers create their own thread pools after the fork
+    if (processes == 1) {
+        threadPoolInitialize(threads);
+    }
 
     Scorer* scorer;
     scorerCreateMatrix(&scorer, matrix, gapOpen, gapExtend);
     
-    Chain** queries = NULL;
-    int queriesLen = 0;
-    readFastaChains(&queries, &queriesLen, queryPath);
-    
-    if (cache) {
+    // workers map the serialized database, generations are recorded with it
+    if (cache || processes > 1 || incrementalPath != NULL) {
         dumpFastaChains(databasePath);
     }
 
@@ -191,132 +265,330 @@ int main(int argc, char* argv[]) {
 
     EValueParams* eValueParams = createEValueParams(cells, scorer);
 
-    DbAlignment*** dbAlignments = NULL;
-    int* dbAlignmentsLens = NULL;
+    HitCache* hitCache = NULL;
+
+    if (hitCachePath != NULL) {
+        hitCache = hitCacheCreate(hitCachePath, hitCacheDatabaseId(databasePath));
+    }
+
+    Chain** queries = NULL;
+    int queriesLen = 0;
+
+    FILE* queryHandle;
+    int querySerialized;
+
+    FILE* outFile = NULL;
+
+    if (queryBatch > 0) {
+
+        // serialized chains are indexed against the whole file, batches are 
+        // therefore read from the fasta file
+        queryHandle = fopen(queryPath, "r");
+        querySerialized = 0;
+
+        ASSERT(queryHandle != NULL, "cannot open %s", queryPath);
+
+        // batches are appended to a single output
+        outFile = out == NULL ? stdout : fopen(out, "w");
+
+        ASSERT(outFile != NULL, "cannot open %s", out);
+
+    } else {
+        readFastaChainsPartInit(&queries, &queriesLen, &queryHandle, 
+            &querySerialized, queryPath);
+    }
 
     Chain** database = NULL; 
     int databaseLen = 0;
-    int databaseStart = 0;
-    int databaseEnd = 0;
 
-    FILE* handle;
-    int serialized;
+    // database read in a single part is searched by all query batches
+    ChainDatabase* residentDatabase = NULL;
 
-    readFastaChainsPartInit(&database, &databaseLen, &handle, &serialized, databasePath);
+    int queryStatus = 1;
 
-    size_t cudaMemory = cudaMinimalGlobalMemory(cards, cardsLen);
-    size_t cudaMemoryMax = cudaMemory - 200000000; // ~200MB breathing space
-    size_t cudaMemoryStep = cudaMemoryMax * 0.075;
+    while (queryStatus) {
 
-    int i, j;
+        queryStatus = readQueryBatch(&queries, &queriesLen, queryHandle, 
+            querySerialized, queryBatch);
 
-    while (1) {
+        // every query is followed by its complement, equal lengths let them
+        // be scored in a single pass over the database
+        if (bothStrands) {
+            addComplements(&queries, &queriesLen);
+        }
+
+        DbAlignment*** dbAlignments = NULL;
+        int* dbAlignmentsLens = NULL;
+
+        // stored results of the previous generation
+        DbAlignment*** dbAlignmentsStored = NULL;
+        int* dbAlignmentsStoredLens = NULL;
 
-        int status = 1;
+        Chain** storedChains = NULL;
+        int storedChainsLen = 0;
 
-        if (cardsLen == 0) {
+        int databaseSkip = 0;
 
-            status &= readFastaChainsPart(&database, &databaseLen, handle,
-                serialized, 1000000000); // ~1GB
+        int streamed = 0;
+
+        if (incrementalPath != NULL) {
+            databaseSkip = readIncremental(&dbAlignmentsStored, 
+                &dbAlignmentsStoredLens, &storedChains, &storedChainsLen, 
+                algorithm, queries, queriesLen, databasePath, scorer, 
+                maxAlignments, maxEValue, eValueParams, cards, cardsLen, 
+                incrementalPath);
+        }
+
+        if (databaseSkip == chains) {
+
+            // nothing was appended, stored results are the results
+            dbAlignments = dbAlignmentsStored;
+            dbAlignmentsLens = dbAlignmentsStoredLens;
+
+            dbAlignmentsStored = NULL;
+
+        } else if (processes > 1) {
+
+            shotgunDatabaseProcesses(&dbAlignments, &dbAlignmentsLens, &database, 
+                &databaseLen, algorithm, queries, queriesLen, databasePath, scorer, 
+                maxAlignments, valueFunction, (void*) eValueParams, maxEValue, 
+                hitCache, processes, threads);
+
+        } else if (residentDatabase != NULL && !bothStrands) {
+
+            // batch results are appended to the output one query at a time,
+            // there is no need to hold the alignments of the whole batch
+            StreamOutput streamOutput = { outFile, outFormat };
+
+            shotgunDatabaseStream(algorithm, queries, queriesLen, 
+                residentDatabase, scorer, maxAlignments, valueFunction, 
+                (void*) eValueParams, maxEValue, NULL, 0, cards, cardsLen, NULL, 
+                outputStreamed, &streamOutput, NULL);
+
+            streamed = 1;
+
+        } else if (residentDatabase != NULL) {
+
+            shotgunDatabase(&dbAlignments, &dbAlignmentsLens, algorithm, queries, 
+                queriesLen, residentDatabase, scorer, maxAlignments, valueFunction, 
+                (void*) eValueParams, maxEValue, NULL, 0, cards, cardsLen, NULL);
 
         } else {
+            int databaseStart = 0;
+            int databaseEnd = 0;
+
+            FILE* handle;
+            int serialized;
+
+            readFastaChainsPartInit(&database, &databaseLen, &handle, &serialized, 
+                databasePath);
+
+            // chains of the stored generation are already searched
+            if (databaseSkip > 0) {
+                skipFastaChainsPart(&database, &databaseLen, handle, serialized, 
+                    databaseSkip);
+                databaseStart = databaseLen;
+                databaseEnd = databaseLen;
+            }
+
+            // names of lazy chains are read from the database when outputted
+            ReadPartFunction readPart = lazyNames ? readFastaChainsPartLazy : 
+                readFastaChainsPart;
+
+            size_t cudaMemory = cudaMinimalGlobalMemory(cards, cardsLen);
+            size_t cudaMemoryMax = cudaMemory - 200000000; // ~200MB breathing space
+            size_t cudaMemoryStep = cudaMemoryMax * 0.075;
+
+            int i, j;
 
             while (1) {
 
-                databaseLen = databaseEnd;
+                int status = 1;
+
+                if (cardsLen == 0) {
+
+                    status &= readPart(&database, &databaseLen, handle, serialized, 
+                        tuneGet(TUNE_READ_BYTES));
+
+                } else {
+
+                    while (1) {
 
-                status &= readFastaChainsPart(&database, &databaseLen, handle,
-                    serialized, cudaMemoryStep);
+                        databaseLen = databaseEnd;
 
-                size_t cudaMemoryMin = chainDatabaseGpuMemoryConsumption(
-                    database + databaseStart, databaseLen - databaseStart);
+                        status &= readPart(&database, &databaseLen, handle,
+                            serialized, cudaMemoryStep);
 
-                // evalue
-                cudaMemoryMin += 16 * (databaseLen - databaseStart);
+                        size_t cudaMemoryMin = chainDatabaseGpuMemoryConsumption(
+                            database + databaseStart, databaseLen - databaseStart);
 
-                if (cudaMemoryMin > cudaMemoryMax || 
-                    (status == 1 && databaseEnd > databaseStart && cudaMemoryMin > 500000000)) {
+                        // evalue
+                        cudaMemoryMin += 16 * (databaseLen - databaseStart);
 
-                    int holder = databaseLen;
-                    databaseLen = databaseEnd;
-                    databaseEnd = holder;
+                        if (cudaMemoryMin > cudaMemoryMax || 
+                            (status == 1 && databaseEnd > databaseStart && 
+                            cudaMemoryMin > 500000000)) {
 
-                    if (databaseLen <= databaseStart) {
-                        ASSERT(0, "cannot read database into CUDA memory");
+                            int holder = databaseLen;
+                            databaseLen = databaseEnd;
+                            databaseEnd = holder;
+
+                            if (databaseLen <= databaseStart) {
+                                ASSERT(0, "cannot read database into CUDA memory");
+                            }
+
+                            status = 1;
+
+                            break;
+                        } else {
+                            databaseEnd = databaseLen;
+                        }
+
+                        if (status == 0) {
+                            break;
+                        }
                     }
+                }
 
-                    status = 1;
+                ChainDatabase* chainDatabase = chainDatabaseCreate(database, 
+                    databaseStart, databaseLen - databaseStart, cards, cardsLen);
 
-                    break;
+                chainDatabaseSetHitCache(chainDatabase, hitCache);
+
+                DbAlignment*** dbAlignmentsPart = NULL;
+                int* dbAlignmentsPartLens = NULL;
+
+                shotgunDatabase(&dbAlignmentsPart, &dbAlignmentsPartLens, 
+                    algorithm, queries, queriesLen, chainDatabase, scorer, 
+                    maxAlignments, valueFunction, (void*) eValueParams, maxEValue, 
+                    NULL, 0, cards, cardsLen, NULL);
+
+                if (dbAlignments == NULL) {
+                    dbAlignments = dbAlignmentsPart;
+                    dbAlignmentsLens = dbAlignmentsPartLens;
+                 } else {
+                    dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
+                        dbAlignmentsPartLens, queriesLen, maxAlignments);
+                    deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, 
+                        queriesLen);
+                }
+
+                if (status == 0 && databaseStart == 0 && queryBatch > 0) {
+                    residentDatabase = chainDatabase;
                 } else {
-                    databaseEnd = databaseLen;
+                    chainDatabaseDelete(chainDatabase);
                 }
 
                 if (status == 0) {
                     break;
                 }
+
+                // delete all unused chains
+                char* usedMask = (char*) calloc(databaseLen, sizeof(char));
+
+                for (i = 0; i < queriesLen; ++i) {
+                    for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+
+                        DbAlignment* dbAlignment = dbAlignments[i][j];
+                        int targetIdx = dbAlignmentGetTargetIdx(dbAlignment);
+
+                        usedMask[targetIdx] = 1;
+                    }
+                }
+
+                for (i = 0; i < databaseLen; ++i) {
+                    if (!usedMask[i] && database[i] != NULL) {
+                        chainDelete(database[i]);
+                        database[i] = NULL;
+                    }
+                }
+
+                free(usedMask);
+
+                databaseStart = databaseLen;
             }
+
+            fclose(handle);
         }
 
-        ChainDatabase* chainDatabase = chainDatabaseCreate(database, 
-            databaseStart, databaseLen - databaseStart, cards, cardsLen);
+        int resultsLen = queriesLen;
 
-        DbAlignment*** dbAlignmentsPart = NULL;
-        int* dbAlignmentsPartLens = NULL;
+        if (bothStrands) {
+            mergeStrands(dbAlignments, dbAlignmentsLens, queriesLen, 
+                maxAlignments);
+            resultsLen = queriesLen / 2;
+        }
+
+        if (dbAlignmentsStored != NULL) {
 
-        shotgunDatabase(&dbAlignmentsPart, &dbAlignmentsPartLens, algorithm, 
-            queries, queriesLen, chainDatabase, scorer, maxAlignments, valueFunction, 
-            (void*) eValueParams, maxEValue, NULL, 0, cards, cardsLen, NULL);
+            dbAlignmentsMerge(dbAlignmentsStored, dbAlignmentsStoredLens, dbAlignments, 
+                dbAlignmentsLens, queriesLen, maxAlignments);
+            deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
 
-        if (dbAlignments == NULL) {
-            dbAlignments = dbAlignmentsPart;
-            dbAlignmentsLens = dbAlignmentsPartLens;
-         } else {
-            dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
-                dbAlignmentsPartLens, queriesLen, maxAlignments);
-            deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
+            dbAlignments = dbAlignmentsStored;
+            dbAlignmentsLens = dbAlignmentsStoredLens;
         }
 
-        chainDatabaseDelete(chainDatabase);
+        // complements are merged into their queries, there is no record of 
+        // the searched strands
+        Chain** searchQueries = bothStrands ? NULL : queries;
 
-        if (status == 0) {
-            break;
+        if (incrementalPath != NULL) {
+            outputShotgunDatabaseGeneration(dbAlignments, dbAlignmentsLens, 
+                resultsLen, incrementalPath, chains, cells, searchQueries, 
+                algorithm, maxAlignments, maxEValue);
+        }
+
+        if (streamed) {
+            // alignments are already written and deleted by outputStreamed
+        } else if (outFile != NULL) {
+            outputShotgunDatabaseFile(dbAlignments, dbAlignmentsLens, resultsLen, 
+                outFile, outFormat);
+        } else if (outFormat == SW_OUT_DB_DUMP) {
+            outputShotgunDatabaseGeneration(dbAlignments, dbAlignmentsLens, 
+                resultsLen, out, chains, cells, searchQueries, algorithm, 
+                maxAlignments, maxEValue);
+        } else {
+            outputShotgunDatabase(dbAlignments, dbAlignmentsLens, resultsLen, out, 
+                outFormat);
         }
 
-        // delete all unused chains
-        char* usedMask = (char*) calloc(databaseLen, sizeof(char));
+        if (!streamed) {
+            deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, resultsLen);
+        }
 
-        for (i = 0; i < queriesLen; ++i) {
-            for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+        deleteFastaChains(queries, queriesLen);
+        deleteFastaChains(storedChains, storedChainsLen);
 
-                DbAlignment* dbAlignment = dbAlignments[i][j];
-                int targetIdx = dbAlignmentGetTargetIdx(dbAlignment);
+        queries = NULL;
+        queriesLen = 0;
 
-                usedMask[targetIdx] = 1;
-            }
+        // resident database outlives the batch
+        if (residentDatabase == NULL) {
+            deleteFastaChains(database, databaseLen);
+            database = NULL;
+            databaseLen = 0;
         }
 
-        for (i = 0; i < databaseLen; ++i) {
-            if (!usedMask[i] && database[i] != NULL) {
-                chainDelete(database[i]);
-                database[i] = NULL;
-            }
-        }
+    }
 
-        free(usedMask);
+    fclose(queryHandle);
 
-        databaseStart = databaseLen;
+    if (outFile != NULL && outFile != stdout) {
+        fclose(outFile);
     }
 
-    fclose(handle);
+    if (residentDatabase != NULL) {
+        chainDatabaseDelete(residentDatabase);
+    }
 
-    outputShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen, out, outFormat);
-    deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
+    deleteFastaChains(database, databaseLen);
 
     deleteEValueParams(eValueParams);
 
-    deleteFastaChains(queries, queriesLen);
-    deleteFastaChains(database, databaseLen);
+    if (hitCache != NULL) {
+        hitCacheDelete(hitCache);
+    }
 
     scorerDelete(scorer);
 
@@ -368,6 +640,213 @@ static void valueFunction(double* values, int* scores, Chain* query,
     eValues(values, scores, query, database, databaseLen, cards, cardsLen, eValueParams);
 }
 
+static void outputStreamed(int queryIdx, DbAlignment** dbAlignments, 
+    int dbAlignmentsLen, void* param) {
+
+    StreamOutput* output = (StreamOutput*) param;
+
+    outputShotgunDatabaseFile(&dbAlignments, &dbAlignmentsLen, 1, output->file, 
+        output->format);
+
+    deleteDatabase(dbAlignments, dbAlignmentsLen);
+}
+
+static int readIncremental(DbAlignment**** dbAlignments, int** dbAlignmentsLens, 
+    Chain*** chains, int* chainsLen, int type, Chain** queries, int queriesLen, 
+    char* databasePath, Scorer* scorer, int maxAlignments, float maxEValue, 
+    EValueParams* eValueParams, int* cards, int cardsLen, char* path) {
+
+    FILE* file = fopen(path, "rb");
+
+    // first run, everything is searched
+    if (file == NULL) {
+        return 0;
+    }
+
+    fclose(file);
+
+    int databaseLen;
+    long long databaseCells;
+    readShotgunDatabaseGeneration(&databaseLen, &databaseCells, path);
+
+    ASSERT(databaseLen > 0, "%s has no database generation", path);
+
+    // stored alignments are merged with the new ones by the query position
+    if (!checkShotgunDatabaseSearch(path, queries, queriesLen, type, 
+            maxAlignments, maxEValue)) {
+        fprintf(stderr, "[WARNING]: %s has results of different queries or "
+            "search arguments, whole database is searched\n", path);
+        return 0;
+    }
+
+    int* generationsChains;
+    long long* generationsCells;
+    int generationsLen;
+    statFastaChainsGenerations(&generationsChains, &generationsCells, 
+        &generationsLen, databasePath);
+
+    int generation = -1;
+
+    int i, j;
+    for (i = 0; i < generationsLen; ++i) {
+        if (generationsChains[i] == databaseLen && 
+            generationsCells[i] == databaseCells) {
+            generation = i;
+        }
+    }
+
+    ASSERT(generation != -1, "%s is not a generation of %s", path, databasePath);
+
+    free(generationsChains);
+    free(generationsCells);
+
+    int dbAlignmentsLen;
+    Scorer* storedScorer;
+
+    readShotgunDatabase(dbAlignments, dbAlignmentsLens, &dbAlignmentsLen, 
+        chains, chainsLen, &storedScorer, path, NULL, 0);
+
+    ASSERT(storedScorer == NULL || (
+        strcmp(scorerGetName(storedScorer), scorerGetName(scorer)) == 0 && 
+        scorerGetGapOpen(storedScorer) == scorerGetGapOpen(scorer) && 
+        scorerGetGapExtend(storedScorer) == scorerGetGapExtend(scorer)), 
+        "%s has results of a different scorer", path);
+
+    // evalues grow with the database, recompute them and filter again
+    for (i = 0; i < queriesLen; ++i) {
+
+        DbAlignment** stored = (*dbAlignments)[i];
+        int storedLen = (*dbAlignmentsLens)[i];
+
+        Chain** targets = (Chain**) malloc(storedLen * sizeof(Chain*) + 1);
+        int* scores = (int*) malloc(storedLen * sizeof(int) + 1);
+        double* values = (double*) malloc(storedLen * sizeof(double) + 1);
+
+        for (j = 0; j < storedLen; ++j) {
+            targets[j] = dbAlignmentGetTarget(stored[j]);
+            scores[j] = dbAlignmentGetScore(stored[j]);
+        }
+
+        valueFunction(values, scores, queries[i], targets, storedLen, cards, 
+            cardsLen, (void*) eValueParams);
+
+        int len = 0;
+
+        for (j = 0; j < storedLen; ++j) {
+
+            DbAlignment* dbAlignment = stored[j];
+
+            if (values[j] > maxEValue) {
+                dbAlignmentDelete(dbAlignment);
+                continue;
+            }
+
+            int pathLen = dbAlignmentGetPathLen(dbAlignment);
+            char* alignmentPath = (char*) malloc(pathLen);
+            dbAlignmentCopyPath(dbAlignment, alignmentPath);
+
+            stored[len++] = dbAlignmentCreate(dbAlignmentGetQuery(dbAlignment), 
+                dbAlignmentGetQueryStart(dbAlignment), 
+                dbAlignmentGetQueryEnd(dbAlignment), 
+                dbAlignmentGetQueryIdx(dbAlignment), 
+                dbAlignmentGetTarget(dbAlignment), 
+                dbAlignmentGetTargetStart(dbAlignment), 
+                dbAlignmentGetTargetEnd(dbAlignment), 
+                dbAlignmentGetTargetIdx(dbAlignment), values[j], 
+                dbAlignmentGetScore(dbAlignment), scorer, alignmentPath, 
+                pathLen);
+
+            dbAlignmentDelete(dbAlignment);
+        }
+
+        (*dbAlignmentsLens)[i] = len;
+
+        free(targets);
+        free(scores);
+        free(values);
+    }
+
+    if (storedScorer != NULL) {
+        scorerDelete(storedScorer);
+    }
+
+    return databaseLen;
+}
+
+static int readQueryBatch(Chain*** queries, int* queriesLen, FILE* handle, 
+    int serialized, size_t bytes) {
+
+    int status = readFastaChainsPart(queries, queriesLen, handle, serialized, 
+        bytes);
+
+    // query larger than the budget, budget is grown until it fits
+    while (status == 1 && *queriesLen == 0) {
+        bytes *= 2;
+        status = readFastaChainsPart(queries, queriesLen, handle, serialized, 
+            bytes);
+    }
+
+    return status;
+}
+
+static void addComplements(Chain*** queries, int* queriesLen) {
+
+    int length = *queriesLen;
+
+    *queries = (Chain**) realloc(*queries, 2 * length * sizeof(Chain*));
+
+    int i;
+    for (i = length - 1; i >= 0; --i) {
+
+        Chain* query = (*queries)[i];
+        Chain* complement = createChainComplement(query);
+
+        // tabular formats cut names at the first space, prefix is attached
+        // to the name so the query id stays visible for the other strand
+        const char prefix[] = "complement:";
+
+        const char* name = chainGetName(query);
+        int nameLen = strlen(name) + sizeof(prefix) - 1;
+
+        char* newName = (char*) malloc(nameLen + 1);
+        sprintf(newName, "%s%s", prefix, name);
+
+        int stringLen = chainGetLength(complement);
+        char* string = (char*) malloc(stringLen * sizeof(char));
+
+        int j;
+        for (j = 0; j < stringLen; ++j) {
+            string[j] = chainGetChar(complement, j);
+        }
+
+        (*queries)[2 * i] = query;
+        (*queries)[2 * i + 1] = chainCreate(newName, nameLen, string, stringLen);
+
+        chainDelete(complement);
+        free(newName);
+        free(string);
+    }
+
+    *queriesLen = 2 * length;
+}
+
+static void mergeStrands(DbAlignment*** dbAlignments, int* dbAlignmentsLens, 
+    int dbAlignmentsLen, int maxAlignments) {
+
+    int i;
+    for (i = 0; i < dbAlignmentsLen / 2; ++i) {
+
+        dbAlignmentsMerge(dbAlignments + 2 * i, dbAlignmentsLens + 2 * i, 
+            dbAlignments + 2 * i + 1, dbAlignmentsLens + 2 * i + 1, 1, 
+            maxAlignments);
+
+        deleteDatabase(dbAlignments[2 * i + 1], dbAlignmentsLens[2 * i + 1]);
+
+        dbAlignments[i] = dbAlignments[2 * i];
+        dbAlignmentsLens[i] = dbAlignmentsLens[2 * i];
+    }
+}
+
 static void help() {
     printf(
     "usage: swsharpdb -i <query db file> -j <target db file> [arguments ...]\n"
@@ -426,14 +905,48 @@ static void help() {
     "            bm8      - blast m8 tabular output format\n"
     "            bm9      - blast m9 commented tabular output format\n"
     "            light    - score-name tabbed output\n"
+    "            dump     - binary format for usage with swsharpout\n"
     "    --nocache\n"
     "        serialized database is stored to speed up future runs with the\n"
     "        same database, option disables this behaviour\n"
+    "    --hit-cache <dir>\n"
+    "        default: none\n"
+    "        directory of the persistent hits cache, hits of every query are\n"
+    "        stored there and repeated queries with the same database, scorer,\n"
+    "        algorithm, --max-aligns and --evalue are not scored again\n"
+    "    --incremental <file>\n"
+    "        default: none\n"
+    "        results of the previous run in the dump format, if the file exists\n"
+    "        only the database sequences appended since its database generation\n"
+    "        are searched and merged with it, the file is then updated with the\n"
+    "        merged results, database must only grow by appending sequences,\n"
+    "        if the queries, --algorithm, --max-aligns or --evalue differ from\n"
+    "        the previous run the whole database is searched\n"
+    "    --lazy-names\n"
+    "        database chain names are not held in memory, names of the\n"
+    "        outputted chains are read from the database file, alignments with\n"
+    "        equal evalue and score are ordered by the database index instead\n"
+    "        of the name, ignored with --processes\n"
+    "    --both-strands\n"
+    "        nucleotide queries are searched with their complements as well,\n"
+    "        both strands are scored in a single pass over the database and\n"
+    "        the best alignments of either strand are outputted for the query,\n"
+    "        not supported with --incremental\n"
+    "    --query-batch <int>\n"
+    "        default: 0\n"
+    "        size of query batches in megabytes, queries are read, searched and\n"
+    "        outputted one batch at a time which bounds the memory used by\n"
+    "        large query files, 0 reads all queries at once, not supported\n"
+    "        with --incremental or the dump out format\n"
     "    --cpu\n"
     "        only cpu is used\n"
     "    -T --threads <int>\n"
     "        default: 8\n"
     "        number of threads used in thread pool\n"
+    "    --processes <int>\n"
+    "        default: 1\n"
+    "        number of worker processes, each searching its own part of the\n"
+    "        database with its own thread pool, only supported with --cpu\n"
     "    -h, -help\n"
     "        prints out the help\n");
 }
@@ -0,0 +1,573 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "swsharp/swsharp.h"
+
+#include "process_module.h"
+
+#define ASSERT(expr, fmt, ...)\
+    do {\
+        if (!(expr)) {\
+            fprintf(stderr, "[ERROR]: " fmt "\n", ##__VA_ARGS__);\
+            exit(-1);\
+        }\
+    } while(0)
+
+typedef struct DatabaseMap {
+    char* data;
+    size_t size;
+    int chainsLen;
+    size_t* offsets;
+    int* sizes;
+} DatabaseMap;
+
+typedef struct Context {
+    int type;
+    Chain** queries;
+    int queriesLen;
+    Scorer* scorer;
+    int maxAlignments;
+    ValueFunction valueFunction;
+    void* valueFunctionParam;
+    double valueThreshold;
+    int threads;
+    HitCache* hitCache;
+    DatabaseMap* databaseMap;
+} Context;
+
+//******************************************************************************
+// PUBLIC
+
+extern void shotgunDatabaseProcesses(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, Chain*** database, int* databaseLen, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, 
+    int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, HitCache* hitCache, int processes, int threads);
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+#ifndef _WIN32
+
+static void workerSearch(Context* context, int start, int end, 
+    const char* name);
+
+static void readWorkerResults(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, Chain** database, Context* context, 
+    const char* name);
+
+static DatabaseMap* databaseMapCreate(const char* databasePath);
+
+static void databaseMapDelete(DatabaseMap* databaseMap);
+
+static Chain* databaseMapGetChain(DatabaseMap* databaseMap, int idx);
+
+#endif
+
+//******************************************************************************
+
+//******************************************************************************
+// PUBLIC
+
+#ifndef _WIN32
+
+extern void shotgunDatabaseProcesses(DbAlignment**** dbAlignments_, 
+    int** dbAlignmentsLens_, Chain*** database_, int* databaseLen_, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, 
+    int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, HitCache* hitCache, int processes, int threads) {
+
+    int i;
+
+    DatabaseMap* databaseMap = databaseMapCreate(databasePath);
+    int chains = databaseMap->chainsLen;
+
+    Context* context = (Context*) malloc(sizeof(Context));
+    context->type = type;
+    context->queries = queries;
+    context->queriesLen = queriesLen;
+    context->scorer = scorer;
+    context->maxAlignments = maxAlignments;
+    context->valueFunction = valueFunction;
+    context->valueFunctionParam = valueFunctionParam;
+    context->valueThreshold = valueThreshold;
+    context->threads = threads;
+    context->hitCache = hitCache;
+    context->databaseMap = databaseMap;
+
+    //**************************************************************************
+    // SPLIT THE DATABASE INTO SHARDS OF SIMILAR SIZE
+
+    size_t bytes = 0;
+    for (i = 0; i < chains; ++i) {
+        bytes += databaseMap->sizes[i];
+    }
+
+    int* shards = (int*) malloc((processes + 1) * sizeof(int));
+    shards[0] = 0;
+
+    size_t shardBytes = 0;
+    int shard = 1;
+
+    for (i = 0; i < chains && shard < processes; ++i) {
+
+        shardBytes += databaseMap->sizes[i];
+
+        while (shard < processes && shardBytes * processes >= bytes * shard) {
+            shards[shard++] = i + 1;
+        }
+    }
+
+    while (shard <= processes) {
+        shards[shard++] = chains;
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // FORK WORKERS
+
+    char** names = (char**) malloc(processes * sizeof(char*));
+    pid_t* pids = (pid_t*) malloc(processes * sizeof(pid_t));
+
+    for (i = 0; i < processes; ++i) {
+        names[i] = (char*) malloc(64);
+        sprintf(names[i], "/swsharpdb.%d.%d", (int) getpid(), i);
+    }
+
+    // children would output the buffered data again
+    fflush(NULL);
+
+    for (i = 0; i < processes; ++i) {
+
+        pids[i] = fork();
+        ASSERT(pids[i] != -1, "cannot fork worker process");
+
+        if (pids[i] == 0) {
+            workerSearch(context, shards[i], shards[i + 1], names[i]);
+            _exit(0);
+        }
+    }
+
+    int failed = 0;
+
+    for (i = 0; i < processes; ++i) {
+
+        int status;
+        waitpid(pids[i], &status, 0);
+
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+
+    if (failed) {
+
+        for (i = 0; i < processes; ++i) {
+            shm_unlink(names[i]);
+        }
+
+        ASSERT(0, "worker process failed");
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // GATHER AND MERGE THE RESULTS
+
+    DbAlignment*** dbAlignments = 
+        (DbAlignment***) calloc(queriesLen, sizeof(DbAlignment**));
+    int* dbAlignmentsLens = (int*) calloc(queriesLen, sizeof(int));
+
+    Chain** database = (Chain**) calloc(chains, sizeof(Chain*));
+
+    for (i = 0; i < processes; ++i) {
+        readWorkerResults(dbAlignments, dbAlignmentsLens, database, context, 
+            names[i]);
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // CLEAN MEMORY
+
+    for (i = 0; i < processes; ++i) {
+        free(names[i]);
+    }
+
+    free(names);
+    free(pids);
+    free(shards);
+    free(context);
+
+    databaseMapDelete(databaseMap);
+
+    //**************************************************************************
+
+    *dbAlignments_ = dbAlignments;
+    *dbAlignmentsLens_ = dbAlignmentsLens;
+    *database_ = database;
+    *databaseLen_ = chains;
+}
+
+#else
+
+extern void shotgunDatabaseProcesses(DbAlignment**** dbAlignments_, 
+    int** dbAlignmentsLens_, Chain*** database_, int* databaseLen_, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, 
+    int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, HitCache* hitCache, int processes, int threads) {
+    ASSERT(0, "worker processes are not supported on windows");
+}
+
+#endif
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+#ifndef _WIN32
+
+//------------------------------------------------------------------------------
+// WORKERS
+
+static void workerSearch(Context* context, int start, int end, 
+    const char* name) {
+
+    int i, j;
+
+    int queriesLen = context->queriesLen;
+    DatabaseMap* databaseMap = context->databaseMap;
+
+    threadPoolInitialize(context->threads);
+
+    Chain** database = (Chain**) calloc(databaseMap->chainsLen, sizeof(Chain*));
+
+    DbAlignment*** dbAlignments = 
+        (DbAlignment***) calloc(queriesLen, sizeof(DbAlignment**));
+    int* dbAlignmentsLens = (int*) calloc(queriesLen, sizeof(int));
+
+    //**************************************************************************
+    // SOLVE THE SHARD IN PARTS
+
+    size_t readBytes = (size_t) tuneGet(TUNE_READ_BYTES);
+
+    int partStart = start;
+
+    while (partStart < end) {
+
+        size_t bytes = databaseMap->sizes[partStart];
+        int partEnd = partStart + 1;
+
+        while (partEnd < end && bytes + databaseMap->sizes[partEnd] <= readBytes) {
+            bytes += databaseMap->sizes[partEnd];
+            partEnd++;
+        }
+
+        for (i = partStart; i < partEnd; ++i) {
+            database[i] = databaseMapGetChain(databaseMap, i);
+        }
+
+        ChainDatabase* chainDatabase = chainDatabaseCreate(database, partStart, 
+            partEnd - partStart, NULL, 0);
+
+        chainDatabaseSetHitCache(chainDatabase, context->hitCache);
+
+        DbAlignment*** dbAlignmentsPart = NULL;
+        int* dbAlignmentsPartLens = NULL;
+
+        shotgunDatabase(&dbAlignmentsPart, &dbAlignmentsPartLens, context->type, 
+            context->queries, queriesLen, chainDatabase, context->scorer, 
+            context->maxAlignments, context->valueFunction, 
+            context->valueFunctionParam, context->valueThreshold, NULL, 0, 
+            NULL, 0, NULL);
+
+        dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
+            dbAlignmentsPartLens, queriesLen, context->maxAlignments);
+        deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
+
+        chainDatabaseDelete(chainDatabase);
+
+        // delete all unused chains
+        char* usedMask = (char*) calloc(partEnd, sizeof(char));
+
+        for (i = 0; i < queriesLen; ++i) {
+            for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+                usedMask[dbAlignmentGetTargetIdx(dbAlignments[i][j])] = 1;
+            }
+        }
+
+        for (i = start; i < partEnd; ++i) {
+            if (!usedMask[i] && database[i] != NULL) {
+                chainDelete(database[i]);
+                database[i] = NULL;
+            }
+        }
+
+        free(usedMask);
+
+        partStart = partEnd;
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // WRITE THE RESULTS TO THE SHARED MEMORY
+
+    // int 1 targetsLen
+    // int targetsLen targets
+    // int queriesLen dbAlignmentsLens
+    // int 1 bytesLen, char bytesLen bytes for every alignment
+    int targetsLen = 0;
+    for (i = start; i < end; ++i) {
+        targetsLen += database[i] != NULL;
+    }
+
+    size_t size = sizeof(int) * (1 + targetsLen + queriesLen);
+
+    for (i = 0; i < queriesLen; ++i) {
+        for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+
+            char* bytes;
+            int bytesLen;
+
+            // serialized only for the size, bytes are small
+            dbAlignmentSerialize(&bytes, &bytesLen, dbAlignments[i][j]);
+            free(bytes);
+
+            size += sizeof(int) + bytesLen;
+        }
+    }
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    ASSERT(fd != -1, "cannot create shared memory %s", name);
+    ASSERT(ftruncate(fd, size) == 0, "cannot resize shared memory %s", name);
+
+    char* shared = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, 
+        fd, 0);
+    ASSERT(shared != MAP_FAILED, "cannot map shared memory %s", name);
+
+    close(fd);
+
+    size_t ptr = 0;
+
+    memcpy(shared + ptr, &targetsLen, sizeof(int));
+    ptr += sizeof(int);
+
+    for (i = start; i < end; ++i) {
+        if (database[i] != NULL) {
+            memcpy(shared + ptr, &i, sizeof(int));
+            ptr += sizeof(int);
+        }
+    }
+
+    memcpy(shared + ptr, dbAlignmentsLens, queriesLen * sizeof(int));
+    ptr += queriesLen * sizeof(int);
+
+    for (i = 0; i < queriesLen; ++i) {
+        for (j = 0; j < dbAlignmentsLens[i]; ++j) {
+
+            char* bytes;
+            int bytesLen;
+
+            dbAlignmentSerialize(&bytes, &bytesLen, dbAlignments[i][j]);
+
+            memcpy(shared + ptr, &bytesLen, sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(shared + ptr, bytes, bytesLen);
+            ptr += bytesLen;
+
+            free(bytes);
+        }
+    }
+
+    munmap(shared, size);
+
+    //**************************************************************************
+
+    deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
+    deleteFastaChains(database, databaseMap->chainsLen);
+
+    threadPoolTerminate();
+
+    fflush(NULL);
+}
+
+static void readWorkerResults(DbAlignment*** dbAlignments, 
+    int* dbAlignmentsLens, Chain** database, Context* context, 
+    const char* name) {
+
+    int i, j;
+
+    int queriesLen = context->queriesLen;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    ASSERT(fd != -1, "cannot open shared memory %s", name);
+
+    struct stat fileStat;
+    ASSERT(fstat(fd, &fileStat) == 0, "cannot stat shared memory %s", name);
+
+    size_t size = fileStat.st_size;
+
+    char* shared = (char*) mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT(shared != MAP_FAILED, "cannot map shared memory %s", name);
+
+    close(fd);
+    shm_unlink(name);
+
+    size_t ptr = 0;
+
+    // targets are read from the mapped database
+    int targetsLen;
+    memcpy(&targetsLen, shared + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    for (i = 0; i < targetsLen; ++i) {
+
+        int idx;
+        memcpy(&idx, shared + ptr, sizeof(int));
+        ptr += sizeof(int);
+
+        database[idx] = databaseMapGetChain(context->databaseMap, idx);
+    }
+
+    int* dbAlignmentsPartLens = (int*) malloc(queriesLen * sizeof(int));
+    memcpy(dbAlignmentsPartLens, shared + ptr, queriesLen * sizeof(int));
+    ptr += queriesLen * sizeof(int);
+
+    DbAlignment*** dbAlignmentsPart = 
+        (DbAlignment***) malloc(queriesLen * sizeof(DbAlignment**));
+
+    for (i = 0; i < queriesLen; ++i) {
+
+        size_t dbAlignmentsSize = dbAlignmentsPartLens[i] * sizeof(DbAlignment*);
+        dbAlignmentsPart[i] = (DbAlignment**) malloc(dbAlignmentsSize);
+
+        for (j = 0; j < dbAlignmentsPartLens[i]; ++j) {
+
+            int bytesLen;
+            memcpy(&bytesLen, shared + ptr, sizeof(int));
+            ptr += sizeof(int);
+
+            dbAlignmentsPart[i][j] = dbAlignmentDeserialize(shared + ptr, 
+                context->queries, database, context->scorer);
+            ptr += bytesLen;
+        }
+    }
+
+    munmap(shared, size);
+
+    dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
+        dbAlignmentsPartLens, queriesLen, context->maxAlignments);
+
+    deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// DATABASE MAP
+
+static DatabaseMap* databaseMapCreate(const char* databasePath) {
+
+    static const char ext[] = ".swsharp";
+
+    char* path = (char*) malloc(strlen(databasePath) + sizeof(ext) + 1);
+    sprintf(path, "%s%s", databasePath, ext);
+
+    int fd = open(path, O_RDONLY);
+    ASSERT(fd != -1, "serialized database %s not found", path);
+
+    struct stat fileStat;
+    ASSERT(fstat(fd, &fileStat) == 0, "cannot stat %s", path);
+
+    DatabaseMap* databaseMap = (DatabaseMap*) malloc(sizeof(DatabaseMap));
+
+    databaseMap->size = fileStat.st_size;
+    databaseMap->data = (char*) mmap(NULL, databaseMap->size, PROT_READ, 
+        MAP_SHARED, fd, 0);
+
+    ASSERT(databaseMap->data != MAP_FAILED, "cannot map %s", path);
+
+    close(fd);
+
+    // int 1 length
+    // long long 1 cells
+    // int 1 size, char size bytes for every chain
+    int chainsLen;
+    memcpy(&chainsLen, databaseMap->data, sizeof(int));
+
+    size_t ptr = sizeof(int) + sizeof(long long);
+
+    databaseMap->chainsLen = chainsLen;
+    databaseMap->offsets = (size_t*) malloc(chainsLen * sizeof(size_t));
+    databaseMap->sizes = (int*) malloc(chainsLen * sizeof(int));
+
+    int i;
+    for (i = 0; i < chainsLen; ++i) {
+
+        ASSERT(ptr + sizeof(int) <= databaseMap->size, "corrupted %s", path);
+
+        memcpy(&(databaseMap->sizes[i]), databaseMap->data + ptr, sizeof(int));
+        ptr += sizeof(int);
+
+        databaseMap->offsets[i] = ptr;
+        ptr += databaseMap->sizes[i];
+    }
+
+    ASSERT(ptr <= databaseMap->size, "corrupted %s", path);
+
+    free(path);
+
+    return databaseMap;
+}
+
+static void databaseMapDelete(DatabaseMap* databaseMap) {
+    munmap(databaseMap->data, databaseMap->size);
+    free(databaseMap->offsets);
+    free(databaseMap->sizes);
+    free(databaseMap);
+}
+
+static Chain* databaseMapGetChain(DatabaseMap* databaseMap, int idx) {
+    return chainDeserialize(databaseMap->data + databaseMap->offsets[idx]);
+}
+
+//------------------------------------------------------------------------------
+
+#endif
+
+//******************************************************************************
@@ -0,0 +1,72 @@
+/*
+swsharp - CUDA parallelized Smith Waterman with applying Hirschberg's and 
+Ukkonen's algorithm and dynamic cell pruning.
+Copyright (C) 2013 Matija Korpar, contributor Mile Šikić
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+Contact the author by mkorpar@gmail.com.
+*/
+
+#ifndef __PROCESS_MODULEH__
+#define __PROCESS_MODULEH__
+
+#include "swsharp/swsharp.h"
+
+#ifdef __cplusplus 
+extern "C" {
+#endif
+
+/*!
+@brief Multi process shotgun database aligning function.
+
+Function forks the given number of worker processes. Every worker maps the 
+same serialized database read only, see dumpFastaChains(), and solves its own
+shard of the database with its own thread pool. Shards are balanced by their 
+size. Workers return the alignments through shared memory, where they are 
+merged with the dbAlignmentsMerge(). Output is the same as the shotgunDatabase()
+output. Thread pool must not be initialized in the calling process, workers 
+are only cpu based.
+
+@param dbAlignments output dbAlignments array of arrays, one for each query, 
+    new array of arrays is created
+@param dbAlignmentsLens output, lengths of the output dbAlignments arrays, 
+    new array is created
+@param database output, target chains referenced by the dbAlignments, has to
+    be deleted with deleteFastaChains() after the dbAlignments
+@param databaseLen output, database array length
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array
+@param queriesLen query chains array length
+@param databasePath database file path, database has to be serialized
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of alignments to return, if negative 
+    number of alignments wont be limited
+@param valueFunction function for valueing the alignment scores
+@param valueFunctionParam additional parameters for the value function
+@param valueThreshold maximum value of returned alignments
+@param hitCache persistent hits cache used by the workers, can be NULL
+@param processes number of worker processes
+@param threads number of threads in the thread pool of every worker
+*/
+extern void shotgunDatabaseProcesses(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, Chain*** database, int* databaseLen, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, 
+    int maxAlignments, ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, HitCache* hitCache, int processes, int threads);
+
+#ifdef __cplusplus 
+}
+#endif
+#endif // __PROCESS_MODULEH__
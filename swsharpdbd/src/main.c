@@ -0,0 +1,990 @@
+#include <ctype.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "swsharp/evalue.h"
+#include "swsharp/swsharp.h"
+
+#define ASSERT(expr, fmt, ...)\
+    do {\
+        if (!(expr)) {\
+            fprintf(stderr, "[ERROR]: " fmt "\n", ##__VA_ARGS__);\
+            exit(-1);\
+        }\
+    } while(0)
+
+#define CHAR_INT_LEN(x) (sizeof(x) / sizeof(CharInt))
+
+#define MAX_DATABASES   64
+
+#define REQUEST_MAGIC   "SWDQ"
+#define RESPONSE_MAGIC  "SWDR"
+
+// queries of a single request are limited to ~1GB
+#define MAX_QUERIES_BYTES 1000000000ll
+
+typedef struct CharInt {
+    const char* format;
+    const int code;
+} CharInt;
+
+// every frame is a fixed size header followed by bytesLen bytes, request
+// bytes are the fasta queries and response bytes the formatted output or
+// the error message
+typedef struct RequestHeader {
+    char magic[4];
+    int database;
+    int algorithm;
+    int maxAlignments;
+    float maxEValue;
+    int outFormat;
+    long long bytesLen;
+} RequestHeader;
+
+typedef struct ResponseHeader {
+    char magic[4];
+    int status;
+    long long bytesLen;
+} ResponseHeader;
+
+typedef struct Database {
+    Chain** chains;
+    int chainsLen;
+    ChainDatabase* chainDatabase;
+    EValueParams* eValueParams;
+} Database;
+
+typedef struct Request {
+    RequestHeader header;
+    Chain** queries;
+    int queriesLen;
+    char* response;
+    size_t responseLen;
+    int status;
+    Semaphore done;
+    struct Request* next;
+} Request;
+
+typedef struct Server {
+    Database* databases;
+    int databasesLen;
+    Scorer* scorer;
+    int* cards;
+    int cardsLen;
+    Request* pending;
+    Request* pendingLast;
+    Mutex mutex;
+    Semaphore wake;
+} Server;
+
+typedef struct Connection {
+    Server* server;
+    int fd;
+} Connection;
+
+static struct option options[] = {
+    {"cards", required_argument, 0, 'c'},
+    {"gap-extend", required_argument, 0, 'e'},
+    {"gap-open", required_argument, 0, 'g'},
+    {"query", required_argument, 0, 'i'},
+    {"target", required_argument, 0, 'j'},
+    {"matrix", required_argument, 0, 'm'},
+    {"out", required_argument, 0, 'o'},
+    {"outfmt", required_argument, 0, 't'},
+    {"evalue", required_argument, 0, 'E'},
+    {"max-aligns", required_argument, 0, 'M'},
+    {"algorithm", required_argument, 0, 'A'},
+    {"database", required_argument, 0, 'd'},
+    {"socket", required_argument, 0, 's'},
+    {"connect", required_argument, 0, 'C'},
+    {"nocache", no_argument, 0, 'N'},
+    {"cpu", no_argument, 0, 'P'},
+    {"threads", required_argument, 0, 'T'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static CharInt outFormats[] = {
+    { "bm0", SW_OUT_DB_BLASTM0 },
+    { "bm8", SW_OUT_DB_BLASTM8 },
+    { "bm9", SW_OUT_DB_BLASTM9 },
+    { "light", SW_OUT_DB_LIGHT },
+    { "dump", SW_OUT_DB_DUMP }
+};
+
+static CharInt algorithms[] = {
+    { "SW", SW_ALIGN },
+    { "NW", NW_ALIGN },
+    { "HW", HW_ALIGN },
+    { "OV", OV_ALIGN }
+};
+
+static void help();
+
+static void getCudaCards(int** cards, int* cardsLen, char* optarg);
+
+static int getOutFormat(char* optarg);
+static int getAlgorithm(char* optarg);
+
+static void valueFunction(double* values, int* scores, Chain* query,
+    Chain** database, int databaseLen, int* cards, int cardsLen, void* param);
+
+static int readFully(int fd, void* data, size_t size);
+static int writeFully(int fd, const void* data, size_t size);
+
+static int readRequest(Request** request, Server* server, int fd);
+static char* queriesError(const char* bytes, size_t bytesLen);
+static int writeResponse(Request* request, int fd);
+static void deleteRequest(Request* request);
+
+static void setResponse(Request* request, int status, char* bytes,
+    size_t bytesLen);
+
+static void solveBatch(Server* server, Request** requests, int requestsLen);
+static void solvePending(Server* server);
+
+static void* batchThread(void* param);
+static void* connectionThread(void* param);
+
+static void serveSocket(Server* server, const char* path);
+static void serveStdio(Server* server, int fd);
+
+static int client(const char* path, char* queryPath, char* out,
+    RequestHeader* header);
+
+int main(int argc, char* argv[]) {
+
+    char* queryPath = NULL;
+
+    char* databasePaths[MAX_DATABASES];
+    int databasesLen = 0;
+
+    int gapOpen = 10;
+    int gapExtend = 1;
+
+    char* matrix = "BLOSUM_62";
+
+    int cardsLen = -1;
+    int* cards = NULL;
+
+    char* out = NULL;
+
+    char* socketPath = NULL;
+    char* connectPath = NULL;
+
+    int cache = 1;
+
+    int forceCpu = 0;
+
+    int threads = 8;
+
+    RequestHeader header;
+    memset(&header, 0, sizeof(RequestHeader));
+    memcpy(header.magic, REQUEST_MAGIC, sizeof(header.magic));
+    header.database = 0;
+    header.algorithm = SW_ALIGN;
+    header.maxAlignments = 10;
+    header.maxEValue = 10;
+    header.outFormat = SW_OUT_DB_BLASTM9;
+
+    while (1) {
+
+        char argument = getopt_long(argc, argv, "i:j:g:e:hT:", options, NULL);
+
+        if (argument == -1) {
+            break;
+        }
+
+        switch (argument) {
+        case 'i':
+            queryPath = optarg;
+            break;
+        case 'j':
+            ASSERT(databasesLen < MAX_DATABASES, "too many databases");
+            databasePaths[databasesLen++] = optarg;
+            break;
+        case 'g':
+            gapOpen = atoi(optarg);
+            break;
+        case 'e':
+            gapExtend = atoi(optarg);
+            break;
+        case 'c':
+            getCudaCards(&cards, &cardsLen, optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 't':
+            header.outFormat = getOutFormat(optarg);
+            break;
+        case 'M':
+            header.maxAlignments = atoi(optarg);
+            break;
+        case 'E':
+            header.maxEValue = atof(optarg);
+            break;
+        case 'm':
+            matrix = optarg;
+            break;
+        case 'A':
+            header.algorithm = getAlgorithm(optarg);
+            break;
+        case 'd':
+            header.database = atoi(optarg);
+            break;
+        case 's':
+            socketPath = optarg;
+            break;
+        case 'C':
+            connectPath = optarg;
+            break;
+        case 'N':
+            cache = 0;
+            break;
+        case 'P':
+            forceCpu = 1;
+            break;
+        case 'T':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            help();
+            return -1;
+        }
+    }
+
+    if (connectPath != NULL) {
+        ASSERT(queryPath != NULL, "missing option -i (query file)");
+        ASSERT(header.maxEValue > 0, "invalid evalue");
+        return client(connectPath, queryPath, out, &header);
+    }
+
+    ASSERT(databasesLen > 0, "missing option -j (database file)");
+
+    if (forceCpu) {
+        cards = NULL;
+        cardsLen = 0;
+    } else {
+
+        if (cardsLen == -1) {
+            cudaGetCards(&cards, &cardsLen);
+        }
+
+        ASSERT(cudaCheckCards(cards, cardsLen), "invalid cuda cards");
+    }
+
+    ASSERT(threads >= 0, "invalid thread number");
+
+    // logs go to standard error, standard output may carry the responses
+    int stdoutFd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    threadPoolInitialize(threads);
+
+    Server server;
+    memset(&server, 0, sizeof(Server));
+    server.cards = cards;
+    server.cardsLen = cardsLen;
+
+    scorerCreateMatrix(&(server.scorer), matrix, gapOpen, gapExtend);
+
+    server.databasesLen = databasesLen;
+    server.databases = (Database*) malloc(databasesLen * sizeof(Database));
+
+    int i;
+    for (i = 0; i < databasesLen; ++i) {
+
+        Database* database = &(server.databases[i]);
+
+        if (cache) {
+            dumpFastaChains(databasePaths[i]);
+        }
+
+        readFastaChains(&(database->chains), &(database->chainsLen),
+            databasePaths[i]);
+
+        long long cells = 0;
+
+        int j;
+        for (j = 0; j < database->chainsLen; ++j) {
+            cells += chainGetLength(database->chains[j]);
+        }
+
+        database->eValueParams = createEValueParams(cells, server.scorer);
+        database->chainDatabase = chainDatabaseCreate(database->chains, 0,
+            database->chainsLen, cards, cardsLen);
+
+        fprintf(stderr, "[INFO]: database %d %s, %d chains\n", i,
+            databasePaths[i], database->chainsLen);
+    }
+
+    if (socketPath != NULL) {
+        close(stdoutFd);
+        serveSocket(&server, socketPath);
+    } else {
+        serveStdio(&server, stdoutFd);
+        close(stdoutFd);
+    }
+
+    for (i = 0; i < databasesLen; ++i) {
+        chainDatabaseDelete(server.databases[i].chainDatabase);
+        deleteEValueParams(server.databases[i].eValueParams);
+        deleteFastaChains(server.databases[i].chains,
+            server.databases[i].chainsLen);
+    }
+
+    free(server.databases);
+    scorerDelete(server.scorer);
+
+    threadPoolTerminate();
+    free(cards);
+
+    return 0;
+}
+
+static void getCudaCards(int** cards, int* cardsLen, char* optarg) {
+
+    *cardsLen = strlen(optarg);
+    *cards = (int*) malloc(*cardsLen * sizeof(int));
+
+    int i;
+    for (i = 0; i < *cardsLen; ++i) {
+        (*cards)[i] = optarg[i] - '0';
+    }
+}
+
+static int getOutFormat(char* optarg) {
+
+    int i;
+    for (i = 0; i < CHAR_INT_LEN(outFormats); ++i) {
+        if (strcmp(outFormats[i].format, optarg) == 0) {
+            return outFormats[i].code;
+        }
+    }
+
+    ASSERT(0, "unknown out format %s", optarg);
+}
+
+static int getAlgorithm(char* optarg) {
+
+    int i;
+    for (i = 0; i < CHAR_INT_LEN(algorithms); ++i) {
+        if (strcmp(algorithms[i].format, optarg) == 0) {
+            return algorithms[i].code;
+        }
+    }
+
+    ASSERT(0, "unknown algorithm %s", optarg);
+}
+
+static void valueFunction(double* values, int* scores, Chain* query,
+    Chain** database, int databaseLen, int* cards, int cardsLen, void* param_ ) {
+
+    EValueParams* eValueParams = (EValueParams*) param_;
+    eValues(values, scores, query, database, databaseLen, cards, cardsLen, eValueParams);
+}
+
+//------------------------------------------------------------------------------
+// FRAMING
+
+static int readFully(int fd, void* data, size_t size) {
+
+    char* ptr = (char*) data;
+
+    while (size > 0) {
+
+        ssize_t read_ = read(fd, ptr, size);
+
+        if (read_ <= 0) {
+            return -1;
+        }
+
+        ptr += read_;
+        size -= read_;
+    }
+
+    return 0;
+}
+
+static int writeFully(int fd, const void* data, size_t size) {
+
+    const char* ptr = (const char*) data;
+
+    while (size > 0) {
+
+        ssize_t written = write(fd, ptr, size);
+
+        if (written <= 0) {
+            return -1;
+        }
+
+        ptr += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+static int readRequest(Request** request_, Server* server, int fd) {
+
+    Request* request = (Request*) calloc(1, sizeof(Request));
+
+    RequestHeader* header = &(request->header);
+
+    if (readFully(fd, header, sizeof(RequestHeader)) != 0 ||
+        memcmp(header->magic, REQUEST_MAGIC, sizeof(header->magic)) != 0 ||
+        header->bytesLen < 0 || header->bytesLen > MAX_QUERIES_BYTES) {
+        free(request);
+        return -1;
+    }
+
+    size_t bytesLen = header->bytesLen;
+    char* bytes = (char*) malloc(bytesLen + 1);
+
+    if (readFully(fd, bytes, bytesLen) != 0) {
+        free(bytes);
+        free(request);
+        return -1;
+    }
+
+    semaphoreCreate(&(request->done), 0);
+
+    *request_ = request;
+
+    int i;
+    int algorithmValid = 0;
+    for (i = 0; i < CHAR_INT_LEN(algorithms); ++i) {
+        algorithmValid |= algorithms[i].code == header->algorithm;
+    }
+
+    int formatValid = 0;
+    for (i = 0; i < CHAR_INT_LEN(outFormats); ++i) {
+        formatValid |= outFormats[i].code == header->outFormat;
+    }
+
+    char* error = NULL;
+
+    if (header->database < 0 || header->database >= server->databasesLen) {
+        error = "invalid database";
+    } else if (!algorithmValid) {
+        error = "invalid algorithm";
+    } else if (!formatValid) {
+        error = "invalid out format";
+    } else if (!(header->maxEValue > 0)) {
+        error = "invalid evalue";
+    } else {
+        error = queriesError(bytes, bytesLen);
+    }
+
+    if (error != NULL) {
+        free(bytes);
+        setResponse(request, -1, strdup(error), strlen(error));
+        return 0;
+    }
+
+    if (bytesLen > 0) {
+        FILE* handle = fmemopen(bytes, bytesLen, "r");
+        readFastaChainsPart(&(request->queries), &(request->queriesLen),
+            handle, 0, 0);
+        fclose(handle);
+    }
+
+    free(bytes);
+
+    return 0;
+}
+
+static char* queriesError(const char* bytes, size_t bytesLen) {
+
+    // library reader exits on invalid chains, queries are checked first by
+    // walking them the same way readFastaChainsPart does
+    int isName = 1;
+    int nameLen = 0;
+    int codesLen = 0;
+
+    size_t i;
+    for (i = 0; i < bytesLen; ++i) {
+
+        char c = bytes[i];
+
+        if (!isName && (c == '>' || i == bytesLen - 1)) {
+
+            if (nameLen == 0) {
+                return "query without a name";
+            }
+
+            if (codesLen == 0) {
+                return "query without valid residues";
+            }
+
+            isName = 1;
+            nameLen = 0;
+            codesLen = 0;
+        }
+
+        if (isName) {
+            if (c == '\n') {
+                isName = 0;
+            } else if (!(nameLen == 0 && (c == '>' || isspace(c))) && 
+                c != '\r') {
+                nameLen++;
+            }
+        } else if (scorerEncode(c) != -1) {
+            codesLen++;
+        }
+    }
+
+    return NULL;
+}
+
+static int writeResponse(Request* request, int fd) {
+
+    ResponseHeader header;
+    memset(&header, 0, sizeof(ResponseHeader));
+    memcpy(header.magic, RESPONSE_MAGIC, sizeof(header.magic));
+    header.status = request->status;
+    header.bytesLen = request->responseLen;
+
+    if (writeFully(fd, &header, sizeof(ResponseHeader)) != 0) {
+        return -1;
+    }
+
+    return writeFully(fd, request->response, request->responseLen);
+}
+
+static void deleteRequest(Request* request) {
+    deleteFastaChains(request->queries, request->queriesLen);
+    semaphoreDelete(&(request->done));
+    free(request->response);
+    free(request);
+}
+
+static void setResponse(Request* request, int status, char* bytes,
+    size_t bytesLen) {
+    request->status = status;
+    request->response = bytes;
+    request->responseLen = bytesLen;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// SEARCH
+
+static void solveBatch(Server* server, Request** requests, int requestsLen) {
+
+    RequestHeader* header = &(requests[0]->header);
+    Database* database = &(server->databases[header->database]);
+
+    int i;
+
+    int queriesLen = 0;
+    for (i = 0; i < requestsLen; ++i) {
+        queriesLen += requests[i]->queriesLen;
+    }
+
+    Chain** queries = (Chain**) malloc(queriesLen * sizeof(Chain*) + 1);
+
+    int offset = 0;
+    for (i = 0; i < requestsLen; ++i) {
+        memcpy(queries + offset, requests[i]->queries,
+            requests[i]->queriesLen * sizeof(Chain*));
+        offset += requests[i]->queriesLen;
+    }
+
+    DbAlignment*** dbAlignments = NULL;
+    int* dbAlignmentsLens = NULL;
+
+    if (queriesLen > 0) {
+        shotgunDatabase(&dbAlignments, &dbAlignmentsLens, header->algorithm,
+            queries, queriesLen, database->chainDatabase, server->scorer,
+            header->maxAlignments, valueFunction,
+            (void*) database->eValueParams, header->maxEValue, NULL, 0,
+            server->cards, server->cardsLen, NULL);
+    }
+
+    // every request gets its own part of the output
+    offset = 0;
+    for (i = 0; i < requestsLen; ++i) {
+
+        char* bytes = NULL;
+        size_t bytesLen = 0;
+
+        FILE* file = open_memstream(&bytes, &bytesLen);
+
+        outputShotgunDatabaseFile(dbAlignments + offset,
+            dbAlignmentsLens + offset, requests[i]->queriesLen, file,
+            requests[i]->header.outFormat);
+
+        fclose(file);
+
+        setResponse(requests[i], 0, bytes, bytesLen);
+
+        offset += requests[i]->queriesLen;
+    }
+
+    if (queriesLen > 0) {
+        deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
+    }
+
+    free(queries);
+}
+
+static void solvePending(Server* server) {
+
+    mutexLock(&(server->mutex));
+
+    Request* pending = server->pending;
+    server->pending = NULL;
+    server->pendingLast = NULL;
+
+    mutexUnlock(&(server->mutex));
+
+    int requestsLen = 0;
+
+    Request* request;
+    for (request = pending; request != NULL; request = request->next) {
+        requestsLen++;
+    }
+
+    Request** batch = (Request**) malloc(requestsLen * sizeof(Request*) + 1);
+
+    // requests which can share a search are solved with one call
+    while (pending != NULL) {
+
+        RequestHeader* header = &(pending->header);
+
+        Request* rest = NULL;
+        Request* restLast = NULL;
+
+        int batchLen = 0;
+
+        while (pending != NULL) {
+
+            Request* next = pending->next;
+            pending->next = NULL;
+
+            RequestHeader* other = &(pending->header);
+
+            if (batchLen == 0 || (other->database == header->database &&
+                other->algorithm == header->algorithm &&
+                other->maxAlignments == header->maxAlignments &&
+                other->maxEValue == header->maxEValue)) {
+
+                batch[batchLen++] = pending;
+
+            } else {
+
+                if (rest == NULL) {
+                    rest = pending;
+                } else {
+                    restLast->next = pending;
+                }
+
+                restLast = pending;
+            }
+
+            pending = next;
+        }
+
+        solveBatch(server, batch, batchLen);
+
+        int i;
+        for (i = 0; i < batchLen; ++i) {
+            semaphorePost(&(batch[i]->done));
+        }
+
+        pending = rest;
+    }
+
+    free(batch);
+}
+
+static void* batchThread(void* param) {
+
+    Server* server = (Server*) param;
+
+    while (1) {
+        semaphoreWait(&(server->wake));
+        solvePending(server);
+    }
+
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// SERVING
+
+static void* connectionThread(void* param) {
+
+    Connection* connection = (Connection*) param;
+    Server* server = connection->server;
+
+    Request* request;
+
+    while (readRequest(&request, server, connection->fd) == 0) {
+
+        if (request->response == NULL) {
+
+            mutexLock(&(server->mutex));
+
+            if (server->pending == NULL) {
+                server->pending = request;
+            } else {
+                server->pendingLast->next = request;
+            }
+
+            server->pendingLast = request;
+
+            mutexUnlock(&(server->mutex));
+
+            semaphorePost(&(server->wake));
+            semaphoreWait(&(request->done));
+        }
+
+        int status = writeResponse(request, connection->fd);
+
+        deleteRequest(request);
+
+        if (status != 0) {
+            break;
+        }
+    }
+
+    close(connection->fd);
+    free(connection);
+
+    return NULL;
+}
+
+static void serveSocket(Server* server, const char* path) {
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT(fd != -1, "cannot create socket");
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+
+    ASSERT(strlen(path) < sizeof(address.sun_path), "socket path too long");
+    strcpy(address.sun_path, path);
+
+    unlink(path);
+
+    ASSERT(bind(fd, (struct sockaddr*) &address, sizeof(address)) == 0,
+        "cannot bind socket %s", path);
+    ASSERT(listen(fd, 64) == 0, "cannot listen on socket %s", path);
+
+    mutexCreate(&(server->mutex));
+    semaphoreCreate(&(server->wake), 0);
+
+    Thread thread;
+    threadCreate(&thread, batchThread, (void*) server);
+
+    fprintf(stderr, "[INFO]: listening on %s\n", path);
+
+    while (1) {
+
+        int client = accept(fd, NULL, NULL);
+
+        if (client == -1) {
+            continue;
+        }
+
+        Connection* connection = (Connection*) malloc(sizeof(Connection));
+        connection->server = server;
+        connection->fd = client;
+
+        // connection threads are never joined
+        threadCreate(&thread, connectionThread, (void*) connection);
+        pthread_detach(thread);
+    }
+}
+
+static void serveStdio(Server* server, int fd) {
+
+    Request* request;
+
+    while (readRequest(&request, server, STDIN_FILENO) == 0) {
+
+        if (request->response == NULL) {
+            solveBatch(server, &request, 1);
+        }
+
+        int status = writeResponse(request, fd);
+
+        deleteRequest(request);
+
+        if (status != 0) {
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// CLIENT
+
+static int client(const char* path, char* queryPath, char* out,
+    RequestHeader* header) {
+
+    FILE* file = fopen(queryPath, "rb");
+    ASSERT(file != NULL, "cannot open %s", queryPath);
+
+    fseek(file, 0L, SEEK_END);
+    header->bytesLen = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    char* bytes = (char*) malloc(header->bytesLen + 1);
+    ASSERT(fread(bytes, 1, header->bytesLen, file) == header->bytesLen,
+        "cannot read %s", queryPath);
+
+    fclose(file);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT(fd != -1, "cannot create socket");
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(struct sockaddr_un));
+    address.sun_family = AF_UNIX;
+
+    ASSERT(strlen(path) < sizeof(address.sun_path), "socket path too long");
+    strcpy(address.sun_path, path);
+
+    ASSERT(connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0,
+        "cannot connect to %s", path);
+
+    ASSERT(writeFully(fd, header, sizeof(RequestHeader)) == 0 &&
+        writeFully(fd, bytes, header->bytesLen) == 0, "cannot send request");
+
+    free(bytes);
+
+    ResponseHeader response;
+    ASSERT(readFully(fd, &response, sizeof(ResponseHeader)) == 0 &&
+        memcmp(response.magic, RESPONSE_MAGIC, sizeof(response.magic)) == 0,
+        "invalid response");
+
+    bytes = (char*) malloc(response.bytesLen + 1);
+    ASSERT(readFully(fd, bytes, response.bytesLen) == 0, "invalid response");
+
+    close(fd);
+
+    if (response.status != 0) {
+        fprintf(stderr, "[ERROR]: %.*s\n", (int) response.bytesLen, bytes);
+        free(bytes);
+        return -1;
+    }
+
+    file = out == NULL ? stdout : fopen(out, "wb");
+    ASSERT(file != NULL, "cannot open %s", out);
+
+    fwrite(bytes, 1, response.bytesLen, file);
+
+    if (file != stdout) fclose(file);
+
+    free(bytes);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void help() {
+    printf(
+    "usage: swsharpdbd -j <target db file> [-j <target db file> ...] [arguments ...]\n"
+    "       swsharpdbd --connect <socket> -i <query db file> [arguments ...]\n"
+    "\n"
+    "server arguments:\n"
+    "    -j, --target <file>\n"
+    "        (required)\n"
+    "        input fasta database target file, can be given multiple times,\n"
+    "        databases are indexed from zero in the given order\n"
+    "    -g, --gap-open <int>\n"
+    "        default: 10\n"
+    "        gap opening penalty, must be given as a positive integer \n"
+    "    -e, --gap-extend <int>\n"
+    "        default: 1\n"
+    "        gap extension penalty, must be given as a positive integer and\n"
+    "        must be less or equal to gap opening penalty\n"
+    "    --matrix <string>\n"
+    "        default: BLOSUM_62\n"
+    "        similarity matrix, can be one of the following:\n"
+    "            BLOSUM_45\n"
+    "            BLOSUM_50\n"
+    "            BLOSUM_62\n"
+    "            BLOSUM_80\n"
+    "            BLOSUM_90\n"
+    "            BLOSUM_30\n"
+    "            BLOSUM_70\n"
+    "            BLOSUM_250\n"
+    "            EDNA_FULL\n"
+    "    --socket <file>\n"
+    "        default: none\n"
+    "        unix domain socket the server listens on, if not given requests\n"
+    "        are read from the standard input and responses are written to the\n"
+    "        standard output\n"
+    "    --cards <ints>\n"
+    "        default: all available CUDA cards\n"
+    "        list of cards should be given as an array of card indexes delimited with\n"
+    "        nothing, for example usage of first two cards is given as --cards 01\n"
+    "    --nocache\n"
+    "        serialized database is stored to speed up future runs with the\n"
+    "        same database, option disables this behaviour\n"
+    "    --cpu\n"
+    "        only cpu is used\n"
+    "    -T --threads <int>\n"
+    "        default: 8\n"
+    "        number of threads used in thread pool\n"
+    "\n"
+    "client arguments:\n"
+    "    --connect <file>\n"
+    "        (required)\n"
+    "        unix domain socket of the running server\n"
+    "    -i, --query <file>\n"
+    "        (required)\n"
+    "        input fasta database query file\n"
+    "    --database <int>\n"
+    "        default: 0\n"
+    "        index of the server database which is searched\n"
+    "    --evalue <float>\n"
+    "        default: 10.0\n"
+    "        evalue threshold, alignments with higher evalue are filtered,\n"
+    "        must be given as a positive float\n"
+    "    --max-aligns <int>\n"
+    "        default: 10\n"
+    "        maximum number of alignments to be outputted\n"
+    "    --algorithm <string>\n"
+    "        default: SW\n"
+    "        algorithm used for alignment, must be one of the following: \n"
+    "            SW - Smith-Waterman local alignment\n"
+    "            NW - Needleman-Wunsch global alignment\n"
+    "            HW - semiglobal alignment\n"
+    "            OV - overlap alignment\n"
+    "    --out <string>\n"
+    "        default: stdout\n"
+    "        output file for the alignment\n"
+    "    --outfmt <string>\n"
+    "        default: bm9\n"
+    "        out format for the output file, must be one of the following:\n"
+    "            bm0      - blast m0 output format\n"
+    "            bm8      - blast m8 tabular output format\n"
+    "            bm9      - blast m9 commented tabular output format\n"
+    "            light    - score-name tabbed output\n"
+    "            dump     - binary format for usage with swsharpout\n"
+    "    -h, -help\n"
+    "        prints out the help\n");
+}
@@ -51,7 +51,8 @@ static CharInt outFormats[] = {
     { "bm0", SW_OUT_DB_BLASTM0 },
     { "bm8", SW_OUT_DB_BLASTM8 },
     { "bm9", SW_OUT_DB_BLASTM9 },
-    { "light", SW_OUT_DB_LIGHT }
+    { "light", SW_OUT_DB_LIGHT },
+    { "dump", SW_OUT_DB_DUMP }
 };
 
 static CharInt algorithms[] = {
@@ -74,11 +75,11 @@ static void valueFunction(double* values, int* scores, Chain* query,
 int main(int argc, char* argv[]) {
 
     int mpiRank = 0;
-    int mpiNodes = 1;
+    int mpiThreads;
     
-    MPI_Init(&argc, &argv);
+    // only the main thread makes mpi calls
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &mpiThreads);
     MPI_Comm_rank(MPI_COMM_WORLD, &mpiRank);
-    MPI_Comm_size(MPI_COMM_WORLD, &mpiNodes);
 
     char* queryPath = NULL;
     char* databasePath = NULL;
@@ -187,10 +188,13 @@ int main(int argc, char* argv[]) {
     int queriesLen = 0;
     readFastaChains(&queries, &queriesLen, queryPath);
     
-    if (cache) {
+    // master node creates the cache, others wait for it
+    if (cache && mpiRank == 0) {
         dumpFastaChains(databasePath);
     }
 
+    MPI_Barrier(MPI_COMM_WORLD);
+
     int chains;
     long long cells;
     statFastaChains(&chains, &cells, databasePath);
@@ -200,259 +204,18 @@ int main(int argc, char* argv[]) {
     DbAlignment*** dbAlignments = NULL;
     int* dbAlignmentsLens = NULL;
 
-    Chain** database = NULL; 
+    Chain** database = NULL;
     int databaseLen = 0;
-    int databaseStart = 0;
-    int databaseEnd = 0;
-
-    FILE* handle;
-    int serialized;
-
-    readFastaChainsPartInit(&database, &databaseLen, &handle, &serialized, databasePath);
-
-    size_t cudaMemory = cudaMinimalGlobalMemory(cards, cardsLen);
-    size_t cudaMemoryMax = cudaMemory - 200000000; // ~200MB breathing space
-    size_t cudaMemoryStep = cudaMemoryMax * 0.075;
-
-    // mpi data
-    int mpiDbStep = chains / mpiNodes;
-    int mpiDbOff = mpiRank * mpiDbStep;
-    int mpiDbLen = mpiRank == mpiNodes - 1 ? chains - mpiDbOff : mpiDbStep;
-
-    fprintf(stderr, "rank %d, mpiDbStep: %d, mpiDbOff: %d, mpiDbLen: %d\n", mpiRank, mpiDbStep, mpiDbOff, mpiDbLen);
-
-    skipFastaChainsPart(&database, &databaseLen, handle, serialized, mpiDbOff);
-
-    databaseStart = databaseLen;
-    databaseEnd = databaseLen;
-
-    int i, j;
-
-    while (1) {
-
-        int status = 1;
-
-        if (cardsLen == 0) {
-
-            status &= readFastaChainsPart(&database, &databaseLen, handle,
-                serialized, 1000000000); // ~1GB
-
-            if (databaseLen > mpiDbOff + mpiDbLen) databaseLen = mpiDbOff + mpiDbLen;
-
-        } else {
-
-            while (1) {
-
-                databaseLen = databaseEnd;
-
-                status &= readFastaChainsPart(&database, &databaseLen, handle,
-                    serialized, cudaMemoryStep);
-
-                if (databaseLen > mpiDbOff + mpiDbLen) {
-
-                    for (i = mpiDbOff + mpiDbLen; i < databaseLen; ++i) {
-                        chainDelete(database[i]);
-                        database[i] = NULL;
-                    }
-
-                    databaseLen = mpiDbOff + mpiDbLen;
-                    status = 0;
-                }
-
-                size_t cudaMemoryMin = chainDatabaseGpuMemoryConsumption(
-                    database + databaseStart, databaseLen - databaseStart);
-
-                // evalue
-                cudaMemoryMin += 16 * (databaseLen - databaseStart);
-
-                if (cudaMemoryMin > cudaMemoryMax || 
-                    (status == 1 && databaseEnd > databaseStart && cudaMemoryMin > 500000000)) {
-
-                    int holder = databaseLen;
-                    databaseLen = databaseEnd;
-                    databaseEnd = holder;
-
-                    if (databaseLen <= databaseStart) {
-                        ASSERT(0, "cannot read database into CUDA memory");
-                    }
-
-                    status = 1;
-
-                    break;
-                } else {
-                    databaseEnd = databaseLen;
-                }
-
-                if (status == 0) {
-                    break;
-                }
-            }
-        }
-
-        fprintf(stderr, "solving: %d-%d\n", databaseStart, databaseLen);
-
-        ChainDatabase* chainDatabase = chainDatabaseCreate(database, 
-            databaseStart, databaseLen - databaseStart, cards, cardsLen);
-
-        DbAlignment*** dbAlignmentsPart = NULL;
-        int* dbAlignmentsPartLens = NULL;
-
-        shotgunDatabase(&dbAlignmentsPart, &dbAlignmentsPartLens, algorithm, 
-            queries, queriesLen, chainDatabase, scorer, maxAlignments, valueFunction, 
-            (void*) eValueParams, maxEValue, NULL, 0, cards, cardsLen, NULL);
-
-        if (dbAlignments == NULL) {
-            dbAlignments = dbAlignmentsPart;
-            dbAlignmentsLens = dbAlignmentsPartLens;
-         } else {
-            dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
-                dbAlignmentsPartLens, queriesLen, maxAlignments);
-            deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
-        }
-
-        chainDatabaseDelete(chainDatabase);
-
-        if (status == 0) {
-            break;
-        }
-
-        // delete all unused chains
-        char* usedMask = (char*) calloc(databaseLen, sizeof(char));
-
-        for (i = 0; i < queriesLen; ++i) {
-            for (j = 0; j < dbAlignmentsLens[i]; ++j) {
-
-                DbAlignment* dbAlignment = dbAlignments[i][j];
-                int targetIdx = dbAlignmentGetTargetIdx(dbAlignment);
 
-                usedMask[targetIdx] = 1;
-            }
-        }
-
-        for (i = 0; i < databaseLen; ++i) {
-            if (!usedMask[i] && database[i] != NULL) {
-                chainDelete(database[i]);
-                database[i] = NULL;
-            }
-        }
-
-        free(usedMask);
-
-        databaseStart = databaseLen;
-    }
+    shotgunDatabaseMpi(&dbAlignments, &dbAlignmentsLens, &database, 
+        &databaseLen, algorithm, queries, queriesLen, databasePath, scorer, 
+        maxAlignments, valueFunction, (void*) eValueParams, maxEValue, cards, 
+        cardsLen);
 
-    fclose(handle);
-
-    // master node gathers and outputs data
+    // master node outputs data
     if (mpiRank == 0) {
-
-        // create used mask
-        char* usedMask = (char*) calloc(chains, sizeof(char));
-
-        // fill local
-        for (i = 0; i < queriesLen; ++i) {
-            for (j = 0; j < dbAlignmentsLens[i]; ++j) {
-                int targetIdx = dbAlignmentGetTargetIdx(dbAlignments[i][j]);
-                usedMask[targetIdx - mpiDbOff] = 1;
-            }
-        }
-
-        // gather used masks
-        for (i = 1; i < mpiNodes; ++i) {
-
-            int off = i * mpiDbStep;
-            int len = i == mpiNodes - 1 ? chains - off : mpiDbStep;
-
-            MPI_Status status;
-            MPI_Recv(usedMask + off, len, MPI_CHAR, i, 0, MPI_COMM_WORLD, &status);
-        }
-
-        // expand database
-        database = (Chain**) realloc(database, chains * sizeof(Chain*));
-
-        for (i = databaseLen + 1; i < chains; ++i) {
-            database[i] = NULL;
-        }
-
-        // load all needed chains from other parts
-
-        Chain** copyDatabase = NULL; 
-        int copyDatabaseLen = 0;
-        int copyDatabaseStart = databaseLen;
-
-        readFastaChainsPartInit(&copyDatabase, &copyDatabaseLen, &handle, &serialized, databasePath);
-        skipFastaChainsPart(&copyDatabase, &copyDatabaseLen, handle, serialized, databaseLen);
-
-        int status = 1;
-        while (1) {
-
-            status &= readFastaChainsPart(&copyDatabase, &copyDatabaseLen, handle,
-                serialized, 100000000);
-
-            for (i = copyDatabaseStart; i < copyDatabaseLen; ++i) {
-                if (usedMask[i]) {
-                    // copy to database and remove from copy
-                    database[i] = copyDatabase[i];
-                    copyDatabase[i] = NULL;
-                }
-            }
-
-            if (status == 0) {
-                break;
-            }
-
-            copyDatabaseStart = copyDatabaseLen;
-        }
-
-        // clear copy memory
-        deleteFastaChains(copyDatabase, copyDatabaseLen);
-        fclose(handle);
-
-        // expand database length
-        databaseLen = chains;
-
-        // gather chain data
-
-        for (i = 1; i < mpiNodes; ++i) {
-
-            DbAlignment*** dbAlignmentsPart = NULL;
-            int* dbAlignmentsPartLens = NULL;
-            int dbAlignmentsLen = 0;
-
-            recieveMpiData(&dbAlignmentsPart, &dbAlignmentsPartLens, &dbAlignmentsLen, 
-                queries, database, scorer, i);
-
-            ASSERT(queriesLen == dbAlignmentsLen, "machine queriesLen mismatch %d %d", queriesLen, dbAlignmentsLen);
-                    
-            dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
-                dbAlignmentsPartLens, queriesLen, maxAlignments);
-            deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
-        }
-
-        // output
         outputShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen, out, outFormat);
         deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
-
-    } else {
-
-        // create used mask only for local chains
-        char* usedMask = (char*) calloc(mpiDbOff, sizeof(char));
-
-        for (i = 0; i < queriesLen; ++i) {
-            for (j = 0; j < dbAlignmentsLens[i]; ++j) {
-                int targetIdx = dbAlignmentGetTargetIdx(dbAlignments[i][j]);
-                usedMask[targetIdx - mpiDbOff] = 1;
-            }
-        }
-
-        // send to master
-        MPI_Send(usedMask, mpiDbLen, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
-
-        sendMpiData(dbAlignments, dbAlignmentsLens, queriesLen, 0);
-        deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, queriesLen);
-
-        // clear
-        free(usedMask);
     }
 
     deleteEValueParams(eValueParams);
@@ -570,6 +333,7 @@ static void help() {
     "            bm8      - blast m8 tabular output format\n"
     "            bm9      - blast m9 commented tabular output format\n"
     "            light    - score-name tabbed output\n"
+    "            dump     - binary format for usage with swsharpout\n"
     "    --nocache\n"
     "        serialized database is stored to speed up future runs with the\n"
     "        same database, option disables this behaviour\n"
@@ -20,67 +20,973 @@ Contact the author by mkorpar@gmail.com.
 */
 
 #include <mpi.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "swsharp/swsharp.h"
+#include "swsharp/thread.h"
 
 #include "mpi_module.h"
 
+#define ASSERT(expr, fmt, ...)\
+    do {\
+        if (!(expr)) {\
+            fprintf(stderr, "[ERROR]: " fmt "\n", ##__VA_ARGS__);\
+            exit(-1);\
+        }\
+    } while(0)
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+#define MASTER_NODE 0
+
+// more chunks per node give better balancing on heterogeneous nodes
+#define NODE_CHUNKS 8
+
+#define MIN_READ_BYTES 4000000 // ~4MB
+
+#define TAG_REQUEST 2
+#define TAG_CHUNK 3
+#define TAG_HITS 4
+#define TAG_ALIGN 5
+#define TAG_ALIGNMENTS 6
+
+typedef struct Context {
+    int type;
+    Chain** queries;
+    int queriesLen;
+    Scorer* scorer;
+    int maxAlignments;
+    ValueFunction valueFunction;
+    void* valueFunctionParam;
+    double valueThreshold;
+    int* cards;
+    int cardsLen;
+    int chains;
+    int chunksLen;
+    size_t chainBytes;
+    size_t readBytes;
+    size_t cudaMemoryMax;
+    Chain** database;
+    int databaseLen;
+    int solvedLen;
+    FILE* handle;
+    int serialized;
+    DbHit** dbHits;
+    int* dbHitsLens;
+} Context;
+
+typedef struct ChunkQueue {
+    int* owners;
+    int chunksLen;
+    int next;
+    Mutex mutex;
+} ChunkQueue;
+
+typedef struct MasterContext {
+    Context* context;
+    ChunkQueue* queue;
+} MasterContext;
+
 //******************************************************************************
 // PUBLIC
 
-extern void sendMpiData(DbAlignment*** dbAlignments, int* dbAlignmentsLens, 
-    int dbAlignmentsLen, int node);
-    
-extern void recieveMpiData(DbAlignment**** dbAlignments, int** dbAlignmentsLens, 
-    int* dbAlignmentsLen, Chain** queries, Chain** database, Scorer* scorer, 
-    int node);
-    
+extern void shotgunDatabaseMpi(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, Chain*** database, int* databaseLen, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* cards, int cardsLen);
+
 //******************************************************************************
 
 //******************************************************************************
 // PRIVATE
 
-static DbAlignment* dbAlignmentFromBytes(char* bytes, Chain** queries, 
+static void masterSearch(DbAlignment**** dbAlignments, int** dbAlignmentsLens, 
+    Chain*** database, Context* context, const char* databasePath, int nodes);
+
+static void* masterThread(void* param);
+
+static void workerSearch(Context* context);
+
+static void solveChunk(Context* context, int chunk);
+
+static void solvePart(Context* context, int start, int end);
+
+static void deleteUnusedChains(Context* context, int end);
+
+static void readUsedChains(Chain*** database, const char* databasePath, 
+    char* usedMask, int usedMaskLen);
+
+static int chunkStart(Context* context, int chunk);
+
+static int chunkOf(Context* context, int idx);
+
+static ChunkQueue* chunkQueueCreate(int chunksLen);
+
+static void chunkQueueDelete(ChunkQueue* queue);
+
+static int chunkQueueNext(ChunkQueue* queue, int node);
+
+static void dbHitsMerge(DbHit** dbHitsDst, int* dbHitsDstLens, 
+    DbHit** dbHitsSrc, int* dbHitsSrcLens, int dbHitsLen, int maxAlignments);
+
+static int dbHitCmp(const void* a_, const void* b_);
+
+static void recieveBytes(char** bytes, int* node, int tag);
+
+static void dbHitsFromBytes(DbHit*** dbHits, int** dbHitsLens, 
+    int* dbHitsLen, char* bytes);
+
+static void dbHitsToBytes(char** bytes, size_t* size, DbHit** dbHits, 
+    int* dbHitsLens, int dbHitsLen);
+
+static void dbAlignmentsFromBytes(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, int* dbAlignmentsLen, char* bytes, Chain** queries,
     Chain** database, Scorer* scorer);
 
-static void dbAlignmentToBytes(char** bytes, size_t* size, 
-    DbAlignment* dbAlignment);
+static void dbAlignmentsToBytes(char** bytes, size_t* size, 
+    DbAlignment*** dbAlignments, int* dbAlignmentsLens, int dbAlignmentsLen);
 
 //******************************************************************************
 
 //******************************************************************************
 // PUBLIC
 
-extern void recieveMpiData(DbAlignment**** dbAlignments_, 
-    int** dbAlignmentsLens_, int* dbAlignmentsLen_, Chain** queries, 
-    Chain** database, Scorer* scorer, int node) {
+extern void shotgunDatabaseMpi(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, Chain*** database, int* databaseLen, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* cards, int cardsLen) {
+
+    int rank;
+    int nodes;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nodes);
+
+    int chains;
+    long long cells;
+    statFastaChains(&chains, &cells, databasePath);
+
+    Context* context = (Context*) malloc(sizeof(Context));
+
+    context->type = type;
+    context->queries = queries;
+    context->queriesLen = queriesLen;
+    context->scorer = scorer;
+    context->maxAlignments = maxAlignments;
+    context->valueFunction = valueFunction;
+    context->valueFunctionParam = valueFunctionParam;
+    context->valueThreshold = valueThreshold;
+    context->cards = cards;
+    context->cardsLen = cardsLen;
+    context->chains = chains;
+    context->chunksLen = MIN(nodes * NODE_CHUNKS, chains);
+
+    // residues and the header, used only to limit the reading ahead
+    context->chainBytes = chains == 0 ? 0 : cells / chains + 64;
+
+    if (cardsLen == 0) {
+        context->readBytes = tuneGet(TUNE_READ_BYTES);
+        context->cudaMemoryMax = 0;
+    } else {
+        size_t cudaMemory = cudaMinimalGlobalMemory(cards, cardsLen);
+        context->cudaMemoryMax = cudaMemory - 200000000; // ~200MB breathing space
+        context->readBytes = context->cudaMemoryMax * 0.075;
+    }
+
+    readFastaChainsPartInit(&(context->database), &(context->databaseLen), 
+        &(context->handle), &(context->serialized), databasePath);
+
+    context->solvedLen = 0;
+
+    context->dbHits = (DbHit**) calloc(queriesLen, sizeof(DbHit*));
+    context->dbHitsLens = (int*) calloc(queriesLen, sizeof(int));
+
+    if (rank == MASTER_NODE) {
+        masterSearch(dbAlignments, dbAlignmentsLens, database, context, 
+            databasePath, nodes);
+        *databaseLen = chains;
+    } else {
+        workerSearch(context);
+        *dbAlignments = NULL;
+        *dbAlignmentsLens = NULL;
+        *database = NULL;
+        *databaseLen = 0;
+    }
+
+    fclose(context->handle);
+
+    deleteFastaChains(context->database, context->databaseLen);
+    deleteShotgunDatabaseHits(context->dbHits, context->dbHitsLens, queriesLen);
+
+    free(context);
+}
+
+//******************************************************************************
+
+//******************************************************************************
+// PRIVATE
+
+//------------------------------------------------------------------------------
+// SEARCH
+
+static void masterSearch(DbAlignment**** dbAlignments_, 
+    int** dbAlignmentsLens_, Chain*** database_, Context* context, 
+    const char* databasePath, int nodes) {
 
     int i, j;
-    MPI_Status status;
-    
+
+    int queriesLen = context->queriesLen;
+
+    ChunkQueue* queue = chunkQueueCreate(context->chunksLen);
+
+    //**************************************************************************
+    // SCORE CHUNKS AND SERVE THE QUEUE
+
+    // master solves its chunks on a separate thread, all mpi calls are made 
+    // from this one
+    MasterContext* param = (MasterContext*) malloc(sizeof(MasterContext));
+    param->context = context;
+    param->queue = queue;
+
+    Thread thread;
+    threadCreate(&thread, masterThread, (void*) param);
+
+    MPI_Request* requests = (MPI_Request*) malloc(nodes * sizeof(MPI_Request));
+    int* chunks = (int*) malloc(nodes * sizeof(int));
+
+    for (i = 0; i < nodes; ++i) {
+        requests[i] = MPI_REQUEST_NULL;
+    }
+
+    DbHit** dbHits = (DbHit**) calloc(queriesLen, sizeof(DbHit*));
+    int* dbHitsLens = (int*) calloc(queriesLen, sizeof(int));
+
+    int workers = nodes - 1;
+
+    while (workers > 0) {
+
+        int flag;
+        MPI_Status status;
+
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_REQUEST, MPI_COMM_WORLD, &flag, &status);
+
+        if (flag) {
+
+            int node = status.MPI_SOURCE;
+
+            MPI_Recv(NULL, 0, MPI_CHAR, node, TAG_REQUEST, MPI_COMM_WORLD, 
+                MPI_STATUS_IGNORE);
+
+            // previous answer to this node has to be delivered
+            MPI_Wait(&(requests[node]), MPI_STATUS_IGNORE);
+
+            chunks[node] = chunkQueueNext(queue, node);
+
+            MPI_Isend(&(chunks[node]), 1, MPI_INT, node, TAG_CHUNK, 
+                MPI_COMM_WORLD, &(requests[node]));
+
+            continue;
+        }
+
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_HITS, MPI_COMM_WORLD, &flag, &status);
+
+        if (flag) {
+
+            int node = status.MPI_SOURCE;
+
+            char* bytes;
+            recieveBytes(&bytes, &node, TAG_HITS);
+
+            DbHit** dbHitsPart;
+            int* dbHitsPartLens;
+            int dbHitsPartLen;
+
+            dbHitsFromBytes(&dbHitsPart, &dbHitsPartLens, &dbHitsPartLen, bytes);
+            free(bytes);
+
+            ASSERT(dbHitsPartLen == queriesLen, "node %d queriesLen mismatch %d %d",
+                node, queriesLen, dbHitsPartLen);
+
+            dbHitsMerge(dbHits, dbHitsLens, dbHitsPart, dbHitsPartLens, 
+                queriesLen, context->maxAlignments);
+
+            deleteShotgunDatabaseHits(dbHitsPart, dbHitsPartLens, queriesLen);
+
+            workers--;
+
+            continue;
+        }
+
+        threadSleep(1);
+    }
+
+    MPI_Waitall(nodes, requests, MPI_STATUSES_IGNORE);
+
+    threadJoin(thread);
+    free(param);
+
+    dbHitsMerge(context->dbHits, context->dbHitsLens, dbHits, dbHitsLens, 
+        queriesLen, context->maxAlignments);
+
+    deleteShotgunDatabaseHits(dbHits, dbHitsLens, queriesLen);
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // SEND THE FINAL HITS TO THE OWNERS OF THEIR TARGETS
+
+    DbHit*** nodeHits = (DbHit***) malloc(nodes * sizeof(DbHit**));
+    int** nodeHitsLens = (int**) malloc(nodes * sizeof(int*));
+
+    for (i = 0; i < nodes; ++i) {
+
+        nodeHits[i] = (DbHit**) malloc(queriesLen * sizeof(DbHit*));
+        nodeHitsLens[i] = (int*) calloc(queriesLen, sizeof(int));
+
+        for (j = 0; j < queriesLen; ++j) {
+            size_t size = context->dbHitsLens[j] * sizeof(DbHit);
+            nodeHits[i][j] = (DbHit*) malloc(size);
+        }
+    }
+
+    int chains = context->chains;
+    char* usedMask = (char*) calloc(chains, sizeof(char));
+
+    for (i = 0; i < queriesLen; ++i) {
+        for (j = 0; j < context->dbHitsLens[i]; ++j) {
+
+            DbHit dbHit = context->dbHits[i][j];
+
+            int node = queue->owners[chunkOf(context, dbHit.targetIdx)];
+            nodeHits[node][i][nodeHitsLens[node][i]++] = dbHit;
+
+            if (node != MASTER_NODE) {
+                usedMask[dbHit.targetIdx] = 1;
+            }
+        }
+    }
+
+    char** buffers = (char**) malloc(nodes * sizeof(char*));
+
+    for (i = 0; i < nodes; ++i) {
+
+        if (i == MASTER_NODE) {
+            buffers[i] = NULL;
+            continue;
+        }
+
+        size_t size;
+        dbHitsToBytes(&(buffers[i]), &size, nodeHits[i], nodeHitsLens[i], 
+            queriesLen);
+
+        MPI_Isend(buffers[i], size, MPI_CHAR, i, TAG_ALIGN, MPI_COMM_WORLD, 
+            &(requests[i]));
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // ALIGN OWN HITS AND GATHER THE ALIGNMENTS
+
+    DbAlignment*** dbAlignments = 
+        (DbAlignment***) calloc(queriesLen, sizeof(DbAlignment**));
+    int* dbAlignmentsLens = (int*) calloc(queriesLen, sizeof(int));
+
+    DbAlignment*** dbAlignmentsPart = NULL;
+    int* dbAlignmentsPartLens = NULL;
+    int dbAlignmentsPartLen = 0;
+
+    alignDatabaseHits(&dbAlignmentsPart, &dbAlignmentsPartLens, context->type,
+        context->queries, queriesLen, context->database, nodeHits[MASTER_NODE],
+        nodeHitsLens[MASTER_NODE], context->scorer, context->cards, 
+        context->cardsLen);
+
+    dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
+        dbAlignmentsPartLens, queriesLen, context->maxAlignments);
+
+    deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
+
+    // other nodes are aligning, read their targets meanwhile
+    Chain** database = NULL;
+    readUsedChains(&database, databasePath, usedMask, chains);
+
+    for (i = 1; i < nodes; ++i) {
+
+        int node = MPI_ANY_SOURCE;
+
+        char* bytes;
+        recieveBytes(&bytes, &node, TAG_ALIGNMENTS);
+
+        dbAlignmentsFromBytes(&dbAlignmentsPart, &dbAlignmentsPartLens, 
+            &dbAlignmentsPartLen, bytes, context->queries, database, 
+            context->scorer);
+
+        free(bytes);
+
+        ASSERT(dbAlignmentsPartLen == queriesLen, "node %d queriesLen mismatch %d %d",
+            node, queriesLen, dbAlignmentsPartLen);
+
+        dbAlignmentsMerge(dbAlignments, dbAlignmentsLens, dbAlignmentsPart, 
+            dbAlignmentsPartLens, queriesLen, context->maxAlignments);
+
+        deleteShotgunDatabase(dbAlignmentsPart, dbAlignmentsPartLens, queriesLen);
+    }
+
+    MPI_Waitall(nodes, requests, MPI_STATUSES_IGNORE);
+
+    // alignments reference the own chains too
+    for (i = 0; i < context->databaseLen; ++i) {
+        if (database[i] == NULL) {
+            database[i] = context->database[i];
+            context->database[i] = NULL;
+        }
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // CLEAN MEMORY
+
+    for (i = 0; i < nodes; ++i) {
+        deleteShotgunDatabaseHits(nodeHits[i], nodeHitsLens[i], queriesLen);
+        free(buffers[i]);
+    }
+
+    free(nodeHits);
+    free(nodeHitsLens);
+    free(buffers);
+
+    free(usedMask);
+
+    free(requests);
+    free(chunks);
+
+    chunkQueueDelete(queue);
+
+    //**************************************************************************
+
+    *dbAlignments_ = dbAlignments;
+    *dbAlignmentsLens_ = dbAlignmentsLens;
+    *database_ = database;
+}
+
+static void* masterThread(void* param) {
+
+    MasterContext* masterContext = (MasterContext*) param;
+
+    Context* context = masterContext->context;
+    ChunkQueue* queue = masterContext->queue;
+
+    int chunk;
+    while ((chunk = chunkQueueNext(queue, MASTER_NODE)) != -1) {
+        solveChunk(context, chunk);
+    }
+
+    return NULL;
+}
+
+static void workerSearch(Context* context) {
+
+    int queriesLen = context->queriesLen;
+
+    int chunk;
+    MPI_Request requests[2];
+
+    MPI_Isend(NULL, 0, MPI_CHAR, MASTER_NODE, TAG_REQUEST, MPI_COMM_WORLD, 
+        &(requests[0]));
+    MPI_Irecv(&chunk, 1, MPI_INT, MASTER_NODE, TAG_CHUNK, MPI_COMM_WORLD, 
+        &(requests[1]));
+
+    while (1) {
+
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+
+        if (chunk == -1) {
+            break;
+        }
+
+        int current = chunk;
+
+        // ask for the next chunk while solving this one
+        MPI_Isend(NULL, 0, MPI_CHAR, MASTER_NODE, TAG_REQUEST, MPI_COMM_WORLD, 
+            &(requests[0]));
+        MPI_Irecv(&chunk, 1, MPI_INT, MASTER_NODE, TAG_CHUNK, MPI_COMM_WORLD, 
+            &(requests[1]));
+
+        solveChunk(context, current);
+    }
+
+    // send the best hits
+    char* buffer;
     size_t size;
-    MPI_Recv(&size, sizeof(size), MPI_CHAR, node, 1, MPI_COMM_WORLD, &status);
 
-    char* buffer = (char*) malloc(size);
-    MPI_Recv(buffer, size, MPI_CHAR, node, 0, MPI_COMM_WORLD, &status);
+    dbHitsToBytes(&buffer, &size, context->dbHits, context->dbHitsLens, 
+        queriesLen);
+
+    MPI_Request request;
+    MPI_Isend(buffer, size, MPI_CHAR, MASTER_NODE, TAG_HITS, MPI_COMM_WORLD, 
+        &request);
+
+    // align the hits which made it to the final output
+    int node = MASTER_NODE;
+
+    char* bytes;
+    recieveBytes(&bytes, &node, TAG_ALIGN);
+
+    DbHit** dbHits;
+    int* dbHitsLens;
+    int dbHitsLen;
+
+    dbHitsFromBytes(&dbHits, &dbHitsLens, &dbHitsLen, bytes);
+    free(bytes);
+
+    DbAlignment*** dbAlignments = NULL;
+    int* dbAlignmentsLens = NULL;
+
+    alignDatabaseHits(&dbAlignments, &dbAlignmentsLens, context->type, 
+        context->queries, dbHitsLen, context->database, dbHits, dbHitsLens, 
+        context->scorer, context->cards, context->cardsLen);
+
+    deleteShotgunDatabaseHits(dbHits, dbHitsLens, dbHitsLen);
+
+    dbAlignmentsToBytes(&bytes, &size, dbAlignments, dbAlignmentsLens, 
+        dbHitsLen);
+
+    MPI_Send(bytes, size, MPI_CHAR, MASTER_NODE, TAG_ALIGNMENTS, MPI_COMM_WORLD);
+
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+    deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, dbHitsLen);
+
+    free(bytes);
+    free(buffer);
+}
+
+static void solveChunk(Context* context, int chunk) {
+
+    int i;
+
+    int start = chunkStart(context, chunk);
+    int end = chunkStart(context, chunk + 1);
+
+    // chains read ahead which belong to chunks of other nodes
+    for (i = context->solvedLen; i < MIN(start, context->databaseLen); ++i) {
+        chainDelete(context->database[i]);
+        context->database[i] = NULL;
+    }
+
+    if (context->databaseLen < start) {
+        skipFastaChainsPart(&(context->database), &(context->databaseLen), 
+            context->handle, context->serialized, start - context->databaseLen);
+    }
+
+    size_t readBytes = (size_t) (end - start) * context->chainBytes;
+    readBytes = MIN(MAX(readBytes, MIN_READ_BYTES), context->readBytes);
+
+    int partStart = start;
+
+    while (partStart < end) {
+
+        if (context->databaseLen < end) {
+
+            int status = readFastaChainsPart(&(context->database), 
+                &(context->databaseLen), context->handle, context->serialized, 
+                readBytes);
+
+            ASSERT(status == 1 || context->databaseLen >= end, 
+                "database changed during the search");
+        }
+
+        int partEnd = MIN(end, context->databaseLen);
+
+        if (partEnd == partStart) {
+            readBytes *= 2; // chain is longer than the reading step
+            continue;
+        }
+
+        if (context->cardsLen > 0) {
+
+            while (partEnd > partStart) {
+
+                int length = partEnd - partStart;
+
+                size_t memory = chainDatabaseGpuMemoryConsumption(
+                    context->database + partStart, length);
+
+                // evalue
+                memory += 16 * length;
+
+                if (memory <= context->cudaMemoryMax) {
+                    break;
+                }
+
+                partEnd = partStart + length / 2;
+            }
+
+            ASSERT(partEnd > partStart, "cannot read database into CUDA memory");
+        }
+
+        solvePart(context, partStart, partEnd);
+
+        partStart = partEnd;
+    }
+
+    context->solvedLen = end;
+
+    deleteUnusedChains(context, end);
+}
+
+static void solvePart(Context* context, int start, int end) {
+
+    int queriesLen = context->queriesLen;
+
+    ChainDatabase* chainDatabase = chainDatabaseCreate(context->database, 
+        start, end - start, context->cards, context->cardsLen);
+
+    DbHit** dbHits = NULL;
+    int* dbHitsLens = NULL;
+
+    shotgunDatabaseHits(&dbHits, &dbHitsLens, context->type, context->queries, 
+        queriesLen, chainDatabase, context->scorer, context->maxAlignments, 
+        context->valueFunction, context->valueFunctionParam, 
+        context->valueThreshold, NULL, 0, context->cards, context->cardsLen, 
+        NULL);
+
+    chainDatabaseDelete(chainDatabase);
+
+    dbHitsMerge(context->dbHits, context->dbHitsLens, dbHits, dbHitsLens, 
+        queriesLen, context->maxAlignments);
+
+    deleteShotgunDatabaseHits(dbHits, dbHitsLens, queriesLen);
+}
+
+static void deleteUnusedChains(Context* context, int end) {
+
+    int i, j;
+
+    char* usedMask = (char*) calloc(end, sizeof(char));
+
+    for (i = 0; i < context->queriesLen; ++i) {
+        for (j = 0; j < context->dbHitsLens[i]; ++j) {
+            usedMask[context->dbHits[i][j].targetIdx] = 1;
+        }
+    }
+
+    for (i = 0; i < end; ++i) {
+        if (!usedMask[i] && context->database[i] != NULL) {
+            chainDelete(context->database[i]);
+            context->database[i] = NULL;
+        }
+    }
+
+    free(usedMask);
+}
+
+static void readUsedChains(Chain*** database_, const char* databasePath, 
+    char* usedMask, int usedMaskLen) {
+
+    int i;
+
+    Chain** database = (Chain**) calloc(usedMaskLen, sizeof(Chain*));
+
+    int usedLen = 0;
+    for (i = 0; i < usedMaskLen; ++i) {
+        if (usedMask[i]) {
+            usedLen = i + 1;
+        }
+    }
+
+    if (usedLen > 0) {
+
+        Chain** copyDatabase = NULL;
+        int copyDatabaseLen = 0;
+        int copyDatabaseStart = 0;
+
+        FILE* handle;
+        int serialized;
+
+        readFastaChainsPartInit(&copyDatabase, &copyDatabaseLen, &handle, 
+            &serialized, databasePath);
+
+        int status = 1;
+
+        while (status && copyDatabaseLen < usedLen) {
+
+            status = readFastaChainsPart(&copyDatabase, &copyDatabaseLen, 
+                handle, serialized, 100000000);
+
+            int length = MIN(copyDatabaseLen, usedMaskLen);
+
+            for (i = copyDatabaseStart; i < length; ++i) {
+                if (usedMask[i]) {
+                    database[i] = copyDatabase[i];
+                } else {
+                    chainDelete(copyDatabase[i]);
+                }
+                copyDatabase[i] = NULL;
+            }
+
+            copyDatabaseStart = copyDatabaseLen;
+        }
+
+        deleteFastaChains(copyDatabase, copyDatabaseLen);
+        fclose(handle);
+    }
+
+    *database_ = database;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// CHUNKS
+
+static int chunkStart(Context* context, int chunk) {
+    return (long long) chunk * context->chains / context->chunksLen;
+}
+
+static int chunkOf(Context* context, int idx) {
+
+    int chunk = (long long) idx * context->chunksLen / context->chains;
+
+    while (chunk + 1 < context->chunksLen && chunkStart(context, chunk + 1) <= idx) {
+        chunk++;
+    }
+
+    while (chunkStart(context, chunk) > idx) {
+        chunk--;
+    }
+
+    return chunk;
+}
+
+static ChunkQueue* chunkQueueCreate(int chunksLen) {
+
+    ChunkQueue* queue = (ChunkQueue*) malloc(sizeof(ChunkQueue));
+
+    queue->owners = (int*) malloc(chunksLen * sizeof(int));
+    queue->chunksLen = chunksLen;
+    queue->next = 0;
+
+    mutexCreate(&(queue->mutex));
+
+    return queue;
+}
+
+static void chunkQueueDelete(ChunkQueue* queue) {
+    mutexDelete(&(queue->mutex));
+    free(queue->owners);
+    free(queue);
+}
+
+static int chunkQueueNext(ChunkQueue* queue, int node) {
+
+    int chunk = -1;
+
+    mutexLock(&(queue->mutex));
+
+    if (queue->next < queue->chunksLen) {
+        chunk = queue->next++;
+        queue->owners[chunk] = node;
+    }
+
+    mutexUnlock(&(queue->mutex));
+
+    return chunk;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// HITS
+
+static void dbHitsMerge(DbHit** dbHitsDst, int* dbHitsDstLens, 
+    DbHit** dbHitsSrc, int* dbHitsSrcLens, int dbHitsLen, int maxAlignments) {
+
+    int i;
+    for (i = 0; i < dbHitsLen; ++i) {
+
+        int dstLen = dbHitsDstLens[i];
+        int srcLen = dbHitsSrcLens[i];
+
+        int len = dstLen + srcLen;
+
+        DbHit* dst = (DbHit*) realloc(dbHitsDst[i], MAX(len, 1) * sizeof(DbHit));
+        memcpy(dst + dstLen, dbHitsSrc[i], srcLen * sizeof(DbHit));
+
+        qsort(dst, len, sizeof(DbHit), dbHitCmp);
+
+        if (maxAlignments >= 0 && len > maxAlignments) {
+
+            // hits tied with the last one are kept, final choice between them
+            // is made on the target names by the dbAlignmentsMerge()
+            int keep = maxAlignments;
+
+            while (keep > 0 && keep < len && 
+                dst[keep].value == dst[keep - 1].value &&
+                dst[keep].score == dst[keep - 1].score) {
+                keep++;
+            }
+
+            len = keep;
+        }
+
+        dbHitsDst[i] = dst;
+        dbHitsDstLens[i] = len;
+    }
+}
+
+static int dbHitCmp(const void* a_, const void* b_) {
+
+    DbHit* a = (DbHit*) a_;
+    DbHit* b = (DbHit*) b_;
+
+    if (a->value != b->value) {
+        return a->value < b->value ? -1 : 1;
+    }
+
+    if (a->score != b->score) {
+        return b->score - a->score;
+    }
+
+    return a->targetIdx - b->targetIdx;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// MESSAGES
+
+static void recieveBytes(char** bytes, int* node, int tag) {
+
+    MPI_Status status;
+    MPI_Probe(*node, tag, MPI_COMM_WORLD, &status);
+
+    int size;
+    MPI_Get_count(&status, MPI_CHAR, &size);
+
+    *node = status.MPI_SOURCE;
+    *bytes = (char*) malloc(size);
+
+    MPI_Recv(*bytes, size, MPI_CHAR, *node, tag, MPI_COMM_WORLD, 
+        MPI_STATUS_IGNORE);
+}
+
+static void dbHitsFromBytes(DbHit*** dbHits_, int** dbHitsLens_, 
+    int* dbHitsLen_, char* bytes) {
+
+    int i, j;
+
+    size_t ptr = 0;
+
+    int dbHitsLen;
+    memcpy(&dbHitsLen, bytes + ptr, sizeof(int));
+    ptr += sizeof(int);
+
+    DbHit** dbHits = (DbHit**) malloc(dbHitsLen * sizeof(DbHit*));
+
+    int* dbHitsLens = (int*) malloc(dbHitsLen * sizeof(int));
+    memcpy(dbHitsLens, bytes + ptr, dbHitsLen * sizeof(int));
+    ptr += dbHitsLen * sizeof(int);
+
+    for (i = 0; i < dbHitsLen; ++i) {
+
+        dbHits[i] = (DbHit*) malloc(dbHitsLens[i] * sizeof(DbHit));
+
+        for (j = 0; j < dbHitsLens[i]; ++j) {
+
+            DbHit* dbHit = &(dbHits[i][j]);
+
+            memcpy(&(dbHit->queryIdx), bytes + ptr, sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(&(dbHit->targetIdx), bytes + ptr, sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(&(dbHit->score), bytes + ptr, sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(&(dbHit->value), bytes + ptr, sizeof(double));
+            ptr += sizeof(double);
+        }
+    }
+
+    *dbHits_ = dbHits;
+    *dbHitsLens_ = dbHitsLens;
+    *dbHitsLen_ = dbHitsLen;
+}
+
+static void dbHitsToBytes(char** bytes, size_t* size, DbHit** dbHits, 
+    int* dbHitsLens, int dbHitsLen) {
+
+    int i, j;
+
+    // int 1 dbHitsLen
+    // int dbHitsLen dbHitsLens
+    // int 3, double 1 for every hit
+    size_t hits = 0;
+    for (i = 0; i < dbHitsLen; ++i) {
+        hits += dbHitsLens[i];
+    }
+
+    *size = sizeof(int) * (1 + dbHitsLen) + 
+        hits * (sizeof(int) * 3 + sizeof(double));
+    *bytes = (char*) malloc(*size);
+
+    size_t ptr = 0;
+
+    memcpy(*bytes + ptr, &dbHitsLen, sizeof(int));
+    ptr += sizeof(int);
+
+    memcpy(*bytes + ptr, dbHitsLens, dbHitsLen * sizeof(int));
+    ptr += dbHitsLen * sizeof(int);
+
+    for (i = 0; i < dbHitsLen; ++i) {
+        for (j = 0; j < dbHitsLens[i]; ++j) {
+
+            DbHit* dbHit = &(dbHits[i][j]);
+
+            memcpy(*bytes + ptr, &(dbHit->queryIdx), sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(*bytes + ptr, &(dbHit->targetIdx), sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(*bytes + ptr, &(dbHit->score), sizeof(int));
+            ptr += sizeof(int);
+
+            memcpy(*bytes + ptr, &(dbHit->value), sizeof(double));
+            ptr += sizeof(double);
+        }
+    }
+}
+
+static void dbAlignmentsFromBytes(DbAlignment**** dbAlignments_, 
+    int** dbAlignmentsLens_, int* dbAlignmentsLen_, char* bytes, 
+    Chain** queries, Chain** database, Scorer* scorer) {
+
+    int i, j;
       
     size_t ptr = 0;
     
     int dbAlignmentsLen;
-    memcpy(&dbAlignmentsLen, buffer + ptr, sizeof(int));
+    memcpy(&dbAlignmentsLen, bytes + ptr, sizeof(int));
     ptr += sizeof(int);  
     
-    size = dbAlignmentsLen * sizeof(DbAlignment**);
+    size_t size = dbAlignmentsLen * sizeof(DbAlignment**);
     DbAlignment*** dbAlignments = (DbAlignment***) malloc(size);
     
-    size = dbAlignmentsLen * sizeof(int*);
+    size = dbAlignmentsLen * sizeof(int);
     int* dbAlignmentsLens = (int*) malloc(size);
     
     for (i = 0; i < dbAlignmentsLen; ++i) {
     
-        memcpy(&(dbAlignmentsLens[i]), buffer + ptr, sizeof(int));
+        memcpy(&(dbAlignmentsLens[i]), bytes + ptr, sizeof(int));
         ptr += sizeof(int);
         
         size = dbAlignmentsLens[i] * sizeof(DbAlignment*);
@@ -89,10 +995,10 @@ extern void recieveMpiData(DbAlignment**** dbAlignments_,
         for (j = 0; j < dbAlignmentsLens[i]; ++j) {
         
             size_t bytesSize;
-            memcpy(&bytesSize, buffer + ptr, sizeof(size_t));
+            memcpy(&bytesSize, bytes + ptr, sizeof(size_t));
             ptr += sizeof(size_t);
             
-            dbAlignments[i][j] = dbAlignmentFromBytes(buffer + ptr, queries, 
+            dbAlignments[i][j] = dbAlignmentDeserialize(bytes + ptr, queries, 
                 database, scorer);
             ptr += bytesSize;
         }
@@ -103,8 +1009,8 @@ extern void recieveMpiData(DbAlignment**** dbAlignments_,
     *dbAlignmentsLen_ = dbAlignmentsLen; 
 }
 
-extern void sendMpiData(DbAlignment*** dbAlignments, int* dbAlignmentsLens, 
-    int dbAlignmentsLen, int node) {
+static void dbAlignmentsToBytes(char** bytes, size_t* size, 
+    DbAlignment*** dbAlignments, int* dbAlignmentsLens, int dbAlignmentsLen) {
     
     int i, j;
     
@@ -134,10 +1040,13 @@ extern void sendMpiData(DbAlignment*** dbAlignments, int* dbAlignmentsLens,
 
         for (j = 0; j < dbAlignmentsLens[i]; ++j) {
         
-            size_t bytesSize;
-            char* bytes;
+            int dbAlignmentBytesLen;
+            char* dbAlignmentBytes;
             
-            dbAlignmentToBytes(&bytes, &bytesSize, dbAlignments[i][j]);
+            dbAlignmentSerialize(&dbAlignmentBytes, &dbAlignmentBytesLen, 
+                dbAlignments[i][j]);
+
+            size_t bytesSize = dbAlignmentBytesLen;
             
             realSize += sizeof(size_t);
             realSize += bytesSize;
@@ -150,131 +1059,15 @@ extern void sendMpiData(DbAlignment*** dbAlignments, int* dbAlignmentsLens,
             memcpy(buffer + ptr, &bytesSize, sizeof(size_t));
             ptr += sizeof(size_t);
             
-            memcpy(buffer + ptr, bytes, bytesSize);
+            memcpy(buffer + ptr, dbAlignmentBytes, bytesSize);
             ptr += bytesSize;
+
+            free(dbAlignmentBytes);
         }
     }
     
-    MPI_Send(&realSize, sizeof(size_t), MPI_CHAR, node, 1, MPI_COMM_WORLD);
-    MPI_Send(buffer, realSize, MPI_CHAR, node, 0, MPI_COMM_WORLD);
-    
-    free(buffer);
-}
-
-//******************************************************************************
-
-//******************************************************************************
-// PRIVATE
-
-//------------------------------------------------------------------------------
-// SERIALIZATION
-
-static DbAlignment* dbAlignmentFromBytes(char* bytes, Chain** queries, 
-    Chain** database, Scorer* scorer) {
-
-    int ptr = 0;
-    
-    int queryStart;
-    memcpy(&queryStart, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-    
-    int queryEnd;
-    memcpy(&queryEnd, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-
-    int queryIdx;
-    memcpy(&queryIdx, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-
-    int targetStart;
-    memcpy(&targetStart, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-
-    int targetEnd;
-    memcpy(&targetEnd, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-
-    int targetIdx;
-    memcpy(&targetIdx, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-    
-    int score;
-    memcpy(&score, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-    
-    double value;
-    memcpy(&value, bytes + ptr, sizeof(double));
-    ptr += sizeof(double);
-    
-    int pathLen;
-    memcpy(&pathLen, bytes + ptr, sizeof(int));
-    ptr += sizeof(int);
-    
-    char* path = (char*) malloc(pathLen);
-    memcpy(path, bytes + ptr, pathLen);
-    
-    Chain* query = queries[queryIdx];
-    Chain* target = database[targetIdx];
-
-    DbAlignment* dbAlignment = dbAlignmentCreate(query, queryStart, queryEnd,
-        queryIdx, target, targetStart, targetEnd, targetIdx, value, score, 
-        scorer, path, pathLen);
-    
-    return dbAlignment;
-}
-
-static void dbAlignmentToBytes(char** bytes, size_t* size, 
-    DbAlignment* dbAlignment) {
-    
-    // int 3 query
-    // int 3 target
-    // int 1 score
-    // double 1 value
-    // int 1 pathLen
-    // char pathLen path
-    *size = sizeof(int) * 8 + sizeof(double) + dbAlignmentGetPathLen(dbAlignment);
-    *bytes = (char*) malloc(*size);
-
-    int ptr = 0;
-
-    int queryStart = dbAlignmentGetQueryStart(dbAlignment);
-    memcpy(*bytes + ptr, &queryStart, sizeof(int));
-    ptr += sizeof(int);
-    
-    int queryEnd = dbAlignmentGetQueryEnd(dbAlignment);
-    memcpy(*bytes + ptr, &queryEnd, sizeof(int));
-    ptr += sizeof(int);
-    
-    int queryIdx = dbAlignmentGetQueryIdx(dbAlignment);
-    memcpy(*bytes + ptr, &queryIdx, sizeof(int));
-    ptr += sizeof(int);
-    
-    int targetStart = dbAlignmentGetTargetStart(dbAlignment);
-    memcpy(*bytes + ptr, &targetStart, sizeof(int));
-    ptr += sizeof(int);
-
-    int targetEnd = dbAlignmentGetTargetEnd(dbAlignment);
-    memcpy(*bytes + ptr, &targetEnd, sizeof(int));
-    ptr += sizeof(int);
-
-    int targetIdx = dbAlignmentGetTargetIdx(dbAlignment);
-    memcpy(*bytes + ptr, &targetIdx, sizeof(int));
-    ptr += sizeof(int);
-
-    int score = dbAlignmentGetScore(dbAlignment);
-    memcpy(*bytes + ptr, &score, sizeof(int));
-    ptr += sizeof(int);
-    
-    double value = dbAlignmentGetValue(dbAlignment);
-    memcpy(*bytes + ptr, &value, sizeof(double));
-    ptr += sizeof(double);
-    
-    int pathLen = dbAlignmentGetPathLen(dbAlignment);
-    memcpy(*bytes + ptr, &pathLen, sizeof(int));
-    ptr += sizeof(int);
-
-    dbAlignmentCopyPath(dbAlignment, *bytes + ptr);
-    ptr += pathLen;
+    *bytes = buffer;
+    *size = realSize;
 }
 
 //------------------------------------------------------------------------------
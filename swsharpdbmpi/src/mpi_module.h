@@ -28,13 +28,44 @@ Contact the author by mkorpar@gmail.com.
 extern "C" {
 #endif
 
-extern void sendMpiData(DbAlignment*** dbAlignments, int* dbAlignmentsLens, 
-    int dbAlignmentsLen, int node);
+/*!
+@brief Distributed shotgun database aligning function.
+
+Function has to be called by every MPI node. Database is split into chunks of
+chains which are handed out by the master node (rank 0) on request, so faster
+nodes solve more chunks. Every node scores its chunks and keeps only the best
+hits, see shotgunDatabaseHits(). Only the hits are sent to the master node, 
+which merges them and sends the final hits back to the nodes that own their 
+target chains. Owners align them and the alignments are gathered on the master
+node. Output is the same as the shotgunDatabase() output.
+
+@param dbAlignments output dbAlignments array of arrays, one for each query, 
+    new array of arrays is created on the master node, NULL on other nodes
+@param dbAlignmentsLens output, lengths of the output dbAlignments arrays, 
+    new array is created on the master node, NULL on other nodes
+@param database output, target chains referenced by the dbAlignments, has to
+    be deleted with deleteFastaChains() after the dbAlignments, NULL on other
+    nodes
+@param databaseLen output, database array length
+@param type aligning type, can be #SW_ALIGN, #NW_ALIGN, #HW_ALIGN or #OV_ALIGN
+@param queries query chains array, same on every node
+@param queriesLen query chains array length
+@param databasePath database file path, database is read by every node
+@param scorer scorer object used for alignment
+@param maxAlignments maximum number of alignments to return, if negative 
+    number of alignments wont be limited
+@param valueFunction function for valueing the alignment scores
+@param valueFunctionParam additional parameters for the value function
+@param valueThreshold maximum value of returned alignments
+@param cards cuda cards index array
+@param cardsLen cuda cards index array length
+*/
+extern void shotgunDatabaseMpi(DbAlignment**** dbAlignments, 
+    int** dbAlignmentsLens, Chain*** database, int* databaseLen, int type, 
+    Chain** queries, int queriesLen, const char* databasePath, Scorer* scorer, int maxAlignments, 
+    ValueFunction valueFunction, void* valueFunctionParam, 
+    double valueThreshold, int* cards, int cardsLen);
 
-extern void recieveMpiData(DbAlignment**** dbAlignments, int** dbAlignmentsLens, 
-    int* dbAlignmentsLen, Chain** queries, Chain** database, Scorer* scorer, 
-    int node);
-    
 #ifdef __cplusplus 
 }
 #endif
@@ -33,6 +33,8 @@ static struct option options[] = {
     {"outfmt", required_argument, 0, 't'},
     {"algorithm", required_argument, 0, 'A'},
     {"cpu", no_argument, 0, 'P'},
+    {"anchored", required_argument, 0, 'K'},
+    {"x-drop", required_argument, 0, 'X'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
 };
@@ -82,6 +84,9 @@ int main(int argc, char* argv[]) {
 
     int forceCpu = 0;
 
+    int seedLen = 0;
+    int xDrop = 50;
+
     while (1) {
 
         char argument = getopt_long(argc, argv, "i:j:g:e:h", options, NULL);
@@ -127,6 +132,12 @@ int main(int argc, char* argv[]) {
         case 'P':
             forceCpu = 1;
             break;
+        case 'K':
+            seedLen = atoi(optarg);
+            break;
+        case 'X':
+            xDrop = atoi(optarg);
+            break;
         case 'h':
         default:
             help();
@@ -136,6 +147,8 @@ int main(int argc, char* argv[]) {
 
     ASSERT(queryPath != NULL, "missing option -i (query file)");
     ASSERT(targetPath != NULL, "missing option -j (target file)");
+    ASSERT(seedLen >= 0, "invalid anchored seed length");
+    ASSERT(xDrop > 0, "invalid x-drop");
     
     if (forceCpu) {
         cards = NULL;
@@ -160,7 +173,23 @@ int main(int argc, char* argv[]) {
 
     threadPoolInitialize(cardsLen + 8);
 
-    if (scoreOnly) {
+    if (seedLen > 0) {
+
+        Alignment* alignment;
+        alignPairAnchored(&alignment, algorithm, query, target, scorer, seedLen, 
+            xDrop, cards, cardsLen, NULL);
+
+        ASSERT(checkAlignment(alignment), "invalid align");
+
+        if (scoreOnly) {
+            outputScore(alignmentGetScore(alignment), query, target, scorer, out);
+        } else {
+            outputAlignment(alignment, out, outFormat);
+        }
+
+        alignmentDelete(alignment);
+
+    } else if (scoreOnly) {
     
         int score;
         scorePair(&score, algorithm, query, target, scorer, cards, 
@@ -278,6 +307,15 @@ static void help() {
     "            dump      - binary format for usage with swsharpout\n"
     "    --cpu\n"
     "        only cpu is used\n"
+    "    --anchored <int>\n"
+    "        default: 0 (disabled)\n"
+    "        seed length, if given exact matches seeded by target unique k-mers\n"
+    "        are chained and only the regions between them are aligned, useful\n"
+    "        for long similar sequences, result is heuristic, only SW and NW\n"
+    "        algorithms are anchored\n"
+    "    --x-drop <int>\n"
+    "        default: 50\n"
+    "        maximal score drop when extending anchored SW alignment ends\n"
     "    -h, -help\n"
     "        prints out the help\n");
 }
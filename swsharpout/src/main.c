@@ -13,7 +13,7 @@
         }\
     } while(0)
 
-#define OUT_FORMATS_LEN (sizeof(outFormats) / sizeof(CharInt))
+#define CHAR_INT_LEN(x) (sizeof(x) / sizeof(CharInt))
 
 typedef struct CharInt {
     const char* format;
@@ -22,6 +22,8 @@ typedef struct CharInt {
 
 static struct option options[] = {
     {"alignment", required_argument, 0, 'i'},
+    {"dbalignment", required_argument, 0, 'd'},
+    {"queries", required_argument, 0, 'q'},
     {"out", required_argument, 0, 'o'},
     {"outfmt", required_argument, 0, 't'},
     {"help", no_argument, 0, 'h'},
@@ -35,20 +37,34 @@ static CharInt outFormats[] = {
     { "stat", SW_OUT_STAT }
 };
 
-static int getOutFormat(char* optarg);
+static CharInt dbOutFormats[] = {
+    { "bm0", SW_OUT_DB_BLASTM0 },
+    { "bm8", SW_OUT_DB_BLASTM8 },
+    { "bm9", SW_OUT_DB_BLASTM9 },
+    { "light", SW_OUT_DB_LIGHT },
+    { "dump", SW_OUT_DB_DUMP }
+};
+
+static int getOutFormat(char* optarg, CharInt* formats, int formatsLen);
+
+static void getQueries(int** queries, int* queriesLen, char* optarg);
 
 static void help();
 
 int main(int argc, char* argv[]) {
 
     char* alignmentPath = NULL;
+    char* dbAlignmentPath = NULL;
+
+    int* queries = NULL;
+    int queriesLen = 0;
     
     char* out = NULL;
-    int outFormat = SW_OUT_STAT_PAIR;
+    char* outFormat = NULL;
     
     while (1) {
 
-        char argument = getopt_long(argc, argv, "i:h", options, NULL);
+        char argument = getopt_long(argc, argv, "i:d:h", options, NULL);
 
         if (argument == -1) {
             break;
@@ -58,11 +74,17 @@ int main(int argc, char* argv[]) {
         case 'i':
             alignmentPath = optarg;
             break;
+        case 'd':
+            dbAlignmentPath = optarg;
+            break;
+        case 'q':
+            getQueries(&queries, &queriesLen, optarg);
+            break;
         case 'o':
             out = optarg;
             break;
         case 't':
-            outFormat = getOutFormat(optarg);
+            outFormat = optarg;
             break;
         case 'h':
         default:
@@ -71,12 +93,49 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    ASSERT(alignmentPath != NULL, "missing option -i (alignment file)");
+    ASSERT((alignmentPath != NULL) != (dbAlignmentPath != NULL), 
+        "exactly one of options -i (alignment file) and -d (database alignment "
+        "file) is required");
+
+    if (dbAlignmentPath != NULL) {
+
+        int format = getOutFormat(outFormat == NULL ? "bm9" : outFormat, 
+            dbOutFormats, CHAR_INT_LEN(dbOutFormats));
+
+        DbAlignment*** dbAlignments;
+        int* dbAlignmentsLens;
+        int dbAlignmentsLen;
+
+        Chain** chains;
+        int chainsLen;
+
+        Scorer* scorer;
+
+        readShotgunDatabase(&dbAlignments, &dbAlignmentsLens, &dbAlignmentsLen, 
+            &chains, &chainsLen, &scorer, dbAlignmentPath, queries, queriesLen);
+
+        outputShotgunDatabase(dbAlignments, dbAlignmentsLens, dbAlignmentsLen, 
+            out, format);
+
+        deleteShotgunDatabase(dbAlignments, dbAlignmentsLens, dbAlignmentsLen);
+        deleteFastaChains(chains, chainsLen);
+
+        if (scorer != NULL) {
+            scorerDelete(scorer);
+        }
+
+        free(queries);
+
+        return 0;
+    }
+
+    int format = getOutFormat(outFormat == NULL ? "pair-stat" : outFormat, 
+        outFormats, CHAR_INT_LEN(outFormats));
     
     Alignment* alignment = readAlignment(alignmentPath);
     ASSERT(checkAlignment(alignment), "invalid align");
     
-    outputAlignment(alignment, out, outFormat);
+    outputAlignment(alignment, out, format);
     
     chainDelete(alignmentGetQuery(alignment));
     chainDelete(alignmentGetTarget(alignment));
@@ -87,18 +146,51 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
-static int getOutFormat(char* optarg) {
+static int getOutFormat(char* optarg, CharInt* formats, int formatsLen) {
 
     int i;
-    for (i = 0; i < OUT_FORMATS_LEN; ++i) {
-        if (strcmp(outFormats[i].format, optarg) == 0) {
-            return outFormats[i].code;
+    for (i = 0; i < formatsLen; ++i) {
+        if (strcmp(formats[i].format, optarg) == 0) {
+            return formats[i].code;
         }
     }
 
     ASSERT(0, "unknown out format %s", optarg);
 }
 
+static void getQueries(int** queries, int* queriesLen, char* optarg) {
+
+    int size = 0;
+
+    char* token = strtok(optarg, ",");
+
+    while (token != NULL) {
+
+        int start;
+        int end;
+
+        if (sscanf(token, "%d-%d", &start, &end) != 2) {
+            ASSERT(sscanf(token, "%d", &start) == 1, "invalid queries %s", token);
+            end = start;
+        }
+
+        ASSERT(start >= 0 && start <= end, "invalid queries %s", token);
+
+        int i;
+        for (i = start; i <= end; ++i) {
+
+            if (*queriesLen == size) {
+                size = 2 * size + 16;
+                *queries = (int*) realloc(*queries, size * sizeof(int));
+            }
+
+            (*queries)[(*queriesLen)++] = i;
+        }
+
+        token = strtok(NULL, ",");
+    }
+}
+
 static void help() {
     printf(
     "usage: swsharpout -i <alignment file> [arguments ...]\n"
@@ -108,6 +200,14 @@ static void help() {
     "        (required)\n"
     "        input binary file of the alignment generated by the 'dump' output format\n"
     "        by other swsharp modules\n"
+    "    -d, --dbalignment <file>\n"
+    "        input binary file of the database alignments generated by the 'dump'\n"
+    "        output format of swsharpdb, used instead of the -i option\n"
+    "    --queries <ints>\n"
+    "        default: all queries\n"
+    "        indexes of the queries from the database alignment file to output,\n"
+    "        given as a comma separated list of indexes and ranges starting from\n"
+    "        zero, for example --queries 0,4,10-20\n"
     "    --out <string>\n"
     "        default: stdout\n"
     "        output file for the alignment\n"
@@ -119,6 +219,13 @@ static void help() {
     "            plot      - output used for plotting alignment with gnuplot \n"
     "            stat      - statistics of the alignment\n"
     "            dump      - binary format for usage with swsharpout\n"
+    "        for database alignment files default is bm9, must be one of the\n"
+    "        following:\n"
+    "            bm0       - blast m0 output format\n"
+    "            bm8       - blast m8 tabular output format\n"
+    "            bm9       - blast m9 commented tabular output format\n"
+    "            light     - score-name tabbed output\n"
+    "            dump      - binary format for usage with swsharpout\n"
     "    -h, -help\n"
     "        prints out the help\n");
 }
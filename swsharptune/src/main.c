@@ -0,0 +1,637 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include "swsharp/swsharp.h"
+
+#define ASSERT(expr, fmt, ...)\
+    do {\
+        if (!(expr)) {\
+            fprintf(stderr, "[ERROR]: " fmt "\n", ##__VA_ARGS__);\
+            exit(-1);\
+        }\
+    } while(0)
+
+#define ARRAY_LEN(x) (sizeof(x) / sizeof(*(x)))
+
+// synthetic workload, large enough to keep all threads busy for a while
+#define DATABASE_LEN    20000
+#define QUERIES_LEN     4
+#define CHAIN_MIN_LEN   100
+#define CHAIN_MAX_LEN   500
+
+#define REPEATS         3
+
+// packed/single comparisons are close near the crossover, take more samples
+#define PACKED_REPEATS  5
+
+#define MIN_READ_BYTES  100000000ll // ~100MB
+#define MAX_READ_BYTES  4000000000ll // ~4GB
+
+typedef struct Workload {
+    Chain** queries;
+    int queriesLen;
+    Chain** database;
+    int databaseLen;
+    Scorer* scorer;
+    int* cards;
+    int cardsLen;
+} Workload;
+
+static struct option options[] = {
+    {"cards", required_argument, 0, 'c'},
+    {"cpu", no_argument, 0, 'P'},
+    {"out", required_argument, 0, 'o'},
+    {"threads", required_argument, 0, 'T'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static void help();
+
+static void getCudaCards(int** cards, int* cardsLen, char* optarg);
+
+static double getTime();
+
+static double median(double* values, int len);
+
+static int doubleCmp(const void* a, const void* b);
+
+static Chain* createRandomChain(int index, int length, unsigned int* seed);
+
+static void valueFunction(double* values, int* scores, Chain* query,
+    Chain** database, int databaseLen, int* cards, int cardsLen, void* param);
+
+static double timeScoring(Workload* workload, ChainDatabase* chainDatabase,
+    int* indexes, int indexesLen, int* cards, int cardsLen);
+
+static double timeAligning(Workload* workload, ChainDatabase* chainDatabase,
+    int hitsLen);
+
+static double timePair(Workload* workload, int length, int* cards,
+    int cardsLen);
+
+static void tuneBest(int param, long long* candidates, int candidatesLen,
+    Workload* workload, ChainDatabase* chainDatabase, int* indexes,
+    int indexesLen, int hitsLen);
+
+static void tunePackedMin(Workload* workload, ChainDatabase* chainDatabase);
+
+static void tuneGpuMinCells(Workload* workload);
+
+static void tuneGpuDbScoreCells(Workload* workload);
+
+static void tuneReadBytes();
+
+int main(int argc, char* argv[]) {
+
+    char* out = NULL;
+
+    int cardsLen = -1;
+    int* cards = NULL;
+
+    int forceCpu = 0;
+
+    int threads = 8;
+
+    while (1) {
+
+        char argument = getopt_long(argc, argv, "T:h", options, NULL);
+
+        if (argument == -1) {
+            break;
+        }
+
+        switch (argument) {
+        case 'c':
+            getCudaCards(&cards, &cardsLen, optarg);
+            break;
+        case 'P':
+            forceCpu = 1;
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'T':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            help();
+            return -1;
+        }
+    }
+
+    if (forceCpu) {
+        cards = NULL;
+        cardsLen = 0;
+    } else {
+
+        if (cardsLen == -1) {
+            cudaGetCards(&cards, &cardsLen);
+        }
+
+        ASSERT(cudaCheckCards(cards, cardsLen), "invalid cuda cards");
+    }
+
+    ASSERT(threads > 0, "invalid thread number");
+
+    if (out == NULL) {
+        out = (char*) tuneProfilePath();
+        ASSERT(out != NULL, "missing option --out (profile file)");
+    }
+
+    threadPoolInitialize(threads);
+
+    //**************************************************************************
+    // CREATE WORKLOAD
+
+    unsigned int seed = 1;
+
+    int i;
+
+    Workload workload;
+    workload.queriesLen = QUERIES_LEN;
+    workload.databaseLen = DATABASE_LEN;
+    workload.cards = cards;
+    workload.cardsLen = cardsLen;
+
+    workload.queries = (Chain**) malloc(QUERIES_LEN * sizeof(Chain*));
+    for (i = 0; i < QUERIES_LEN; ++i) {
+        workload.queries[i] = createRandomChain(i, CHAIN_MAX_LEN, &seed);
+    }
+
+    workload.database = (Chain**) malloc(DATABASE_LEN * sizeof(Chain*));
+    for (i = 0; i < DATABASE_LEN; ++i) {
+        int length = CHAIN_MIN_LEN + rand_r(&seed) % (CHAIN_MAX_LEN - CHAIN_MIN_LEN);
+        workload.database[i] = createRandomChain(i, length, &seed);
+    }
+
+    scorerCreateMatrix(&(workload.scorer), "BLOSUM_62", 10, 1);
+
+    // cpu layout of the database is built only without cuda cards
+    ChainDatabase* chainDatabase = chainDatabaseCreate(workload.database, 0,
+        DATABASE_LEN, NULL, 0);
+
+    int* indexes = (int*) malloc(DATABASE_LEN * sizeof(int));
+    for (i = 0; i < DATABASE_LEN; ++i) {
+        indexes[i] = i;
+    }
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // CALIBRATE
+
+    long long threadBlocks[] = { 4, 8, 16, 32, 64 };
+    tuneBest(TUNE_CPU_THREAD_BLOCKS, threadBlocks, ARRAY_LEN(threadBlocks),
+        &workload, chainDatabase, NULL, 0, 0);
+
+    // indexed scoring does not use the interleaved layout
+    long long threadChunks[] = { 250, 500, 1000, 2000, 4000 };
+    tuneBest(TUNE_CPU_THREAD_CHUNK, threadChunks, ARRAY_LEN(threadChunks),
+        &workload, chainDatabase, indexes, DATABASE_LEN, 0);
+
+    tuneSet(TUNE_CPU_PACKED_MIN, 1);
+
+    long long packedChunks[] = { 5, 10, 25, 50, 100 };
+    tuneBest(TUNE_CPU_PACKED_CHUNK, packedChunks, ARRAY_LEN(packedChunks),
+        &workload, chainDatabase, NULL, 0, 10000);
+
+    tunePackedMin(&workload, chainDatabase);
+
+    if (cardsLen > 0) {
+        tuneGpuMinCells(&workload);
+        tuneGpuDbScoreCells(&workload);
+    }
+
+    tuneReadBytes();
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // OUTPUT
+
+    ASSERT(tuneWrite(out) == 0, "unable to write profile %s", out);
+
+    for (i = 0; i < TUNE_PARAMS_LEN; ++i) {
+        printf("%-20s %lld\n", tuneGetName(i), tuneGet(i));
+    }
+
+    printf("profile written to %s\n", out);
+
+    //**************************************************************************
+
+    //**************************************************************************
+    // CLEAN MEMORY
+
+    free(indexes);
+
+    chainDatabaseDelete(chainDatabase);
+
+    for (i = 0; i < QUERIES_LEN; ++i) {
+        chainDelete(workload.queries[i]);
+    }
+    free(workload.queries);
+
+    for (i = 0; i < DATABASE_LEN; ++i) {
+        chainDelete(workload.database[i]);
+    }
+    free(workload.database);
+
+    scorerDelete(workload.scorer);
+
+    free(cards);
+
+    threadPoolTerminate();
+
+    //**************************************************************************
+
+    return 0;
+}
+
+static void getCudaCards(int** cards, int* cardsLen, char* optarg) {
+
+    *cardsLen = strlen(optarg);
+    *cards = (int*) malloc(*cardsLen * sizeof(int));
+
+    int i;
+    for (i = 0; i < *cardsLen; ++i) {
+        (*cards)[i] = optarg[i] - '0';
+    }
+}
+
+static double getTime() {
+#ifdef _WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval time;
+    gettimeofday(&time, NULL);
+    return time.tv_sec + time.tv_usec / 1e6;
+#endif
+}
+
+static double median(double* values, int len) {
+
+    qsort(values, len, sizeof(double), doubleCmp);
+
+    if (len % 2 == 1) {
+        return values[len / 2];
+    }
+
+    return (values[len / 2 - 1] + values[len / 2]) / 2;
+}
+
+static int doubleCmp(const void* a, const void* b) {
+
+    double x = *((double*) a);
+    double y = *((double*) b);
+
+    return (x > y) - (x < y);
+}
+
+static Chain* createRandomChain(int index, int length, unsigned int* seed) {
+
+    static const char* alphabet = "ARNDCQEGHILKMFPSTWYV";
+
+    char name[32];
+    int nameLen = sprintf(name, "tune_%d", index);
+
+    char* string = (char*) malloc(length * sizeof(char));
+
+    int i;
+    for (i = 0; i < length; ++i) {
+        string[i] = alphabet[rand_r(seed) % 20];
+    }
+
+    Chain* chain = chainCreate(name, nameLen, string, length);
+
+    free(string);
+
+    return chain;
+}
+
+static void valueFunction(double* values, int* scores, Chain* query,
+    Chain** database, int databaseLen, int* cards, int cardsLen, void* param) {
+
+    int i;
+    for (i = 0; i < databaseLen; ++i) {
+        values[i] = -scores[i];
+    }
+}
+
+static double timeScoring(Workload* workload, ChainDatabase* chainDatabase,
+    int* indexes, int indexesLen, int* cards, int cardsLen) {
+
+    double best = -1;
+
+    int i;
+    for (i = 0; i < REPEATS; ++i) {
+
+        DbHit** dbHits;
+        int* dbHitsLen;
+
+        double start = getTime();
+
+        shotgunDatabaseHits(&dbHits, &dbHitsLen, SW_ALIGN, workload->queries,
+            workload->queriesLen, chainDatabase, workload->scorer, 10,
+            valueFunction, NULL, 1e9, indexes, indexesLen, cards, cardsLen,
+            NULL);
+
+        double time = getTime() - start;
+
+        deleteShotgunDatabaseHits(dbHits, dbHitsLen, workload->queriesLen);
+
+        if (best < 0 || time < best) {
+            best = time;
+        }
+    }
+
+    return best;
+}
+
+static double timeAligning(Workload* workload, ChainDatabase* chainDatabase,
+    int hitsLen) {
+
+    DbHit** dbHits;
+    int* dbHitsLen;
+
+    int maxAlignments = hitsLen / workload->queriesLen;
+
+    shotgunDatabaseHits(&dbHits, &dbHitsLen, SW_ALIGN, workload->queries,
+        workload->queriesLen, chainDatabase, workload->scorer, maxAlignments,
+        valueFunction, NULL, 1e9, NULL, 0, NULL, 0, NULL);
+
+    double best = -1;
+
+    int i;
+    for (i = 0; i < REPEATS; ++i) {
+
+        DbAlignment*** dbAlignments;
+        int* dbAlignmentsLen;
+
+        double start = getTime();
+
+        alignDatabaseHits(&dbAlignments, &dbAlignmentsLen, SW_ALIGN,
+            workload->queries, workload->queriesLen, workload->database,
+            dbHits, dbHitsLen, workload->scorer, NULL, 0);
+
+        double time = getTime() - start;
+
+        deleteShotgunDatabase(dbAlignments, dbAlignmentsLen,
+            workload->queriesLen);
+
+        if (best < 0 || time < best) {
+            best = time;
+        }
+    }
+
+    deleteShotgunDatabaseHits(dbHits, dbHitsLen, workload->queriesLen);
+
+    return best;
+}
+
+static double timePair(Workload* workload, int length, int* cards,
+    int cardsLen) {
+
+    unsigned int seed = length;
+
+    Chain* query = createRandomChain(0, length, &seed);
+    Chain* target = createRandomChain(1, length, &seed);
+
+    double best = -1;
+
+    int i;
+    for (i = 0; i < REPEATS; ++i) {
+
+        Alignment* alignment;
+
+        double start = getTime();
+
+        alignPair(&alignment, SW_ALIGN, query, target, workload->scorer,
+            cards, cardsLen, NULL);
+
+        double time = getTime() - start;
+
+        alignmentDelete(alignment);
+
+        if (best < 0 || time < best) {
+            best = time;
+        }
+    }
+
+    chainDelete(query);
+    chainDelete(target);
+
+    return best;
+}
+
+static void tuneBest(int param, long long* candidates, int candidatesLen,
+    Workload* workload, ChainDatabase* chainDatabase, int* indexes,
+    int indexesLen, int hitsLen) {
+
+    long long bestValue = tuneGet(param);
+    double bestTime = -1;
+
+    int i;
+    for (i = 0; i < candidatesLen; ++i) {
+
+        tuneSet(param, candidates[i]);
+
+        double time;
+        if (hitsLen > 0) {
+            time = timeAligning(workload, chainDatabase, hitsLen);
+        } else {
+            time = timeScoring(workload, chainDatabase, indexes, indexesLen,
+                NULL, 0);
+        }
+
+        fprintf(stderr, "%s %lld: %.3fs\n", tuneGetName(param), candidates[i],
+            time);
+
+        if (bestTime < 0 || time < bestTime) {
+            bestTime = time;
+            bestValue = candidates[i];
+        }
+    }
+
+    tuneSet(param, bestValue);
+}
+
+static void tunePackedMin(Workload* workload, ChainDatabase* chainDatabase) {
+
+    int sizes[] = { 500, 1000, 2500, 5000, 10000, 20000 };
+    int sizesLen = ARRAY_LEN(sizes);
+
+    // packing never pays off if it is not faster on the largest workload
+    long long packedMin = 2 * sizes[sizesLen - 1];
+
+    int i;
+    for (i = 0; i < sizesLen; ++i) {
+
+        double singles[PACKED_REPEATS];
+        double packeds[PACKED_REPEATS];
+
+        // interleaved so that clock drift affects both configurations alike
+        int j;
+        for (j = 0; j < PACKED_REPEATS; ++j) {
+
+            tuneSet(TUNE_CPU_PACKED_MIN, sizes[i] + 1);
+            singles[j] = timeAligning(workload, chainDatabase, sizes[i]);
+
+            tuneSet(TUNE_CPU_PACKED_MIN, 1);
+            packeds[j] = timeAligning(workload, chainDatabase, sizes[i]);
+        }
+
+        double single = median(singles, PACKED_REPEATS);
+        double packed = median(packeds, PACKED_REPEATS);
+
+        fprintf(stderr, "%s %d: %.3fs single, %.3fs packed\n",
+            tuneGetName(TUNE_CPU_PACKED_MIN), sizes[i], single, packed);
+
+        if (packed <= single) {
+            packedMin = sizes[i];
+            break;
+        }
+    }
+
+    tuneSet(TUNE_CPU_PACKED_MIN, packedMin);
+}
+
+static void tuneGpuMinCells(Workload* workload) {
+
+    tuneSet(TUNE_GPU_MIN_CELLS, 1);
+
+    int length;
+    for (length = 256; length <= 8192; length *= 2) {
+
+        double cpu = timePair(workload, length, NULL, 0);
+        double gpu = timePair(workload, length, workload->cards,
+            workload->cardsLen);
+
+        fprintf(stderr, "%s %d: %.3fs cpu, %.3fs gpu\n",
+            tuneGetName(TUNE_GPU_MIN_CELLS), length, cpu, gpu);
+
+        if (gpu < cpu) {
+            tuneSet(TUNE_GPU_MIN_CELLS, (long long) length * length);
+            return;
+        }
+    }
+
+    // the cpu is faster on every tested length, nothing was calibrated
+    tuneReset(TUNE_GPU_MIN_CELLS);
+}
+
+static void tuneGpuDbScoreCells(Workload* workload) {
+
+    long long queriesElems = 0;
+
+    int i;
+    for (i = 0; i < workload->queriesLen; ++i) {
+        queriesElems += chainGetLength(workload->queries[i]);
+    }
+
+    int sizes[] = { 250, 500, 1000, 2000, 5000, 10000, 20000 };
+
+    for (i = 0; i < ARRAY_LEN(sizes); ++i) {
+
+        int size = sizes[i];
+
+        ChainDatabase* cpuDatabase = chainDatabaseCreate(workload->database,
+            0, size, NULL, 0);
+
+        ChainDatabase* gpuDatabase = chainDatabaseCreate(workload->database,
+            0, size, workload->cards, workload->cardsLen);
+
+        long long databaseElems = 0;
+
+        int j;
+        for (j = 0; j < size; ++j) {
+            databaseElems += chainGetLength(workload->database[j]);
+        }
+
+        tuneSet(TUNE_GPU_DB_SCORE_CELLS, 1);
+
+        double cpu = timeScoring(workload, cpuDatabase, NULL, 0, NULL, 0);
+        double gpu = timeScoring(workload, gpuDatabase, NULL, 0,
+            workload->cards, workload->cardsLen);
+
+        chainDatabaseDelete(cpuDatabase);
+        chainDatabaseDelete(gpuDatabase);
+
+        fprintf(stderr, "%s %d: %.3fs cpu, %.3fs gpu\n",
+            tuneGetName(TUNE_GPU_DB_SCORE_CELLS), size, cpu, gpu);
+
+        if (gpu < cpu) {
+            tuneSet(TUNE_GPU_DB_SCORE_CELLS, queriesElems * databaseElems);
+            return;
+        }
+    }
+
+    // the cpu is faster on every tested size, nothing was calibrated
+    tuneReset(TUNE_GPU_DB_SCORE_CELLS);
+}
+
+static void tuneReadBytes() {
+
+    long long memory = 0;
+
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        memory = status.ullTotalPhys;
+    }
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        memory = (long long) pages * pageSize;
+    }
+#endif
+
+    if (memory == 0) {
+        return;
+    }
+
+    // read database parts are held next to their scoring layout and alignments
+    long long readBytes = memory / 4;
+    readBytes = readBytes < MIN_READ_BYTES ? MIN_READ_BYTES : readBytes;
+    readBytes = readBytes > MAX_READ_BYTES ? MAX_READ_BYTES : readBytes;
+
+    tuneSet(TUNE_READ_BYTES, readBytes);
+}
+
+static void help() {
+    printf(
+    "usage: swsharptune [arguments ...]\n"
+    "\n"
+    "Runs short calibration workloads on the current host and writes a tuning\n"
+    "profile which is loaded by the swsharp library at startup. Values from the\n"
+    "profile can be overridden with SWSHARP_<NAME> environment variables, for\n"
+    "example SWSHARP_CPU_THREAD_CHUNK=500.\n"
+    "\n"
+    "arguments:\n"
+    "    --out <file>\n"
+    "        default: $SWSHARP_TUNE_PROFILE or ~/.swsharp_tune\n"
+    "        output file for the tuning profile\n"
+    "    --cards <ints>\n"
+    "        default: all available CUDA cards\n"
+    "        list of cards which should be used for the gpu calibration\n"
+    "    --cpu\n"
+    "        only cpu parameters are calibrated\n"
+    "    -T, --threads <int>\n"
+    "        default: 8\n"
+    "        number of threads used in thread pool, should be the same as\n"
+    "        the one used by the other modules\n"
+    "    -h, -help\n"
+    "        prints out the help\n");
+}